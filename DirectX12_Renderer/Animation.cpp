@@ -0,0 +1,271 @@
+#include "Animation.h"
+
+using namespace DirectX;
+
+void AnimationKernels::ResetPackets(JointPacket* packets, UINT count)
+{
+    const XMVECTOR zero = XMVectorZero();
+    const XMVECTOR one = XMVectorSplatOne();
+
+    for (UINT i = 0; i < count; ++i)
+    {
+        JointPacket& p = packets[i];
+        p.Tx = zero; p.Ty = zero; p.Tz = zero;
+        p.Qx = zero; p.Qy = zero; p.Qz = zero; p.Qw = one;
+        p.Sx = one;  p.Sy = one;  p.Sz = one;
+    }
+}
+
+void AnimationKernels::StoreJoint(JointPacket* packets, UINT joint,
+    FXMVECTOR scale, FXMVECTOR rotation, FXMVECTOR translation)
+{
+    JointPacket& p = packets[joint / 4];
+    const size_t lane = joint % 4;
+
+    p.Tx = XMVectorSetByIndex(p.Tx, XMVectorGetX(translation), lane);
+    p.Ty = XMVectorSetByIndex(p.Ty, XMVectorGetY(translation), lane);
+    p.Tz = XMVectorSetByIndex(p.Tz, XMVectorGetZ(translation), lane);
+
+    p.Qx = XMVectorSetByIndex(p.Qx, XMVectorGetX(rotation), lane);
+    p.Qy = XMVectorSetByIndex(p.Qy, XMVectorGetY(rotation), lane);
+    p.Qz = XMVectorSetByIndex(p.Qz, XMVectorGetZ(rotation), lane);
+    p.Qw = XMVectorSetByIndex(p.Qw, XMVectorGetW(rotation), lane);
+
+    p.Sx = XMVectorSetByIndex(p.Sx, XMVectorGetX(scale), lane);
+    p.Sy = XMVectorSetByIndex(p.Sy, XMVectorGetY(scale), lane);
+    p.Sz = XMVectorSetByIndex(p.Sz, XMVectorGetZ(scale), lane);
+}
+
+void AnimationKernels::Interpolate(const JointPacket* a, const JointPacket* b, float t, UINT packetCount, JointPacket* out)
+{
+    const XMVECTOR vt = XMVectorReplicate(t);
+    const XMVECTOR zero = XMVectorZero();
+
+    for (UINT i = 0; i < packetCount; ++i)
+    {
+        const JointPacket& pa = a[i];
+        const JointPacket& pb = b[i];
+        JointPacket& po = out[i];
+
+        po.Tx = XMVectorMultiplyAdd(XMVectorSubtract(pb.Tx, pa.Tx), vt, pa.Tx);
+        po.Ty = XMVectorMultiplyAdd(XMVectorSubtract(pb.Ty, pa.Ty), vt, pa.Ty);
+        po.Tz = XMVectorMultiplyAdd(XMVectorSubtract(pb.Tz, pa.Tz), vt, pa.Tz);
+
+        po.Sx = XMVectorMultiplyAdd(XMVectorSubtract(pb.Sx, pa.Sx), vt, pa.Sx);
+        po.Sy = XMVectorMultiplyAdd(XMVectorSubtract(pb.Sy, pa.Sy), vt, pa.Sy);
+        po.Sz = XMVectorMultiplyAdd(XMVectorSubtract(pb.Sz, pa.Sz), vt, pa.Sz);
+
+        // Take the shortest arc: flip b wherever the lanes point into opposite hemispheres.
+        XMVECTOR dot = XMVectorMultiply(pa.Qx, pb.Qx);
+        dot = XMVectorMultiplyAdd(pa.Qy, pb.Qy, dot);
+        dot = XMVectorMultiplyAdd(pa.Qz, pb.Qz, dot);
+        dot = XMVectorMultiplyAdd(pa.Qw, pb.Qw, dot);
+        const XMVECTOR flip = XMVectorAndInt(XMVectorLess(dot, zero), XMVectorSplatSignMask());
+
+        const XMVECTOR bx = XMVectorXorInt(pb.Qx, flip);
+        const XMVECTOR by = XMVectorXorInt(pb.Qy, flip);
+        const XMVECTOR bz = XMVectorXorInt(pb.Qz, flip);
+        const XMVECTOR bw = XMVectorXorInt(pb.Qw, flip);
+
+        XMVECTOR qx = XMVectorMultiplyAdd(XMVectorSubtract(bx, pa.Qx), vt, pa.Qx);
+        XMVECTOR qy = XMVectorMultiplyAdd(XMVectorSubtract(by, pa.Qy), vt, pa.Qy);
+        XMVECTOR qz = XMVectorMultiplyAdd(XMVectorSubtract(bz, pa.Qz), vt, pa.Qz);
+        XMVECTOR qw = XMVectorMultiplyAdd(XMVectorSubtract(bw, pa.Qw), vt, pa.Qw);
+
+        XMVECTOR len2 = XMVectorMultiply(qx, qx);
+        len2 = XMVectorMultiplyAdd(qy, qy, len2);
+        len2 = XMVectorMultiplyAdd(qz, qz, len2);
+        len2 = XMVectorMultiplyAdd(qw, qw, len2);
+        const XMVECTOR invLen = XMVectorReciprocalSqrt(len2);
+
+        po.Qx = XMVectorMultiply(qx, invLen);
+        po.Qy = XMVectorMultiply(qy, invLen);
+        po.Qz = XMVectorMultiply(qz, invLen);
+        po.Qw = XMVectorMultiply(qw, invLen);
+    }
+}
+
+void AnimationKernels::SampleClip(const AnimationClip& clip, float time, JointPacket* out)
+{
+    assert(clip.SampleCount > 0);
+
+    const float frame = MathHelper::Max(time * clip.SampleRate, 0.0f);
+    const UINT last = clip.SampleCount - 1;
+    const UINT k0 = MathHelper::Min((UINT)frame, last);
+    const UINT k1 = MathHelper::Min(k0 + 1, last);
+
+    Interpolate(clip.Sample(k0), clip.Sample(k1), frame - (float)k0, clip.PacketCount, out);
+}
+
+void AnimationKernels::BuildPalette(const Skeleton& skeleton, const JointPacket* localPose,
+    XMFLOAT4X4* localMatrices, XMFLOAT4X4* palette)
+{
+    const XMVECTOR one = XMVectorSplatOne();
+    const XMVECTOR two = XMVectorReplicate(2.0f);
+    const XMVECTOR zero = XMVectorZero();
+
+    // Quaternion/scale/translation -> matrix for four joints at once.  The rows are
+    // computed in SoA form and transposed so each joint ends up with its own matrix.
+    const UINT packetCount = skeleton.PacketCount();
+    for (UINT i = 0; i < packetCount; ++i)
+    {
+        const JointPacket& p = localPose[i];
+
+        const XMVECTOR xx = XMVectorMultiply(p.Qx, p.Qx);
+        const XMVECTOR yy = XMVectorMultiply(p.Qy, p.Qy);
+        const XMVECTOR zz = XMVectorMultiply(p.Qz, p.Qz);
+        const XMVECTOR xy = XMVectorMultiply(p.Qx, p.Qy);
+        const XMVECTOR xz = XMVectorMultiply(p.Qx, p.Qz);
+        const XMVECTOR yz = XMVectorMultiply(p.Qy, p.Qz);
+        const XMVECTOR xw = XMVectorMultiply(p.Qx, p.Qw);
+        const XMVECTOR yw = XMVectorMultiply(p.Qy, p.Qw);
+        const XMVECTOR zw = XMVectorMultiply(p.Qz, p.Qw);
+
+        // Row-vector rotation matrix (matches XMMatrixRotationQuaternion), rows scaled by S.
+        XMMATRIX r0(
+            XMVectorMultiply(XMVectorNegativeMultiplySubtract(two, XMVectorAdd(yy, zz), one), p.Sx),
+            XMVectorMultiply(XMVectorMultiply(two, XMVectorAdd(xy, zw)), p.Sx),
+            XMVectorMultiply(XMVectorMultiply(two, XMVectorSubtract(xz, yw)), p.Sx),
+            zero);
+        XMMATRIX r1(
+            XMVectorMultiply(XMVectorMultiply(two, XMVectorSubtract(xy, zw)), p.Sy),
+            XMVectorMultiply(XMVectorNegativeMultiplySubtract(two, XMVectorAdd(xx, zz), one), p.Sy),
+            XMVectorMultiply(XMVectorMultiply(two, XMVectorAdd(yz, xw)), p.Sy),
+            zero);
+        XMMATRIX r2(
+            XMVectorMultiply(XMVectorMultiply(two, XMVectorAdd(xz, yw)), p.Sz),
+            XMVectorMultiply(XMVectorMultiply(two, XMVectorSubtract(yz, xw)), p.Sz),
+            XMVectorMultiply(XMVectorNegativeMultiplySubtract(two, XMVectorAdd(xx, yy), one), p.Sz),
+            zero);
+        XMMATRIX r3(p.Tx, p.Ty, p.Tz, one);
+
+        r0 = XMMatrixTranspose(r0);
+        r1 = XMMatrixTranspose(r1);
+        r2 = XMMatrixTranspose(r2);
+        r3 = XMMatrixTranspose(r3);
+
+        for (UINT lane = 0; lane < 4; ++lane)
+        {
+            XMMATRIX m(r0.r[lane], r1.r[lane], r2.r[lane], r3.r[lane]);
+            XMStoreFloat4x4(&localMatrices[i * 4 + lane], m);
+        }
+    }
+
+    // Walk the hierarchy; parents precede children so their model transform is final.
+    const UINT jointCount = skeleton.JointCount();
+    for (UINT j = 0; j < jointCount; ++j)
+    {
+        XMMATRIX model = XMLoadFloat4x4(&localMatrices[j]);
+
+        const int parent = skeleton.ParentIndices[j];
+        if (parent >= 0)
+        {
+            model = XMMatrixMultiply(model, XMLoadFloat4x4(&localMatrices[parent]));
+            XMStoreFloat4x4(&localMatrices[j], model);
+        }
+
+        XMMATRIX inverseBind = XMLoadFloat4x4(&skeleton.InverseBindPose[j]);
+        XMStoreFloat4x4(&palette[j], XMMatrixMultiply(inverseBind, model));
+    }
+}
+
+AnimationSystem::AnimationSystem()
+{
+    __int64 countsPerSec;
+    QueryPerformanceFrequency((LARGE_INTEGER*)&countsPerSec);
+    mSecondsPerCount = 1.0 / (double)countsPerSec;
+}
+
+void AnimationSystem::SetSkeleton(const Skeleton* skeleton)
+{
+    mSkeleton = skeleton;
+    mInstances.clear();
+    mNextInstance = 0;
+
+    const UINT packetCount = skeleton->PacketCount();
+    mPose.resize(packetCount);
+    mBlendPose.resize(packetCount);
+    mLocalMatrices.resize((size_t)packetCount * 4);
+}
+
+UINT AnimationSystem::AddInstance(const AnimationClip* clip)
+{
+    assert(mSkeleton != nullptr);
+    assert(clip->PacketCount == mSkeleton->PacketCount());
+
+    AnimationInstance instance;
+    instance.Clip = clip;
+    instance.Palette.resize(mSkeleton->JointCount(), MathHelper::Identity4x4());
+    instance.FramesStale = 1;
+    mInstances.push_back(std::move(instance));
+
+    return (UINT)mInstances.size() - 1;
+}
+
+void AnimationSystem::Update(float dt, float budgetMs)
+{
+    mStats = Stats();
+    if (mSkeleton == nullptr || mInstances.empty())
+        return;
+
+    for (auto& e : mInstances)
+    {
+        const float duration = e.Clip->Duration();
+        e.Time += dt * e.Speed;
+        if (e.Loop && duration > 0.0f)
+        {
+            e.Time = fmodf(e.Time, duration);
+            if (e.Time < 0.0f)
+                e.Time += duration;
+        }
+        else
+        {
+            e.Time = MathHelper::Clamp(e.Time, 0.0f, duration);
+        }
+        e.FramesStale++;
+    }
+
+    const double start = Seconds();
+    const double budget = budgetMs * 0.001;
+    const UINT count = (UINT)mInstances.size();
+
+    for (UINT i = 0; i < count; ++i)
+    {
+        // Reading the performance counter costs more than a small skeleton,
+        // so only check the budget every few instances.
+        if (budget > 0.0 && i > 0 && (i % 8) == 0 && Seconds() - start >= budget)
+            break;
+
+        Evaluate(mInstances[mNextInstance]);
+        mNextInstance = (mNextInstance + 1) % count;
+        mStats.InstancesEvaluated++;
+    }
+
+    mStats.JointsEvaluated = mStats.InstancesEvaluated * mSkeleton->JointCount();
+    mStats.Milliseconds = (float)((Seconds() - start) * 1000.0);
+}
+
+void AnimationSystem::Evaluate(AnimationInstance& instance)
+{
+    AnimationKernels::SampleClip(*instance.Clip, instance.Time, mPose.data());
+
+    if (instance.BlendClip != nullptr && instance.BlendWeight > 0.0f)
+    {
+        // Sample the second clip at the same normalized phase so gait cycles stay in step.
+        const float duration = instance.Clip->Duration();
+        const float phase = duration > 0.0f ? instance.Time / duration : 0.0f;
+        AnimationKernels::SampleClip(*instance.BlendClip, phase * instance.BlendClip->Duration(), mBlendPose.data());
+        AnimationKernels::Interpolate(mPose.data(), mBlendPose.data(), instance.BlendWeight,
+            mSkeleton->PacketCount(), mPose.data());
+    }
+
+    AnimationKernels::BuildPalette(*mSkeleton, mPose.data(), mLocalMatrices.data(), instance.Palette.data());
+    instance.FramesStale = 0;
+}
+
+double AnimationSystem::Seconds()const
+{
+    __int64 counts;
+    QueryPerformanceCounter((LARGE_INTEGER*)&counts);
+    return counts * mSecondsPerCount;
+}
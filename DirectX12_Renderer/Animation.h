@@ -0,0 +1,141 @@
+#pragma once
+
+#include "d3dUtil.h"
+
+// Local transforms of four consecutive joints in structure-of-arrays form.  Each
+// member holds one component for the four joints, so the sampling and blending
+// kernels below handle a whole packet with a few SSE instructions and no shuffles.
+struct JointPacket
+{
+    DirectX::XMVECTOR Tx, Ty, Tz;
+    DirectX::XMVECTOR Qx, Qy, Qz, Qw;
+    DirectX::XMVECTOR Sx, Sy, Sz;
+};
+
+struct Skeleton
+{
+    std::vector<std::string> JointNames;
+
+    // Parent joint index, or -1 for a root.  Parents always precede their children,
+    // so a single forward pass resolves the hierarchy.
+    std::vector<int> ParentIndices;
+
+    // Transforms model space into each joint's bind space (row-vector convention).
+    std::vector<DirectX::XMFLOAT4X4> InverseBindPose;
+
+    UINT JointCount()const { return (UINT)ParentIndices.size(); }
+    UINT PacketCount()const { return (JointCount() + 3) / 4; }
+};
+
+// An animation resampled at a fixed rate.  Every key holds PacketCount joint
+// packets so sampling never searches for keyframes; padding lanes are identity.
+struct AnimationClip
+{
+    std::string Name;
+
+    float SampleRate = 30.0f;
+    UINT SampleCount = 0;
+    UINT PacketCount = 0;
+
+    std::vector<JointPacket> Samples;
+
+    float Duration()const
+    {
+        return SampleCount > 1 ? (float)(SampleCount - 1) / SampleRate : 0.0f;
+    }
+
+    const JointPacket* Sample(UINT index)const
+    {
+        return &Samples[(size_t)index * PacketCount];
+    }
+};
+
+struct AnimationInstance
+{
+    const AnimationClip* Clip = nullptr;
+
+    // Optional second clip cross-faded in by BlendWeight.
+    const AnimationClip* BlendClip = nullptr;
+    float BlendWeight = 0.0f;
+
+    float Time = 0.0f;
+    float Speed = 1.0f;
+    bool Loop = true;
+
+    // Final skinning matrices (inverse bind * model), row-vector convention.
+    std::vector<DirectX::XMFLOAT4X4> Palette;
+
+    // Frames since Palette was last rebuilt; non-zero when the budget ran out.
+    UINT FramesStale = 0;
+};
+
+namespace AnimationKernels
+{
+    // Sets count packets to the identity transform.
+    void ResetPackets(JointPacket* packets, UINT count);
+
+    // Writes the transform of one joint into its lane of a packet array.
+    void StoreJoint(JointPacket* packets, UINT joint,
+        DirectX::FXMVECTOR scale, DirectX::FXMVECTOR rotation, DirectX::FXMVECTOR translation);
+
+    // out = lerp(a, b, t) for translation/scale and shortest-path nlerp for rotation.
+    void Interpolate(const JointPacket* a, const JointPacket* b, float t, UINT packetCount, JointPacket* out);
+
+    // Samples clip at time (seconds, already wrapped into [0, Duration]).
+    void SampleClip(const AnimationClip& clip, float time, JointPacket* out);
+
+    // Converts a local pose into skinning matrices.  localMatrices is scratch
+    // space of at least PacketCount*4 entries and receives the model transforms.
+    void BuildPalette(const Skeleton& skeleton, const JointPacket* localPose,
+        DirectX::XMFLOAT4X4* localMatrices, DirectX::XMFLOAT4X4* palette);
+}
+
+// Evaluates many instances of one skeleton per frame.  Instance times always
+// advance, but poses are only rebuilt while the frame's time budget lasts;
+// evaluation resumes round-robin next frame so every instance is refreshed.
+class AnimationSystem
+{
+public:
+    struct Stats
+    {
+        UINT InstancesEvaluated = 0;
+        UINT JointsEvaluated = 0;
+        float Milliseconds = 0.0f;
+    };
+
+    AnimationSystem();
+    AnimationSystem(const AnimationSystem& rhs) = delete;
+    AnimationSystem& operator=(const AnimationSystem& rhs) = delete;
+
+    void SetSkeleton(const Skeleton* skeleton);
+    const Skeleton* GetSkeleton()const { return mSkeleton; }
+
+    UINT AddInstance(const AnimationClip* clip);
+    AnimationInstance& GetInstance(UINT index) { return mInstances[index]; }
+    UINT InstanceCount()const { return (UINT)mInstances.size(); }
+
+    // Advances all instances by dt and rebuilds as many palettes as fit in budgetMs.
+    // A budget <= 0 evaluates every instance.
+    void Update(float dt, float budgetMs);
+
+    // Rebuilds a single instance's palette immediately.
+    void Evaluate(AnimationInstance& instance);
+
+    const Stats& GetStats()const { return mStats; }
+
+private:
+    double Seconds()const;
+
+private:
+    const Skeleton* mSkeleton = nullptr;
+    std::vector<AnimationInstance> mInstances;
+    UINT mNextInstance = 0;
+
+    // Scratch poses shared by all instances; evaluation is single threaded.
+    std::vector<JointPacket> mPose;
+    std::vector<JointPacket> mBlendPose;
+    std::vector<DirectX::XMFLOAT4X4> mLocalMatrices;
+
+    double mSecondsPerCount = 0.0;
+    Stats mStats;
+};
@@ -0,0 +1,178 @@
+#include "AnimationImporter.h"
+
+using namespace DirectX;
+
+bool AnimationImporter::LoadFbx(const std::string& filename, Skeleton& skeleton,
+    std::vector<AnimationClip>& clips, float sampleRate)
+{
+    FbxManager* fbxManager = FbxManager::Create();
+    FbxIOSettings* ios = FbxIOSettings::Create(fbxManager, IOSROOT);
+    fbxManager->SetIOSettings(ios);
+    FbxImporter* fbxImporter = FbxImporter::Create(fbxManager, "");
+    FbxScene* fbxScene = FbxScene::Create(fbxManager, "");
+
+    if (!fbxImporter->Initialize(filename.c_str(), -1, fbxManager->GetIOSettings()) ||
+        !fbxImporter->Import(fbxScene))
+    {
+        fbxImporter->Destroy();
+        fbxManager->Destroy();
+        return false;
+    }
+    fbxImporter->Destroy();
+
+    skeleton = Skeleton();
+    clips.clear();
+
+    std::vector<FbxNode*> nodes;
+    CollectJoints(fbxScene->GetRootNode(), -1, skeleton, nodes);
+
+    if (nodes.empty())
+    {
+        fbxManager->Destroy();
+        return false;
+    }
+
+    LoadInverseBindPose(fbxScene, nodes, skeleton);
+
+    const int stackCount = fbxScene->GetSrcObjectCount<FbxAnimStack>();
+    for (int i = 0; i < stackCount; ++i)
+    {
+        AnimationClip clip;
+        LoadClip(fbxScene, fbxScene->GetSrcObject<FbxAnimStack>(i), nodes, skeleton, sampleRate, clip);
+        clips.push_back(std::move(clip));
+    }
+
+    fbxManager->Destroy();
+    return true;
+}
+
+XMFLOAT4X4 AnimationImporter::ToDirectXMatrix(const FbxAMatrix& m)
+{
+    // FbxAMatrix keeps the translation in row 3, which is already the layout
+    // DirectXMath expects for row vectors.  Only the y/z swap is needed.
+    static const int axis[4] = { 0, 2, 1, 3 };
+
+    XMFLOAT4X4 result;
+    for (int r = 0; r < 4; ++r)
+    {
+        for (int c = 0; c < 4; ++c)
+        {
+            result(r, c) = static_cast<float>(m.Get(axis[r], axis[c]));
+        }
+    }
+    return result;
+}
+
+void AnimationImporter::CollectJoints(FbxNode* node, int parent, Skeleton& skeleton, std::vector<FbxNode*>& nodes)
+{
+    int index = parent;
+
+    FbxNodeAttribute* attribute = node->GetNodeAttribute();
+    if (attribute != nullptr && attribute->GetAttributeType() == FbxNodeAttribute::eSkeleton)
+    {
+        index = (int)skeleton.ParentIndices.size();
+        skeleton.JointNames.push_back(node->GetName());
+        skeleton.ParentIndices.push_back(parent);
+        nodes.push_back(node);
+    }
+
+    for (int i = 0; i < node->GetChildCount(); ++i)
+    {
+        CollectJoints(node->GetChild(i), index, skeleton, nodes);
+    }
+}
+
+void AnimationImporter::LoadInverseBindPose(FbxScene* scene, const std::vector<FbxNode*>& nodes, Skeleton& skeleton)
+{
+    const UINT jointCount = (UINT)nodes.size();
+    skeleton.InverseBindPose.resize(jointCount);
+
+    // Joints that do not drive any vertices fall back to their default pose.
+    for (UINT j = 0; j < jointCount; ++j)
+    {
+        XMFLOAT4X4 global = ToDirectXMatrix(nodes[j]->EvaluateGlobalTransform());
+        XMMATRIX M = XMLoadFloat4x4(&global);
+        XMStoreFloat4x4(&skeleton.InverseBindPose[j], XMMatrixInverse(&XMMatrixDeterminant(M), M));
+    }
+
+    // Skin clusters carry the real bind pose: mesh transform and joint transform at bind time.
+    const int meshCount = scene->GetSrcObjectCount<FbxMesh>();
+    for (int i = 0; i < meshCount; ++i)
+    {
+        FbxMesh* mesh = scene->GetSrcObject<FbxMesh>(i);
+
+        for (int d = 0; d < mesh->GetDeformerCount(FbxDeformer::eSkin); ++d)
+        {
+            FbxSkin* skin = static_cast<FbxSkin*>(mesh->GetDeformer(d, FbxDeformer::eSkin));
+
+            for (int c = 0; c < skin->GetClusterCount(); ++c)
+            {
+                FbxCluster* cluster = skin->GetCluster(c);
+                auto it = std::find(nodes.begin(), nodes.end(), cluster->GetLink());
+                if (it == nodes.end())
+                    continue;
+
+                FbxAMatrix meshMatrix;
+                FbxAMatrix linkMatrix;
+                cluster->GetTransformMatrix(meshMatrix);
+                cluster->GetTransformLinkMatrix(linkMatrix);
+
+                XMFLOAT4X4 mesh4x4 = ToDirectXMatrix(meshMatrix);
+                XMFLOAT4X4 link4x4 = ToDirectXMatrix(linkMatrix);
+                XMMATRIX meshM = XMLoadFloat4x4(&mesh4x4);
+                XMMATRIX linkM = XMLoadFloat4x4(&link4x4);
+
+                XMMATRIX inverseBind = XMMatrixMultiply(meshM, XMMatrixInverse(&XMMatrixDeterminant(linkM), linkM));
+                XMStoreFloat4x4(&skeleton.InverseBindPose[it - nodes.begin()], inverseBind);
+            }
+        }
+    }
+}
+
+void AnimationImporter::LoadClip(FbxScene* scene, FbxAnimStack* stack, const std::vector<FbxNode*>& nodes,
+    const Skeleton& skeleton, float sampleRate, AnimationClip& clip)
+{
+    scene->SetCurrentAnimationStack(stack);
+
+    FbxTimeSpan span = stack->GetLocalTimeSpan();
+    const double start = span.GetStart().GetSecondDouble();
+    const double duration = MathHelper::Max(span.GetDuration().GetSecondDouble(), 0.0);
+
+    const UINT jointCount = skeleton.JointCount();
+
+    clip.Name = stack->GetName();
+    clip.SampleRate = sampleRate;
+    clip.SampleCount = (UINT)(duration * sampleRate + 0.5) + 1;
+    clip.PacketCount = skeleton.PacketCount();
+    clip.Samples.resize((size_t)clip.SampleCount * clip.PacketCount);
+
+    std::vector<XMFLOAT4X4> globals(jointCount);
+
+    for (UINT k = 0; k < clip.SampleCount; ++k)
+    {
+        FbxTime time;
+        time.SetSecondDouble(start + MathHelper::Min(k / (double)sampleRate, duration));
+
+        JointPacket* sample = &clip.Samples[(size_t)k * clip.PacketCount];
+        AnimationKernels::ResetPackets(sample, clip.PacketCount);
+
+        // Locals are taken relative to the parent joint rather than the parent node,
+        // so helper nodes between joints are folded into the child transform.
+        for (UINT j = 0; j < jointCount; ++j)
+        {
+            globals[j] = ToDirectXMatrix(nodes[j]->EvaluateGlobalTransform(time));
+
+            XMMATRIX local = XMLoadFloat4x4(&globals[j]);
+            const int parent = skeleton.ParentIndices[j];
+            if (parent >= 0)
+            {
+                XMMATRIX parentGlobal = XMLoadFloat4x4(&globals[parent]);
+                local = XMMatrixMultiply(local, XMMatrixInverse(&XMMatrixDeterminant(parentGlobal), parentGlobal));
+            }
+
+            XMVECTOR s, q, t;
+            XMMatrixDecompose(&s, &q, &t, local);
+            AnimationKernels::StoreJoint(sample, j, s, q, t);
+        }
+    }
+}
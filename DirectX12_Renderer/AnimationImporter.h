@@ -0,0 +1,26 @@
+#pragma once
+
+#include "Animation.h"
+#include <fbxsdk.h>
+
+// Pulls skeletons, skin bind poses and animation stacks out of FBX files and
+// resamples them into the fixed-rate SoA clips consumed by AnimationSystem.
+class AnimationImporter
+{
+public:
+    // Loads the skeleton and every animation stack in filename.  Returns false
+    // if the file cannot be opened or contains no skeleton.
+    static bool LoadFbx(const std::string& filename, Skeleton& skeleton,
+        std::vector<AnimationClip>& clips, float sampleRate = 30.0f);
+
+    // Converts an FBX matrix into the renderer's left-handed, y-up space.
+    // LoadCharacters swaps the y and z axes of the control points, so joints
+    // get the same permutation applied on both sides (P * M * P).
+    static DirectX::XMFLOAT4X4 ToDirectXMatrix(const FbxAMatrix& m);
+
+private:
+    static void CollectJoints(FbxNode* node, int parent, Skeleton& skeleton, std::vector<FbxNode*>& nodes);
+    static void LoadInverseBindPose(FbxScene* scene, const std::vector<FbxNode*>& nodes, Skeleton& skeleton);
+    static void LoadClip(FbxScene* scene, FbxAnimStack* stack, const std::vector<FbxNode*>& nodes,
+        const Skeleton& skeleton, float sampleRate, AnimationClip& clip);
+};
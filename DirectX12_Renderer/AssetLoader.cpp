@@ -0,0 +1,204 @@
+#include "AssetLoader.h"
+
+AssetLoader::~AssetLoader()
+{
+    Shutdown();
+}
+
+void AssetLoader::Initialize(const AssetLoaderDesc& desc)
+{
+    assert(mThreads.empty() && desc.DecodeThreads >= 1);
+
+    mDesc = desc;
+    mQuit = false;
+    mThreads.emplace_back(&AssetLoader::IoMain, this);
+    for (UINT i = 0; i < desc.DecodeThreads; ++i)
+        mThreads.emplace_back(&AssetLoader::DecodeMain, this);
+}
+
+void AssetLoader::Shutdown()
+{
+    if (mThreads.empty())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mQuit = true;
+    }
+    mWakeIo.notify_all();
+    mWakeDecode.notify_all();
+
+    for (auto& t : mThreads)
+        t.join();
+    mThreads.clear();
+
+    for (Queue* queue : { &mReads, &mDecodes })
+    {
+        while (!queue->empty())
+        {
+            delete queue->top();
+            queue->pop();
+        }
+    }
+    for (Item* item : mFinished)
+        delete item;
+    for (Item* item : mArrived)
+        delete item;
+    mFinished.clear();
+    mArrived.clear();
+    mStats.Pending = 0;
+}
+
+void AssetLoader::Load(Request request)
+{
+    assert(!mThreads.empty() && request.Ready);
+
+    Item* item = new Item();
+    item->Req = std::move(request);
+    item->Sequence = mSequence++;
+    item->QueuedTime = Now();
+    mStats.Pending++;
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (item->Req.Read)
+            mReads.push(item);
+        else if (item->Req.Decode)
+            mDecodes.push(item);
+        else
+            mFinished.push_back(item);
+    }
+    mWakeIo.notify_one();
+    mWakeDecode.notify_one();
+}
+
+void AssetLoader::Update()
+{
+    mStats.Readied = 0;
+    mStats.UploadBytes = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mArrived.insert(mArrived.end(), mFinished.begin(), mFinished.end());
+        mFinished.clear();
+        mStats.ReadSeconds = mReadSeconds;
+        mStats.DecodeSeconds = mDecodeSeconds;
+    }
+    if (mArrived.empty())
+        return;
+
+    // Most urgent last, so the ones done are popped off the back.
+    std::sort(mArrived.begin(), mArrived.end(), Later());
+
+    const double now = Now();
+    while (!mArrived.empty())
+    {
+        if (mStats.Readied > 0 && mStats.UploadBytes >= mDesc.MaxUploadBytesPerFrame)
+            break;
+
+        std::unique_ptr<Item> item(mArrived.back());
+        mArrived.pop_back();
+
+        // May queue further requests.
+        mStats.UploadBytes += item->Req.Ready(item->Loaded);
+
+        if (item->Loaded)
+            mStats.Loaded++;
+        else
+            mStats.Failed++;
+        mStats.Readied++;
+        mStats.Pending--;
+        mStats.LatencySeconds += now - item->QueuedTime;
+    }
+}
+
+void AssetLoader::IoMain()
+{
+    for (;;)
+    {
+        Item* item;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mWakeIo.wait(lock, [this]() { return mQuit || !mReads.empty(); });
+            if (mQuit)
+                return;
+            item = mReads.top();
+            mReads.pop();
+        }
+
+        double seconds = 0.0;
+        item->Loaded = Run(item->Req.Read, seconds);
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mReadSeconds += seconds;
+            if (item->Loaded && item->Req.Decode)
+                mDecodes.push(item);
+            else
+                mFinished.push_back(item);
+        }
+        mWakeDecode.notify_one();
+    }
+}
+
+void AssetLoader::DecodeMain()
+{
+    for (;;)
+    {
+        Item* item;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mWakeDecode.wait(lock, [this]() { return mQuit || !mDecodes.empty(); });
+            if (mQuit)
+                return;
+            item = mDecodes.top();
+            mDecodes.pop();
+        }
+
+        double seconds = 0.0;
+        item->Loaded = Run(item->Req.Decode, seconds);
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        mDecodeSeconds += seconds;
+        mFinished.push_back(item);
+    }
+}
+
+bool AssetLoader::Run(const Step& step, double& seconds)
+{
+    const double start = Now();
+    bool ok;
+    try
+    {
+        ok = step();
+    }
+    catch (...)
+    {
+        ok = false;
+    }
+    seconds = Now() - start;
+    return ok;
+}
+
+void AssetLoader::Prefetch(const void* data, UINT64 byteSize)
+{
+    const volatile BYTE* bytes = static_cast<const volatile BYTE*>(data);
+    BYTE sum = 0;
+    for (UINT64 offset = 0; offset < byteSize; offset += 4096)
+        sum += bytes[offset];
+    (void)sum;
+}
+
+double AssetLoader::Now()
+{
+    static const double secondsPerCount = []()
+    {
+        __int64 countsPerSec;
+        QueryPerformanceFrequency((LARGE_INTEGER*)&countsPerSec);
+        return 1.0 / (double)countsPerSec;
+    }();
+
+    __int64 counts;
+    QueryPerformanceCounter((LARGE_INTEGER*)&counts);
+    return counts * secondsPerCount;
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include "d3dUtil.h"
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+
+enum class AssetPriority
+{
+    High,           // Wanted for the first frames.
+    Normal,
+    Low,            // Background content.
+};
+
+struct AssetLoaderDesc
+{
+    // Threads running Decode steps, in addition to the I/O thread.
+    UINT DecodeThreads = 2;
+
+    // Bytes the Ready steps of one frame may upload.  One asset always gets
+    // through, however large.
+    UINT64 MaxUploadBytesPerFrame = 8ull * 1024 * 1024;
+};
+
+// Loads assets in the background and hands them to the render thread once
+// they are ready, so startup does not wait for them.
+//   - Load queues a request of three steps.  One I/O thread runs the Read
+//     steps (open, map and fault in the file) highest priority first, in
+//     order of arrival within a priority; reads stay on one thread so the
+//     disk sees one stream at a time.
+//   - Requests that have been read go to the decode threads for their Decode
+//     step (import, cook, convert), again by priority.
+//   - Update runs the Ready steps of finished requests on the render thread,
+//     where they create the GPU resources and render items.  Ready returns
+//     the bytes it uploaded; once a frame's uploads reach the cap the rest
+//     wait for the next frame.  The caller submits the frame's uploads as
+//     one batch.
+//   - A failed Read or Decode goes straight to Ready with loaded false.
+// The steps share state through what they capture.  Read and Decode run on
+// the loader's threads and must not touch anything else.
+class AssetLoader
+{
+public:
+    typedef std::function<bool()> Step;
+    typedef std::function<UINT64(bool loaded)> ReadyStep;
+
+    struct Request
+    {
+        std::string Name;
+        AssetPriority Priority = AssetPriority::Normal;
+        Step Read;          // Either may be empty.
+        Step Decode;
+        ReadyStep Ready;
+    };
+
+    struct Stats
+    {
+        UINT Pending = 0;           // Queued and not through Ready yet.
+        UINT Loaded = 0;
+        UINT Failed = 0;
+
+        // This frame.
+        UINT Readied = 0;
+        UINT64 UploadBytes = 0;
+
+        // Over the whole run, summed over the assets.
+        double ReadSeconds = 0.0;
+        double DecodeSeconds = 0.0;
+        double LatencySeconds = 0.0;    // From Load to Ready.
+    };
+
+    AssetLoader() = default;
+    AssetLoader(const AssetLoader& rhs) = delete;
+    AssetLoader& operator=(const AssetLoader& rhs) = delete;
+    ~AssetLoader();
+
+    void Initialize(const AssetLoaderDesc& desc);
+
+    // Waits for the steps running and drops the requests not through yet;
+    // their Ready steps are never called.
+    void Shutdown();
+
+    // Render thread, including from a Ready step.
+    void Load(Request request);
+
+    // Render thread, once per frame: runs the Ready steps of finished
+    // requests, most urgent first, up to the frame's upload cap.
+    void Update();
+
+    UINT Pending()const { return mStats.Pending; }
+    const Stats& GetStats()const { return mStats; }
+
+    // Touches every page of data, so that a mapped file is read on the
+    // calling thread rather than by whoever uses it first.
+    static void Prefetch(const void* data, UINT64 byteSize);
+
+    // Performance counter time in seconds, for load timings.
+    static double Now();
+
+private:
+    struct Item
+    {
+        Request Req;
+        UINT64 Sequence = 0;
+        bool Loaded = true;
+        double QueuedTime = 0.0;
+    };
+
+    // Orders the queues highest priority first, then oldest first.
+    struct Later
+    {
+        bool operator()(const Item* a, const Item* b)const
+        {
+            return a->Req.Priority != b->Req.Priority ? a->Req.Priority > b->Req.Priority : a->Sequence > b->Sequence;
+        }
+    };
+
+    typedef std::priority_queue<Item*, std::vector<Item*>, Later> Queue;
+
+    void IoMain();
+    void DecodeMain();
+
+    // Runs step, timing it into seconds; a throw counts as a failure.
+    bool Run(const Step& step, double& seconds);
+
+private:
+    AssetLoaderDesc mDesc;
+    UINT64 mSequence = 0;
+    std::vector<Item*> mArrived;    // Render thread: finished, waiting for Ready.
+    Stats mStats;
+
+    // Shared with the threads.
+    std::vector<std::thread> mThreads;
+    std::mutex mMutex;
+    std::condition_variable mWakeIo;
+    std::condition_variable mWakeDecode;
+    Queue mReads;
+    Queue mDecodes;
+    std::vector<Item*> mFinished;
+    double mReadSeconds = 0.0;
+    double mDecodeSeconds = 0.0;
+    bool mQuit = false;
+};
@@ -0,0 +1,2302 @@
+#include "Benchmark.h"
+#include "Animation.h"
+#include "AnimationImporter.h"
+#include "MeshImporter.h"
+#include "SceneBvh.h"
+#include "InstanceBatcher.h"
+#include "DrawQueue.h"
+#include "DrawRecorder.h"
+#include "RenderCommandStream.h"
+#include "JobSystem.h"
+#include "UploadRing.h"
+#include "LightClusters.h"
+#include "Terrain.h"
+#include "HeightField.h"
+#include "TerrainStreamer.h"
+#include "TransformSystem.h"
+#include "Registry.h"
+#include "GpuTimeline.h"
+#include "TextureCooker.h"
+#include "BlockEncoder.h"
+#include "DdsFile.h"
+#include "TextureUploader.h"
+#include "TextureStreamer.h"
+#include "AssetLoader.h"
+#include "Camera.h"
+#include <chrono>
+#include <cstdarg>
+
+using namespace DirectX;
+
+namespace
+{
+    // Builds a Mixamo-sized rig: a spine chain with the remaining joints hanging off
+    // random earlier joints, so the hierarchy pass sees realistic parent distances.
+    void BuildSyntheticSkeleton(UINT jointCount, Skeleton& skeleton)
+    {
+        skeleton = Skeleton();
+        for (UINT j = 0; j < jointCount; ++j)
+        {
+            skeleton.JointNames.push_back("joint" + std::to_string(j));
+            skeleton.ParentIndices.push_back(j == 0 ? -1 : (int)(j < 8 ? j - 1 : MathHelper::Rand(0, j - 1)));
+
+            XMFLOAT4X4 inverseBind;
+            XMStoreFloat4x4(&inverseBind, XMMatrixTranslation(0.0f, -(float)j, 0.0f));
+            skeleton.InverseBindPose.push_back(inverseBind);
+        }
+    }
+
+    // A looping clip of random rotations for every joint of skeleton.
+    void BuildSyntheticClip(const Skeleton& skeleton, UINT sampleCount, AnimationClip& clip)
+    {
+        clip = AnimationClip();
+        clip.Name = "synthetic";
+        clip.SampleCount = sampleCount;
+        clip.PacketCount = skeleton.PacketCount();
+        clip.Samples.resize((size_t)sampleCount * clip.PacketCount);
+
+        for (UINT k = 0; k < sampleCount; ++k)
+        {
+            JointPacket* sample = &clip.Samples[(size_t)k * clip.PacketCount];
+            AnimationKernels::ResetPackets(sample, clip.PacketCount);
+
+            for (UINT j = 0; j < skeleton.JointCount(); ++j)
+            {
+                XMVECTOR q = XMQuaternionRotationRollPitchYaw(
+                    MathHelper::RandF(-0.5f, 0.5f), MathHelper::RandF(-0.5f, 0.5f), MathHelper::RandF(-0.5f, 0.5f));
+                AnimationKernels::StoreJoint(sample, j, XMVectorSplatOne(), q, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+            }
+        }
+    }
+
+    void RunAnimationInstances(Benchmark& bench, const char* label, const Skeleton& skeleton,
+        const AnimationClip& clip, const AnimationClip& blendClip)
+    {
+        const UINT instanceCounts[] = { 1, 64, 256, 1024 };
+        const UINT frames = 200;
+        const float frameTime = 1.0f / 60.0f;
+
+        for (UINT instanceCount : instanceCounts)
+        {
+            AnimationSystem system;
+            system.SetSkeleton(&skeleton);
+            for (UINT i = 0; i < instanceCount; ++i)
+            {
+                AnimationInstance& instance = system.GetInstance(system.AddInstance(&clip));
+                instance.Time = MathHelper::RandF(0.0f, clip.Duration());
+                instance.Speed = MathHelper::RandF(0.8f, 1.2f);
+
+                // Every other instance cross-fades a second clip to exercise the blend path.
+                if (i % 2)
+                {
+                    instance.BlendClip = &blendClip;
+                    instance.BlendWeight = 0.5f;
+                }
+            }
+
+            UINT64 joints = 0;
+            double begin = bench.Now();
+            for (UINT f = 0; f < frames; ++f)
+            {
+                system.Update(frameTime, 0.0f);
+                joints += system.GetStats().JointsEvaluated;
+            }
+            double seconds = bench.Now() - begin;
+
+            bench.Report("  %-10s %5u instances x %3u joints: %8.3f ms/frame, %7.2f M joints/s",
+                label, instanceCount, skeleton.JointCount(),
+                seconds * 1000.0 / frames, joints / seconds / 1.0e6);
+        }
+    }
+
+    void AnimationBenchmark(Benchmark& bench)
+    {
+        Skeleton skeleton;
+        AnimationClip clip;
+        AnimationClip blendClip;
+        BuildSyntheticSkeleton(65, skeleton);
+        BuildSyntheticClip(skeleton, 32, clip);
+        BuildSyntheticClip(skeleton, 48, blendClip);
+
+        RunAnimationInstances(bench, "synthetic", skeleton, clip, blendClip);
+
+        Skeleton walkSkeleton;
+        std::vector<AnimationClip> walkClips;
+        if (AnimationImporter::LoadFbx("Models/Walking.fbx", walkSkeleton, walkClips) && !walkClips.empty())
+        {
+            RunAnimationInstances(bench, "Walking", walkSkeleton, walkClips[0], walkClips[0]);
+        }
+        else
+        {
+            bench.Report("  Models/Walking.fbx not loaded, skipped");
+        }
+
+        // Budgeted update: how many of 1024 instances fit in 2 ms.
+        AnimationSystem system;
+        system.SetSkeleton(&skeleton);
+        for (UINT i = 0; i < 1024; ++i)
+            system.AddInstance(&clip);
+        system.Update(1.0f / 60.0f, 2.0f);
+        bench.Report("  2 ms budget: %u of %u instances evaluated in %.3f ms",
+            system.GetStats().InstancesEvaluated, system.InstanceCount(), system.GetStats().Milliseconds);
+    }
+
+    // Sums every 4 KB page of a buffer so the mapped path pays its page faults
+    // just like the upload into the default heap would.
+    std::uint64_t TouchPages(const void* data, size_t byteSize)
+    {
+        const std::uint8_t* bytes = static_cast<const std::uint8_t*>(data);
+        std::uint64_t sum = 0;
+        for (size_t i = 0; i < byteSize; i += 4096)
+            sum += bytes[i];
+        return sum;
+    }
+
+    void MeshLoadBenchmark(Benchmark& bench)
+    {
+        const char* fbxFile = "Models/Remy.fbx";
+        const std::wstring meshFile = L"Models/Remy.bench.mesh";
+        const int iterations = 5;
+
+        MeshAsset asset;
+        double start = bench.Now();
+        bool imported = true;
+        for (int i = 0; i < iterations && imported; ++i)
+            imported = MeshImporter::ImportFbx(fbxFile, asset);
+        const double fbxSeconds = (bench.Now() - start) / iterations;
+
+        if (!imported)
+        {
+            bench.Report("  %s not loaded, skipped", fbxFile);
+            return;
+        }
+
+        if (!MeshFile::Write(meshFile, asset))
+        {
+            bench.Report("  could not write baked mesh, skipped");
+            return;
+        }
+
+        std::uint64_t checksum = 0;
+        start = bench.Now();
+        for (int i = 0; i < iterations; ++i)
+        {
+            MeshFile file;
+            if (!file.Open(meshFile))
+                break;
+            checksum += TouchPages(file.Vertices(), file.VertexBufferByteSize());
+            checksum += TouchPages(file.Indices(), file.IndexBufferByteSize());
+        }
+        const double mappedSeconds = (bench.Now() - start) / iterations;
+
+        DeleteFileW(meshFile.c_str());
+
+        bench.Report("  %s: %zu vertices, %zu indices, %zu submeshes",
+            fbxFile, asset.Vertices.size(), asset.Indices32.size(), asset.Submeshes.size());
+        bench.Report("  FBX import  %10.3f ms", fbxSeconds * 1000.0);
+        bench.Report("  baked mmap  %10.3f ms  (%.1fx faster, checksum %llu)",
+            mappedSeconds * 1000.0, fbxSeconds / mappedSeconds, (unsigned long long)checksum);
+    }
+
+    void ReportCacheStats(Benchmark& bench, const char* name, const std::uint32_t* indices, UINT indexCount,
+        UINT vertexCount, const VertexCacheStats& before, double seconds)
+    {
+        VertexCacheStats after = MeshOptimizer::AnalyzeVertexCache(indices, indexCount, vertexCount);
+        bench.Report("  %-12s %7u tris  ACMR %.3f -> %.3f  ATVR %.3f -> %.3f  %8.3f ms",
+            name, after.TriangleCount, before.ACMR, after.ACMR, before.ATVR, after.ATVR, seconds * 1000.0);
+    }
+
+    void OptimizeGenerated(Benchmark& bench, const char* name, GeometryGenerator::MeshData mesh)
+    {
+        VertexCacheStats before = MeshOptimizer::AnalyzeVertexCache(mesh.Indices32.data(),
+            (UINT)mesh.Indices32.size(), (UINT)mesh.Vertices.size());
+
+        double start = bench.Now();
+        MeshOptimizer::Optimize(mesh);
+        double seconds = bench.Now() - start;
+
+        ReportCacheStats(bench, name, mesh.Indices32.data(), (UINT)mesh.Indices32.size(),
+            (UINT)mesh.Vertices.size(), before, seconds);
+    }
+
+    // Post-transform cache efficiency (FIFO, MeshOptimizer::CacheSize entries)
+    // before and after the optimizer.
+    void MeshOptimizerBenchmark(Benchmark& bench)
+    {
+        GeometryGenerator geoGen;
+        OptimizeGenerated(bench, "box", geoGen.CreateBox(1.0f, 1.0f, 1.0f, 3));
+        OptimizeGenerated(bench, "sphere", geoGen.CreateSphere(1.0f, 64, 64));
+        OptimizeGenerated(bench, "geosphere", geoGen.CreateGeosphere(1.0f, 5));
+        OptimizeGenerated(bench, "cylinder", geoGen.CreateCylinder(1.0f, 0.5f, 3.0f, 64, 64));
+        OptimizeGenerated(bench, "grid", geoGen.CreateGrid(100.0f, 100.0f, 256, 256));
+
+        MeshAsset asset;
+        if (!MeshImporter::ImportFbx("Models/Remy.fbx", asset, false))
+        {
+            bench.Report("  Models/Remy.fbx not loaded, skipped");
+            return;
+        }
+
+        std::vector<VertexCacheStats> before;
+        for (const SubmeshGeometry& sm : asset.Submeshes)
+        {
+            before.push_back(MeshOptimizer::AnalyzeVertexCache(&asset.Indices32[sm.StartIndexLocation],
+                sm.IndexCount, (UINT)asset.Vertices.size() - sm.BaseVertexLocation));
+        }
+
+        double start = bench.Now();
+        MeshOptimizer::Optimize(asset);
+        double seconds = bench.Now() - start;
+
+        for (size_t i = 0; i < asset.Submeshes.size(); ++i)
+        {
+            const SubmeshGeometry& sm = asset.Submeshes[i];
+            ReportCacheStats(bench, asset.SubmeshNames[i].c_str(), &asset.Indices32[sm.StartIndexLocation],
+                sm.IndexCount, (UINT)asset.Vertices.size() - sm.BaseVertexLocation, before[i], seconds);
+        }
+    }
+
+    // Expands a grid into the per-polygon-vertex stream an FBX importer sees
+    // (three vertices per triangle) and welds it back down.
+    void VertexWeldBenchmark(Benchmark& bench)
+    {
+        GeometryGenerator geoGen;
+        GeometryGenerator::MeshData grid = geoGen.CreateGrid(100.0f, 100.0f, 512, 512);
+
+        std::vector<Vertex> stream(grid.Indices32.size());
+        for (size_t i = 0; i < grid.Indices32.size(); ++i)
+        {
+            const GeometryGenerator::Vertex& g = grid.Vertices[grid.Indices32[i]];
+            stream[i].Pos = g.Position;
+            stream[i].Normal = g.Normal;
+            stream[i].Tex = g.TexC;
+        }
+
+        double start = bench.Now();
+        VertexWelder<Vertex> welder((std::uint32_t)grid.Vertices.size());
+        std::uint64_t checksum = 0;
+        for (const Vertex& v : stream)
+            checksum += welder.Add(v);
+        double seconds = bench.Now() - start;
+
+        bench.Report("  grid: %u polygon vertices -> %u unique (%zu expected), %.3f ms, %.1f M vertices/s (checksum %llu)",
+            welder.AddedCount(), welder.UniqueCount(), grid.Vertices.size(), seconds * 1000.0,
+            welder.AddedCount() / seconds / 1.0e6, (unsigned long long)checksum);
+
+        MeshAsset asset;
+        if (MeshImporter::ImportFbx("Models/Remy.fbx", asset, false))
+        {
+            bench.Report("  Remy: %zu polygon vertices -> %zu unique",
+                asset.Indices32.size(), asset.Vertices.size());
+        }
+        else
+        {
+            bench.Report("  Models/Remy.fbx not loaded, skipped");
+        }
+    }
+
+    // 100k unit-ish boxes scattered through a 2 km cube, culled against a
+    // camera at the origin.  Compares the BVH with testing every item against a
+    // DirectX::BoundingFrustum, and times a refit after 1% of the items move.
+    void CullingBenchmark(Benchmark& bench)
+    {
+        const UINT itemCount = 100000;
+        const int frames = 100;
+
+        std::vector<RenderItem> items(itemCount);
+        std::vector<RenderItem*> itemPtrs(itemCount);
+        for (UINT i = 0; i < itemCount; ++i)
+        {
+            RenderItem& ri = items[i];
+            ri.Bounds = BoundingBox(XMFLOAT3(0.0f, 0.0f, 0.0f),
+                XMFLOAT3(MathHelper::RandF(0.5f, 2.0f), MathHelper::RandF(0.5f, 2.0f), MathHelper::RandF(0.5f, 2.0f)));
+            XMStoreFloat4x4(&ri.World, XMMatrixTranslation(
+                MathHelper::RandF(-1000.0f, 1000.0f), MathHelper::RandF(-1000.0f, 1000.0f), MathHelper::RandF(-1000.0f, 1000.0f)));
+            itemPtrs[i] = &ri;
+        }
+
+        SceneBvh bvh;
+        double start = bench.Now();
+        bvh.Build(itemPtrs.data(), itemCount);
+        bench.Report("  build: %u items, %u nodes, %.3f ms", itemCount, bvh.NodeCount(), (bench.Now() - start) * 1000.0);
+
+        Camera camera;
+        camera.SetLens(0.25f * MathHelper::Pi, 16.0f / 9.0f, 1.0f, 1000.0f);
+
+        std::vector<RenderItem*> visible;
+        visible.reserve(itemCount);
+        double bvhSeconds = 0.0;
+        double bruteSeconds = 0.0;
+        UINT bruteVisible = 0;
+        for (int f = 0; f < frames; ++f)
+        {
+            camera.RotateY(2.0f * MathHelper::Pi / frames);
+            camera.UpdateViewMatrix();
+
+            XMFLOAT4 planes[6];
+            camera.GetFrustumPlanes(planes);
+            FrustumPlanes frustum;
+            frustum.Set(planes);
+
+            start = bench.Now();
+            bvh.Cull(frustum, visible);
+            bvhSeconds += bench.Now() - start;
+
+            // Reference: every item against the view-space frustum.
+            BoundingFrustum viewFrustum(camera.GetProj());
+            BoundingFrustum worldFrustum;
+            viewFrustum.Transform(worldFrustum, XMMatrixInverse(nullptr, camera.GetView()));
+
+            start = bench.Now();
+            bruteVisible = 0;
+            for (const RenderItem& ri : items)
+            {
+                BoundingBox world;
+                ri.Bounds.Transform(world, XMLoadFloat4x4(&ri.World));
+                if (worldFrustum.Contains(world) != DirectX::DISJOINT)
+                    bruteVisible++;
+            }
+            bruteSeconds += bench.Now() - start;
+        }
+
+        const SceneBvh::Stats& stats = bvh.GetStats();
+        bench.Report("  bvh:   %8.3f ms/frame  %6.1f M items/s  (last frame: %u visible, %u nodes, %u item tests)",
+            bvhSeconds * 1000.0 / frames, itemCount * frames / bvhSeconds / 1.0e6,
+            stats.ItemsVisible, stats.NodesVisited, stats.ItemsTested);
+        bench.Report("  brute: %8.3f ms/frame  %6.1f M items/s  (last frame: %u visible)",
+            bruteSeconds * 1000.0 / frames, itemCount * frames / bruteSeconds / 1.0e6, bruteVisible);
+
+        for (UINT i = 0; i < itemCount; i += 100)
+        {
+            XMStoreFloat4x4(&items[i].World, XMMatrixTranslation(
+                MathHelper::RandF(-1000.0f, 1000.0f), MathHelper::RandF(-1000.0f, 1000.0f), MathHelper::RandF(-1000.0f, 1000.0f)));
+            items[i].BoundsDirty = true;
+        }
+
+        start = bench.Now();
+        bvh.Refit();
+        bench.Report("  refit after %u moves: %.3f ms", itemCount / 100, (bench.Now() - start) * 1000.0);
+    }
+
+    // A tile map of 20k boxes spread over two geometries and four materials:
+    // how long grouping takes and how many draws it saves.
+    void BatchingBenchmark(Benchmark& bench)
+    {
+        const UINT itemCount = 20000;
+        const int frames = 100;
+
+        MeshGeometry geos[2];
+        Material mats[4];
+        std::vector<RenderItem> items(itemCount);
+        std::vector<RenderItem*> itemPtrs(itemCount);
+        for (UINT i = 0; i < itemCount; ++i)
+        {
+            items[i].Geo = &geos[MathHelper::Rand(0, 1)];
+            items[i].Mat = &mats[MathHelper::Rand(0, 3)];
+            items[i].IndexCount = 36;
+            itemPtrs[i] = &items[i];
+        }
+
+        InstanceBatcher batcher;
+        double start = bench.Now();
+        for (int f = 0; f < frames; ++f)
+            batcher.Build(itemPtrs.data(), itemCount);
+        double seconds = (bench.Now() - start) / frames;
+
+        UINT draws = 0;
+        for (const InstanceBatch& batch : batcher.Batches())
+            draws += batch.InstanceCount >= InstanceBatcher::MinInstanceCount ? 1 : batch.InstanceCount;
+
+        bench.Report("  %u items -> %u draws in %zu batches, %.3f ms per frame",
+            itemCount, draws, batcher.Batches().size(), seconds * 1000.0);
+    }
+
+    // Radix-sorted draw queue against std::sort on the same keys, and how many
+    // geometry/material changes a sorted submission order leaves.
+    void DrawQueueBenchmark(Benchmark& bench)
+    {
+        const UINT drawCount = 100000;
+        const int frames = 50;
+
+        std::vector<std::uint64_t> keys(drawCount);
+        for (UINT i = 0; i < drawCount; ++i)
+        {
+            keys[i] = DrawKey::Make(MathHelper::Rand(0, 1), MathHelper::Rand(0, 15), MathHelper::Rand(0, 63),
+                MathHelper::Rand(0, 7), MathHelper::RandF());
+        }
+
+        auto countChanges = [](const std::vector<std::uint64_t>& ordered)
+        {
+            UINT changes = 0;
+            for (size_t i = 1; i < ordered.size(); ++i)
+                changes += (ordered[i] >> 16) != (ordered[i - 1] >> 16) ? 1 : 0;
+            return changes;
+        };
+
+        DrawQueue queue;
+        double start = bench.Now();
+        for (int f = 0; f < frames; ++f)
+        {
+            queue.Clear();
+            for (UINT i = 0; i < drawCount; ++i)
+                queue.Push(keys[i], DrawPacket());
+            queue.Sort();
+        }
+        double radixSeconds = (bench.Now() - start) / frames;
+
+        std::vector<std::uint64_t> radixOrder(drawCount);
+        for (UINT i = 0; i < drawCount; ++i)
+            radixOrder[i] = queue.Key(i);
+
+        std::vector<std::uint64_t> sorted;
+        start = bench.Now();
+        for (int f = 0; f < frames; ++f)
+        {
+            sorted = keys;
+            std::sort(sorted.begin(), sorted.end());
+        }
+        double stdSeconds = (bench.Now() - start) / frames;
+
+        bench.Report("  %u draws: radix %.3f ms, std::sort %.3f ms, orders %s",
+            drawCount, radixSeconds * 1000.0, stdSeconds * 1000.0, radixOrder == sorted ? "match" : "DIFFER");
+        bench.Report("  state changes: %u unsorted -> %u sorted", countChanges(keys), countChanges(radixOrder));
+    }
+
+    // Bindings for recording without a device.  The null backend only hashes and
+    // checks the values, so any distinct, suitably aligned ones will do.
+    DrawBindings HeadlessBindings()
+    {
+        DrawBindings bindings;
+        bindings.RootSignature = reinterpret_cast<ID3D12RootSignature*>(0x100);
+        bindings.SrvHeap = reinterpret_cast<ID3D12DescriptorHeap*>(0x200);
+        bindings.Viewport = { 0.0f, 0.0f, 1920.0f, 1080.0f, 0.0f, 1.0f };
+        bindings.ScissorRect = { 0, 0, 1920, 1080 };
+        bindings.RenderTarget.ptr = 0x300;
+        bindings.DepthStencil.ptr = 0x400;
+        bindings.DefaultPSO = reinterpret_cast<ID3D12PipelineState*>(0x1000);
+        bindings.InstancedPSO = reinterpret_cast<ID3D12PipelineState*>(0x2000);
+        bindings.SrvHeapStart.ptr = 0x10000;
+        bindings.SrvDescriptorSize = 32;
+        bindings.PassCB = 0x100000;
+        bindings.MaterialCB = 0x300000;
+        bindings.LightCB = 0x500000;
+        bindings.MaterialCBByteSize = 256;
+        bindings.ClusterLights = 0x600000;
+        bindings.ClusterRanges = 0x700000;
+        bindings.ClusterLightIndices = 0x800000;
+        return bindings;
+    }
+
+    // Records a sorted 100k-draw queue into NullCommandBackends split across 1-8
+    // chunks, one chunk per pool thread, to show how recording scales without a GPU.
+    void RecordingBenchmark(Benchmark& bench)
+    {
+        const UINT drawCount = 100000;
+        const int frames = 20;
+        const UINT maxChunks = 8;
+
+        MeshGeometry geos[16];
+        Material mats[64];
+        for (UINT m = 0; m < 64; ++m)
+        {
+            mats[m].MatCBIndex = m;
+            mats[m].DiffuseSrvHeapIndex = m % 8;
+        }
+
+        std::vector<RenderItem> items(drawCount);
+        DrawQueue queue;
+        for (UINT i = 0; i < drawCount; ++i)
+        {
+            RenderItem& ri = items[i];
+            UINT geo = MathHelper::Rand(0, 15);
+            ri.Geo = &geos[geo];
+            ri.Mat = &mats[MathHelper::Rand(0, 63)];
+            ri.ObjCBIndex = i;
+            ri.IndexCount = 36;
+            ri.Submesh = MathHelper::Rand(0, 7);
+            ri.StartIndexLocation = 36 * ri.Submesh;
+
+            DrawPacket packet;
+            packet.Item = &ri;
+            packet.FirstInstance = i;
+            UINT pipeline = MathHelper::Rand(0, 1);
+            packet.InstanceCount = pipeline == DrawKey::InstancedPipeline ? 4 : 1;
+            packet.Constants = 0x200000 + (UINT64)i * 256;
+            queue.Push(DrawKey::Make(pipeline, geo, ri.Mat->MatCBIndex, ri.Submesh, MathHelper::RandF()), packet);
+        }
+        queue.Sort();
+
+        DrawBindings bindings = HeadlessBindings();
+
+        JobSystem jobs(maxChunks - 1);
+        NullCommandBackend backends[maxChunks];
+        DrawRecorder recorders[maxChunks];
+
+        double singleSeconds = 0.0;
+        for (UINT chunkCount = 1; chunkCount <= maxChunks; chunkCount *= 2)
+        {
+            double start = bench.Now();
+            for (int f = 0; f < frames; ++f)
+            {
+                jobs.ParallelFor(chunkCount, 1, [&](UINT firstChunk, UINT lastChunk)
+                {
+                    for (UINT chunk = firstChunk; chunk < lastChunk; ++chunk)
+                    {
+                        backends[chunk].Reset();
+                        recorders[chunk].Begin(&backends[chunk], nullptr);
+                        recorders[chunk].RecordQueue(queue, drawCount * chunk / chunkCount, drawCount * (chunk + 1) / chunkCount, bindings);
+                    }
+                });
+            }
+            double seconds = (bench.Now() - start) / frames;
+            if (chunkCount == 1)
+                singleSeconds = seconds;
+
+            UINT draws = 0;
+            UINT commands = 0;
+            for (UINT chunk = 0; chunk < chunkCount; ++chunk)
+            {
+                draws += recorders[chunk].GetStats().Draws;
+                commands += backends[chunk].CommandCount();
+            }
+
+            bench.Report("  %u chunks: %.3f ms per frame, %.2fx, %u draws, %u commands",
+                chunkCount, seconds * 1000.0, singleSeconds / seconds, draws, commands);
+        }
+    }
+
+    // The renderer's whole CPU frame without a device: BVH refit and cull,
+    // batching, draw queue build and sort, object/instance constant writes
+    // (into a system memory upload ring), parallel recording into
+    // command streams, and a replay through the validating null device.
+    void HeadlessFrameBenchmark(Benchmark& bench)
+    {
+        const UINT itemCount = 20000;
+        const int frames = 100;
+        const UINT chunkCount = 4;
+
+        MeshGeometry geos[4];
+        for (UINT g = 0; g < 4; ++g)
+            geos[g].GeoIndex = g;
+
+        Material mats[16];
+        for (UINT m = 0; m < 16; ++m)
+        {
+            mats[m].MatCBIndex = m;
+            mats[m].DiffuseSrvHeapIndex = m % 4;
+        }
+
+        // A 2 km square field of boxes over 64 geometry/material pairs.
+        std::vector<std::unique_ptr<RenderItem>> items(itemCount);
+        std::vector<RenderItem*> itemPtrs(itemCount);
+        for (UINT i = 0; i < itemCount; ++i)
+        {
+            items[i] = std::make_unique<RenderItem>();
+            RenderItem& ri = *items[i];
+            ri.Geo = &geos[MathHelper::Rand(0, 3)];
+            ri.Mat = &mats[MathHelper::Rand(0, 15)];
+            ri.ObjCBIndex = i;
+            ri.IndexCount = 36;
+            ri.Bounds = BoundingBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f));
+            XMStoreFloat4x4(&ri.World, XMMatrixTranslation(
+                MathHelper::RandF(-1000.0f, 1000.0f), MathHelper::RandF(0.0f, 50.0f), MathHelper::RandF(-1000.0f, 1000.0f)));
+            itemPtrs[i] = &ri;
+        }
+
+        SceneBvh bvh;
+        bvh.Build(itemPtrs.data(), itemCount);
+
+        Camera camera;
+        camera.SetLens(0.25f * MathHelper::Pi, 16.0f / 9.0f, 1.0f, 1000.0f);
+        camera.SetPosition(0.0f, 20.0f, 0.0f);
+
+        std::vector<RenderItem*> visible;
+        InstanceBatcher batcher;
+        DrawQueue queue;
+        UploadRing ring(gNumFrameResources * itemCount * d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants)));
+
+        JobSystem jobs(chunkCount - 1);
+        RenderCommandStream streams[chunkCount];
+        DrawRecorder recorders[chunkCount];
+        const DrawBindings bindings = HeadlessBindings();
+
+        NullCommandBackend device;
+        device.RequireRootParameters(bindings.DefaultPSO, DrawRecorder::DefaultRootParameters);
+        device.RequireRootParameters(bindings.InstancedPSO, DrawRecorder::InstancedRootParameters);
+
+        enum { Cull, Batch, Queue, Constants, Record, Validate, StageCount };
+        const char* stageNames[StageCount] = { "cull", "batch", "queue", "constants", "record", "validate" };
+        double stageSeconds[StageCount] = {};
+        UINT errors = 0;
+        std::string firstError;
+
+        for (int f = 0; f < frames; ++f)
+        {
+            // 1% of the scene moves every frame.
+            for (UINT i = f % 100; i < itemCount; i += 100)
+            {
+                items[i]->World._42 = MathHelper::RandF(0.0f, 50.0f);
+                items[i]->BoundsDirty = true;
+            }
+
+            camera.RotateY(2.0f * MathHelper::Pi / frames);
+            camera.UpdateViewMatrix();
+
+            double start = bench.Now();
+            XMFLOAT4 planes[6];
+            camera.GetFrustumPlanes(planes);
+            FrustumPlanes frustum;
+            frustum.Set(planes);
+            bvh.Refit();
+            bvh.Cull(frustum, visible);
+
+            double t = bench.Now();
+            stageSeconds[Cull] += t - start;
+            start = t;
+
+            batcher.Build(visible.data(), (UINT)visible.size());
+
+            t = bench.Now();
+            stageSeconds[Batch] += t - start;
+            start = t;
+
+            queue.Build(batcher, camera.GetPosition(), camera.GetLook(), camera.GetFarZ());
+
+            t = bench.Now();
+            stageSeconds[Queue] += t - start;
+            start = t;
+
+            // Frame f is signalled with fence f + 1 and the GPU is taken to
+            // lag the full gNumFrameResources frames behind.
+            ring.BeginFrame(f + 1 > gNumFrameResources ? f + 1 - gNumFrameResources : 0);
+            jobs.ParallelFor(queue.Size(), 256, [&](UINT first, UINT last)
+            {
+                queue.WriteConstants(first, last, batcher, ring);
+            });
+            ring.EndFrame(f + 1);
+
+            t = bench.Now();
+            stageSeconds[Constants] += t - start;
+            start = t;
+
+            const UINT drawCount = queue.Size();
+            jobs.ParallelFor(chunkCount, 1, [&](UINT firstChunk, UINT lastChunk)
+            {
+                for (UINT chunk = firstChunk; chunk < lastChunk; ++chunk)
+                {
+                    streams[chunk].Clear();
+                    recorders[chunk].Begin(&streams[chunk], nullptr);
+                    recorders[chunk].RecordQueue(queue, drawCount * chunk / chunkCount, drawCount * (chunk + 1) / chunkCount, bindings);
+                }
+            });
+
+            t = bench.Now();
+            stageSeconds[Record] += t - start;
+            start = t;
+
+            device.Reset();
+            for (UINT chunk = 0; chunk < chunkCount; ++chunk)
+            {
+                device.BeginList();
+                streams[chunk].Replay(device);
+            }
+            errors += device.ErrorCount();
+            if (firstError.empty() && device.ErrorCount() > 0)
+                firstError = device.FirstError();
+
+            stageSeconds[Validate] += bench.Now() - start;
+        }
+
+        double total = 0.0;
+        for (int s = 0; s < StageCount; ++s)
+        {
+            bench.Report("  %-10s %8.3f ms/frame", stageNames[s], stageSeconds[s] * 1000.0 / frames);
+            total += stageSeconds[s];
+        }
+        bench.Report("  %-10s %8.3f ms/frame", "total", total * 1000.0 / frames);
+
+        size_t streamBytes = 0;
+        for (UINT chunk = 0; chunk < chunkCount; ++chunk)
+            streamBytes += streams[chunk].ByteSize();
+
+        bench.Report("  last frame: %zu visible, %u draws, %u commands (%u root, %u IA, %u PSO), %zu stream bytes",
+            visible.size(), device.Count(NullCommandBackend::DrawCommand), device.CommandCount(), device.Count(NullCommandBackend::RootParameterCommand),
+            device.Count(NullCommandBackend::InputAssemblerCommand), device.Count(NullCommandBackend::PipelineCommand), streamBytes);
+        const UploadRing::FrameStats ringStats = ring.GetFrameStats();
+        bench.Report("  upload ring: %u allocations, %llu bytes + %llu alignment, %u failed",
+            ringStats.Allocations, (unsigned long long)ringStats.BytesAllocated, (unsigned long long)ringStats.BytesWasted, ringStats.Failures);
+        bench.Report("  validation: %u errors over %d frames%s%s", errors, frames,
+            errors > 0 ? ", first: " : "", firstError.c_str());
+    }
+
+    // Job system overheads and scaling, for 1, 2, 4, ... threads up to the core count:
+    //   spawn: one thread creates 4000 empty children of a root job, then waits.
+    //   chain: 2000 jobs each depending on the previous one (no parallelism,
+    //          measures the release-to-start latency of a dependency).
+    //   for:   ParallelFor over 1M transforms at grain 1024, against the same
+    //          loop on one thread.
+    void JobSystemBenchmark(Benchmark& bench)
+    {
+        const UINT spawnCount = 4000;
+        const UINT chainLength = 2000;
+        const UINT transformCount = 1 << 20;
+        const int rounds = 20;
+
+        std::vector<XMFLOAT4X4> input(transformCount);
+        std::vector<XMFLOAT4X4> output(transformCount);
+        for (UINT i = 0; i < transformCount; ++i)
+            XMStoreFloat4x4(&input[i], XMMatrixRotationY((float)i) * XMMatrixTranslation((float)i, 0.0f, 0.0f));
+
+        auto transform = [&](UINT first, UINT last)
+        {
+            for (UINT i = first; i < last; ++i)
+            {
+                XMMATRIX m = XMLoadFloat4x4(&input[i]);
+                XMStoreFloat4x4(&output[i], XMMatrixTranspose(XMMatrixInverse(nullptr, m)));
+            }
+        };
+
+        double start = bench.Now();
+        for (int r = 0; r < rounds; ++r)
+            transform(0, transformCount);
+        const double serialSeconds = (bench.Now() - start) / rounds;
+        bench.Report("  serial for: %.3f ms", serialSeconds * 1000.0);
+
+        const unsigned int hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned int threads = 1; ; threads = std::min(threads * 2, hardwareThreads))
+        {
+            JobSystem jobs(threads - 1);
+
+            start = bench.Now();
+            for (int r = 0; r < rounds; ++r)
+            {
+                Job* root = jobs.Create(nullptr);
+                for (UINT i = 0; i < spawnCount; ++i)
+                    jobs.Run(jobs.Create([]() {}, root));
+                jobs.Run(root);
+                jobs.Wait(root);
+            }
+            const double spawnSeconds = (bench.Now() - start) / rounds;
+            const JobSystem::Stats spawnStats = jobs.GetStats();
+
+            start = bench.Now();
+            for (int r = 0; r < rounds; ++r)
+            {
+                Job* root = jobs.Create(nullptr);
+                Job* previous = nullptr;
+                for (UINT i = 0; i < chainLength; ++i)
+                {
+                    Job* job = jobs.Create([]() {}, root);
+                    if (previous != nullptr)
+                    {
+                        jobs.AddDependency(job, previous);
+                        jobs.Run(previous);
+                    }
+                    previous = job;
+                }
+                jobs.Run(previous);
+                jobs.Run(root);
+                jobs.Wait(root);
+            }
+            const double chainSeconds = (bench.Now() - start) / rounds;
+
+            jobs.ResetStats();
+            start = bench.Now();
+            for (int r = 0; r < rounds; ++r)
+                jobs.ParallelFor(transformCount, 1024, transform);
+            const double forSeconds = (bench.Now() - start) / rounds;
+            const JobSystem::Stats forStats = jobs.GetStats();
+
+            bench.Report("  %2u threads: spawn %6.1f ns/job (%5.1f%% stolen), chain %6.1f ns/job, for %7.3f ms (%.2fx, %5.1f%% stolen)",
+                threads, spawnSeconds * 1.0e9 / spawnCount, 100.0 * spawnStats.JobsStolen / std::max<std::uint64_t>(spawnStats.JobsExecuted, 1),
+                chainSeconds * 1.0e9 / chainLength, forSeconds * 1000.0, serialSeconds / forSeconds,
+                100.0 * forStats.JobsStolen / std::max<std::uint64_t>(forStats.JobsExecuted, 1));
+
+            if (threads == hardwareThreads)
+                break;
+        }
+    }
+
+    // The transient upload ring against the fixed per-item slots it replaced
+    // (one 256-byte ObjectConstants slot per item per frame resource):
+    //   alloc:  ns per AllocateConstants from one thread and from every thread.
+    //   frames: a scene growing from 10k to 40k items over 300 frames, about a
+    //           third drawn (half singly, half in batches of 16 instances),
+    //           with the GPU gNumFrameResources frames behind.  The ring starts
+    //           sized for 10k items and doubles when a frame runs out, as the
+    //           renderer does.
+    void UploadRingBenchmark(Benchmark& bench)
+    {
+        const UINT allocationCount = 200000;
+        const int rounds = 10;
+
+        {
+            UploadRing ring(allocationCount * 256);
+            ObjectConstants constants;
+
+            double start = bench.Now();
+            for (int r = 0; r < rounds; ++r)
+            {
+                ring.BeginFrame(r);
+                for (UINT i = 0; i < allocationCount; ++i)
+                    ring.AllocateConstants(constants);
+                ring.EndFrame(r + 1);
+            }
+            const double serialSeconds = (bench.Now() - start) / rounds;
+
+            const unsigned int hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+            JobSystem jobs(hardwareThreads - 1);
+            start = bench.Now();
+            for (int r = 0; r < rounds; ++r)
+            {
+                ring.BeginFrame(rounds + r);
+                jobs.ParallelFor(allocationCount, 1024, [&](UINT first, UINT last)
+                {
+                    for (UINT i = first; i < last; ++i)
+                        ring.AllocateConstants(constants);
+                });
+                ring.EndFrame(rounds + r + 1);
+            }
+            const double parallelSeconds = (bench.Now() - start) / rounds;
+
+            bench.Report("  alloc: %.1f ns on 1 thread, %.1f ns on %u threads (%u failed)",
+                serialSeconds * 1.0e9 / allocationCount, parallelSeconds * 1.0e9 / allocationCount,
+                jobs.ThreadCount(), ring.GetFrameStats().Failures);
+        }
+
+        const UINT firstItemCount = 10000;
+        const UINT lastItemCount = 40000;
+        const int frames = 300;
+        const UINT batchSize = 16;
+
+        std::unique_ptr<UploadRing> ring = std::make_unique<UploadRing>(gNumFrameResources * firstItemCount * 256ull);
+        AffineTransform instances[batchSize];
+        ObjectConstants constants;
+
+        UINT growths = 0;
+        UINT64 allocations = 0;
+        UINT64 bytes = 0;
+        UINT64 wasted = 0;
+        UINT64 peakInFlight = 0;
+        UINT itemCount = firstItemCount;
+
+        double start = bench.Now();
+        for (int f = 0; f < frames; ++f)
+        {
+            itemCount = firstItemCount + (lastItemCount - firstItemCount) * f / (frames - 1);
+            const UINT drawnCount = itemCount / 3;
+
+            for (;;)
+            {
+                ring->BeginFrame(f + 1 > gNumFrameResources ? f + 1 - gNumFrameResources : 0);
+
+                for (UINT i = 0; i < drawnCount / 2; ++i)
+                    ring->AllocateConstants(constants);
+                for (UINT i = drawnCount / 2; i < drawnCount; i += batchSize)
+                {
+                    UploadAllocation a = ring->Allocate(sizeof(instances), 16);
+                    if (a.Cpu != nullptr)
+                        memcpy(a.Cpu, instances, sizeof(instances));
+                }
+
+                if (ring->GetFrameStats().Failures == 0)
+                    break;
+
+                // The renderer flushes the GPU first; here nothing is really in flight.
+                ring = std::make_unique<UploadRing>(2 * ring->Capacity());
+                growths++;
+            }
+
+            const UploadRing::FrameStats stats = ring->GetFrameStats();
+            allocations += stats.Allocations;
+            bytes += stats.BytesAllocated;
+            wasted += stats.BytesWasted;
+            peakInFlight = std::max(peakInFlight, ring->BytesInFlight());
+            ring->EndFrame(f + 1);
+        }
+        const double seconds = (bench.Now() - start) / frames;
+
+        const UINT64 fixedBytes = gNumFrameResources * (UINT64)itemCount * d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
+        bench.Report("  frames: %llu allocations, %.1f KB + %.1f KB alignment (%.1f%%) per frame, %.3f ms",
+            (unsigned long long)(allocations / frames), bytes / 1024.0 / frames, wasted / 1024.0 / frames,
+            100.0 * wasted / std::max<UINT64>(bytes + wasted, 1), seconds * 1000.0);
+        bench.Report("  ring: %u growths to %.2f MB, peak %.2f MB in flight; fixed slots for %u items: %.2f MB",
+            growths, ring->Capacity() / (1024.0 * 1024.0), peakInFlight / (1024.0 * 1024.0),
+            itemCount, fixedBytes / (1024.0 * 1024.0));
+    }
+
+    // Scene constants written per frame with the layout before packing (two
+    // transposed 4x4s per item and instance, a pass CB with six view/proj
+    // matrices and every light each frame) against the packed one (3x4 worlds,
+    // texture transforms only where not identity, lights only while dirty).
+    // 10000 items: 9000 instanced over 64 geometry/material pairs, 1000 drawn
+    // on their own; 5% have a texture transform.
+    void ConstantPackingBenchmark(Benchmark& bench)
+    {
+        const UINT itemCount = 10000;
+        const int frames = 100;
+
+        struct LegacyObjectConstants
+        {
+            XMFLOAT4X4 World;
+            XMFLOAT4X4 TexTransform;
+        };
+        struct LegacyPassConstants
+        {
+            XMFLOAT4X4 Matrices[6];
+            XMFLOAT4 Misc[3];
+            LightConstants Lighting;
+        };
+
+        std::vector<MeshGeometry> geos(8 + itemCount / 10);
+        for (UINT g = 0; g < (UINT)geos.size(); ++g)
+            geos[g].GeoIndex = g;
+        Material mats[8];
+        for (UINT m = 0; m < 8; ++m)
+            mats[m].MatCBIndex = m;
+
+        std::vector<RenderItem> items(itemCount);
+        std::vector<RenderItem*> itemPtrs(itemCount);
+        for (UINT i = 0; i < itemCount; ++i)
+        {
+            RenderItem& ri = items[i];
+            ri.Geo = i % 10 == 0 ? &geos[8 + i / 10] : &geos[MathHelper::Rand(0, 7)];
+            ri.Mat = &mats[MathHelper::Rand(0, 7)];
+            ri.IndexCount = 36;
+            XMStoreFloat4x4(&ri.World, XMMatrixRotationY(MathHelper::RandF()) *
+                XMMatrixTranslation(MathHelper::RandF(-500.0f, 500.0f), 0.0f, MathHelper::RandF(-500.0f, 500.0f)));
+            if (i % 20 == 0)
+                XMStoreFloat4x4(&ri.TexTransform, XMMatrixScaling(4.0f, 4.0f, 1.0f));
+            itemPtrs[i] = &ri;
+        }
+
+        InstanceBatcher batcher;
+        batcher.Build(itemPtrs.data(), itemCount);
+        DrawQueue queue;
+        queue.Build(batcher, XMVectorZero(), XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f), 1000.0f);
+
+        XMMATRIX view = XMMatrixLookAtLH(XMVectorSet(0.0f, 20.0f, -50.0f, 1.0f), XMVectorZero(), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+        XMMATRIX proj = XMMatrixPerspectiveFovLH(0.25f * MathHelper::Pi, 16.0f / 9.0f, 1.0f, 1000.0f);
+        LightConstants lights;
+        LightConstants lightCB;
+
+        const UINT64 ringBytes = gNumFrameResources * (UINT64)itemCount * d3dUtil::CalcConstantBufferByteSize(sizeof(LegacyObjectConstants));
+        UploadRing legacyRing(ringBytes);
+        UploadRing packedRing(ringBytes);
+        UploadRing::FrameStats legacyStats;
+        UploadRing::FrameStats packedStats;
+
+        double start = bench.Now();
+        for (int f = 0; f < frames; ++f)
+        {
+            legacyRing.BeginFrame(f + 1 > gNumFrameResources ? f + 1 - gNumFrameResources : 0);
+
+            const auto& instances = batcher.Instances();
+            for (UINT p = 0; p < queue.Size(); ++p)
+            {
+                const DrawPacket& packet = queue.Packet(p);
+                if (DrawKey::Pipeline(queue.Key(p)) == DrawKey::InstancedPipeline)
+                {
+                    UploadAllocation a = legacyRing.Allocate(packet.InstanceCount * sizeof(LegacyObjectConstants), 16);
+                    LegacyObjectConstants* data = reinterpret_cast<LegacyObjectConstants*>(a.Cpu);
+                    for (UINT i = 0; i < packet.InstanceCount; ++i)
+                    {
+                        const RenderItem* ri = instances[packet.FirstInstance + i];
+                        XMStoreFloat4x4(&data[i].World, XMMatrixTranspose(XMLoadFloat4x4(&ri->World)));
+                        XMStoreFloat4x4(&data[i].TexTransform, XMMatrixTranspose(XMLoadFloat4x4(&ri->TexTransform)));
+                    }
+                }
+                else
+                {
+                    LegacyObjectConstants objConstants;
+                    XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(XMLoadFloat4x4(&packet.Item->World)));
+                    XMStoreFloat4x4(&objConstants.TexTransform, XMMatrixTranspose(XMLoadFloat4x4(&packet.Item->TexTransform)));
+                    legacyRing.AllocateConstants(objConstants);
+                }
+            }
+
+            LegacyPassConstants pass;
+            XMMATRIX viewProj = XMMatrixMultiply(view, proj);
+            XMStoreFloat4x4(&pass.Matrices[0], XMMatrixTranspose(view));
+            XMStoreFloat4x4(&pass.Matrices[1], XMMatrixTranspose(XMMatrixInverse(nullptr, view)));
+            XMStoreFloat4x4(&pass.Matrices[2], XMMatrixTranspose(proj));
+            XMStoreFloat4x4(&pass.Matrices[3], XMMatrixTranspose(XMMatrixInverse(nullptr, proj)));
+            XMStoreFloat4x4(&pass.Matrices[4], XMMatrixTranspose(viewProj));
+            XMStoreFloat4x4(&pass.Matrices[5], XMMatrixTranspose(XMMatrixInverse(nullptr, viewProj)));
+            pass.Lighting = lights;
+            legacyRing.AllocateConstants(pass);
+
+            legacyStats = legacyRing.GetFrameStats();
+            legacyRing.EndFrame(f + 1);
+        }
+        const double legacySeconds = (bench.Now() - start) / frames;
+
+        UINT64 lightBytes = 0;
+        int lightFramesDirty = gNumFrameResources;
+        start = bench.Now();
+        for (int f = 0; f < frames; ++f)
+        {
+            packedRing.BeginFrame(f + 1 > gNumFrameResources ? f + 1 - gNumFrameResources : 0);
+
+            queue.WriteConstants(0, queue.Size(), batcher, packedRing);
+
+            PassConstants pass;
+            XMStoreFloat4x4(&pass.ViewProj, XMMatrixTranspose(XMMatrixMultiply(view, proj)));
+            packedRing.AllocateConstants(pass);
+
+            if (lightFramesDirty > 0)
+            {
+                memcpy(&lightCB, &lights, sizeof(lights));
+                lightBytes += sizeof(lights);
+                lightFramesDirty--;
+            }
+
+            packedStats = packedRing.GetFrameStats();
+            packedRing.EndFrame(f + 1);
+        }
+        const double packedSeconds = (bench.Now() - start) / frames;
+
+        bench.Report("  %u draws for %u items", queue.Size(), itemCount);
+        bench.Report("  before: %8.1f KB/frame + %6.1f KB CBV padding, %.3f ms",
+            legacyStats.BytesAllocated / 1024.0, legacyStats.BytesWasted / 1024.0, legacySeconds * 1000.0);
+        bench.Report("  after:  %8.1f KB/frame + %6.1f KB CBV padding, %.3f ms (lights %llu bytes over %d frames)",
+            packedStats.BytesAllocated / 1024.0, packedStats.BytesWasted / 1024.0, packedSeconds * 1000.0,
+            (unsigned long long)lightBytes, frames);
+        bench.Report("  %.2fx fewer bytes written", (double)legacyStats.BytesAllocated / packedStats.BytesAllocated);
+    }
+
+    // Clustered light binning time against light count, on one thread and on
+    // every core.  Lights of radius 2-10 are scattered over a 400 x 400 area
+    // around a camera turning on the spot; the two runs must produce the same
+    // cluster lists.
+    void LightClusterBenchmark(Benchmark& bench)
+    {
+        const UINT lightCounts[] = { 256, 1024, 4096, 16384 };
+        const int frames = 64;
+
+        Camera camera;
+        camera.SetLens(0.25f * MathHelper::Pi, 16.0f / 9.0f, 1.0f, 1000.0f);
+        camera.SetPosition(0.0f, 10.0f, 0.0f);
+
+        const unsigned int hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+        JobSystem jobs(hardwareThreads - 1);
+
+        for (UINT lightCount : lightCounts)
+        {
+            std::vector<Light> lights(lightCount);
+            for (auto& light : lights)
+            {
+                light.Position = { MathHelper::RandF(-200.0f, 200.0f), MathHelper::RandF(0.0f, 20.0f), MathHelper::RandF(-200.0f, 200.0f) };
+                light.FalloffEnd = MathHelper::RandF(2.0f, 10.0f);
+                light.SpotPower = MathHelper::Rand(0, 3) == 0 ? 8.0f : 0.0f;
+            }
+
+            LightClusters serial;
+            LightClusters parallel;
+            double serialSeconds = 0.0;
+            double parallelSeconds = 0.0;
+            UINT mismatches = 0;
+            for (int f = 0; f < frames; ++f)
+            {
+                camera.RotateY(2.0f * MathHelper::Pi / frames);
+                camera.UpdateViewMatrix();
+
+                double start = bench.Now();
+                serial.Build(lights.data(), lightCount, camera, nullptr);
+                serialSeconds += bench.Now() - start;
+
+                start = bench.Now();
+                parallel.Build(lights.data(), lightCount, camera, &jobs);
+                parallelSeconds += bench.Now() - start;
+
+                if (serial.Indices() != parallel.Indices())
+                    mismatches++;
+            }
+
+            const LightClusters::Stats& stats = parallel.GetStats();
+            bench.Report("  %5u lights: 1 thread %7.3f ms, %2u threads %7.3f ms (%.2fx); %u visible, %u entries, max %u per cluster%s",
+                lightCount, serialSeconds * 1000.0 / frames, jobs.ThreadCount(), parallelSeconds * 1000.0 / frames,
+                serialSeconds / parallelSeconds, stats.VisibleLights, stats.IndexCount, stats.MaxLightsPerCluster,
+                mismatches > 0 ? ", LISTS DIFFER" : "");
+        }
+    }
+
+    // Terrain build time and CDLOD selection over a camera circling the
+    // terrain, against drawing every leaf at full resolution.
+    void TerrainBenchmark(Benchmark& bench)
+    {
+        const int frames = 256;
+
+        // The field of Renderer::GetTerrainHeight.
+        auto height = [](float x, float z) { return roundf(0.2f * (z * sinf(0.1f * x) + x * cosf(0.1f * z))); };
+
+        TerrainDesc desc;
+        Terrain terrain;
+        double start = bench.Now();
+        terrain.Build(desc, height);
+        bench.Report("  build: %u nodes, %u vertices (%.1f MB), %.3f ms", terrain.NodeCount(), (UINT)terrain.Vertices().size(),
+            terrain.Vertices().size() * sizeof(Vertex) / (1024.0 * 1024.0), (bench.Now() - start) * 1000.0);
+        for (UINT l = 0; l < desc.LodCount; ++l)
+            bench.Report("  level %u: range %7.1f m, skirt %.2f m", l, terrain.LodRange(l), terrain.SkirtDepth(l));
+
+        Camera camera;
+        camera.SetLens(0.25f * MathHelper::Pi, 16.0f / 9.0f, 1.0f, 1000.0f);
+
+        std::vector<RenderItem*> visible;
+        double selectSeconds = 0.0;
+        UINT64 nodes = 0;
+        UINT64 triangles = 0;
+        UINT maxTriangles = 0;
+        for (int f = 0; f < frames; ++f)
+        {
+            const float angle = 2.0f * MathHelper::Pi * f / frames;
+            const float x = 300.0f * cosf(angle);
+            const float z = 300.0f * sinf(angle);
+            camera.LookAt(XMFLOAT3(x, height(x, z) + 30.0f, z), XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(0.0f, 1.0f, 0.0f));
+            camera.UpdateViewMatrix();
+
+            XMFLOAT4 planes[6];
+            camera.GetFrustumPlanes(planes);
+            FrustumPlanes frustum;
+            frustum.Set(planes);
+
+            visible.clear();
+            start = bench.Now();
+            terrain.Select(camera.GetPosition3f(), frustum, visible);
+            selectSeconds += bench.Now() - start;
+
+            const Terrain::Stats& stats = terrain.GetStats();
+            nodes += stats.NodesSelected;
+            triangles += stats.TrianglesSelected;
+            maxTriangles = std::max(maxTriangles, stats.TrianglesSelected);
+        }
+
+        const UINT leafCount = 1u << (2 * (desc.LodCount - 1));
+        const UINT64 fullTriangles = (UINT64)leafCount * terrain.Indices().size() / 3;
+        bench.Report("  select: %.4f ms/frame, %.1f nodes, %.0f triangles (max %u) against %llu for every leaf",
+            selectSeconds * 1000.0 / frames, (double)nodes / frames, (double)triangles / frames, maxTriangles,
+            (unsigned long long)fullTriangles);
+    }
+
+    // Height queries at 1M random points over a 1 km field: the analytic
+    // function, the cached field one point at a time and in batches, and the
+    // batched gradient.  Errors are against the function, on the terraced
+    // field the renderer uses and on a smooth one.
+    void HeightFieldBenchmark(Benchmark& bench)
+    {
+        const UINT pointCount = 1 << 20;
+        const float size = 1024.0f;
+        const UINT samples = (UINT)size + 1;
+
+        auto terraced = [](float x, float z) { return roundf(0.2f * (z * sinf(0.1f * x) + x * cosf(0.1f * z))); };
+        auto smooth = [](float x, float z) { return 0.2f * (z * sinf(0.1f * x) + x * cosf(0.1f * z)); };
+
+        std::vector<float> xs(pointCount), zs(pointCount);
+        for (UINT i = 0; i < pointCount; ++i)
+        {
+            xs[i] = MathHelper::RandF(-0.5f * size, 0.5f * size);
+            zs[i] = MathHelper::RandF(-0.5f * size, 0.5f * size);
+        }
+        std::vector<float> heights(pointCount), dhdx(pointCount), dhdz(pointCount), reference(pointCount);
+
+        const unsigned int hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+        JobSystem jobs(hardwareThreads - 1);
+
+        const HeightField::HeightFunction fields[] = { terraced, smooth };
+        const char* fieldNames[] = { "terraced", "smooth" };
+        for (int f = 0; f < 2; ++f)
+        {
+            HeightField field;
+            double start = bench.Now();
+            field.Build(-0.5f * size, -0.5f * size, 1.0f, samples, samples, fields[f], &jobs);
+            bench.Report("  %s: build %.3f ms on %u threads, %.1f MB", fieldNames[f], (bench.Now() - start) * 1000.0,
+                jobs.ThreadCount(), field.ByteSize() / (1024.0 * 1024.0));
+
+            start = bench.Now();
+            for (UINT i = 0; i < pointCount; ++i)
+                reference[i] = fields[f](xs[i], zs[i]);
+            const double functionSeconds = bench.Now() - start;
+
+            start = bench.Now();
+            for (UINT i = 0; i < pointCount; ++i)
+                heights[i] = field.Height(xs[i], zs[i]);
+            const double scalarSeconds = bench.Now() - start;
+
+            start = bench.Now();
+            field.HeightBatch(xs.data(), zs.data(), heights.data(), pointCount);
+            const double batchSeconds = bench.Now() - start;
+
+            start = bench.Now();
+            field.HeightAndGradientBatch(xs.data(), zs.data(), heights.data(), dhdx.data(), dhdz.data(), pointCount);
+            const double gradientSeconds = bench.Now() - start;
+
+            double maxError = 0.0;
+            double sumError = 0.0;
+            for (UINT i = 0; i < pointCount; ++i)
+            {
+                const double e = fabs((double)heights[i] - reference[i]);
+                maxError = std::max(maxError, e);
+                sumError += e;
+            }
+
+            auto rate = [&](double seconds) { return pointCount / seconds * 1.0e-6; };
+            bench.Report("    function %7.1f M/s, field %7.1f M/s, batch %7.1f M/s (%.2fx function), batch+gradient %7.1f M/s",
+                rate(functionSeconds), rate(scalarSeconds), rate(batchSeconds), functionSeconds / batchSeconds, rate(gradientSeconds));
+            bench.Report("    error: max %.4f, mean %.5f", maxError, sumError / pointCount);
+        }
+    }
+
+    // Terrain streaming without a device: the camera flies at 300 m/s across
+    // the world for five seconds of 60 Hz frames, so chunks are generated
+    // ahead of it and evicted behind it.  The render thread side (Update and
+    // Select) is timed per frame; it should stay flat while the workers run.
+    void StreamingBenchmark(Benchmark& bench)
+    {
+        const int frames = 300;
+        const float speed = 300.0f;
+        const auto frameTime = std::chrono::microseconds(16667);
+
+        auto height = [](float x, float z) { return roundf(0.2f * (z * sinf(0.1f * x) + x * cosf(0.1f * z))); };
+
+        TerrainStreamerDesc desc;
+        desc.MemoryBudget = 48ull * 1024 * 1024;
+        TerrainStreamer streamer;
+        streamer.Initialize(nullptr, nullptr, desc, height, nullptr, 0);
+        bench.Report("  chunk: %.0f m, %.2f MB; budget %.0f MB (%u chunks), load radius %.0f m, %u workers",
+            desc.Chunk.Size, streamer.ChunkByteSize() / (1024.0 * 1024.0), desc.MemoryBudget / (1024.0 * 1024.0),
+            streamer.MaxResidentChunks(), desc.LoadRadius, desc.WorkerCount);
+
+        Camera camera;
+        camera.SetLens(0.25f * MathHelper::Pi, 16.0f / 9.0f, 1.0f, 1000.0f);
+
+        std::vector<RenderItem*> visible;
+        double updateSeconds = 0.0, maxUpdate = 0.0;
+        double selectSeconds = 0.0, maxSelect = 0.0;
+        UINT64 peakBytes = 0;
+        UINT64 triangles = 0;
+        int settledFrame = -1;
+        auto next = std::chrono::steady_clock::now();
+        for (int f = 0; f < frames; ++f)
+        {
+            const float x = speed * f / 60.0f;
+            camera.LookAt(XMFLOAT3(x, height(x, 0.0f) + 30.0f, 0.0f), XMFLOAT3(x + 100.0f, 0.0f, 0.0f), XMFLOAT3(0.0f, 1.0f, 0.0f));
+            camera.UpdateViewMatrix();
+
+            XMFLOAT4 planes[6];
+            camera.GetFrustumPlanes(planes);
+            FrustumPlanes frustum;
+            frustum.Set(planes);
+
+            double start = bench.Now();
+            streamer.Update(camera.GetPosition3f(), 0);
+            const double update = bench.Now() - start;
+
+            visible.clear();
+            start = bench.Now();
+            streamer.Select(camera.GetPosition3f(), frustum, visible);
+            const double select = bench.Now() - start;
+
+            updateSeconds += update;
+            maxUpdate = std::max(maxUpdate, update);
+            selectSeconds += select;
+            maxSelect = std::max(maxSelect, select);
+
+            const TerrainStreamer::Stats& stats = streamer.GetStats();
+            peakBytes = std::max(peakBytes, stats.ResidentBytes);
+            triangles += stats.TrianglesSelected;
+            if (settledFrame < 0 && stats.PendingChunks == 0 && stats.Requested == 0)
+                settledFrame = f;
+
+            streamer.EndFrame(f + 1);
+
+            next += frameTime;
+            std::this_thread::sleep_until(next);
+        }
+
+        const TerrainStreamer::Stats& stats = streamer.GetStats();
+        bench.Report("  update: %.4f ms/frame (max %.4f), select: %.4f ms/frame (max %.4f), %.0f triangles/frame",
+            updateSeconds * 1000.0 / frames, maxUpdate * 1000.0, selectSeconds * 1000.0 / frames, maxSelect * 1000.0,
+            (double)triangles / frames);
+        bench.Report("  %llu chunks streamed, %llu evicted, peak %.1f MB resident, first settled at frame %d",
+            (unsigned long long)stats.TotalArrived, (unsigned long long)stats.TotalEvicted,
+            peakBytes / (1024.0 * 1024.0), settledFrame);
+        streamer.Shutdown();
+    }
+
+    // A forest of 256 trees, five levels deep with six children per node and
+    // an item on every leaf.  TransformSystem::Update with nothing moved, with
+    // scattered nodes moved, with a few whole trees moved and with every root
+    // moved, against recomposing every world matrix from its parent chain.
+    void TransformsBenchmark(Benchmark& bench)
+    {
+        const UINT rootCount = 256;
+        const UINT depth = 5;
+        const UINT fanout = 6;
+        const int frames = 32;
+
+        TransformSystem transforms;
+        std::vector<UINT> parents;
+        std::vector<XMFLOAT4X4> locals;
+        std::vector<UINT> roots;
+        std::vector<RenderItem> items;
+
+        auto randomLocal = []()
+        {
+            return XMMatrixRotationRollPitchYaw(MathHelper::RandF(-1.0f, 1.0f), MathHelper::RandF(-1.0f, 1.0f), MathHelper::RandF(-1.0f, 1.0f)) *
+                XMMatrixTranslation(MathHelper::RandF(-2.0f, 2.0f), MathHelper::RandF(-2.0f, 2.0f), MathHelper::RandF(-2.0f, 2.0f));
+        };
+
+        auto create = [&](UINT parent)
+        {
+            XMMATRIX local = randomLocal();
+            parents.push_back(parent);
+            locals.emplace_back();
+            XMStoreFloat4x4(&locals.back(), local);
+            return transforms.Create(parent, local);
+        };
+
+        // Breadth-first, so parents are always created first.
+        for (UINT r = 0; r < rootCount; ++r)
+            roots.push_back(create(TransformSystem::InvalidNode));
+        std::vector<UINT> level = roots;
+        for (UINT d = 1; d < depth; ++d)
+        {
+            std::vector<UINT> nextLevel;
+            for (UINT parent : level)
+            {
+                for (UINT c = 0; c < fanout; ++c)
+                    nextLevel.push_back(create(parent));
+            }
+            level.swap(nextLevel);
+        }
+        const std::vector<UINT>& leaves = level;
+
+        items.resize(leaves.size());
+        for (UINT i = 0; i < (UINT)leaves.size(); ++i)
+            transforms.Attach(leaves[i], &items[i]);
+
+        const unsigned int hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+        JobSystem jobs(hardwareThreads - 1);
+
+        double start = bench.Now();
+        transforms.Update(nullptr);
+        bench.Report("  %u nodes, %u items, first update %.3f ms", transforms.NodeCount(), (UINT)items.size(),
+            (bench.Now() - start) * 1000.0);
+
+        // Ad hoc composition: every node walks its parent chain every frame.
+        const UINT nodeCount = transforms.NodeCount();
+        std::vector<XMFLOAT4X4> reference(nodeCount);
+        start = bench.Now();
+        for (int f = 0; f < frames; ++f)
+        {
+            for (UINT n = 0; n < nodeCount; ++n)
+            {
+                XMMATRIX world = XMLoadFloat4x4(&locals[n]);
+                for (UINT p = parents[n]; p != TransformSystem::InvalidNode; p = parents[p])
+                    world = world * XMLoadFloat4x4(&locals[p]);
+                XMStoreFloat4x4(&reference[n], world);
+            }
+        }
+        const double referenceSeconds = (bench.Now() - start) / frames;
+        bench.Report("  %-26s %8.4f ms", "parent chains, all nodes:", referenceSeconds * 1000.0);
+
+        auto run = [&](const char* name, JobSystem* jobSystem, const std::function<void()>& move)
+        {
+            double seconds = 0.0;
+            UINT64 updated = 0;
+            UINT64 itemsMoved = 0;
+            for (int f = 0; f < frames; ++f)
+            {
+                move();
+                start = bench.Now();
+                transforms.Update(jobSystem);
+                seconds += bench.Now() - start;
+                updated += transforms.GetStats().NodesUpdated;
+                itemsMoved += transforms.GetStats().ItemsUpdated;
+            }
+            bench.Report("  %-26s %8.4f ms, %7.0f nodes and %7.0f items per update (%.1fx)", name, seconds * 1000.0 / frames,
+                (double)updated / frames, (double)itemsMoved / frames, referenceSeconds / (seconds / frames));
+        };
+
+        auto moveNode = [&](UINT node)
+        {
+            XMMATRIX local = randomLocal();
+            XMStoreFloat4x4(&locals[node], local);
+            transforms.SetLocal(node, local);
+        };
+
+        run("static:", nullptr, []() {});
+        run("1% of nodes moved:", nullptr, [&]() { for (UINT i = 0; i < nodeCount / 100; ++i) moveNode(MathHelper::Rand(0, (int)nodeCount - 1)); });
+        run("4 trees moved:", nullptr, [&]() { for (UINT i = 0; i < 4; ++i) moveNode(roots[MathHelper::Rand(0, (int)rootCount - 1)]); });
+        run("all trees moved:", nullptr, [&]() { for (UINT r : roots) moveNode(r); });
+        run("all trees moved, jobs:", &jobs, [&]() { for (UINT r : roots) moveNode(r); });
+
+        // Check the last state against the parent chains.
+        float maxError = 0.0f;
+        for (UINT n = 0; n < nodeCount; ++n)
+        {
+            XMMATRIX world = XMLoadFloat4x4(&locals[n]);
+            for (UINT p = parents[n]; p != TransformSystem::InvalidNode; p = parents[p])
+                world = world * XMLoadFloat4x4(&locals[p]);
+            XMMATRIX diff = transforms.GetWorld(n) - world;
+            for (int r = 0; r < 4; ++r)
+                maxError = std::max(maxError, XMVectorGetX(XMVector4LengthEst(diff.r[r])));
+        }
+        bench.Report("  max difference from parent chains: %g", maxError);
+    }
+
+    void HandlesBenchmark(Benchmark& bench)
+    {
+        const UINT geometryCount = 64;
+        const UINT submeshCount = 8;
+        const UINT materialCount = 32;
+        const UINT itemCount = 100000;
+        const int builds = 8;
+
+        // A data-driven scene: every item names its geometry, submesh and
+        // material, as a level file would.
+        struct ItemDesc
+        {
+            std::string Geo;
+            std::string Submesh;
+            std::string Mat;
+        };
+        std::vector<ItemDesc> scene(itemCount);
+        for (ItemDesc& desc : scene)
+        {
+            desc.Geo = "geo" + std::to_string(MathHelper::Rand(0, (int)geometryCount - 1));
+            desc.Submesh = "submesh" + std::to_string(MathHelper::Rand(0, (int)submeshCount - 1));
+            desc.Mat = "mat" + std::to_string(MathHelper::Rand(0, (int)materialCount - 1));
+        }
+
+        // Before: resources in string-keyed maps, submeshes in DrawArgs.
+        struct StringGeometry
+        {
+            MeshGeometry Geo;
+            std::unordered_map<std::string, SubmeshGeometry> DrawArgs;
+        };
+        std::unordered_map<std::string, std::unique_ptr<StringGeometry>> stringGeometries;
+        std::unordered_map<std::string, std::unique_ptr<Material>> stringMaterials;
+
+        // After: interned names and registries.
+        Registry<MeshGeometry> geometries;
+        Registry<Material> materials;
+
+        for (UINT g = 0; g < geometryCount; ++g)
+        {
+            const std::string name = "geo" + std::to_string(g);
+            auto stringGeo = std::make_unique<StringGeometry>();
+            auto geo = std::make_unique<MeshGeometry>();
+            for (UINT s = 0; s < submeshCount; ++s)
+            {
+                SubmeshGeometry submesh;
+                submesh.IndexCount = 36 * (s + 1);
+                submesh.StartIndexLocation = 36 * s;
+                stringGeo->DrawArgs["submesh" + std::to_string(s)] = submesh;
+                geo->AddSubmesh(Names::Intern("submesh" + std::to_string(s)), submesh);
+            }
+            stringGeometries[name] = std::move(stringGeo);
+            geometries.Add(Names::Intern(name), std::move(geo));
+        }
+        for (UINT m = 0; m < materialCount; ++m)
+        {
+            const std::string name = "mat" + std::to_string(m);
+            stringMaterials[name] = std::make_unique<Material>();
+            auto mat = std::make_unique<Material>();
+            mat->Name = name;
+            materials.Add(Names::Intern(name), std::move(mat));
+        }
+
+        std::vector<RenderItem> items(itemCount);
+        UINT64 checksum[3] = {};
+
+        auto run = [&](const char* name, int variant, const std::function<void()>& build)
+        {
+            double seconds = 0.0;
+            for (int b = 0; b < builds; ++b)
+            {
+                double start = bench.Now();
+                build();
+                seconds += bench.Now() - start;
+            }
+            for (const RenderItem& item : items)
+                checksum[variant] += item.IndexCount + item.StartIndexLocation + (UINT64)(item.Mat != nullptr);
+            bench.Report("  %-28s %8.3f ms per build, %6.1f ns per item", name, seconds * 1000.0 / builds,
+                seconds * 1e9 / ((double)builds * itemCount));
+            return seconds;
+        };
+
+        const double stringSeconds = run("string maps:", 0, [&]()
+        {
+            for (UINT i = 0; i < itemCount; ++i)
+            {
+                const ItemDesc& desc = scene[i];
+                StringGeometry* geo = stringGeometries[desc.Geo].get();
+                const SubmeshGeometry& submesh = geo->DrawArgs[desc.Submesh];
+                RenderItem& item = items[i];
+                item.Geo = &geo->Geo;
+                item.Mat = stringMaterials[desc.Mat].get();
+                item.IndexCount = submesh.IndexCount;
+                item.StartIndexLocation = submesh.StartIndexLocation;
+                item.BaseVertexLocation = submesh.BaseVertexLocation;
+            }
+        });
+
+        // The scene's names are interned once, when it is loaded.
+        struct ItemNames
+        {
+            NameId Geo;
+            NameId Submesh;
+            NameId Mat;
+        };
+        std::vector<ItemNames> sceneNames(itemCount);
+        double start = bench.Now();
+        for (UINT i = 0; i < itemCount; ++i)
+        {
+            sceneNames[i].Geo = Names::Intern(scene[i].Geo);
+            sceneNames[i].Submesh = Names::Intern(scene[i].Submesh);
+            sceneNames[i].Mat = Names::Intern(scene[i].Mat);
+        }
+        bench.Report("  %-28s %8.3f ms, once at load", "interning the scene:", (bench.Now() - start) * 1000.0);
+
+        const double nameSeconds = run("interned names:", 1, [&]()
+        {
+            for (UINT i = 0; i < itemCount; ++i)
+            {
+                const ItemNames& desc = sceneNames[i];
+                MeshGeometry* geo = geometries.Get(geometries.Find(desc.Geo));
+                const SubmeshGeometry& submesh = geo->Submeshes[geo->FindSubmesh(desc.Submesh)];
+                RenderItem& item = items[i];
+                item.Geo = geo;
+                item.Mat = materials.Get(materials.Find(desc.Mat));
+                item.IndexCount = submesh.IndexCount;
+                item.StartIndexLocation = submesh.StartIndexLocation;
+                item.BaseVertexLocation = submesh.BaseVertexLocation;
+            }
+        });
+
+        // Resolved further to handles and submesh indices, as Renderer does.
+        struct ItemHandles
+        {
+            Handle<MeshGeometry> Geo;
+            UINT Submesh;
+            Handle<Material> Mat;
+        };
+        std::vector<ItemHandles> sceneHandles(itemCount);
+        for (UINT i = 0; i < itemCount; ++i)
+        {
+            sceneHandles[i].Geo = geometries.Find(sceneNames[i].Geo);
+            sceneHandles[i].Submesh = geometries.Get(sceneHandles[i].Geo)->FindSubmesh(sceneNames[i].Submesh);
+            sceneHandles[i].Mat = materials.Find(sceneNames[i].Mat);
+        }
+
+        const double handleSeconds = run("handles:", 2, [&]()
+        {
+            for (UINT i = 0; i < itemCount; ++i)
+            {
+                const ItemHandles& desc = sceneHandles[i];
+                MeshGeometry* geo = geometries.Get(desc.Geo);
+                const SubmeshGeometry& submesh = geo->Submeshes[desc.Submesh];
+                RenderItem& item = items[i];
+                item.Geo = geo;
+                item.Mat = materials.Get(desc.Mat);
+                item.IndexCount = submesh.IndexCount;
+                item.StartIndexLocation = submesh.StartIndexLocation;
+                item.BaseVertexLocation = submesh.BaseVertexLocation;
+            }
+        });
+
+        bench.Report("  speedup over string maps: %.1fx interned names, %.1fx handles", stringSeconds / nameSeconds,
+            stringSeconds / handleSeconds);
+        bench.Report("  results %s", checksum[0] == checksum[1] && checksum[1] == checksum[2] ? "match" : "DIFFER");
+    }
+
+    void FenceBenchmark(Benchmark& bench)
+    {
+        // Waiting on an event that is already set: the cost the per-wait
+        // CreateEventEx/CloseHandle pair added to every frame that blocked.
+        const int waits = 20000;
+        double start = bench.Now();
+        for (int i = 0; i < waits; ++i)
+        {
+            HANDLE eventHandle = CreateEventEx(nullptr, nullptr, 0, EVENT_ALL_ACCESS);
+            SetEvent(eventHandle);
+            WaitForSingleObject(eventHandle, INFINITE);
+            CloseHandle(eventHandle);
+        }
+        const double createSeconds = bench.Now() - start;
+
+        HANDLE persistentEvent = CreateEventEx(nullptr, nullptr, 0, EVENT_ALL_ACCESS);
+        start = bench.Now();
+        for (int i = 0; i < waits; ++i)
+        {
+            SetEvent(persistentEvent);
+            WaitForSingleObject(persistentEvent, INFINITE);
+        }
+        const double persistentSeconds = bench.Now() - start;
+        CloseHandle(persistentEvent);
+
+        bench.Report("  %-26s %8.0f ns per wait", "event per wait:", createSeconds * 1e9 / waits);
+        bench.Report("  %-26s %8.0f ns per wait (%.1fx)", "persistent event:", persistentSeconds * 1e9 / waits,
+            createSeconds / persistentSeconds);
+
+        // Frame pacing against a stand-in GPU that takes gpuMs per frame,
+        // with the CPU spending cpuMs on each.  With one frame in flight the
+        // two serialize; with more the GPU should stay busy.
+        const double cpuMs = 1.0;
+        const double gpuMs = 2.0;
+        const int frames = 120;
+
+        auto spin = [&](double ms)
+        {
+            const double until = bench.Now() + ms / 1000.0;
+            while (bench.Now() < until)
+                std::this_thread::yield();
+        };
+
+        for (UINT framesInFlight = 1; framesInFlight <= 3; ++framesInFlight)
+        {
+            CpuTimeline timeline;
+            std::atomic<bool> quit{ false };
+            std::thread gpu([&]()
+            {
+                while (!quit.load(std::memory_order_relaxed))
+                {
+                    const UINT64 next = timeline.CompletedValue() + 1;
+                    if (timeline.Queued() < next)
+                    {
+                        std::this_thread::yield();
+                        continue;
+                    }
+                    spin(gpuMs);
+                    timeline.Complete(next);
+                }
+            });
+
+            std::vector<UINT64> frameFences(framesInFlight, 0);
+            start = bench.Now();
+            for (int f = 0; f < frames; ++f)
+            {
+                // As Renderer::Update: reuse the oldest frame resource once
+                // the GPU is done with it.
+                UINT64& fence = frameFences[f % framesInFlight];
+                if (fence != 0)
+                    timeline.Wait(fence);
+                spin(cpuMs);
+                fence = timeline.Signal();
+            }
+            timeline.WaitIdle();
+            const double seconds = bench.Now() - start;
+
+            quit = true;
+            gpu.join();
+
+            const GpuTimeline::Stats& stats = timeline.GetTotalStats();
+            bench.Report("  %u frame(s) in flight: %6.2f ms per frame, %5.2f ms waiting per frame, %u of %d frames blocked",
+                framesInFlight, seconds * 1000.0 / frames, stats.WaitSeconds * 1000.0 / frames, stats.Waits, frames);
+        }
+    }
+
+    void TextureCookBenchmark(Benchmark& bench)
+    {
+        const std::wstring directory = L"Models/Remy.fbm/";
+        const unsigned int hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+        JobSystem jobs(hardwareThreads - 1);
+
+        TextureImage image;
+        if (!TextureCooker::DecodeImage(directory + L"Remy_Top_Diffuse.png", true, image))
+        {
+            bench.Report("  Remy_Top_Diffuse.png not loaded, skipped");
+            return;
+        }
+
+        std::vector<TextureImage> mips;
+        auto timeMips = [&](const char* name, MipFilter filter, JobSystem* jobSystem)
+        {
+            double start = bench.Now();
+            TextureCooker::BuildMips(image, filter, false, jobSystem, mips);
+            bench.Report("  %-22s %8.1f ms, %u levels", name, (bench.Now() - start) * 1000.0, (UINT)mips.size());
+        };
+        bench.Report("  mips of %ux%u, %u threads", image.Width, image.Height, jobs.ThreadCount());
+        timeMips("box:", MipFilter::Box, nullptr);
+        timeMips("box, jobs:", MipFilter::Box, &jobs);
+        timeMips("kaiser:", MipFilter::Kaiser, nullptr);
+        timeMips("kaiser, jobs:", MipFilter::Kaiser, &jobs);
+
+        // One map of each kind, cooked as CookDirectory would.
+        struct Case
+        {
+            const wchar_t* Name;
+            const wchar_t* Opacity;
+            TextureUsage Usage;
+        };
+        const Case cases[] =
+        {
+            { L"Remy_Top_Diffuse", nullptr, TextureUsage::Color },
+            { L"Remy_Hair_Diffuse", L"Remy_Hair_Opacity", TextureUsage::ColorAlpha },
+            { L"Remy_Top_Normal", nullptr, TextureUsage::Normal },
+            { L"Remy_Top_Gloss", nullptr, TextureUsage::Mask },
+        };
+
+        TextureCookOptions options;
+        options.Jobs = &jobs;
+        UINT64 uncompressed = 0;
+        UINT64 cooked = 0;
+        for (const Case& c : cases)
+        {
+            const std::wstring ddsFile = directory + c.Name + L".bench.dds";
+            TextureCookStats stats;
+            if (!TextureCooker::Cook(directory + c.Name + L".png", c.Opacity != nullptr ? directory + c.Opacity + L".png" : L"",
+                ddsFile, c.Usage, options, &stats))
+            {
+                bench.Report("  %ls not cooked", c.Name);
+                continue;
+            }
+            DeleteFileW(ddsFile.c_str());
+
+            bench.Report("  %-18ls %4ux%-4u %7.1f -> %5.1f MB (%.1fx), decode %6.1f ms, mips %6.1f ms, encode %7.1f ms",
+                c.Name, stats.Width, stats.Height, stats.UncompressedBytes / (1024.0 * 1024.0), stats.CookedBytes / (1024.0 * 1024.0),
+                (double)stats.UncompressedBytes / stats.CookedBytes, stats.DecodeSeconds * 1000.0, stats.MipSeconds * 1000.0,
+                stats.EncodeSeconds * 1000.0);
+            uncompressed += stats.UncompressedBytes;
+            cooked += stats.CookedBytes;
+        }
+        if (cooked > 0)
+            bench.Report("  total %.1f -> %.1f MB of texture memory (%.1fx)", uncompressed / (1024.0 * 1024.0),
+                cooked / (1024.0 * 1024.0), (double)uncompressed / cooked);
+    }
+
+    void BlockEncodeBenchmark(Benchmark& bench)
+    {
+        const unsigned int hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+        JobSystem jobs(hardwareThreads - 1);
+
+        // Each image in the formats the cooker would pick for it; Channels is
+        // how many of RGBA the format keeps and the PSNR is measured over.
+        struct Case
+        {
+            const wchar_t* File;
+            DXGI_FORMAT Format;
+            const char* FormatName;
+            UINT Channels;
+        };
+        const Case cases[] =
+        {
+            { L"Models/Remy.fbm/Remy_Top_Diffuse.png", DXGI_FORMAT_BC1_UNORM_SRGB, "BC1", 3 },
+            { L"Models/Remy.fbm/Remy_Top_Diffuse.png", DXGI_FORMAT_BC7_UNORM_SRGB, "BC7", 3 },
+            { L"Models/Remy.fbm/Remy_Top_Normal.png", DXGI_FORMAT_BC5_UNORM, "BC5", 2 },
+            { L"Models/Remy.fbm/Remy_Top_Gloss.png", DXGI_FORMAT_BC4_UNORM, "BC4", 1 },
+            { L"Textures/grass.jpg", DXGI_FORMAT_BC1_UNORM_SRGB, "BC1", 3 },
+            { L"Textures/grass.jpg", DXGI_FORMAT_BC7_UNORM_SRGB, "BC7", 3 },
+        };
+        const char* qualityNames[] = { "fast", "normal", "high" };
+
+        bench.Report("  %u threads", jobs.ThreadCount());
+        for (const Case& test : cases)
+        {
+            // Texels as stored in the file; the encoder never converts.
+            TextureImage image;
+            if (!TextureCooker::DecodeImage(test.File, false, image))
+            {
+                bench.Report("  %ls not loaded, skipped", test.File);
+                continue;
+            }
+
+            const UINT width = image.Width;
+            const UINT height = image.Height;
+            const size_t rowPitch = (size_t)width * 4;
+            std::vector<BYTE> rgba(rowPitch * height);
+            for (size_t i = 0; i < image.Texels.size(); ++i)
+            {
+                const float* texel = &image.Texels[i].x;
+                for (UINT k = 0; k < 4; ++k)
+                    rgba[4 * i + k] = (BYTE)(MathHelper::Clamp(texel[k], 0.0f, 1.0f) * 255.0f + 0.5f);
+            }
+
+            const size_t blockRowPitch = (size_t)((width + 3) / 4) * BlockEncoder::BlockBytes(test.Format);
+            std::vector<BYTE> blocks(blockRowPitch * ((height + 3) / 4));
+            std::vector<BYTE> decoded(rgba.size());
+
+            bench.Report("  %ls, %ux%u, %s", test.File, width, height, test.FormatName);
+            for (UINT q = 0; q < 3; ++q)
+            {
+                const BlockQuality quality = (BlockQuality)q;
+                double start = bench.Now();
+                BlockEncoder::Encode(test.Format, rgba.data(), width, height, rowPitch, quality, nullptr, blocks.data(), blockRowPitch);
+                const double serial = bench.Now() - start;
+
+                start = bench.Now();
+                BlockEncoder::Encode(test.Format, rgba.data(), width, height, rowPitch, quality, &jobs, blocks.data(), blockRowPitch);
+                const double parallel = bench.Now() - start;
+
+                BlockEncoder::Decode(test.Format, blocks.data(), blockRowPitch, width, height, decoded.data(), rowPitch);
+                double squaredError = 0.0;
+                for (size_t i = 0; i < rgba.size(); i += 4)
+                {
+                    for (UINT k = 0; k < test.Channels; ++k)
+                    {
+                        const double d = (double)rgba[i + k] - decoded[i + k];
+                        squaredError += d * d;
+                    }
+                }
+                const double mse = squaredError / ((double)width * height * test.Channels);
+                const double psnr = mse > 0.0 ? 10.0 * log10(255.0 * 255.0 / mse) : 99.0;
+
+                const double megapixels = (double)width * height / 1.0e6;
+                bench.Report("    %-7s PSNR %6.2f dB, %7.2f MPix/s, %7.2f MPix/s with jobs",
+                    qualityNames[q], psnr, megapixels / serial, megapixels / parallel);
+            }
+        }
+    }
+
+    void DdsUploadBenchmark(Benchmark& bench)
+    {
+        // Cooked copies of the Remy maps plus the grass texture.
+        const std::wstring directory = L"Models/Remy.fbm/";
+        const wchar_t* maps[] = { L"Remy_Top_Diffuse", L"Remy_Bottom_Diffuse", L"Remy_Shoes_Diffuse", L"Remy_Top_Normal" };
+        std::vector<std::wstring> files;
+        std::vector<std::wstring> cooked;
+
+        TextureCookOptions options;
+        options.Quality = BlockQuality::Fast;
+        for (const wchar_t* map : maps)
+        {
+            const std::wstring ddsFile = directory + map + L".bench.dds";
+            const TextureUsage usage = wcsstr(map, L"Normal") != nullptr ? TextureUsage::Normal : TextureUsage::Color;
+            if (TextureCooker::Cook(directory + map + L".png", L"", ddsFile, usage, options))
+            {
+                files.push_back(ddsFile);
+                cooked.push_back(ddsFile);
+            }
+        }
+        files.push_back(L"Textures/grass.dds");
+
+        const int passes = 5;
+        UINT64 fileBytes = 0;
+
+        // Whole file read into memory, then one upload buffer per texture
+        // kept until the end, as LoadDDSTextureFromFile and a committed
+        // upload heap each did.
+        UINT64 legacyPeak = 0;
+        double start = bench.Now();
+        for (int pass = 0; pass < passes; ++pass)
+        {
+            std::vector<std::vector<BYTE>> fileData;
+            std::vector<std::vector<BYTE>> uploadBuffers;
+            UINT64 held = 0;
+            for (const std::wstring& file : files)
+            {
+                std::ifstream in(file, std::ios::binary | std::ios::ate);
+                fileData.emplace_back((size_t)in.tellg());
+                in.seekg(0);
+                in.read(reinterpret_cast<char*>(fileData.back().data()), fileData.back().size());
+
+                DdsFile dds;
+                if (!dds.Open(file))
+                    continue;
+                UINT64 uploadBytes = 0;
+                for (UINT mip = 0; mip < dds.MipLevels(); ++mip)
+                    uploadBytes += TextureUploader::RowPitch(dds.GetLevel(mip).RowBytes) * dds.GetLevel(mip).Rows;
+                uploadBuffers.emplace_back((size_t)uploadBytes);
+
+                BYTE* dst = uploadBuffers.back().data();
+                for (UINT mip = 0; mip < dds.MipLevels(); ++mip)
+                {
+                    const DdsFile::Level& level = dds.GetLevel(mip);
+                    const UINT64 pitch = TextureUploader::RowPitch(level.RowBytes);
+                    const BYTE* src = fileData.back().data() + level.Offset;
+                    for (UINT row = 0; row < level.Rows; ++row)
+                        memcpy(dst + pitch * row, src + level.RowBytes * row, (size_t)level.RowBytes);
+                    dst += pitch * level.Rows;
+                }
+                held += fileData.back().size() + uploadBytes;
+                if (pass == 0)
+                    fileBytes += fileData.back().size();
+            }
+            legacyPeak = std::max(legacyPeak, held);
+        }
+        const double legacySeconds = (bench.Now() - start) / passes;
+
+        // Mapped files streamed through one ring; the GPU is played by
+        // retiring the whole ring whenever a piece does not fit.
+        const UINT64 stagingBytes = 8 * 1024 * 1024;
+        UploadRing ring(stagingBytes);
+        UINT64 fence = 0;
+        UINT stalls = 0;
+        start = bench.Now();
+        for (int pass = 0; pass < passes; ++pass)
+        {
+            for (const std::wstring& file : files)
+            {
+                DdsFile dds;
+                if (!dds.Open(file))
+                    continue;
+                for (UINT mip = 0; mip < dds.MipLevels(); ++mip)
+                {
+                    const DdsFile::Level& level = dds.GetLevel(mip);
+                    const UINT64 pitch = TextureUploader::RowPitch(level.RowBytes);
+                    const UINT maxRows = (UINT)std::max<UINT64>(1, (ring.Capacity() / 2 - D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT) / pitch);
+                    UINT row = 0;
+                    while (row < level.Rows)
+                    {
+                        const UINT rows = std::min(level.Rows - row, maxRows);
+                        UploadAllocation piece = ring.Allocate(pitch * rows, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+                        if (piece.Cpu == nullptr)
+                        {
+                            ring.EndFrame(++fence);
+                            ring.BeginFrame(fence);
+                            stalls++;
+                            continue;
+                        }
+                        dds.CopyRows(mip, row, rows, piece.Cpu, pitch);
+                        row += rows;
+                    }
+                }
+            }
+        }
+        const double ringSeconds = (bench.Now() - start) / passes;
+
+        for (const std::wstring& file : cooked)
+            DeleteFileW(file.c_str());
+
+        bench.Report("  %u textures, %.1f MB of DDS files", (UINT)files.size(), fileBytes / (1024.0 * 1024.0));
+        bench.Report("  read + upload buffer per texture: %7.2f ms, %6.1f MB held until the flush",
+            legacySeconds * 1000.0, legacyPeak / (1024.0 * 1024.0));
+        bench.Report("  mapped + staging ring:            %7.2f ms, %6.1f MB staging, %u ring turnovers per load",
+            ringSeconds * 1000.0, ring.Capacity() / (1024.0 * 1024.0), stalls / passes);
+    }
+
+    void TextureStreamingBenchmark(Benchmark& bench)
+    {
+        // Twenty-four 2048x2048 BC1/BC3 maps on objects 4 m across, spaced
+        // along a 240 m path the camera flies down and back.  A change lands
+        // three frames after it is planned, like a copy behind a frame queue.
+        const UINT textureCount = 24;
+        const UINT mipLevels = 12;
+        const UINT minResidentSize = 64;
+        const float objectSize = 4.0f;
+        const float spacing = 10.0f;
+        const float viewportHeight = 1080.0f;
+        const float projScale = 1.0f / tanf(0.25f * MathHelper::Pi * 0.5f);
+        const int frames = 2000;
+        const int latency = 3;
+
+        TextureResidency residency;
+        UINT64 fullBytes = 0;
+        UINT64 coarseBytes = 0;
+        for (UINT t = 0; t < textureCount; ++t)
+        {
+            const UINT blockBytes = t % 3 == 0 ? 16 : 8;
+            UINT64 levelBytes[DdsFile::MaxMipLevels];
+            UINT coarsest = mipLevels - 1;
+            for (UINT mip = mipLevels; mip-- > 0; )
+            {
+                const UINT size = std::max(1u, 2048u >> mip);
+                const UINT blocks = (size + 3) / 4;
+                levelBytes[mip] = (UINT64)blocks * blocks * blockBytes;
+                if (size <= minResidentSize)
+                    coarsest = mip;
+            }
+            const UINT texture = residency.Add(levelBytes, mipLevels, coarsest);
+            fullBytes += residency.Bytes(texture, 0);
+            coarseBytes += residency.Bytes(texture, coarsest);
+        }
+
+        const UINT64 budgetBytes = 16ull * 1024 * 1024;
+        const UINT64 uploadBytesPerFrame = 2ull * 1024 * 1024;
+
+        std::vector<TextureResidency::Change> changes;
+        std::deque<std::pair<int, UINT>> landing;
+        UINT64 peakBytes = 0;
+        UINT64 peakUpload = 0;
+        UINT64 totalUpload = 0;
+        UINT changeCount = 0;
+        UINT evictions = 0;
+        int settledFrames = 0;
+        double planSeconds = 0.0;
+
+        for (int frame = 0; frame < frames; ++frame)
+        {
+            while (!landing.empty() && landing.front().first <= frame)
+            {
+                residency.Complete(landing.front().second);
+                landing.pop_front();
+            }
+
+            // Down the path and back; only the objects within 60 m are drawn.
+            const float phase = (float)(frame % 1000) / 1000.0f;
+            const float eye = (phase < 0.5f ? phase : 1.0f - phase) * 2.0f * textureCount * spacing;
+            bool settled = true;
+            for (UINT t = 0; t < textureCount; ++t)
+            {
+                const float distance = std::max(0.1f, fabsf(t * spacing - eye) - 0.5f * objectSize);
+                if (distance > 60.0f)
+                    continue;
+                const UINT mip = TextureResidency::RequiredMip(2048, 1.0f, objectSize, distance, projScale,
+                    viewportHeight, mipLevels);
+                residency.Request(t, mip);
+                settled = settled && residency.ResidentMip(t) <= mip;
+            }
+            settledFrames += settled ? 1 : 0;
+
+            changes.clear();
+            const double start = bench.Now();
+            residency.Plan(budgetBytes, uploadBytesPerFrame, changes);
+            planSeconds += bench.Now() - start;
+
+            UINT64 upload = 0;
+            for (const TextureResidency::Change& change : changes)
+            {
+                upload += change.UploadBytes;
+                evictions += change.UploadBytes == 0 ? 1 : 0;
+                landing.push_back(std::make_pair(frame + latency, change.Texture));
+            }
+            changeCount += (UINT)changes.size();
+            totalUpload += upload;
+            peakUpload = std::max(peakUpload, upload);
+            peakBytes = std::max(peakBytes, residency.SettledBytes());
+        }
+
+        const double mb = 1024.0 * 1024.0;
+        bench.Report("  %u textures: %.1f MB with every level, %.2f MB coarse levels loaded up front",
+            textureCount, fullBytes / mb, coarseBytes / mb);
+        bench.Report("  resident: peak %.1f MB of a %.1f MB budget", peakBytes / mb, budgetBytes / mb);
+        bench.Report("  %u changes (%u evictions), %.2f per frame; uploads peak %.2f MB per frame, %.1f MB in total",
+            changeCount, evictions, (double)changeCount / frames, peakUpload / mb, totalUpload / mb);
+        bench.Report("  every visible texture sharp enough in %.1f%% of frames", 100.0 * settledFrames / frames);
+        bench.Report("  Plan: %.2f us per frame", planSeconds * 1e6 / frames);
+    }
+
+    // Startup with and without the asset loader, on the Remy source maps.
+    // Each is read (the I/O step) and decoded through WIC (the decode step).
+    // Loaded one after another, nothing can be shown until the last one is
+    // done; through the loader the render thread keeps ticking at 60 Hz and
+    // takes the maps on as they arrive, diffuse maps first.
+    // Whichever goes second in a round reads files the first one just pulled
+    // into the OS cache, so the rounds alternate which goes first and the
+    // times are reported by position.  Only the very first pass can find the
+    // cache cold.
+    void AssetLoadBenchmark(Benchmark& bench)
+    {
+        const std::wstring directory = L"Models/Remy.fbm/";
+        const wchar_t* maps[] =
+        {
+            L"Remy_Body_Normal", L"Remy_Body_Specular", L"Remy_Bottom_Diffuse", L"Remy_Bottom_Normal",
+            L"Remy_Hair_Diffuse", L"Remy_Hair_Normal", L"Remy_Shoes_Diffuse", L"Remy_Shoes_Normal",
+            L"Remy_Shoes_Specular", L"Remy_Body_Gloss", L"Remy_Bottom_Gloss", L"Remy_Hair_Gloss",
+        };
+        const UINT mapCount = _countof(maps);
+
+        auto read = [](const std::wstring& file)
+        {
+            std::ifstream in(file, std::ios::binary | std::ios::ate);
+            if (!in)
+                return false;
+            std::vector<char> data((size_t)in.tellg());
+            in.seekg(0);
+            in.read(data.data(), data.size());
+            return true;
+        };
+
+        UINT64 texels = 0;
+        auto sequential = [&]()
+        {
+            const double start = bench.Now();
+            texels = 0;
+            for (const wchar_t* map : maps)
+            {
+                const std::wstring file = directory + map + L".png";
+                TextureImage image;
+                if (read(file) && TextureCooker::DecodeImage(file, false, image))
+                    texels += (UINT64)image.Width * image.Height;
+            }
+            return bench.Now() - start;
+        };
+
+        AssetLoaderDesc desc;
+        desc.DecodeThreads = std::max(2u, std::thread::hardware_concurrency() / 2);
+
+        struct LoaderRun
+        {
+            double Seconds = 0.0;
+            double FirstDiffuse = 0.0;
+            double LastDiffuse = 0.0;
+            double MaxUpdate = 0.0;
+            int Frames = 0;
+            AssetLoader::Stats Stats;
+        };
+        UINT diffuseCount = 0;
+        auto throughLoader = [&]()
+        {
+            LoaderRun run;
+            AssetLoader loader;
+            loader.Initialize(desc);
+
+            const double start = bench.Now();
+            diffuseCount = 0;
+            for (const wchar_t* map : maps)
+            {
+                const std::wstring file = directory + map + L".png";
+                const bool diffuse = wcsstr(map, L"Diffuse") != nullptr;
+                diffuseCount += diffuse ? 1 : 0;
+                auto image = std::make_shared<TextureImage>();
+
+                AssetLoader::Request request;
+                request.Priority = diffuse ? AssetPriority::High : wcsstr(map, L"Normal") != nullptr ? AssetPriority::Normal : AssetPriority::Low;
+                request.Read = [read, file]() { return read(file); };
+                request.Decode = [file, image]() { return TextureCooker::DecodeImage(file, false, *image); };
+                request.Ready = [&, diffuse, image](bool loaded) -> UINT64
+                {
+                    if (diffuse)
+                    {
+                        const double now = bench.Now() - start;
+                        run.FirstDiffuse = run.FirstDiffuse == 0.0 ? now : run.FirstDiffuse;
+                        run.LastDiffuse = now;
+                    }
+                    return loaded ? (UINT64)image->Width * image->Height * 4 : 0;
+                };
+                loader.Load(std::move(request));
+            }
+
+            // The render thread: one Update per 60 Hz frame until everything is in.
+            const auto frameTime = std::chrono::microseconds(16667);
+            auto next = std::chrono::steady_clock::now();
+            while (loader.Pending() > 0)
+            {
+                const double updateStart = bench.Now();
+                loader.Update();
+                run.MaxUpdate = std::max(run.MaxUpdate, bench.Now() - updateStart);
+                run.Frames++;
+
+                next += frameTime;
+                std::this_thread::sleep_until(next);
+            }
+            run.Seconds = bench.Now() - start;
+            run.Stats = loader.GetStats();
+            return run;
+        };
+
+        // [0] when it went first in its round, [1] when it went second.
+        const int rounds = 4;
+        double sequentialSeconds[2] = {};
+        double loaderSeconds[2] = {};
+        double coldSeconds = 0.0;
+        LoaderRun last;
+        for (int r = 0; r < rounds; ++r)
+        {
+            const bool loaderFirst = (r & 1) != 0;
+            for (int position = 0; position < 2; ++position)
+            {
+                if ((position == 0) == loaderFirst)
+                {
+                    last = throughLoader();
+                    loaderSeconds[position] += last.Seconds;
+                }
+                else
+                {
+                    const double seconds = sequential();
+                    sequentialSeconds[position] += seconds;
+                    if (r == 0)
+                        coldSeconds = seconds;
+                }
+                if (r == 0 && position == 0 && texels == 0)
+                {
+                    bench.Report("  Remy maps not found, skipped");
+                    return;
+                }
+            }
+        }
+        const int perPosition = rounds / 2;
+
+        bench.Report("  %u maps, %.1f Mtexels; %u decode threads; %d rounds, alternating which goes first",
+            mapCount, texels * 1e-6, desc.DecodeThreads, rounds);
+        bench.Report("  one after another: %7.1f ms first, %7.1f ms second, before anything can be drawn",
+            sequentialSeconds[0] * 1000.0 / perPosition, sequentialSeconds[1] * 1000.0 / perPosition);
+        bench.Report("  asset loader:      %7.1f ms first, %7.1f ms second, to load everything",
+            loaderSeconds[0] * 1000.0 / perPosition, loaderSeconds[1] * 1000.0 / perPosition);
+        bench.Report("  very first pass (one after another, cache possibly cold): %.1f ms", coldSeconds * 1000.0);
+        bench.Report("  last loader pass: %d frames, Update at most %.3f ms; diffuse maps (high priority) first after %.1f ms, all %u after %.1f ms",
+            last.Frames, last.MaxUpdate * 1000.0, last.FirstDiffuse * 1000.0, diffuseCount, last.LastDiffuse * 1000.0);
+        bench.Report("  %u loaded, %u failed; read %.1f ms, decode %.1f ms, %.1f ms from Load to Ready on average",
+            last.Stats.Loaded, last.Stats.Failed, last.Stats.ReadSeconds * 1000.0, last.Stats.DecodeSeconds * 1000.0,
+            last.Stats.LatencySeconds * 1000.0 / std::max(1u, last.Stats.Loaded + last.Stats.Failed));
+    }
+
+    struct BenchmarkEntry
+    {
+        const char* Name;
+        void(*Func)(Benchmark& bench);
+    };
+
+    const BenchmarkEntry gBenchmarks[] =
+    {
+        { "animation", AnimationBenchmark },
+        { "mesh", MeshLoadBenchmark },
+        { "vertexcache", MeshOptimizerBenchmark },
+        { "weld", VertexWeldBenchmark },
+        { "culling", CullingBenchmark },
+        { "batching", BatchingBenchmark },
+        { "drawqueue", DrawQueueBenchmark },
+        { "recording", RecordingBenchmark },
+        { "headless", HeadlessFrameBenchmark },
+        { "jobs", JobSystemBenchmark },
+        { "upload", UploadRingBenchmark },
+        { "packing", ConstantPackingBenchmark },
+        { "clusters", LightClusterBenchmark },
+        { "terrain", TerrainBenchmark },
+        { "heightfield", HeightFieldBenchmark },
+        { "streaming", StreamingBenchmark },
+        { "transforms", TransformsBenchmark },
+        { "handles", HandlesBenchmark },
+        { "fences", FenceBenchmark },
+        { "texcook", TextureCookBenchmark },
+        { "blocks", BlockEncodeBenchmark },
+        { "ddsupload", DdsUploadBenchmark },
+        { "texstream", TextureStreamingBenchmark },
+        { "assetload", AssetLoadBenchmark },
+    };
+}
+
+Benchmark::Benchmark() : mLog("Benchmark.log")
+{
+    __int64 countsPerSec;
+    QueryPerformanceFrequency((LARGE_INTEGER*)&countsPerSec);
+    mSecondsPerCount = 1.0 / (double)countsPerSec;
+}
+
+int Benchmark::Run(const std::string& filter)
+{
+    Benchmark bench;
+
+    for (const auto& e : gBenchmarks)
+    {
+        if (!filter.empty() && std::string(e.Name).find(filter) == std::string::npos)
+            continue;
+
+        bench.Report("[%s]", e.Name);
+        e.Func(bench);
+    }
+
+    return 0;
+}
+
+double Benchmark::Now()const
+{
+    __int64 counts;
+    QueryPerformanceCounter((LARGE_INTEGER*)&counts);
+    return counts * mSecondsPerCount;
+}
+
+void Benchmark::Report(const char* format, ...)
+{
+    char buffer[512];
+
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+
+    mLog << buffer << std::endl;
+    ::OutputDebugStringA(buffer);
+    ::OutputDebugStringA("\n");
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <windows.h>
+#include <string>
+#include <fstream>
+
+// Headless CPU benchmarks.  Launch the executable with "-benchmark [name]" to
+// run every benchmark (or only the one whose name matches) without creating a
+// window or a Direct3D device.  Results go to the debugger output and to
+// Benchmark.log next to the executable.
+class Benchmark
+{
+public:
+    Benchmark();
+    Benchmark(const Benchmark& rhs) = delete;
+    Benchmark& operator=(const Benchmark& rhs) = delete;
+
+    // Runs the benchmarks whose name contains filter (all of them if empty).
+    static int Run(const std::string& filter);
+
+    // Seconds since an arbitrary epoch, from the performance counter.
+    double Now()const;
+
+    // printf-style line written to the log and the debugger output.
+    void Report(const char* format, ...);
+
+private:
+    double mSecondsPerCount = 0.0;
+    std::ofstream mLog;
+};
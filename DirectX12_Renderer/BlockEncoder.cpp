@@ -0,0 +1,970 @@
+#include "BlockEncoder.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cfloat>
+#include <emmintrin.h>
+
+using namespace DirectX;
+
+namespace
+{
+    // Rows of blocks per job.
+    const UINT BlockRowGrain = 4;
+
+    // BC7 interpolation weights, out of 64, for 3 and 4 bit indices.
+    const int Weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+    const int Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    // BC7 two-subset partitions: bit i set puts texel i in subset 1.
+    const std::uint16_t Partitions2[64] =
+    {
+        0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+        0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+        0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+        0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+        0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A,
+        0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+        0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C,
+        0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22,
+    };
+
+    // The texel of subset 1 whose index is stored without its top bit.
+    const BYTE Anchors2[64] =
+    {
+        15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+        15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+        15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+         6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15,
+    };
+
+    enum BlockFormat
+    {
+        FormatBC1,
+        FormatBC3,
+        FormatBC4,
+        FormatBC5,
+        FormatBC7,
+        FormatUnsupported,
+    };
+
+    BlockFormat Classify(DXGI_FORMAT format)
+    {
+        switch (format)
+        {
+        case DXGI_FORMAT_BC1_UNORM:
+        case DXGI_FORMAT_BC1_UNORM_SRGB: return FormatBC1;
+        case DXGI_FORMAT_BC3_UNORM:
+        case DXGI_FORMAT_BC3_UNORM_SRGB: return FormatBC3;
+        case DXGI_FORMAT_BC4_UNORM: return FormatBC4;
+        case DXGI_FORMAT_BC5_UNORM: return FormatBC5;
+        case DXGI_FORMAT_BC7_UNORM:
+        case DXGI_FORMAT_BC7_UNORM_SRGB: return FormatBC7;
+        default: return FormatUnsupported;
+        }
+    }
+
+    // Blocks are built up from zero, least significant bit first.
+    struct BitWriter
+    {
+        BYTE* Out;
+        UINT Position = 0;
+
+        explicit BitWriter(BYTE* out) : Out(out) {}
+
+        void Write(UINT value, UINT bits)
+        {
+            for (UINT b = 0; b < bits; ++b, ++Position)
+                Out[Position >> 3] |= (BYTE)(((value >> b) & 1) << (Position & 7));
+        }
+    };
+
+    struct BitReader
+    {
+        const BYTE* In;
+        UINT Position = 0;
+
+        explicit BitReader(const BYTE* in) : In(in) {}
+
+        UINT Read(UINT bits)
+        {
+            UINT value = 0;
+            for (UINT b = 0; b < bits; ++b, ++Position)
+                value |= (UINT)((In[Position >> 3] >> (Position & 7)) & 1) << b;
+            return value;
+        }
+    };
+
+    XMVECTOR LoadTexel(const BYTE* texel, bool alpha)
+    {
+        return XMVectorSet(texel[0], texel[1], texel[2], alpha ? texel[3] : 0.0f);
+    }
+
+    XMVECTOR ClampTexel(FXMVECTOR v)
+    {
+        return XMVectorClamp(v, XMVectorZero(), XMVectorReplicate(255.0f));
+    }
+
+    // Mean and principal axis of the texels in mask, by power iteration on
+    // the covariance.  Returns the summed squared distance off the axis, which
+    // is what a line through the block cannot represent.
+    float FitLine(const XMVECTOR texels[16], UINT mask, XMVECTOR& mean, XMVECTOR& axis)
+    {
+        XMVECTOR sum = XMVectorZero();
+        UINT count = 0;
+        for (UINT i = 0; i < 16; ++i)
+        {
+            if (mask & (1u << i))
+            {
+                sum = XMVectorAdd(sum, texels[i]);
+                count++;
+            }
+        }
+        mean = XMVectorScale(sum, 1.0f / std::max(1u, count));
+
+        XMMATRIX cov(XMVectorZero(), XMVectorZero(), XMVectorZero(), XMVectorZero());
+        for (UINT i = 0; i < 16; ++i)
+        {
+            if (mask & (1u << i))
+            {
+                const XMVECTOR d = XMVectorSubtract(texels[i], mean);
+                cov.r[0] = XMVectorMultiplyAdd(d, XMVectorSplatX(d), cov.r[0]);
+                cov.r[1] = XMVectorMultiplyAdd(d, XMVectorSplatY(d), cov.r[1]);
+                cov.r[2] = XMVectorMultiplyAdd(d, XMVectorSplatZ(d), cov.r[2]);
+                cov.r[3] = XMVectorMultiplyAdd(d, XMVectorSplatW(d), cov.r[3]);
+            }
+        }
+
+        // Start from the row of the channel that varies most.
+        float diagonal[4] = { XMVectorGetX(cov.r[0]), XMVectorGetY(cov.r[1]), XMVectorGetZ(cov.r[2]), XMVectorGetW(cov.r[3]) };
+        const float trace = diagonal[0] + diagonal[1] + diagonal[2] + diagonal[3];
+        const int largest = (int)(std::max_element(diagonal, diagonal + 4) - diagonal);
+        if (diagonal[largest] <= 0.0f)
+        {
+            axis = XMVector4Normalize(XMVectorSet(1.0f, 1.0f, 1.0f, 0.0f));
+            return 0.0f;
+        }
+
+        XMVECTOR v = XMVector4Normalize(cov.r[largest]);
+        for (int iteration = 0; iteration < 8; ++iteration)
+            v = XMVector4Normalize(XMVector4Transform(v, cov));
+        axis = v;
+
+        const float variance = XMVectorGetX(XMVector4Dot(v, XMVector4Transform(v, cov)));
+        return std::max(0.0f, trace - variance);
+    }
+
+    // Endpoints at the extremes of the texels projected onto the axis.
+    void LineEndpoints(const XMVECTOR texels[16], UINT mask, FXMVECTOR mean, FXMVECTOR axis, XMVECTOR endpoints[2])
+    {
+        float lo = FLT_MAX;
+        float hi = -FLT_MAX;
+        for (UINT i = 0; i < 16; ++i)
+        {
+            if (mask & (1u << i))
+            {
+                const float t = XMVectorGetX(XMVector4Dot(XMVectorSubtract(texels[i], mean), axis));
+                lo = std::min(lo, t);
+                hi = std::max(hi, t);
+            }
+        }
+        endpoints[0] = ClampTexel(XMVectorMultiplyAdd(axis, XMVectorReplicate(lo), mean));
+        endpoints[1] = ClampTexel(XMVectorMultiplyAdd(axis, XMVectorReplicate(hi), mean));
+    }
+
+    // Least-squares endpoints for the chosen indices; weights[i] is how much
+    // of endpoint 1 index i holds.  False when the indices leave it open.
+    bool RefitEndpoints(const XMVECTOR texels[16], UINT mask, const BYTE indices[16], const float* weights, XMVECTOR endpoints[2])
+    {
+        float a = 0.0f, b = 0.0f, c = 0.0f;
+        XMVECTOR x0 = XMVectorZero();
+        XMVECTOR x1 = XMVectorZero();
+        for (UINT i = 0; i < 16; ++i)
+        {
+            if (mask & (1u << i))
+            {
+                const float t = weights[indices[i]];
+                const float s = 1.0f - t;
+                a += s * s;
+                b += s * t;
+                c += t * t;
+                x0 = XMVectorMultiplyAdd(texels[i], XMVectorReplicate(s), x0);
+                x1 = XMVectorMultiplyAdd(texels[i], XMVectorReplicate(t), x1);
+            }
+        }
+
+        const float det = a * c - b * b;
+        if (fabsf(det) < 1e-6f)
+            return false;
+
+        const float inv = 1.0f / det;
+        endpoints[0] = ClampTexel(XMVectorScale(XMVectorSubtract(XMVectorScale(x0, c), XMVectorScale(x1, b)), inv));
+        endpoints[1] = ClampTexel(XMVectorScale(XMVectorSubtract(XMVectorScale(x1, a), XMVectorScale(x0, b)), inv));
+        return true;
+    }
+
+    // Up to 16 RGBA entries stored channel by channel, four entries per
+    // vector, so one texel is compared against four entries at a time.
+    struct Palette
+    {
+        UINT Count = 0;
+        XMFLOAT4A Channels[4][4];
+
+        void Set(UINT i, float r, float g, float b, float a)
+        {
+            (&Channels[0][i / 4].x)[i % 4] = r;
+            (&Channels[1][i / 4].x)[i % 4] = g;
+            (&Channels[2][i / 4].x)[i % 4] = b;
+            (&Channels[3][i / 4].x)[i % 4] = a;
+        }
+    };
+
+    // Nearest entry by squared RGBA distance.
+    UINT Nearest(const Palette& palette, FXMVECTOR texel, float& error)
+    {
+        const XMVECTOR r = XMVectorSplatX(texel);
+        const XMVECTOR g = XMVectorSplatY(texel);
+        const XMVECTOR b = XMVectorSplatZ(texel);
+        const XMVECTOR a = XMVectorSplatW(texel);
+
+        UINT best = 0;
+        error = FLT_MAX;
+        for (UINT group = 0; group * 4 < palette.Count; ++group)
+        {
+            XMVECTOR d = XMVectorSubtract(r, XMLoadFloat4A(&palette.Channels[0][group]));
+            XMVECTOR dist = XMVectorMultiply(d, d);
+            d = XMVectorSubtract(g, XMLoadFloat4A(&palette.Channels[1][group]));
+            dist = XMVectorMultiplyAdd(d, d, dist);
+            d = XMVectorSubtract(b, XMLoadFloat4A(&palette.Channels[2][group]));
+            dist = XMVectorMultiplyAdd(d, d, dist);
+            d = XMVectorSubtract(a, XMLoadFloat4A(&palette.Channels[3][group]));
+            dist = XMVectorMultiplyAdd(d, d, dist);
+
+            XMFLOAT4A distances;
+            XMStoreFloat4A(&distances, dist);
+            const float* values = &distances.x;
+            for (UINT k = 0; k < 4 && group * 4 + k < palette.Count; ++k)
+            {
+                if (values[k] < error)
+                {
+                    error = values[k];
+                    best = group * 4 + k;
+                }
+            }
+        }
+        return best;
+    }
+
+    float ChooseIndices(const XMVECTOR texels[16], UINT mask, const Palette& palette, BYTE indices[16])
+    {
+        float total = 0.0f;
+        for (UINT i = 0; i < 16; ++i)
+        {
+            if (mask & (1u << i))
+            {
+                float error;
+                indices[i] = (BYTE)Nearest(palette, texels[i], error);
+                total += error;
+            }
+        }
+        return total;
+    }
+
+    // ---- BC4: one channel, also the alpha of BC3 and both halves of BC5 ----
+
+    void Bc4Palette(int r0, int r1, int palette[8])
+    {
+        palette[0] = r0;
+        palette[1] = r1;
+        if (r0 > r1)
+        {
+            for (int i = 1; i < 7; ++i)
+                palette[i + 1] = ((7 - i) * r0 + i * r1 + 3) / 7;
+        }
+        else
+        {
+            for (int i = 1; i < 5; ++i)
+                palette[i + 1] = ((5 - i) * r0 + i * r1 + 2) / 5;
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+    }
+
+    // Nearest entry for all 16 values at once; returns the summed squared error.
+    UINT Bc4Indices(const BYTE values[16], const int palette[8], BYTE indices[16])
+    {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values));
+        __m128i best = _mm_set1_epi8((char)0xFF);
+        __m128i bestIndex = _mm_setzero_si128();
+        for (int i = 0; i < 8; ++i)
+        {
+            const __m128i p = _mm_set1_epi8((char)palette[i]);
+            const __m128i diff = _mm_or_si128(_mm_subs_epu8(v, p), _mm_subs_epu8(p, v));
+            const __m128i smaller = _mm_min_epu8(diff, best);
+            const __m128i closer = _mm_andnot_si128(_mm_cmpeq_epi8(diff, best), _mm_cmpeq_epi8(smaller, diff));
+            best = smaller;
+            bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi8((char)i)), _mm_andnot_si128(closer, bestIndex));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(indices), bestIndex);
+
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i lo = _mm_unpacklo_epi8(best, zero);
+        const __m128i hi = _mm_unpackhi_epi8(best, zero);
+        __m128i squares = _mm_add_epi32(_mm_madd_epi16(lo, lo), _mm_madd_epi16(hi, hi));
+        squares = _mm_add_epi32(squares, _mm_shuffle_epi32(squares, _MM_SHUFFLE(1, 0, 3, 2)));
+        squares = _mm_add_epi32(squares, _mm_shuffle_epi32(squares, _MM_SHUFFLE(2, 3, 0, 1)));
+        return (UINT)_mm_cvtsi128_si32(squares);
+    }
+
+    void EncodeBc4(const BYTE texels[64], UINT channel, BlockQuality quality, BYTE block[8])
+    {
+        BYTE values[16];
+        int lo = 255;
+        int hi = 0;
+        for (UINT i = 0; i < 16; ++i)
+        {
+            values[i] = texels[4 * i + channel];
+            lo = std::min(lo, (int)values[i]);
+            hi = std::max(hi, (int)values[i]);
+        }
+
+        int bestR0 = hi;
+        int bestR1 = lo;
+        BYTE bestIndices[16];
+        UINT bestError = UINT_MAX;
+        auto tryEndpoints = [&](int r0, int r1)
+        {
+            int palette[8];
+            BYTE indices[16];
+            Bc4Palette(r0, r1, palette);
+            const UINT error = Bc4Indices(values, palette, indices);
+            if (error < bestError)
+            {
+                bestError = error;
+                bestR0 = r0;
+                bestR1 = r1;
+                memcpy(bestIndices, indices, 16);
+            }
+        };
+
+        // Eight levels between the extremes.
+        tryEndpoints(hi, lo);
+
+        // Six levels between the inner values, plus exact 0 and 255.
+        if (quality != BlockQuality::Fast && bestError > 0 && (lo == 0 || hi == 255))
+        {
+            int innerLo = 255;
+            int innerHi = 0;
+            for (BYTE v : values)
+            {
+                if (v != 0 && v != 255)
+                {
+                    innerLo = std::min(innerLo, (int)v);
+                    innerHi = std::max(innerHi, (int)v);
+                }
+            }
+            if (innerLo <= innerHi)
+                tryEndpoints(innerLo, innerHi);
+        }
+
+        // Pulling the endpoints in often moves the levels closer to the bulk
+        // of the values.
+        if (quality == BlockQuality::High && bestError > 0)
+        {
+            for (int d0 = 0; d0 < 4; ++d0)
+            {
+                for (int d1 = 0; d1 < 4; ++d1)
+                {
+                    if (hi - d0 > lo + d1)
+                        tryEndpoints(hi - d0, lo + d1);
+                }
+            }
+        }
+
+        block[0] = (BYTE)bestR0;
+        block[1] = (BYTE)bestR1;
+        std::uint64_t bits = 0;
+        for (UINT i = 0; i < 16; ++i)
+            bits |= (std::uint64_t)bestIndices[i] << (3 * i);
+        for (UINT i = 0; i < 6; ++i)
+            block[2 + i] = (BYTE)(bits >> (8 * i));
+    }
+
+    void DecodeBc4(const BYTE block[8], UINT channel, BYTE texels[64])
+    {
+        int palette[8];
+        Bc4Palette(block[0], block[1], palette);
+        std::uint64_t bits = 0;
+        for (UINT i = 0; i < 6; ++i)
+            bits |= (std::uint64_t)block[2 + i] << (8 * i);
+        for (UINT i = 0; i < 16; ++i)
+            texels[4 * i + channel] = (BYTE)palette[(bits >> (3 * i)) & 7];
+    }
+
+    // ---- BC1: RGB 5:6:5 endpoints, four levels ----
+
+    const float Bc1Weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+    void Expand565(UINT c, int rgb[3])
+    {
+        const int r = (c >> 11) & 31;
+        const int g = (c >> 5) & 63;
+        const int b = c & 31;
+        rgb[0] = (r << 3) | (r >> 2);
+        rgb[1] = (g << 2) | (g >> 4);
+        rgb[2] = (b << 3) | (b >> 2);
+    }
+
+    UINT Quantize565(FXMVECTOR color)
+    {
+        XMFLOAT4 c;
+        XMStoreFloat4(&c, color);
+        const UINT r = (UINT)(c.x * 31.0f / 255.0f + 0.5f);
+        const UINT g = (UINT)(c.y * 63.0f / 255.0f + 0.5f);
+        const UINT b = (UINT)(c.z * 31.0f / 255.0f + 0.5f);
+        return (std::min(r, 31u) << 11) | (std::min(g, 63u) << 5) | std::min(b, 31u);
+    }
+
+    // Four-level palette; with equal endpoints every entry is the same color.
+    void Bc1Palette(UINT c0, UINT c1, int palette[4][3])
+    {
+        Expand565(c0, palette[0]);
+        Expand565(c1, palette[1]);
+        for (int k = 0; k < 3; ++k)
+        {
+            palette[2][k] = (2 * palette[0][k] + palette[1][k]) / 3;
+            palette[3][k] = (palette[0][k] + 2 * palette[1][k]) / 3;
+        }
+    }
+
+    void EncodeBc1(const BYTE texels8[64], BlockQuality quality, BYTE block[8])
+    {
+        XMVECTOR texels[16];
+        for (UINT i = 0; i < 16; ++i)
+            texels[i] = LoadTexel(texels8 + 4 * i, false);
+
+        XMVECTOR mean, axis;
+        FitLine(texels, 0xFFFF, mean, axis);
+        XMVECTOR endpoints[2];
+        LineEndpoints(texels, 0xFFFF, mean, axis, endpoints);
+
+        const int refines = quality == BlockQuality::Fast ? 0 : quality == BlockQuality::Normal ? 1 : 3;
+        UINT bestC0 = 0;
+        UINT bestC1 = 0;
+        BYTE bestIndices[16] = {};
+        float bestError = FLT_MAX;
+        for (int iteration = 0; ; ++iteration)
+        {
+            // The larger endpoint goes first to select the four-level mode.
+            UINT c0 = Quantize565(endpoints[1]);
+            UINT c1 = Quantize565(endpoints[0]);
+            if (c0 < c1)
+                std::swap(c0, c1);
+
+            int levels[4][3];
+            Bc1Palette(c0, c1, levels);
+            Palette palette;
+            palette.Count = c0 == c1 ? 1 : 4;
+            for (UINT k = 0; k < 4; ++k)
+                palette.Set(k, (float)levels[k][0], (float)levels[k][1], (float)levels[k][2], 0.0f);
+
+            BYTE indices[16];
+            const float error = ChooseIndices(texels, 0xFFFF, palette, indices);
+            if (error < bestError)
+            {
+                bestError = error;
+                bestC0 = c0;
+                bestC1 = c1;
+                memcpy(bestIndices, indices, 16);
+            }
+
+            if (iteration == refines || bestError == 0.0f || c0 == c1)
+                break;
+
+            // endpoints[1] is c0, the color index 0 selects.
+            XMVECTOR refit[2];
+            if (!RefitEndpoints(texels, 0xFFFF, indices, Bc1Weights, refit))
+                break;
+            endpoints[0] = refit[1];
+            endpoints[1] = refit[0];
+        }
+
+        block[0] = (BYTE)bestC0;
+        block[1] = (BYTE)(bestC0 >> 8);
+        block[2] = (BYTE)bestC1;
+        block[3] = (BYTE)(bestC1 >> 8);
+        UINT bits = 0;
+        for (UINT i = 0; i < 16; ++i)
+            bits |= (UINT)bestIndices[i] << (2 * i);
+        for (UINT i = 0; i < 4; ++i)
+            block[4 + i] = (BYTE)(bits >> (8 * i));
+    }
+
+    // fourLevels is set for the color half of BC3, which ignores the
+    // endpoint order.
+    void DecodeBc1(const BYTE block[8], bool fourLevels, BYTE texels[64])
+    {
+        const UINT c0 = block[0] | (block[1] << 8);
+        const UINT c1 = block[2] | (block[3] << 8);
+        int palette[4][4];
+        Expand565(c0, palette[0]);
+        Expand565(c1, palette[1]);
+        palette[0][3] = palette[1][3] = palette[2][3] = palette[3][3] = 255;
+        for (int k = 0; k < 3; ++k)
+        {
+            if (fourLevels || c0 > c1)
+            {
+                palette[2][k] = (2 * palette[0][k] + palette[1][k]) / 3;
+                palette[3][k] = (palette[0][k] + 2 * palette[1][k]) / 3;
+            }
+            else
+            {
+                palette[2][k] = (palette[0][k] + palette[1][k]) / 2;
+                palette[3][k] = 0;
+            }
+        }
+        if (!fourLevels && c0 <= c1)
+            palette[3][3] = 0;
+
+        const UINT bits = block[4] | (block[5] << 8) | (block[6] << 16) | ((UINT)block[7] << 24);
+        for (UINT i = 0; i < 16; ++i)
+        {
+            const int* c = palette[(bits >> (2 * i)) & 3];
+            for (int k = 0; k < 4; ++k)
+                texels[4 * i + k] = (BYTE)c[k];
+        }
+    }
+
+    // ---- BC7 modes 1 and 6 ----
+
+    struct Bc7Mode
+    {
+        UINT ColorBits;     // Per channel, without the p-bit.
+        bool Alpha;         // Alpha endpoints with ColorBits too; otherwise 255.
+        bool SharedPBit;    // One p-bit per subset instead of per endpoint.
+        UINT IndexBits;
+    };
+
+    const Bc7Mode Mode1 = { 6, false, true, 3 };
+    const Bc7Mode Mode6 = { 7, true, false, 4 };
+
+    struct SubsetFit
+    {
+        int Color[2][4] = {};
+        int PBit[2] = {};
+        BYTE Indices[16] = {};
+        float Error = FLT_MAX;
+    };
+
+    int ExpandEndpoint(int q, int pbit, UINT colorBits)
+    {
+        const int v = (q << 1) | pbit;
+        const UINT n = colorBits + 1;
+        return n >= 8 ? v : (v << (8 - n)) | (v >> (2 * n - 8));
+    }
+
+    int QuantizeEndpoint(float v, int pbit, UINT colorBits)
+    {
+        const float target = v * ((1 << (colorBits + 1)) - 1) / 255.0f;
+        return MathHelper::Clamp((int)floorf((target - pbit) * 0.5f + 0.5f), 0, (1 << colorBits) - 1);
+    }
+
+    float EndpointError(const float* v, int pbit, const Bc7Mode& mode)
+    {
+        float error = 0.0f;
+        for (UINT c = 0; c < (mode.Alpha ? 4u : 3u); ++c)
+        {
+            const float d = ExpandEndpoint(QuantizeEndpoint(v[c], pbit, mode.ColorBits), pbit, mode.ColorBits) - v[c];
+            error += d * d;
+        }
+        return error;
+    }
+
+    // Quantizes the endpoints with the given p-bits and picks indices.
+    void EvaluateSubset(const XMVECTOR texels[16], UINT mask, const Bc7Mode& mode, const XMVECTOR endpoints[2],
+        const int pbits[2], SubsetFit& fit)
+    {
+        int levels[2][4];
+        for (UINT e = 0; e < 2; ++e)
+        {
+            XMFLOAT4 v;
+            XMStoreFloat4(&v, endpoints[e]);
+            const float* channels = &v.x;
+            fit.PBit[e] = pbits[e];
+            for (UINT c = 0; c < 4; ++c)
+            {
+                if (c < 3 || mode.Alpha)
+                {
+                    fit.Color[e][c] = QuantizeEndpoint(channels[c], pbits[e], mode.ColorBits);
+                    levels[e][c] = ExpandEndpoint(fit.Color[e][c], pbits[e], mode.ColorBits);
+                }
+                else
+                {
+                    fit.Color[e][c] = 0;
+                    levels[e][c] = 255;
+                }
+            }
+        }
+
+        const int* weights = mode.IndexBits == 3 ? Weights3 : Weights4;
+        Palette palette;
+        palette.Count = 1u << mode.IndexBits;
+        for (UINT i = 0; i < palette.Count; ++i)
+        {
+            int c[4];
+            for (UINT k = 0; k < 4; ++k)
+                c[k] = ((64 - weights[i]) * levels[0][k] + weights[i] * levels[1][k] + 32) >> 6;
+            palette.Set(i, (float)c[0], (float)c[1], (float)c[2], (float)c[3]);
+        }
+        fit.Error = ChooseIndices(texels, mask, palette, fit.Indices);
+    }
+
+    void FitSubset(const XMVECTOR texels[16], UINT mask, const Bc7Mode& mode, int refines, SubsetFit& best)
+    {
+        XMVECTOR mean, axis;
+        FitLine(texels, mask, mean, axis);
+        XMVECTOR endpoints[2];
+        LineEndpoints(texels, mask, mean, axis, endpoints);
+
+        float weights[16];
+        const int* table = mode.IndexBits == 3 ? Weights3 : Weights4;
+        for (UINT i = 0; i < (1u << mode.IndexBits); ++i)
+            weights[i] = table[i] / 64.0f;
+
+        best = SubsetFit();
+        for (int iteration = 0; ; ++iteration)
+        {
+            SubsetFit fit;
+            if (mode.SharedPBit)
+            {
+                for (int p = 0; p < 2; ++p)
+                {
+                    const int pbits[2] = { p, p };
+                    SubsetFit candidate;
+                    EvaluateSubset(texels, mask, mode, endpoints, pbits, candidate);
+                    if (candidate.Error < fit.Error)
+                        fit = candidate;
+                }
+            }
+            else
+            {
+                int pbits[2];
+                for (UINT e = 0; e < 2; ++e)
+                {
+                    XMFLOAT4 v;
+                    XMStoreFloat4(&v, endpoints[e]);
+                    pbits[e] = EndpointError(&v.x, 1, mode) < EndpointError(&v.x, 0, mode) ? 1 : 0;
+                }
+                EvaluateSubset(texels, mask, mode, endpoints, pbits, fit);
+            }
+
+            if (fit.Error < best.Error)
+                best = fit;
+            if (iteration == refines || best.Error == 0.0f)
+                break;
+            if (!RefitEndpoints(texels, mask, fit.Indices, weights, endpoints))
+                break;
+        }
+    }
+
+    // The anchor texel's index is stored without its top bit, so that bit
+    // must be clear: swapping the endpoints mirrors the indices.
+    void FixAnchor(SubsetFit& fit, UINT mask, UINT anchor, UINT indexBits)
+    {
+        const UINT top = 1u << (indexBits - 1);
+        if ((fit.Indices[anchor] & top) == 0)
+            return;
+
+        for (UINT c = 0; c < 4; ++c)
+            std::swap(fit.Color[0][c], fit.Color[1][c]);
+        std::swap(fit.PBit[0], fit.PBit[1]);
+        const UINT maxIndex = (1u << indexBits) - 1;
+        for (UINT i = 0; i < 16; ++i)
+        {
+            if (mask & (1u << i))
+                fit.Indices[i] = (BYTE)(maxIndex - fit.Indices[i]);
+        }
+    }
+
+    void PackMode6(SubsetFit fit, BYTE block[16])
+    {
+        FixAnchor(fit, 0xFFFF, 0, 4);
+
+        memset(block, 0, 16);
+        BitWriter out(block);
+        out.Write(1u << 6, 7);
+        for (UINT c = 0; c < 4; ++c)
+        {
+            out.Write(fit.Color[0][c], 7);
+            out.Write(fit.Color[1][c], 7);
+        }
+        out.Write(fit.PBit[0], 1);
+        out.Write(fit.PBit[1], 1);
+        for (UINT i = 0; i < 16; ++i)
+            out.Write(fit.Indices[i], i == 0 ? 3 : 4);
+    }
+
+    void PackMode1(UINT partition, SubsetFit fits[2], BYTE block[16])
+    {
+        const UINT mask1 = Partitions2[partition];
+        const UINT mask0 = ~mask1 & 0xFFFF;
+        const UINT anchor1 = Anchors2[partition];
+        FixAnchor(fits[0], mask0, 0, 3);
+        FixAnchor(fits[1], mask1, anchor1, 3);
+
+        memset(block, 0, 16);
+        BitWriter out(block);
+        out.Write(1u << 1, 2);
+        out.Write(partition, 6);
+        for (UINT c = 0; c < 3; ++c)
+        {
+            for (UINT s = 0; s < 2; ++s)
+            {
+                out.Write(fits[s].Color[0][c], 6);
+                out.Write(fits[s].Color[1][c], 6);
+            }
+        }
+        out.Write(fits[0].PBit[0], 1);
+        out.Write(fits[1].PBit[0], 1);
+        for (UINT i = 0; i < 16; ++i)
+        {
+            const BYTE index = (mask1 & (1u << i)) ? fits[1].Indices[i] : fits[0].Indices[i];
+            out.Write(index, i == 0 || i == anchor1 ? 2 : 3);
+        }
+    }
+
+    void EncodeBc7(const BYTE texels8[64], BlockQuality quality, BYTE block[16])
+    {
+        XMVECTOR texels[16];
+        bool opaque = true;
+        for (UINT i = 0; i < 16; ++i)
+        {
+            texels[i] = LoadTexel(texels8 + 4 * i, true);
+            opaque = opaque && texels8[4 * i + 3] == 255;
+        }
+
+        const int refines = quality == BlockQuality::Fast ? 0 : quality == BlockQuality::Normal ? 1 : 2;
+        SubsetFit single;
+        FitSubset(texels, 0xFFFF, Mode6, refines, single);
+
+        // Two subsets help blocks that straddle an edge.  Partitions are
+        // ranked by how far their subsets are from a line and only the best
+        // few are encoded in full.
+        const UINT candidates = quality == BlockQuality::Fast ? 0 : quality == BlockQuality::Normal ? 1 : 6;
+        if (candidates == 0 || !opaque || single.Error == 0.0f)
+        {
+            PackMode6(single, block);
+            return;
+        }
+
+        std::pair<float, UINT> ranked[64];
+        for (UINT p = 0; p < 64; ++p)
+        {
+            XMVECTOR mean, axis;
+            const float error = FitLine(texels, ~(UINT)Partitions2[p] & 0xFFFF, mean, axis) + FitLine(texels, Partitions2[p], mean, axis);
+            ranked[p] = std::make_pair(error, p);
+        }
+        std::partial_sort(ranked, ranked + candidates, ranked + 64);
+
+        float bestError = single.Error;
+        UINT bestPartition = 64;
+        SubsetFit bestFits[2];
+        for (UINT k = 0; k < candidates; ++k)
+        {
+            const UINT p = ranked[k].second;
+            SubsetFit fits[2];
+            FitSubset(texels, ~(UINT)Partitions2[p] & 0xFFFF, Mode1, refines, fits[0]);
+            FitSubset(texels, Partitions2[p], Mode1, refines, fits[1]);
+            if (fits[0].Error + fits[1].Error < bestError)
+            {
+                bestError = fits[0].Error + fits[1].Error;
+                bestPartition = p;
+                bestFits[0] = fits[0];
+                bestFits[1] = fits[1];
+            }
+        }
+
+        if (bestPartition < 64)
+            PackMode1(bestPartition, bestFits, block);
+        else
+            PackMode6(single, block);
+    }
+
+    void DecodeBc7(const BYTE block[16], BYTE texels[64])
+    {
+        BitReader in(block);
+        UINT mode = 0;
+        while (mode < 8 && in.Read(1) == 0)
+            mode++;
+
+        if (mode == 6)
+        {
+            int q[2][4];
+            for (UINT c = 0; c < 4; ++c)
+            {
+                q[0][c] = in.Read(7);
+                q[1][c] = in.Read(7);
+            }
+            const int p0 = in.Read(1);
+            const int p1 = in.Read(1);
+            for (UINT i = 0; i < 16; ++i)
+            {
+                const int w = Weights4[in.Read(i == 0 ? 3 : 4)];
+                for (UINT c = 0; c < 4; ++c)
+                {
+                    const int e0 = ExpandEndpoint(q[0][c], p0, 7);
+                    const int e1 = ExpandEndpoint(q[1][c], p1, 7);
+                    texels[4 * i + c] = (BYTE)(((64 - w) * e0 + w * e1 + 32) >> 6);
+                }
+            }
+        }
+        else if (mode == 1)
+        {
+            const UINT partition = in.Read(6);
+            int q[2][2][3];
+            for (UINT c = 0; c < 3; ++c)
+            {
+                for (UINT s = 0; s < 2; ++s)
+                {
+                    q[s][0][c] = in.Read(6);
+                    q[s][1][c] = in.Read(6);
+                }
+            }
+            const int pbits[2] = { (int)in.Read(1), (int)in.Read(1) };
+            const UINT mask1 = Partitions2[partition];
+            for (UINT i = 0; i < 16; ++i)
+            {
+                const UINT s = (mask1 >> i) & 1;
+                const int w = Weights3[in.Read(i == 0 || i == Anchors2[partition] ? 2 : 3)];
+                for (UINT c = 0; c < 3; ++c)
+                {
+                    const int e0 = ExpandEndpoint(q[s][0][c], pbits[s], 6);
+                    const int e1 = ExpandEndpoint(q[s][1][c], pbits[s], 6);
+                    texels[4 * i + c] = (BYTE)(((64 - w) * e0 + w * e1 + 32) >> 6);
+                }
+                texels[4 * i + 3] = 255;
+            }
+        }
+        else
+        {
+            // Not written by EncodeBc7.
+            memset(texels, 0, 64);
+        }
+    }
+}
+
+bool BlockEncoder::Supports(DXGI_FORMAT format)
+{
+    return Classify(format) != FormatUnsupported;
+}
+
+UINT BlockEncoder::BlockBytes(DXGI_FORMAT format)
+{
+    const BlockFormat f = Classify(format);
+    return f == FormatBC1 || f == FormatBC4 ? 8 : 16;
+}
+
+void BlockEncoder::EncodeBlock(DXGI_FORMAT format, const BYTE texels[64], BlockQuality quality, BYTE* block)
+{
+    switch (Classify(format))
+    {
+    case FormatBC1:
+        EncodeBc1(texels, quality, block);
+        break;
+    case FormatBC3:
+        EncodeBc4(texels, 3, quality, block);
+        EncodeBc1(texels, quality, block + 8);
+        break;
+    case FormatBC4:
+        EncodeBc4(texels, 0, quality, block);
+        break;
+    case FormatBC5:
+        EncodeBc4(texels, 0, quality, block);
+        EncodeBc4(texels, 1, quality, block + 8);
+        break;
+    case FormatBC7:
+        EncodeBc7(texels, quality, block);
+        break;
+    default:
+        assert(false && "unsupported block format");
+    }
+}
+
+void BlockEncoder::DecodeBlock(DXGI_FORMAT format, const BYTE* block, BYTE texels[64])
+{
+    switch (Classify(format))
+    {
+    case FormatBC1:
+        DecodeBc1(block, false, texels);
+        break;
+    case FormatBC3:
+        DecodeBc1(block + 8, true, texels);
+        DecodeBc4(block, 3, texels);
+        break;
+    case FormatBC4:
+    case FormatBC5:
+        for (UINT i = 0; i < 16; ++i)
+        {
+            texels[4 * i + 0] = texels[4 * i + 1] = texels[4 * i + 2] = 0;
+            texels[4 * i + 3] = 255;
+        }
+        DecodeBc4(block, 0, texels);
+        if (Classify(format) == FormatBC5)
+            DecodeBc4(block + 8, 1, texels);
+        break;
+    case FormatBC7:
+        DecodeBc7(block, texels);
+        break;
+    default:
+        assert(false && "unsupported block format");
+    }
+}
+
+void BlockEncoder::Encode(DXGI_FORMAT format, const BYTE* rgba, UINT width, UINT height, size_t rowPitch,
+    BlockQuality quality, JobSystem* jobs, BYTE* blocks, size_t blockRowPitch)
+{
+    const UINT blocksX = (width + 3) / 4;
+    const UINT blocksY = (height + 3) / 4;
+    const UINT blockBytes = BlockBytes(format);
+
+    auto encodeRows = [&](UINT first, UINT last)
+    {
+        BYTE texels[64];
+        for (UINT by = first; by < last; ++by)
+        {
+            for (UINT bx = 0; bx < blocksX; ++bx)
+            {
+                for (UINT y = 0; y < 4; ++y)
+                {
+                    const BYTE* row = rgba + std::min(by * 4 + y, height - 1) * rowPitch;
+                    for (UINT x = 0; x < 4; ++x)
+                        memcpy(texels + 4 * (4 * y + x), row + 4 * std::min(bx * 4 + x, width - 1), 4);
+                }
+                EncodeBlock(format, texels, quality, blocks + by * blockRowPitch + bx * blockBytes);
+            }
+        }
+    };
+
+    if (jobs != nullptr && blocksY > BlockRowGrain)
+        jobs->ParallelFor(blocksY, BlockRowGrain, encodeRows);
+    else
+        encodeRows(0, blocksY);
+}
+
+void BlockEncoder::Decode(DXGI_FORMAT format, const BYTE* blocks, size_t blockRowPitch, UINT width, UINT height,
+    BYTE* rgba, size_t rowPitch)
+{
+    const UINT blockBytes = BlockBytes(format);
+    BYTE texels[64];
+    for (UINT by = 0; by < (height + 3) / 4; ++by)
+    {
+        for (UINT bx = 0; bx < (width + 3) / 4; ++bx)
+        {
+            DecodeBlock(format, blocks + by * blockRowPitch + bx * blockBytes, texels);
+            for (UINT y = 0; y < 4 && by * 4 + y < height; ++y)
+            {
+                for (UINT x = 0; x < 4 && bx * 4 + x < width; ++x)
+                    memcpy(rgba + (by * 4 + y) * rowPitch + 4 * (bx * 4 + x), texels + 4 * (4 * y + x), 4);
+            }
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "d3dUtil.h"
+
+class JobSystem;
+
+// Effort spent per block.  Each tier costs roughly 2-4x the one below.
+enum class BlockQuality
+{
+    Fast,       // Principal axis endpoints only; BC7 mode 6.
+    Normal,     // One least-squares refinement; BC7 mode 6 or mode 1.
+    High,       // Several refinements and endpoint searches; more BC7 partitions.
+};
+
+// Block compression of RGBA8 images.
+//   - BC1 color, BC3 (BC1 + BC4 alpha), BC4 one channel, BC5 two channels and
+//     BC7 using modes 6 (one subset, RGBA) and 1 (two subsets, RGB, for
+//     opaque blocks), UNORM or UNORM_SRGB.  sRGB formats take texels already
+//     in sRGB; no conversion happens here.
+//   - Endpoints come from the principal axis of each block (DirectXMath),
+//     indices from a nearest-palette search, SSE2 for the single channel
+//     blocks.  Higher tiers refit the endpoints to the chosen indices by
+//     least squares.
+//   - Encode splits the image into rows of blocks across the job system.
+// Decode reads everything Encode writes, for measuring the error.
+class BlockEncoder
+{
+public:
+    static bool Supports(DXGI_FORMAT format);
+
+    // 8 for BC1 and BC4, 16 otherwise.
+    static UINT BlockBytes(DXGI_FORMAT format);
+
+    // texels are 16 RGBA8 values in row order.
+    static void EncodeBlock(DXGI_FORMAT format, const BYTE texels[64], BlockQuality quality, BYTE* block);
+    static void DecodeBlock(DXGI_FORMAT format, const BYTE* block, BYTE texels[64]);
+
+    // rgba rows are rowPitch bytes apart.  Blocks past the right or bottom
+    // edge repeat the last column or row.
+    static void Encode(DXGI_FORMAT format, const BYTE* rgba, UINT width, UINT height, size_t rowPitch,
+        BlockQuality quality, JobSystem* jobs, BYTE* blocks, size_t blockRowPitch);
+    static void Decode(DXGI_FORMAT format, const BYTE* blocks, size_t blockRowPitch, UINT width, UINT height,
+        BYTE* rgba, size_t rowPitch);
+};
@@ -176,6 +176,34 @@ XMFLOAT4X4 Camera::GetProj4x4f()const
 	return mProj;
 }
 
+void Camera::GetFrustumPlanes(XMFLOAT4 planes[6])const
+{
+	assert(!mViewDirty);
+
+	// Gribb/Hartmann: with row vectors, clip = p*M, so each plane is a sum or
+	// difference of columns of M.  Direct3D clips z to [0, w].
+	XMFLOAT4X4 M;
+	XMStoreFloat4x4(&M, XMMatrixMultiply(GetView(), GetProj()));
+
+	XMVECTOR c0 = XMVectorSet(M(0, 0), M(1, 0), M(2, 0), M(3, 0));
+	XMVECTOR c1 = XMVectorSet(M(0, 1), M(1, 1), M(2, 1), M(3, 1));
+	XMVECTOR c2 = XMVectorSet(M(0, 2), M(1, 2), M(2, 2), M(3, 2));
+	XMVECTOR c3 = XMVectorSet(M(0, 3), M(1, 3), M(2, 3), M(3, 3));
+
+	XMVECTOR p[6] =
+	{
+		c3 + c0,	// left
+		c3 - c0,	// right
+		c3 + c1,	// bottom
+		c3 - c1,	// top
+		c2,			// near
+		c3 - c2		// far
+	};
+
+	for(int i = 0; i < 6; ++i)
+		XMStoreFloat4(&planes[i], XMPlaneNormalize(p[i]));
+}
+
 void Camera::Strafe(float d)
 {
 	// mPosition += d*mRight
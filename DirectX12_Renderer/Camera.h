@@ -61,6 +61,10 @@ public:
 	DirectX::XMFLOAT4X4 GetView4x4f()const;
 	DirectX::XMFLOAT4X4 GetProj4x4f()const;
 
+	// Get the world space frustum planes (left, right, bottom, top, near, far),
+	// normalized and facing inward.  Requires an up to date view matrix.
+	void GetFrustumPlanes(DirectX::XMFLOAT4 planes[6])const;
+
 	// Strafe/Walk the camera a distance d.
 	void Strafe(float d);
 	void Walk(float d);
@@ -0,0 +1,191 @@
+#include "CommandBackend.h"
+
+void NullCommandBackend::RequireRootParameters(ID3D12PipelineState* pso, UINT mask)
+{
+    mRequiredRootParameters[pso] = mask;
+}
+
+void NullCommandBackend::Reset()
+{
+    mCommandCount = 0;
+    for (UINT i = 0; i < CommandTypeCount; ++i)
+        mCounts[i] = 0;
+    mHash = 14695981039346656037ull;
+
+    mErrorCount = 0;
+    mFirstError.clear();
+    mResourceStates.clear();
+
+    BeginList();
+}
+
+void NullCommandBackend::BeginList()
+{
+    mHasRootSignature = false;
+    mHasHeap = false;
+    mHasViewport = false;
+    mHasRenderTarget = false;
+    mHasVertexBuffer = false;
+    mHasIndexBuffer = false;
+    mPSO = nullptr;
+    mTopology = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
+    mBoundRootParameters = 0;
+}
+
+void NullCommandBackend::Mix(CommandType type, std::uint64_t op, std::uint64_t value)
+{
+    mCommandCount++;
+    mCounts[type]++;
+    mHash = (mHash ^ op) * 1099511628211ull;
+    mHash = (mHash ^ value) * 1099511628211ull;
+}
+
+void NullCommandBackend::Error(const char* message)
+{
+    if (mErrorCount++ == 0)
+        mFirstError = "command " + std::to_string(mCommandCount) + ": " + message;
+}
+
+void NullCommandBackend::SetRootSignature(ID3D12RootSignature* rootSignature)
+{
+    Mix(SetupCommand, 1, (std::uint64_t)rootSignature);
+    if (rootSignature == nullptr)
+        Error("null root signature");
+
+    // Changing the root signature invalidates every root argument.
+    mHasRootSignature = rootSignature != nullptr;
+    mBoundRootParameters = 0;
+}
+
+void NullCommandBackend::SetDescriptorHeap(ID3D12DescriptorHeap* heap)
+{
+    Mix(SetupCommand, 2, (std::uint64_t)heap);
+    if (heap == nullptr)
+        Error("null descriptor heap");
+    mHasHeap = heap != nullptr;
+}
+
+void NullCommandBackend::SetViewport(const D3D12_VIEWPORT& viewport, const D3D12_RECT& scissorRect)
+{
+    Mix(SetupCommand, 3, ((std::uint64_t)scissorRect.right << 32) | (UINT)scissorRect.bottom);
+    if (viewport.Width <= 0.0f || viewport.Height <= 0.0f || scissorRect.right <= scissorRect.left || scissorRect.bottom <= scissorRect.top)
+        Error("empty viewport or scissor rect");
+    mHasViewport = true;
+}
+
+void NullCommandBackend::SetRenderTarget(D3D12_CPU_DESCRIPTOR_HANDLE rtv, D3D12_CPU_DESCRIPTOR_HANDLE dsv)
+{
+    Mix(SetupCommand, 4, rtv.ptr ^ (dsv.ptr << 1));
+    if (rtv.ptr == 0)
+        Error("null render target view");
+    mHasRenderTarget = rtv.ptr != 0;
+}
+
+void NullCommandBackend::ClearRenderTarget(D3D12_CPU_DESCRIPTOR_HANDLE rtv, const FLOAT color[4])
+{
+    Mix(ClearCommand, 5, rtv.ptr);
+    if (rtv.ptr == 0)
+        Error("clear of null render target view");
+}
+
+void NullCommandBackend::ClearDepthStencil(D3D12_CPU_DESCRIPTOR_HANDLE dsv, FLOAT depth, UINT8 stencil)
+{
+    Mix(ClearCommand, 6, dsv.ptr);
+    if (dsv.ptr == 0)
+        Error("clear of null depth stencil view");
+    if (depth < 0.0f || depth > 1.0f)
+        Error("depth clear value outside [0, 1]");
+}
+
+void NullCommandBackend::Transition(ID3D12Resource* resource, D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after)
+{
+    Mix(BarrierCommand, 7, (std::uint64_t)resource ^ ((std::uint64_t)after << 32));
+    if (before == after)
+        Error("transition to the same state");
+
+    // A resource seen for the first time adopts the state the barrier claims.
+    auto it = mResourceStates.find(resource);
+    if (it != mResourceStates.end() && it->second != before)
+        Error("transition does not start from the resource's current state");
+    mResourceStates[resource] = after;
+}
+
+void NullCommandBackend::SetPipelineState(ID3D12PipelineState* pso)
+{
+    Mix(PipelineCommand, 8, (std::uint64_t)pso);
+    if (pso == nullptr)
+        Error("null pipeline state");
+    mPSO = pso;
+}
+
+void NullCommandBackend::SetVertexBuffer(const D3D12_VERTEX_BUFFER_VIEW& vbv)
+{
+    Mix(InputAssemblerCommand, 9, vbv.BufferLocation);
+    mHasVertexBuffer = true;
+}
+
+void NullCommandBackend::SetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW& ibv)
+{
+    Mix(InputAssemblerCommand, 10, ibv.BufferLocation ^ ibv.Format);
+    if (ibv.Format != DXGI_FORMAT_R16_UINT && ibv.Format != DXGI_FORMAT_R32_UINT)
+        Error("index buffer format is not R16_UINT or R32_UINT");
+    mHasIndexBuffer = true;
+}
+
+void NullCommandBackend::SetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology)
+{
+    Mix(InputAssemblerCommand, 11, topology);
+    mTopology = topology;
+}
+
+void NullCommandBackend::SetRootParameter(UINT rootIndex)
+{
+    if (!mHasRootSignature)
+        Error("root argument set before the root signature");
+    if (rootIndex >= MaxRootParameters)
+        Error("root parameter index out of range");
+    else
+        mBoundRootParameters |= 1u << rootIndex;
+}
+
+void NullCommandBackend::SetDescriptorTable(UINT rootIndex, D3D12_GPU_DESCRIPTOR_HANDLE handle)
+{
+    Mix(RootParameterCommand, 12 + rootIndex, handle.ptr);
+    if (!mHasHeap)
+        Error("descriptor table set before a descriptor heap");
+    SetRootParameter(rootIndex);
+}
+
+void NullCommandBackend::SetConstantBufferView(UINT rootIndex, D3D12_GPU_VIRTUAL_ADDRESS address)
+{
+    Mix(RootParameterCommand, 12 + rootIndex, address);
+    if (address % D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT != 0)
+        Error("constant buffer view is not 256-byte aligned");
+    SetRootParameter(rootIndex);
+}
+
+void NullCommandBackend::SetShaderResourceView(UINT rootIndex, D3D12_GPU_VIRTUAL_ADDRESS address)
+{
+    Mix(RootParameterCommand, 12 + rootIndex, address);
+    SetRootParameter(rootIndex);
+}
+
+void NullCommandBackend::DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance)
+{
+    Mix(DrawCommand, 64, ((std::uint64_t)indexCount << 32) | instanceCount);
+    mHash = (mHash ^ (((std::uint64_t)startIndex << 32) | (UINT)baseVertex)) * 1099511628211ull;
+    mHash = (mHash ^ startInstance) * 1099511628211ull;
+
+    if (!mHasRootSignature || !mHasViewport || !mHasRenderTarget)
+        Error("draw before root signature, viewport and render target are set");
+    if (mPSO == nullptr)
+        Error("draw without a pipeline state");
+    if (!mHasVertexBuffer || !mHasIndexBuffer || mTopology == D3D_PRIMITIVE_TOPOLOGY_UNDEFINED)
+        Error("draw without vertex buffer, index buffer or topology");
+    if (indexCount == 0 || instanceCount == 0)
+        Error("empty draw");
+
+    auto it = mRequiredRootParameters.find(mPSO);
+    if (it != mRequiredRootParameters.end() && (it->second & ~mBoundRootParameters) != 0)
+        Error("draw with unbound root parameters");
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include "d3dUtil.h"
+
+// The subset of ID3D12GraphicsCommandList a frame is recorded with, behind an
+// interface so the same recording code can target a real command list, a
+// RenderCommandStream, or a GPU-less backend (headless benchmarks, validation).
+class CommandBackend
+{
+public:
+    virtual ~CommandBackend() = default;
+
+    // Frame setup.
+    virtual void SetRootSignature(ID3D12RootSignature* rootSignature) = 0;
+    virtual void SetDescriptorHeap(ID3D12DescriptorHeap* heap) = 0;
+    virtual void SetViewport(const D3D12_VIEWPORT& viewport, const D3D12_RECT& scissorRect) = 0;
+    virtual void SetRenderTarget(D3D12_CPU_DESCRIPTOR_HANDLE rtv, D3D12_CPU_DESCRIPTOR_HANDLE dsv) = 0;
+    virtual void ClearRenderTarget(D3D12_CPU_DESCRIPTOR_HANDLE rtv, const FLOAT color[4]) = 0;
+    virtual void ClearDepthStencil(D3D12_CPU_DESCRIPTOR_HANDLE dsv, FLOAT depth, UINT8 stencil) = 0;
+    virtual void Transition(ID3D12Resource* resource, D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after) = 0;
+
+    // Draw state.
+    virtual void SetPipelineState(ID3D12PipelineState* pso) = 0;
+    virtual void SetVertexBuffer(const D3D12_VERTEX_BUFFER_VIEW& vbv) = 0;
+    virtual void SetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW& ibv) = 0;
+    virtual void SetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology) = 0;
+    virtual void SetDescriptorTable(UINT rootIndex, D3D12_GPU_DESCRIPTOR_HANDLE handle) = 0;
+    virtual void SetConstantBufferView(UINT rootIndex, D3D12_GPU_VIRTUAL_ADDRESS address) = 0;
+    virtual void SetShaderResourceView(UINT rootIndex, D3D12_GPU_VIRTUAL_ADDRESS address) = 0;
+    virtual void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance) = 0;
+};
+
+// Forwards straight to a graphics command list.
+class D3D12CommandBackend : public CommandBackend
+{
+public:
+    void SetCommandList(ID3D12GraphicsCommandList* cmdList) { mCmdList = cmdList; }
+
+    void SetRootSignature(ID3D12RootSignature* rootSignature)override { mCmdList->SetGraphicsRootSignature(rootSignature); }
+    void SetDescriptorHeap(ID3D12DescriptorHeap* heap)override { mCmdList->SetDescriptorHeaps(1, &heap); }
+    void SetViewport(const D3D12_VIEWPORT& viewport, const D3D12_RECT& scissorRect)override
+    {
+        mCmdList->RSSetViewports(1, &viewport);
+        mCmdList->RSSetScissorRects(1, &scissorRect);
+    }
+    void SetRenderTarget(D3D12_CPU_DESCRIPTOR_HANDLE rtv, D3D12_CPU_DESCRIPTOR_HANDLE dsv)override { mCmdList->OMSetRenderTargets(1, &rtv, true, &dsv); }
+    void ClearRenderTarget(D3D12_CPU_DESCRIPTOR_HANDLE rtv, const FLOAT color[4])override { mCmdList->ClearRenderTargetView(rtv, color, 0, nullptr); }
+    void ClearDepthStencil(D3D12_CPU_DESCRIPTOR_HANDLE dsv, FLOAT depth, UINT8 stencil)override
+    {
+        mCmdList->ClearDepthStencilView(dsv, D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, depth, stencil, 0, nullptr);
+    }
+    void Transition(ID3D12Resource* resource, D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after)override
+    {
+        CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(resource, before, after);
+        mCmdList->ResourceBarrier(1, &barrier);
+    }
+
+    void SetPipelineState(ID3D12PipelineState* pso)override { mCmdList->SetPipelineState(pso); }
+    void SetVertexBuffer(const D3D12_VERTEX_BUFFER_VIEW& vbv)override { mCmdList->IASetVertexBuffers(0, 1, &vbv); }
+    void SetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW& ibv)override { mCmdList->IASetIndexBuffer(&ibv); }
+    void SetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology)override { mCmdList->IASetPrimitiveTopology(topology); }
+    void SetDescriptorTable(UINT rootIndex, D3D12_GPU_DESCRIPTOR_HANDLE handle)override { mCmdList->SetGraphicsRootDescriptorTable(rootIndex, handle); }
+    void SetConstantBufferView(UINT rootIndex, D3D12_GPU_VIRTUAL_ADDRESS address)override { mCmdList->SetGraphicsRootConstantBufferView(rootIndex, address); }
+    void SetShaderResourceView(UINT rootIndex, D3D12_GPU_VIRTUAL_ADDRESS address)override { mCmdList->SetGraphicsRootShaderResourceView(rootIndex, address); }
+    void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance)override
+    {
+        mCmdList->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+    }
+
+private:
+    ID3D12GraphicsCommandList* mCmdList = nullptr;
+};
+
+// Null device: records nothing, but checks every command against the state
+// the debug layer would expect and counts commands by type.  Arguments are
+// folded into a hash so the work cannot be optimized away and two recordings
+// can be compared.
+//
+// Checked: draws need a root signature, viewport, render target, PSO, vertex
+// and index buffers, a topology and every root parameter the PSO requires;
+// root parameters must be set after the root signature and descriptor tables
+// after a heap; transitions must start from the state the resource was left in.
+class NullCommandBackend : public CommandBackend
+{
+public:
+    enum CommandType
+    {
+        SetupCommand,
+        ClearCommand,
+        BarrierCommand,
+        PipelineCommand,
+        InputAssemblerCommand,
+        RootParameterCommand,
+        DrawCommand,
+        CommandTypeCount
+    };
+
+    // Root parameters (one bit per index) that must be bound for draws with pso.
+    void RequireRootParameters(ID3D12PipelineState* pso, UINT mask);
+
+    // Forgets everything: counters, errors, bindings and resource states.
+    void Reset();
+
+    // Starts a new command list.  Bindings reset, resource states carry over.
+    void BeginList();
+
+    UINT CommandCount()const { return mCommandCount; }
+    UINT Count(CommandType type)const { return mCounts[type]; }
+    UINT ErrorCount()const { return mErrorCount; }
+    const std::string& FirstError()const { return mFirstError; }
+    std::uint64_t Hash()const { return mHash; }
+
+    void SetRootSignature(ID3D12RootSignature* rootSignature)override;
+    void SetDescriptorHeap(ID3D12DescriptorHeap* heap)override;
+    void SetViewport(const D3D12_VIEWPORT& viewport, const D3D12_RECT& scissorRect)override;
+    void SetRenderTarget(D3D12_CPU_DESCRIPTOR_HANDLE rtv, D3D12_CPU_DESCRIPTOR_HANDLE dsv)override;
+    void ClearRenderTarget(D3D12_CPU_DESCRIPTOR_HANDLE rtv, const FLOAT color[4])override;
+    void ClearDepthStencil(D3D12_CPU_DESCRIPTOR_HANDLE dsv, FLOAT depth, UINT8 stencil)override;
+    void Transition(ID3D12Resource* resource, D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after)override;
+
+    void SetPipelineState(ID3D12PipelineState* pso)override;
+    void SetVertexBuffer(const D3D12_VERTEX_BUFFER_VIEW& vbv)override;
+    void SetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW& ibv)override;
+    void SetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology)override;
+    void SetDescriptorTable(UINT rootIndex, D3D12_GPU_DESCRIPTOR_HANDLE handle)override;
+    void SetConstantBufferView(UINT rootIndex, D3D12_GPU_VIRTUAL_ADDRESS address)override;
+    void SetShaderResourceView(UINT rootIndex, D3D12_GPU_VIRTUAL_ADDRESS address)override;
+    void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance)override;
+
+private:
+    static const UINT MaxRootParameters = 32;
+
+    void Mix(CommandType type, std::uint64_t op, std::uint64_t value);
+    void SetRootParameter(UINT rootIndex);
+    void Error(const char* message);
+
+private:
+    UINT mCommandCount = 0;
+    UINT mCounts[CommandTypeCount] = {};
+    std::uint64_t mHash = 14695981039346656037ull;
+
+    UINT mErrorCount = 0;
+    std::string mFirstError;
+
+    std::unordered_map<ID3D12PipelineState*, UINT> mRequiredRootParameters;
+    std::unordered_map<ID3D12Resource*, D3D12_RESOURCE_STATES> mResourceStates;
+
+    // Per command list.
+    bool mHasRootSignature = false;
+    bool mHasHeap = false;
+    bool mHasViewport = false;
+    bool mHasRenderTarget = false;
+    bool mHasVertexBuffer = false;
+    bool mHasIndexBuffer = false;
+    ID3D12PipelineState* mPSO = nullptr;
+    D3D12_PRIMITIVE_TOPOLOGY mTopology = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
+    UINT mBoundRootParameters = 0;
+};
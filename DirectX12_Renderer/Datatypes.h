@@ -12,8 +12,6 @@ struct RenderItem
 
     XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
 
-    int NumFramesDirty = gNumFrameResources;
-
     UINT ObjCBIndex = -1;
 
     Material* Mat = nullptr;
@@ -24,6 +22,20 @@ struct RenderItem
     UINT IndexCount = 0;
     UINT StartIndexLocation = 0;
     int BaseVertexLocation = 0;
+
+    DXGI_FORMAT IndexFormat = DXGI_FORMAT_R16_UINT;
+    UINT IndexByteOffset = 0;
+
+    // Index of the submesh in Geo->Submeshes, which tells draws of one
+    // geometry apart in the draw sort key.
+    UINT Submesh = 0;
+
+    // Local-space bounds of the submesh.  Set BoundsDirty whenever World
+    // changes so the scene BVH refits; items attached to a TransformSystem
+    // node get both from it.  Object constants need no dirty flag:
+    // they are written to the upload ring every frame the item is drawn.
+    BoundingBox Bounds;
+    bool BoundsDirty = true;
 };
 
 struct FbxMeshData {
@@ -32,20 +44,66 @@ struct FbxMeshData {
     UINT IndexSize = 0;
 };
 
+// Transforms are affine, so only the first three columns of a row-vector
+// matrix are stored, each as a float4 row (the matrix transposed and cut to
+// 3x4).  The shaders rebuild a position with three dot products.
+struct AffineTransform
+{
+    DirectX::XMFLOAT4 Rows[3] = { { 1.0f, 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f, 0.0f } };
+};
+
+// Texture transforms only ever produce u and v: the first two columns.
+struct TexTransform2D
+{
+    DirectX::XMFLOAT4 Rows[2] = { { 1.0f, 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f, 0.0f } };
+};
+
+inline void StoreAffineTransform(AffineTransform* dst, DirectX::FXMMATRIX m)
+{
+    DirectX::XMMATRIX t = DirectX::XMMatrixTranspose(m);
+    DirectX::XMStoreFloat4(&dst->Rows[0], t.r[0]);
+    DirectX::XMStoreFloat4(&dst->Rows[1], t.r[1]);
+    DirectX::XMStoreFloat4(&dst->Rows[2], t.r[2]);
+}
+
+inline void StoreTexTransform2D(TexTransform2D* dst, DirectX::FXMMATRIX m)
+{
+    DirectX::XMMATRIX t = DirectX::XMMatrixTranspose(m);
+    DirectX::XMStoreFloat4(&dst->Rows[0], t.r[0]);
+    DirectX::XMStoreFloat4(&dst->Rows[1], t.r[1]);
+}
+
+inline bool IsIdentity(const DirectX::XMFLOAT4X4& m)
+{
+    static const DirectX::XMFLOAT4X4 identity = MathHelper::Identity4x4();
+    return memcmp(&m, &identity, sizeof(m)) == 0;
+}
+
+// Root CBV (b0) for items drawn on their own.  The texture transform stays
+// in even when it is the identity: the 256-byte CBV placement pads the
+// 80 bytes anyway.
 struct ObjectConstants
 {
-    DirectX::XMFLOAT4X4 World = MathHelper::Identity4x4();
-    DirectX::XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
+    AffineTransform World;
+    TexTransform2D TexTransform;
 };
 
+// Instanced draws read a raw buffer (t0, space1) bound at the packet's data:
+// an InstanceHeader, then InstanceCount worlds, each followed by its texture
+// transform only if the header has InstanceHasTexTransform set, i.e. if any
+// instance of the batch has a non-identity one.
+const UINT InstanceHasTexTransform = 0x1;
+
+struct InstanceHeader
+{
+    UINT Flags = 0;
+    UINT Pad[3] = { 0, 0, 0 };
+};
+
+// Everything the shaders read that changes every frame.
 struct PassConstants
 {
-    DirectX::XMFLOAT4X4 View = MathHelper::Identity4x4();
-    DirectX::XMFLOAT4X4 InvView = MathHelper::Identity4x4();
-    DirectX::XMFLOAT4X4 Proj = MathHelper::Identity4x4();
-    DirectX::XMFLOAT4X4 InvProj = MathHelper::Identity4x4();
     DirectX::XMFLOAT4X4 ViewProj = MathHelper::Identity4x4();
-    DirectX::XMFLOAT4X4 InvViewProj = MathHelper::Identity4x4();
     DirectX::XMFLOAT3 EyePosW = { 0.0f, 0.0f, 0.0f };
     float cbPerObjectPad1 = 0.0f;
     DirectX::XMFLOAT2 RenderTargetSize = { 0.0f, 0.0f };
@@ -55,6 +113,16 @@ struct PassConstants
     float TotalTime = 0.0f;
     float DeltaTime = 0.0f;
 
+    // Clustered lighting depth slices: slice = log2(viewZ)*scale + bias.
+    float ClusterSliceScale = 0.0f;
+    float ClusterSliceBias = 0.0f;
+    DirectX::XMFLOAT2 cbPassPad2 = { 0.0f, 0.0f };
+};
+
+// Lighting changes far less often than the camera, so it has its own buffer
+// (b3), kept per frame resource and only rewritten while dirty.
+struct LightConstants
+{
     DirectX::XMFLOAT4 AmbientLight = { 0.0f, 0.0f, 0.0f, 1.0f };
 
     // Indices [0, NUM_DIR_LIGHTS) are directional lights;
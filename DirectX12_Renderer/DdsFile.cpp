@@ -0,0 +1,319 @@
+#include "DdsFile.h"
+
+namespace
+{
+    const std::uint32_t DdsMagic = 0x20534444; // "DDS "
+
+    // DDS_HEADER flags and pixel format flags.
+    const std::uint32_t DdsdMipMapCount = 0x00020000;
+    const std::uint32_t DdsdDepth = 0x00800000;
+    const std::uint32_t DdpfAlphaPixels = 0x00000001;
+    const std::uint32_t DdpfFourCC = 0x00000004;
+    const std::uint32_t DdpfRgb = 0x00000040;
+    const std::uint32_t Ddscaps2Cubemap = 0x00000200;
+
+    const std::uint32_t Dx10Texture2D = 3;
+    const std::uint32_t Dx10MiscCube = 0x4;
+
+    struct DdsPixelFormat
+    {
+        std::uint32_t Size;
+        std::uint32_t Flags;
+        std::uint32_t FourCC;
+        std::uint32_t RgbBitCount;
+        std::uint32_t RBitMask;
+        std::uint32_t GBitMask;
+        std::uint32_t BBitMask;
+        std::uint32_t ABitMask;
+    };
+
+    struct DdsHeader
+    {
+        std::uint32_t Size;
+        std::uint32_t Flags;
+        std::uint32_t Height;
+        std::uint32_t Width;
+        std::uint32_t PitchOrLinearSize;
+        std::uint32_t Depth;
+        std::uint32_t MipMapCount;
+        std::uint32_t Reserved1[11];
+        DdsPixelFormat PixelFormat;
+        std::uint32_t Caps;
+        std::uint32_t Caps2;
+        std::uint32_t Caps3;
+        std::uint32_t Caps4;
+        std::uint32_t Reserved2;
+    };
+
+    struct DdsHeaderDx10
+    {
+        std::uint32_t Format;
+        std::uint32_t Dimension;
+        std::uint32_t MiscFlag;
+        std::uint32_t ArraySize;
+        std::uint32_t MiscFlags2;
+    };
+
+    static_assert(sizeof(DdsHeader) == 124, "DDS_HEADER is 124 bytes");
+    static_assert(sizeof(DdsHeaderDx10) == 20, "DDS_HEADER_DXT10 is 20 bytes");
+
+    std::uint32_t MakeFourCC(char a, char b, char c, char d)
+    {
+        return (std::uint32_t)(BYTE)a | ((std::uint32_t)(BYTE)b << 8) | ((std::uint32_t)(BYTE)c << 16) | ((std::uint32_t)(BYTE)d << 24);
+    }
+
+    // Legacy headers; DXGI_FORMAT_UNKNOWN for anything else.
+    DXGI_FORMAT LegacyFormat(const DdsPixelFormat& pf)
+    {
+        if (pf.Flags & DdpfFourCC)
+        {
+            if (pf.FourCC == MakeFourCC('D', 'X', 'T', '1'))
+                return DXGI_FORMAT_BC1_UNORM;
+            if (pf.FourCC == MakeFourCC('D', 'X', 'T', '2') || pf.FourCC == MakeFourCC('D', 'X', 'T', '3'))
+                return DXGI_FORMAT_BC2_UNORM;
+            if (pf.FourCC == MakeFourCC('D', 'X', 'T', '4') || pf.FourCC == MakeFourCC('D', 'X', 'T', '5'))
+                return DXGI_FORMAT_BC3_UNORM;
+            if (pf.FourCC == MakeFourCC('A', 'T', 'I', '1') || pf.FourCC == MakeFourCC('B', 'C', '4', 'U'))
+                return DXGI_FORMAT_BC4_UNORM;
+            if (pf.FourCC == MakeFourCC('A', 'T', 'I', '2') || pf.FourCC == MakeFourCC('B', 'C', '5', 'U'))
+                return DXGI_FORMAT_BC5_UNORM;
+            return DXGI_FORMAT_UNKNOWN;
+        }
+
+        if ((pf.Flags & DdpfRgb) && pf.RgbBitCount == 32)
+        {
+            const bool alpha = (pf.Flags & DdpfAlphaPixels) != 0 && pf.ABitMask == 0xFF000000;
+            if (pf.RBitMask == 0x000000FF && pf.GBitMask == 0x0000FF00 && pf.BBitMask == 0x00FF0000)
+                return DXGI_FORMAT_R8G8B8A8_UNORM;
+            if (pf.RBitMask == 0x00FF0000 && pf.GBitMask == 0x0000FF00 && pf.BBitMask == 0x000000FF)
+                return alpha ? DXGI_FORMAT_B8G8R8A8_UNORM : DXGI_FORMAT_B8G8R8X8_UNORM;
+        }
+        return DXGI_FORMAT_UNKNOWN;
+    }
+
+    DXGI_FORMAT StripSrgb(DXGI_FORMAT format)
+    {
+        switch (format)
+        {
+        case DXGI_FORMAT_BC1_UNORM_SRGB: return DXGI_FORMAT_BC1_UNORM;
+        case DXGI_FORMAT_BC2_UNORM_SRGB: return DXGI_FORMAT_BC2_UNORM;
+        case DXGI_FORMAT_BC3_UNORM_SRGB: return DXGI_FORMAT_BC3_UNORM;
+        case DXGI_FORMAT_BC7_UNORM_SRGB: return DXGI_FORMAT_BC7_UNORM;
+        case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB: return DXGI_FORMAT_R8G8B8A8_UNORM;
+        case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB: return DXGI_FORMAT_B8G8R8A8_UNORM;
+        default: return format;
+        }
+    }
+
+    // Bytes per 4x4 block for BC formats, per texel otherwise; 0 when the
+    // format is not one the reader handles.
+    UINT ElementBytes(DXGI_FORMAT format, bool& blockCompressed)
+    {
+        blockCompressed = true;
+        switch (format)
+        {
+        case DXGI_FORMAT_BC1_UNORM:
+        case DXGI_FORMAT_BC1_UNORM_SRGB:
+        case DXGI_FORMAT_BC4_UNORM:
+        case DXGI_FORMAT_BC4_SNORM:
+            return 8;
+        case DXGI_FORMAT_BC2_UNORM:
+        case DXGI_FORMAT_BC2_UNORM_SRGB:
+        case DXGI_FORMAT_BC3_UNORM:
+        case DXGI_FORMAT_BC3_UNORM_SRGB:
+        case DXGI_FORMAT_BC5_UNORM:
+        case DXGI_FORMAT_BC5_SNORM:
+        case DXGI_FORMAT_BC6H_UF16:
+        case DXGI_FORMAT_BC6H_SF16:
+        case DXGI_FORMAT_BC7_UNORM:
+        case DXGI_FORMAT_BC7_UNORM_SRGB:
+            return 16;
+        default:
+            break;
+        }
+
+        blockCompressed = false;
+        switch (format)
+        {
+        case DXGI_FORMAT_R8_UNORM:
+            return 1;
+        case DXGI_FORMAT_R8G8_UNORM:
+        case DXGI_FORMAT_R16_UNORM:
+        case DXGI_FORMAT_R16_FLOAT:
+            return 2;
+        case DXGI_FORMAT_R8G8B8A8_UNORM:
+        case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+        case DXGI_FORMAT_B8G8R8A8_UNORM:
+        case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+        case DXGI_FORMAT_B8G8R8X8_UNORM:
+        case DXGI_FORMAT_R16G16_FLOAT:
+        case DXGI_FORMAT_R32_FLOAT:
+            return 4;
+        case DXGI_FORMAT_R16G16B16A16_FLOAT:
+        case DXGI_FORMAT_R16G16B16A16_UNORM:
+            return 8;
+        case DXGI_FORMAT_R32G32B32A32_FLOAT:
+            return 16;
+        default:
+            return 0;
+        }
+    }
+}
+
+DdsFile::~DdsFile()
+{
+    Close();
+}
+
+bool DdsFile::Fail(const wchar_t* reason)
+{
+    ::OutputDebugStringW((mFilename + L": " + reason + L"\n").c_str());
+    Close();
+    return false;
+}
+
+bool DdsFile::Open(const std::wstring& filename, bool ignoreSrgb)
+{
+    Close();
+    mFilename = filename;
+
+    mFile = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (mFile == INVALID_HANDLE_VALUE)
+        return Fail(L"not found");
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(mFile, &size) || size.QuadPart < (LONGLONG)(sizeof(std::uint32_t) + sizeof(DdsHeader)))
+        return Fail(L"too small for a DDS header");
+    mSize = (std::uint64_t)size.QuadPart;
+
+    mMapping = CreateFileMappingW(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mMapping == nullptr)
+        return Fail(L"could not be mapped");
+
+    mView = static_cast<const std::uint8_t*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+    if (mView == nullptr)
+        return Fail(L"could not be mapped");
+
+    std::uint32_t magic;
+    memcpy(&magic, mView, sizeof(magic));
+    const DdsHeader& header = *reinterpret_cast<const DdsHeader*>(mView + sizeof(magic));
+    if (magic != DdsMagic || header.Size != sizeof(DdsHeader) || header.PixelFormat.Size != sizeof(DdsPixelFormat))
+        return Fail(L"not a DDS file");
+
+    std::uint64_t dataOffset = sizeof(magic) + sizeof(DdsHeader);
+    if ((header.PixelFormat.Flags & DdpfFourCC) && header.PixelFormat.FourCC == MakeFourCC('D', 'X', '1', '0'))
+    {
+        if (mSize < dataOffset + sizeof(DdsHeaderDx10))
+            return Fail(L"truncated DX10 header");
+
+        const DdsHeaderDx10& dx10 = *reinterpret_cast<const DdsHeaderDx10*>(mView + dataOffset);
+        if (dx10.Dimension != Dx10Texture2D || (dx10.MiscFlag & Dx10MiscCube) || dx10.ArraySize != 1)
+            return Fail(L"only single 2D textures are supported");
+
+        mFormat = (DXGI_FORMAT)dx10.Format;
+        dataOffset += sizeof(DdsHeaderDx10);
+    }
+    else
+    {
+        if ((header.Flags & DdsdDepth) || (header.Caps2 & Ddscaps2Cubemap))
+            return Fail(L"only single 2D textures are supported");
+
+        mFormat = LegacyFormat(header.PixelFormat);
+    }
+
+    if (ignoreSrgb)
+        mFormat = StripSrgb(mFormat);
+
+    const UINT elementBytes = ElementBytes(mFormat, mBlockCompressed);
+    if (elementBytes == 0)
+        return Fail(L"unsupported pixel format");
+    if (header.Width == 0 || header.Height == 0 ||
+        header.Width > D3D12_REQ_TEXTURE2D_U_OR_V_DIMENSION || header.Height > D3D12_REQ_TEXTURE2D_U_OR_V_DIMENSION)
+        return Fail(L"bad dimensions");
+
+    // A full chain of a 16384 texture is 15 levels; more is a broken header.
+    mMipLevels = (header.Flags & DdsdMipMapCount) && header.MipMapCount > 0 ? header.MipMapCount : 1;
+    UINT fullChain = 1;
+    for (UINT extent = std::max(header.Width, header.Height); extent > 1; extent /= 2)
+        fullChain++;
+    if (mMipLevels > fullChain)
+        return Fail(L"more mip levels than the size allows");
+
+    // Levels follow each other with no padding.
+    std::uint64_t offset = dataOffset;
+    for (UINT mip = 0; mip < mMipLevels; ++mip)
+    {
+        Level& level = mLevels[mip];
+        level.Width = std::max(1u, header.Width >> mip);
+        level.Height = std::max(1u, header.Height >> mip);
+        if (mBlockCompressed)
+        {
+            level.RowBytes = (std::uint64_t)((level.Width + 3) / 4) * elementBytes;
+            level.Rows = (level.Height + 3) / 4;
+        }
+        else
+        {
+            level.RowBytes = (std::uint64_t)level.Width * elementBytes;
+            level.Rows = level.Height;
+        }
+        level.Offset = offset;
+        offset += level.RowBytes * level.Rows;
+    }
+    if (offset > mSize)
+        return Fail(L"truncated texel data");
+
+    return true;
+}
+
+void DdsFile::Close()
+{
+    if (mView != nullptr)
+        UnmapViewOfFile(mView);
+    if (mMapping != nullptr)
+        CloseHandle(mMapping);
+    if (mFile != INVALID_HANDLE_VALUE)
+        CloseHandle(mFile);
+
+    mView = nullptr;
+    mMapping = nullptr;
+    mFile = INVALID_HANDLE_VALUE;
+    mSize = 0;
+    mFormat = DXGI_FORMAT_UNKNOWN;
+    mBlockCompressed = false;
+    mMipLevels = 0;
+}
+
+D3D12_RESOURCE_DESC DdsFile::ResourceDesc()const
+{
+    return CD3DX12_RESOURCE_DESC::Tex2D(mFormat, Width(), Height(), 1, (UINT16)mMipLevels);
+}
+
+D3D12_SUBRESOURCE_DATA DdsFile::Subresource(UINT mip)const
+{
+    assert(mip < mMipLevels);
+    const Level& level = mLevels[mip];
+
+    D3D12_SUBRESOURCE_DATA data;
+    data.pData = mView + level.Offset;
+    data.RowPitch = (LONG_PTR)level.RowBytes;
+    data.SlicePitch = (LONG_PTR)(level.RowBytes * level.Rows);
+    return data;
+}
+
+void DdsFile::CopyRows(UINT mip, UINT firstRow, UINT rowCount, BYTE* dst, UINT64 rowPitch)const
+{
+    assert(mip < mMipLevels);
+    const Level& level = mLevels[mip];
+    assert(firstRow + rowCount <= level.Rows && rowPitch >= level.RowBytes);
+
+    const std::uint8_t* src = mView + level.Offset + level.RowBytes * firstRow;
+    if (rowPitch == level.RowBytes)
+    {
+        memcpy(dst, src, (size_t)(level.RowBytes * rowCount));
+        return;
+    }
+
+    for (UINT row = 0; row < rowCount; ++row)
+        memcpy(dst + rowPitch * row, src + level.RowBytes * row, (size_t)level.RowBytes);
+}
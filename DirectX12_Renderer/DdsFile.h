@@ -0,0 +1,80 @@
+#pragma once
+
+#include "d3dUtil.h"
+
+// Read-only view of a DDS texture.  Open maps the whole file with a single
+// MapViewOfFile and validates the headers; every mip level points straight
+// into the mapping, so the texels are not copied until they go to the GPU.
+//   - 2D textures with one array slice: DX10 headers, the DXT1-5, ATI1/ATI2
+//     and BC4U/BC5U four-CCs, and 32-bit RGBA/BGRA masks.
+//   - Levels are stored tightly packed, a row (a row of 4x4 blocks for BC
+//     formats) after another; CopyRows re-pitches them for an upload buffer.
+// Failures return false and say why in the debugger output.
+class DdsFile
+{
+public:
+    static const UINT MaxMipLevels = 16;
+
+    struct Level
+    {
+        UINT Width = 0;
+        UINT Height = 0;
+        UINT Rows = 0;          // Block rows for BC formats.
+        UINT64 RowBytes = 0;
+        UINT64 Offset = 0;      // From the start of the file.
+    };
+
+    DdsFile() = default;
+    DdsFile(const DdsFile& rhs) = delete;
+    DdsFile& operator=(const DdsFile& rhs) = delete;
+    ~DdsFile();
+
+    // ignoreSrgb reads sRGB formats as their UNORM counterparts, like
+    // DDS_LOADER_IGNORE_SRGB.
+    bool Open(const std::wstring& filename, bool ignoreSrgb = false);
+    void Close();
+
+    bool IsOpen()const { return mView != nullptr; }
+    const std::wstring& Filename()const { return mFilename; }
+    UINT64 FileSize()const { return mSize; }
+
+    UINT Width()const { return mLevels[0].Width; }
+    UINT Height()const { return mLevels[0].Height; }
+    UINT MipLevels()const { return mMipLevels; }
+    DXGI_FORMAT Format()const { return mFormat; }
+    bool IsBlockCompressed()const { return mBlockCompressed; }
+
+    // Whether a texture can be created with mip as its level 0: for BC
+    // formats, level 0 has to be whole 4x4 blocks.
+    bool CanBeFirstMip(UINT mip)const
+    {
+        return !mBlockCompressed || (mLevels[mip].Width % 4 == 0 && mLevels[mip].Height % 4 == 0);
+    }
+
+    // Default-heap description of the whole texture.
+    D3D12_RESOURCE_DESC ResourceDesc()const;
+
+    const Level& GetLevel(UINT mip)const { return mLevels[mip]; }
+
+    // The level as stored, for UpdateSubresources and the like.
+    D3D12_SUBRESOURCE_DATA Subresource(UINT mip)const;
+
+    // Copies rows [firstRow, firstRow + rowCount) of mip to dst, rowPitch
+    // bytes apart.
+    void CopyRows(UINT mip, UINT firstRow, UINT rowCount, BYTE* dst, UINT64 rowPitch)const;
+
+private:
+    bool Fail(const wchar_t* reason);
+
+private:
+    std::wstring mFilename;
+    HANDLE mFile = INVALID_HANDLE_VALUE;
+    HANDLE mMapping = nullptr;
+    const std::uint8_t* mView = nullptr;
+    std::uint64_t mSize = 0;
+
+    DXGI_FORMAT mFormat = DXGI_FORMAT_UNKNOWN;
+    bool mBlockCompressed = false;
+    UINT mMipLevels = 0;
+    Level mLevels[MaxMipLevels];
+};
@@ -0,0 +1,177 @@
+#include "DrawQueue.h"
+#include "UploadRing.h"
+
+std::uint64_t DrawKey::Make(UINT pipeline, UINT geometry, UINT material, UINT submesh, float depth01)
+{
+    // Truncating a field would give different bindings the same key, and the
+    // state cache would then skip a rebind that is needed.
+    assert(pipeline <= 0xF && "pipeline does not fit its draw key field");
+    assert(geometry <= 0xFFFF && "geometry does not fit its draw key field");
+    assert(material <= 0xFFFF && "material does not fit its draw key field");
+    assert(submesh <= 0xFFF && "submesh does not fit its draw key field");
+
+    const float d = depth01 < 0.0f ? 0.0f : (depth01 > 1.0f ? 1.0f : depth01);
+    const std::uint64_t depth = (std::uint64_t)(d * 65535.0f);
+
+    return ((std::uint64_t)(pipeline & 0xF) << 60) |
+        ((std::uint64_t)(geometry & 0xFFFF) << 44) |
+        ((std::uint64_t)(material & 0xFFFF) << 28) |
+        ((std::uint64_t)(submesh & 0xFFF) << 16) |
+        depth;
+}
+
+void DrawQueue::Clear()
+{
+    mKeys.clear();
+    mPackets.clear();
+    mOrder.clear();
+}
+
+void DrawQueue::Push(std::uint64_t key, const DrawPacket& packet)
+{
+    mKeys.push_back(key);
+    mPackets.push_back(packet);
+}
+
+void DrawQueue::Sort()
+{
+    const UINT count = (UINT)mKeys.size();
+
+    mOrder.resize(count);
+    mScratchOrder.resize(count);
+    mSortedKeys.assign(mKeys.begin(), mKeys.end());
+    mScratchKeys.resize(count);
+    for (UINT i = 0; i < count; ++i)
+        mOrder[i] = i;
+
+    if (count < 2)
+        return;
+
+    // All eight histograms in one pass over the keys.
+    UINT histograms[8][256] = {};
+    for (UINT i = 0; i < count; ++i)
+    {
+        std::uint64_t k = mSortedKeys[i];
+        for (int pass = 0; pass < 8; ++pass)
+            histograms[pass][(k >> (pass * 8)) & 0xFF]++;
+    }
+
+    for (int pass = 0; pass < 8; ++pass)
+    {
+        UINT* histogram = histograms[pass];
+        const int shift = pass * 8;
+
+        // Every key has the same byte here; the pass would not move anything.
+        if (histogram[(mSortedKeys[0] >> shift) & 0xFF] == count)
+            continue;
+
+        UINT offset = 0;
+        for (int b = 0; b < 256; ++b)
+        {
+            UINT c = histogram[b];
+            histogram[b] = offset;
+            offset += c;
+        }
+
+        for (UINT i = 0; i < count; ++i)
+        {
+            const std::uint64_t k = mSortedKeys[i];
+            const UINT dst = histogram[(k >> shift) & 0xFF]++;
+            mScratchKeys[dst] = k;
+            mScratchOrder[dst] = mOrder[i];
+        }
+
+        mSortedKeys.swap(mScratchKeys);
+        mOrder.swap(mScratchOrder);
+    }
+}
+
+void DrawQueue::Build(const InstanceBatcher& batcher, DirectX::FXMVECTOR eye, DirectX::FXMVECTOR look, float farZ)
+{
+    using namespace DirectX;
+
+    Clear();
+
+    const float invFar = 1.0f / farZ;
+    const auto& instances = batcher.Instances();
+    for (const InstanceBatch& batch : batcher.Batches())
+    {
+        const bool instanced = batch.InstanceCount >= InstanceBatcher::MinInstanceCount;
+        const UINT drawCount = instanced ? 1 : batch.InstanceCount;
+
+        for (UINT i = 0; i < drawCount; ++i)
+        {
+            DrawPacket packet;
+            packet.Item = instanced ? batch.Item : instances[batch.FirstInstance + i];
+            packet.FirstInstance = batch.FirstInstance + i;
+            packet.InstanceCount = instanced ? batch.InstanceCount : 1;
+
+            // View depth of the item's bounds center; a batch sorts by its first instance.
+            const RenderItem* ri = packet.Item;
+            XMVECTOR center = XMVector3Transform(XMLoadFloat3(&ri->Bounds.Center), XMLoadFloat4x4(&ri->World));
+            float depth = XMVectorGetX(XMVector3Dot(center - eye, look)) * invFar;
+
+            std::uint64_t key = DrawKey::Make(instanced ? DrawKey::InstancedPipeline : DrawKey::DefaultPipeline,
+                ri->Geo->GeoIndex, ri->Mat->MatCBIndex, ri->Submesh, depth);
+            Push(key, packet);
+        }
+    }
+
+    Sort();
+}
+
+bool DrawQueue::WriteConstants(UINT first, UINT last, const InstanceBatcher& batcher, UploadRing& ring)
+{
+    using namespace DirectX;
+
+    const auto& instances = batcher.Instances();
+    for (UINT p = first; p < last; ++p)
+    {
+        DrawPacket& packet = mPackets[p];
+
+        if (DrawKey::Pipeline(mKeys[p]) == DrawKey::InstancedPipeline)
+        {
+            // Texture transforms are left out unless some instance needs one.
+            InstanceHeader header;
+            for (UINT i = 0; i < packet.InstanceCount; ++i)
+            {
+                if (!IsIdentity(instances[packet.FirstInstance + i]->TexTransform))
+                {
+                    header.Flags |= InstanceHasTexTransform;
+                    break;
+                }
+            }
+            const bool texTransforms = (header.Flags & InstanceHasTexTransform) != 0;
+            const UINT stride = sizeof(AffineTransform) + (texTransforms ? sizeof(TexTransform2D) : 0);
+
+            // A raw buffer view only needs 16-byte alignment here (the shader
+            // loads float4s), so batches are packed back to back.
+            UploadAllocation a = ring.Allocate(sizeof(InstanceHeader) + (UINT64)packet.InstanceCount * stride, 16);
+            if (a.Cpu == nullptr)
+                return false;
+
+            memcpy(a.Cpu, &header, sizeof(header));
+            BYTE* data = a.Cpu + sizeof(InstanceHeader);
+            for (UINT i = 0; i < packet.InstanceCount; ++i)
+            {
+                const RenderItem* ri = instances[packet.FirstInstance + i];
+                StoreAffineTransform(reinterpret_cast<AffineTransform*>(data), XMLoadFloat4x4(&ri->World));
+                if (texTransforms)
+                    StoreTexTransform2D(reinterpret_cast<TexTransform2D*>(data + sizeof(AffineTransform)), XMLoadFloat4x4(&ri->TexTransform));
+                data += stride;
+            }
+            packet.Constants = a.Gpu;
+        }
+        else
+        {
+            ObjectConstants objConstants;
+            StoreAffineTransform(&objConstants.World, XMLoadFloat4x4(&packet.Item->World));
+            StoreTexTransform2D(&objConstants.TexTransform, XMLoadFloat4x4(&packet.Item->TexTransform));
+
+            packet.Constants = ring.AllocateConstants(objConstants);
+            if (packet.Constants == 0)
+                return false;
+        }
+    }
+    return true;
+}
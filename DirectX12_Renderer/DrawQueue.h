@@ -0,0 +1,68 @@
+#pragma once
+
+#include "InstanceBatcher.h"
+
+class UploadRing;
+
+// One draw submitted to the queue: a whole instanced batch, or a single item
+// drawn through ObjectCB when InstanceCount is below InstanceBatcher::MinInstanceCount.
+struct DrawPacket
+{
+    RenderItem* Item = nullptr;
+    UINT FirstInstance = 0;
+    UINT InstanceCount = 1;
+
+    // Transient per-draw data, set by DrawQueue::WriteConstants: the object
+    // CB for single draws, the batch's instance data otherwise.
+    D3D12_GPU_VIRTUAL_ADDRESS Constants = 0;
+};
+
+// 64-bit draw sort key, most significant field first, so that sorting groups
+// draws by the state that is most expensive to change:
+//   [63..60] pipeline  [59..44] geometry  [43..28] material  [27..16] submesh  [15..0] depth
+// Depth is a front-to-back bucket so opaque draws with equal state still
+// help early-z.  Make asserts that every field fits.
+namespace DrawKey
+{
+    // Pipeline field values.
+    const UINT DefaultPipeline = 0;
+    const UINT InstancedPipeline = 1;
+
+    std::uint64_t Make(UINT pipeline, UINT geometry, UINT material, UINT submesh, float depth01);
+
+    inline UINT Pipeline(std::uint64_t key) { return (UINT)(key >> 60); }
+}
+
+// Per-frame list of draws sorted by DrawKey with an LSD radix sort (8 passes of
+// 8 bits, passes whose byte is identical for every key are skipped).
+class DrawQueue
+{
+public:
+    void Clear();
+    void Push(std::uint64_t key, const DrawPacket& packet);
+    void Sort();
+
+    // Clear, then one packet per instanced batch (or per item of a batch too
+    // small to instance) keyed by its view depth along look, then Sort.
+    void Build(const InstanceBatcher& batcher, DirectX::FXMVECTOR eye, DirectX::FXMVECTOR look, float farZ);
+
+    // Writes ObjectConstants or the batch's instance data for packets [first, last)
+    // (in push order, not sorted order) into ring memory and points the packets
+    // at it.  Disjoint ranges may be written in parallel.  Returns false if the
+    // ring ran out of space.
+    bool WriteConstants(UINT first, UINT last, const InstanceBatcher& batcher, UploadRing& ring);
+
+    UINT Size()const { return (UINT)mPackets.size(); }
+    std::uint64_t Key(UINT i)const { return mKeys[mOrder[i]]; }
+    const DrawPacket& Packet(UINT i)const { return mPackets[mOrder[i]]; }
+
+private:
+    std::vector<std::uint64_t> mKeys;
+    std::vector<DrawPacket> mPackets;
+
+    // Sorted position -> packet index, plus scratch for the radix passes.
+    std::vector<UINT> mOrder;
+    std::vector<UINT> mScratchOrder;
+    std::vector<std::uint64_t> mSortedKeys;
+    std::vector<std::uint64_t> mScratchKeys;
+};
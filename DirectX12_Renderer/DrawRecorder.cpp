@@ -0,0 +1,139 @@
+#include "DrawRecorder.h"
+
+void DrawRecorder::Begin(CommandBackend* backend, ID3D12PipelineState* pso)
+{
+    mBackend = backend;
+    mPSO = pso;
+    mVertexBuffer = {};
+    mIndexBuffer = {};
+    mTopology = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
+    for (UINT i = 0; i < MaxRootParameters; ++i)
+        mRootParameters[i] = 0;
+
+    mStats = DrawStats();
+}
+
+bool DrawRecorder::Changed(bool changed)
+{
+    if (changed)
+        mStats.BindsIssued++;
+    else
+        mStats.BindsSkipped++;
+    return changed;
+}
+
+void DrawRecorder::SetPipelineState(ID3D12PipelineState* pso)
+{
+    if (Changed(pso != mPSO))
+    {
+        mPSO = pso;
+        mBackend->SetPipelineState(pso);
+    }
+}
+
+void DrawRecorder::SetVertexBuffer(const D3D12_VERTEX_BUFFER_VIEW& vbv)
+{
+    if (Changed(memcmp(&vbv, &mVertexBuffer, sizeof(vbv)) != 0))
+    {
+        mVertexBuffer = vbv;
+        mBackend->SetVertexBuffer(vbv);
+    }
+}
+
+void DrawRecorder::SetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW& ibv)
+{
+    if (Changed(memcmp(&ibv, &mIndexBuffer, sizeof(ibv)) != 0))
+    {
+        mIndexBuffer = ibv;
+        mBackend->SetIndexBuffer(ibv);
+    }
+}
+
+void DrawRecorder::SetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology)
+{
+    if (Changed(topology != mTopology))
+    {
+        mTopology = topology;
+        mBackend->SetPrimitiveTopology(topology);
+    }
+}
+
+void DrawRecorder::SetDescriptorTable(UINT rootIndex, D3D12_GPU_DESCRIPTOR_HANDLE handle)
+{
+    assert(rootIndex < MaxRootParameters);
+    if (Changed(handle.ptr != mRootParameters[rootIndex]))
+    {
+        mRootParameters[rootIndex] = handle.ptr;
+        mBackend->SetDescriptorTable(rootIndex, handle);
+    }
+}
+
+void DrawRecorder::SetConstantBufferView(UINT rootIndex, D3D12_GPU_VIRTUAL_ADDRESS address)
+{
+    assert(rootIndex < MaxRootParameters);
+    if (Changed(address != mRootParameters[rootIndex]))
+    {
+        mRootParameters[rootIndex] = address;
+        mBackend->SetConstantBufferView(rootIndex, address);
+    }
+}
+
+void DrawRecorder::SetShaderResourceView(UINT rootIndex, D3D12_GPU_VIRTUAL_ADDRESS address)
+{
+    assert(rootIndex < MaxRootParameters);
+    if (Changed(address != mRootParameters[rootIndex]))
+    {
+        mRootParameters[rootIndex] = address;
+        mBackend->SetShaderResourceView(rootIndex, address);
+    }
+}
+
+void DrawRecorder::DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance)
+{
+    mStats.Draws++;
+    mStats.Instances += instanceCount;
+    mBackend->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+}
+
+void DrawRecorder::RecordQueue(const DrawQueue& queue, UINT first, UINT last, const DrawBindings& bindings)
+{
+    mBackend->SetRootSignature(bindings.RootSignature);
+    mBackend->SetDescriptorHeap(bindings.SrvHeap);
+    mBackend->SetViewport(bindings.Viewport, bindings.ScissorRect);
+    mBackend->SetRenderTarget(bindings.RenderTarget, bindings.DepthStencil);
+
+    SetConstantBufferView(2, bindings.PassCB);
+    SetConstantBufferView(5, bindings.LightCB);
+    SetShaderResourceView(6, bindings.ClusterLights);
+    SetShaderResourceView(7, bindings.ClusterRanges);
+    SetShaderResourceView(8, bindings.ClusterLightIndices);
+
+    for (UINT i = first; i < last; ++i)
+    {
+        const DrawPacket& packet = queue.Packet(i);
+        const RenderItem* ri = packet.Item;
+        const bool instanced = DrawKey::Pipeline(queue.Key(i)) == DrawKey::InstancedPipeline;
+
+        SetPipelineState(instanced ? bindings.InstancedPSO : bindings.DefaultPSO);
+        SetVertexBuffer(ri->Geo->VertexBufferView());
+        SetIndexBuffer(ri->Geo->IndexBufferView(ri->IndexFormat, ri->IndexByteOffset));
+        SetPrimitiveTopology(ri->PrimitiveType);
+
+        D3D12_GPU_DESCRIPTOR_HANDLE tex = bindings.SrvHeapStart;
+        tex.ptr += (UINT64)ri->Mat->DiffuseSrvHeapIndex * bindings.SrvDescriptorSize;
+        SetDescriptorTable(0, tex);
+        SetConstantBufferView(3, bindings.MaterialCB + ri->Mat->MatCBIndex * bindings.MaterialCBByteSize);
+
+        if (instanced)
+        {
+            // SV_InstanceID restarts at 0 every draw, so the view starts at the batch.
+            SetShaderResourceView(4, packet.Constants);
+        }
+        else
+        {
+            SetConstantBufferView(1, packet.Constants);
+        }
+
+        DrawIndexedInstanced(ri->IndexCount, packet.InstanceCount, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+    }
+}
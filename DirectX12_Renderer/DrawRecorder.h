@@ -0,0 +1,100 @@
+#pragma once
+
+#include "CommandBackend.h"
+#include "DrawQueue.h"
+
+// Per-frame counters from DrawRecorder.  A "bind" is any IA, PSO or root
+// parameter call; BindsSkipped counts calls dropped because the same value
+// was already bound.
+struct DrawStats
+{
+    UINT Draws = 0;
+    UINT Instances = 0;
+    UINT BindsIssued = 0;
+    UINT BindsSkipped = 0;
+};
+
+// Everything needed to record a queue range into a fresh command list: the
+// render target setup, the PSOs selected by the key's pipeline field and the
+// per-frame buffers the root parameters point into.  Per-draw object and
+// instance data come from each packet's Constants address.
+struct DrawBindings
+{
+    ID3D12RootSignature* RootSignature = nullptr;
+    ID3D12DescriptorHeap* SrvHeap = nullptr;
+    D3D12_VIEWPORT Viewport = {};
+    D3D12_RECT ScissorRect = {};
+    D3D12_CPU_DESCRIPTOR_HANDLE RenderTarget = {};
+    D3D12_CPU_DESCRIPTOR_HANDLE DepthStencil = {};
+
+    ID3D12PipelineState* DefaultPSO = nullptr;
+    ID3D12PipelineState* InstancedPSO = nullptr;
+
+    D3D12_GPU_DESCRIPTOR_HANDLE SrvHeapStart = {};
+    UINT SrvDescriptorSize = 0;
+
+    D3D12_GPU_VIRTUAL_ADDRESS PassCB = 0;
+    D3D12_GPU_VIRTUAL_ADDRESS MaterialCB = 0;
+    D3D12_GPU_VIRTUAL_ADDRESS LightCB = 0;
+    UINT MaterialCBByteSize = 0;
+
+    // Clustered point/spot lights: the lights, the per-cluster ranges and the
+    // light index list (root SRVs 6, 7 and 8).
+    D3D12_GPU_VIRTUAL_ADDRESS ClusterLights = 0;
+    D3D12_GPU_VIRTUAL_ADDRESS ClusterRanges = 0;
+    D3D12_GPU_VIRTUAL_ADDRESS ClusterLightIndices = 0;
+};
+
+// Thin state cache in front of a CommandBackend.  Every setter compares
+// against the last value it forwarded and only records the call on a change,
+// so a sorted draw queue can set the full state for every draw.
+class DrawRecorder
+{
+public:
+    static const UINT MaxRootParameters = 16;
+
+    // Root parameters each pipeline reads (bit per root index): both use the
+    // texture table (0), PassCB (2), MaterialCB (3), LightCB (5) and the
+    // cluster buffers (6-8); the default pipeline reads ObjectCB (1), the
+    // instanced one the instance buffer (4).
+    static const UINT DefaultRootParameters = 0x1EF;
+    static const UINT InstancedRootParameters = 0x1FD;
+
+    // Forgets all cached state; call after the command list is reset or its
+    // state is changed behind the recorder's back.  pso is the state the list
+    // was reset with.
+    void Begin(CommandBackend* backend, ID3D12PipelineState* pso);
+
+    // Records queue entries [first, last) into a list that has just been reset:
+    // root signature, heap, viewport and render target, the pass, light and
+    // cluster buffers, then every packet's state and draw.
+    void RecordQueue(const DrawQueue& queue, UINT first, UINT last, const DrawBindings& bindings);
+
+    void SetPipelineState(ID3D12PipelineState* pso);
+    void SetVertexBuffer(const D3D12_VERTEX_BUFFER_VIEW& vbv);
+    void SetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW& ibv);
+    void SetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology);
+    void SetDescriptorTable(UINT rootIndex, D3D12_GPU_DESCRIPTOR_HANDLE handle);
+    void SetConstantBufferView(UINT rootIndex, D3D12_GPU_VIRTUAL_ADDRESS address);
+    void SetShaderResourceView(UINT rootIndex, D3D12_GPU_VIRTUAL_ADDRESS address);
+
+    void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance);
+
+    const DrawStats& GetStats()const { return mStats; }
+
+private:
+    bool Changed(bool changed);
+
+private:
+    CommandBackend* mBackend = nullptr;
+
+    ID3D12PipelineState* mPSO = nullptr;
+    D3D12_VERTEX_BUFFER_VIEW mVertexBuffer = {};
+    D3D12_INDEX_BUFFER_VIEW mIndexBuffer = {};
+    D3D12_PRIMITIVE_TOPOLOGY mTopology = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
+
+    // Root descriptor tables and root CBV/SRV addresses share one slot per root parameter.
+    UINT64 mRootParameters[MaxRootParameters] = {};
+
+    DrawStats mStats;
+};
@@ -1,15 +1,29 @@
 #include "FrameResource.h"
 
-FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount)
+FrameResource::FrameResource(ID3D12Device* device, UINT materialCount, UINT recordChunkCount)
 {
     ThrowIfFailed(device->CreateCommandAllocator(
         D3D12_COMMAND_LIST_TYPE_DIRECT,
 		IID_PPV_ARGS(CmdListAlloc.GetAddressOf())));
 
+    ChunkCmdListAllocs.resize(recordChunkCount);
+    ChunkCmdLists.resize(recordChunkCount);
+    for (UINT i = 0; i < recordChunkCount; ++i)
+    {
+        ThrowIfFailed(device->CreateCommandAllocator(
+            D3D12_COMMAND_LIST_TYPE_DIRECT,
+            IID_PPV_ARGS(ChunkCmdListAllocs[i].GetAddressOf())));
+
+        ThrowIfFailed(device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT,
+            ChunkCmdListAllocs[i].Get(), nullptr, IID_PPV_ARGS(ChunkCmdLists[i].GetAddressOf())));
+
+        // Lists are created open; Draw expects to Reset them.
+        ThrowIfFailed(ChunkCmdLists[i]->Close());
+    }
+
   //  FrameCB = std::make_unique<UploadBuffer<FrameConstants>>(device, 1, true);
-    PassCB = std::make_unique<UploadBuffer<PassConstants>>(device, passCount, true);
     MaterialCB = std::make_unique<UploadBuffer<MaterialConstants>>(device, materialCount, true);
-    ObjectCB = std::make_unique<UploadBuffer<ObjectConstants>>(device, objectCount, true);
+    LightCB = std::make_unique<UploadBuffer<LightConstants>>(device, 1, true);
 }
 
 FrameResource::~FrameResource()
@@ -0,0 +1,68 @@
+#include "GpuTimeline.h"
+#include <chrono>
+
+UINT64 GpuTimeline::Signal()
+{
+    SignalValue(++mLastSignaled);
+    return mLastSignaled;
+}
+
+void GpuTimeline::Wait(UINT64 value)
+{
+    assert(value <= mLastSignaled && "waiting for a value that was never signaled");
+    if (IsComplete(value))
+        return;
+
+    auto start = std::chrono::steady_clock::now();
+    Block(value);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    mFrameStats.Waits++;
+    mFrameStats.WaitSeconds += seconds;
+    mTotalStats.Waits++;
+    mTotalStats.WaitSeconds += seconds;
+}
+
+D3D12Timeline::D3D12Timeline(ID3D12Device* device, ID3D12CommandQueue* queue) : mQueue(queue)
+{
+    ThrowIfFailed(device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&mFence)));
+
+    // Auto-reset: each Block consumes the one signal it asked for.
+    mEvent = CreateEventEx(nullptr, nullptr, 0, EVENT_ALL_ACCESS);
+    if (mEvent == nullptr)
+        ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+}
+
+D3D12Timeline::~D3D12Timeline()
+{
+    if (mEvent != nullptr)
+        CloseHandle(mEvent);
+}
+
+void D3D12Timeline::SignalValue(UINT64 value)
+{
+    ThrowIfFailed(mQueue->Signal(mFence.Get(), value));
+}
+
+void D3D12Timeline::Block(UINT64 value)
+{
+    ThrowIfFailed(mFence->SetEventOnCompletion(value, mEvent));
+    WaitForSingleObject(mEvent, INFINITE);
+}
+
+void CpuTimeline::Complete(UINT64 value)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (value <= mCompleted.load(std::memory_order_relaxed))
+            return;
+        mCompleted.store(value, std::memory_order_release);
+    }
+    mCompletedChanged.notify_all();
+}
+
+void CpuTimeline::Block(UINT64 value)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    mCompletedChanged.wait(lock, [&]() { return mCompleted.load(std::memory_order_relaxed) >= value; });
+}
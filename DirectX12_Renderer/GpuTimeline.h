@@ -0,0 +1,110 @@
+#pragma once
+
+#include "d3dUtil.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+// A fence timeline: the render thread signals increasing values behind its
+// submissions and later asks whether, or waits until, the GPU got there.
+//   - Signal returns the value it queued, so frame resources, the upload
+//     ring and the streamer can be tagged with it.
+//   - IsComplete polls without blocking; Wait returns at once for values
+//     already reached and only then goes to the OS.
+//   - Time spent in Wait is counted per frame and in total.
+// D3D12Timeline drives an ID3D12Fence; CpuTimeline is a stand-in completed by
+// the caller, so frame pacing can be exercised without a GPU.
+// Not thread safe, except where noted on CpuTimeline.
+class GpuTimeline
+{
+public:
+    struct Stats
+    {
+        UINT Waits = 0;
+        double WaitSeconds = 0.0;
+    };
+
+    GpuTimeline() = default;
+    GpuTimeline(const GpuTimeline& rhs) = delete;
+    GpuTimeline& operator=(const GpuTimeline& rhs) = delete;
+    virtual ~GpuTimeline() = default;
+
+    // Queues a signal of the next value and returns the value.
+    UINT64 Signal();
+    UINT64 LastSignaled()const { return mLastSignaled; }
+
+    virtual UINT64 CompletedValue() = 0;
+    bool IsComplete(UINT64 value) { return value <= CompletedValue(); }
+
+    // Blocks until value is reached.
+    void Wait(UINT64 value);
+
+    // Waits for everything signaled so far.  Enough to drain the queue when
+    // every submission has been followed by a Signal.
+    void WaitIdle() { Wait(mLastSignaled); }
+
+    // Signals and waits, so everything submitted before is done.
+    void Flush() { Wait(Signal()); }
+
+    // Waits since ResetFrameStats, and since creation.
+    const Stats& GetFrameStats()const { return mFrameStats; }
+    const Stats& GetTotalStats()const { return mTotalStats; }
+    void ResetFrameStats() { mFrameStats = Stats(); }
+
+protected:
+    virtual void SignalValue(UINT64 value) = 0;
+
+    // Returns once value is reached.
+    virtual void Block(UINT64 value) = 0;
+
+private:
+    UINT64 mLastSignaled = 0;
+    Stats mFrameStats;
+    Stats mTotalStats;
+};
+
+// Signals on a command queue.  The wait event is created once and reused.
+class D3D12Timeline : public GpuTimeline
+{
+public:
+    D3D12Timeline(ID3D12Device* device, ID3D12CommandQueue* queue);
+    ~D3D12Timeline();
+
+    ID3D12Fence* Fence()const { return mFence.Get(); }
+
+    UINT64 CompletedValue()override { return mFence->GetCompletedValue(); }
+
+protected:
+    void SignalValue(UINT64 value)override;
+    void Block(UINT64 value)override;
+
+private:
+    Microsoft::WRL::ComPtr<ID3D12Fence> mFence;
+    ID3D12CommandQueue* mQueue = nullptr;
+    HANDLE mEvent = nullptr;
+};
+
+// A timeline without a GPU.  Values are completed by calling Complete, from
+// the waiting thread or from another one playing the GPU; Complete,
+// CompletedValue and Queued may be called from any thread.
+class CpuTimeline : public GpuTimeline
+{
+public:
+    UINT64 CompletedValue()override { return mCompleted.load(std::memory_order_acquire); }
+
+    // The last value signaled, for the thread playing the GPU.
+    UINT64 Queued()const { return mQueued.load(std::memory_order_acquire); }
+
+    // Marks every value up to value as reached and wakes waiters.
+    void Complete(UINT64 value);
+
+protected:
+    void SignalValue(UINT64 value)override { mQueued.store(value, std::memory_order_release); }
+    void Block(UINT64 value)override;
+
+private:
+    std::atomic<UINT64> mQueued{ 0 };
+    std::atomic<UINT64> mCompleted{ 0 };
+    std::mutex mMutex;
+    std::condition_variable mCompletedChanged;
+};
@@ -0,0 +1,165 @@
+#include "HeightField.h"
+#include "JobSystem.h"
+
+using namespace DirectX;
+
+void HeightField::Build(float originX, float originZ, float spacing, UINT samplesX, UINT samplesZ,
+    const HeightFunction& height, JobSystem* jobs)
+{
+    assert(samplesX >= 2 && samplesZ >= 2 && spacing > 0.0f);
+
+    mOriginX = originX;
+    mOriginZ = originZ;
+    mSpacing = spacing;
+    mInvSpacing = 1.0f / spacing;
+    mCellsX = samplesX - 1;
+    mCellsZ = samplesZ - 1;
+    mTilesX = (mCellsX + TileSize - 1) / TileSize;
+    mTilesZ = (mCellsZ + TileSize - 1) / TileSize;
+    mSamples.resize((size_t)mTilesX * mTilesZ * TileStride * TileStride);
+
+    auto fillTiles = [&](UINT first, UINT last)
+    {
+        for (UINT tile = first; tile < last; ++tile)
+        {
+            const UINT tx = tile % mTilesX;
+            const UINT tz = tile / mTilesX;
+            float* out = &mSamples[(size_t)tile * TileStride * TileStride];
+            for (UINT j = 0; j < TileStride; ++j)
+            {
+                // The last tile may run past the field; repeat the border.
+                const UINT gz = std::min(tz * TileSize + j, mCellsZ);
+                for (UINT i = 0; i < TileStride; ++i)
+                {
+                    const UINT gx = std::min(tx * TileSize + i, mCellsX);
+                    out[j * TileStride + i] = height(originX + gx * spacing, originZ + gz * spacing);
+                }
+            }
+        }
+    };
+
+    if (jobs != nullptr)
+        jobs->ParallelFor(mTilesX * mTilesZ, 1, fillTiles);
+    else
+        fillTiles(0, mTilesX * mTilesZ);
+}
+
+float HeightField::Height(float x, float z)const
+{
+    return HeightAndGradient(x, z, nullptr, nullptr);
+}
+
+float HeightField::HeightAndGradient(float x, float z, float* dhdx, float* dhdz)const
+{
+    // Same operations as Batch, one lane at a time.
+    const float u = std::min(std::max((x - mOriginX) * mInvSpacing, 0.0f), (float)mCellsX);
+    const float v = std::min(std::max((z - mOriginZ) * mInvSpacing, 0.0f), (float)mCellsZ);
+    const float cu = std::min(floorf(u), (float)(mCellsX - 1));
+    const float cv = std::min(floorf(v), (float)(mCellsZ - 1));
+    const float fu = u - cu;
+    const float fv = v - cv;
+
+    const float* p = Cell((UINT)cu, (UINT)cv);
+    const float h00 = p[0];
+    const float h10 = p[1];
+    const float h01 = p[TileStride];
+    const float h11 = p[TileStride + 1];
+
+    const float dx0 = h10 - h00;
+    const float dx1 = h11 - h01;
+    const float h0 = h00 + fu * dx0;
+    const float h1 = h01 + fu * dx1;
+
+    if (dhdx != nullptr)
+    {
+        *dhdx = (dx0 + fv * (dx1 - dx0)) * mInvSpacing;
+        *dhdz = (h1 - h0) * mInvSpacing;
+    }
+    return h0 + fv * (h1 - h0);
+}
+
+template<bool Gradient>
+void HeightField::Batch(const float* x, const float* z, float* heights, float* dhdx, float* dhdz, UINT count)const
+{
+    const XMVECTOR zero = XMVectorZero();
+    const XMVECTOR originX = XMVectorReplicate(mOriginX);
+    const XMVECTOR originZ = XMVectorReplicate(mOriginZ);
+    const XMVECTOR invSpacing = XMVectorReplicate(mInvSpacing);
+    const XMVECTOR maxU = XMVectorReplicate((float)mCellsX);
+    const XMVECTOR maxV = XMVectorReplicate((float)mCellsZ);
+    const XMVECTOR maxCellU = XMVectorReplicate((float)(mCellsX - 1));
+    const XMVECTOR maxCellV = XMVectorReplicate((float)(mCellsZ - 1));
+
+    UINT i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        // Two groups of four, interleaved so the corner loads of one overlap
+        // the arithmetic of the other.
+        XMVECTOR fu[2], fv[2];
+        XMUINT4 cu[2], cv[2];
+        for (int g = 0; g < 2; ++g)
+        {
+            XMVECTOR u = XMVectorMultiply(XMVectorSubtract(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(x + i + 4 * g)), originX), invSpacing);
+            XMVECTOR v = XMVectorMultiply(XMVectorSubtract(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(z + i + 4 * g)), originZ), invSpacing);
+            u = XMVectorClamp(u, zero, maxU);
+            v = XMVectorClamp(v, zero, maxV);
+            XMVECTOR cellU = XMVectorMin(XMVectorFloor(u), maxCellU);
+            XMVECTOR cellV = XMVectorMin(XMVectorFloor(v), maxCellV);
+            fu[g] = XMVectorSubtract(u, cellU);
+            fv[g] = XMVectorSubtract(v, cellV);
+            XMStoreUInt4(&cu[g], XMConvertVectorFloatToUInt(cellU, 0));
+            XMStoreUInt4(&cv[g], XMConvertVectorFloatToUInt(cellV, 0));
+        }
+
+        XMFLOAT4 c00[2], c10[2], c01[2], c11[2];
+        for (int g = 0; g < 2; ++g)
+        {
+            const UINT* su = &cu[g].x;
+            const UINT* sv = &cv[g].x;
+            float* h00 = &c00[g].x;
+            float* h10 = &c10[g].x;
+            float* h01 = &c01[g].x;
+            float* h11 = &c11[g].x;
+            for (int k = 0; k < 4; ++k)
+            {
+                const float* p = Cell(su[k], sv[k]);
+                h00[k] = p[0];
+                h10[k] = p[1];
+                h01[k] = p[TileStride];
+                h11[k] = p[TileStride + 1];
+            }
+        }
+
+        for (int g = 0; g < 2; ++g)
+        {
+            const XMVECTOR h00 = XMLoadFloat4(&c00[g]);
+            const XMVECTOR h01 = XMLoadFloat4(&c01[g]);
+            const XMVECTOR dx0 = XMVectorSubtract(XMLoadFloat4(&c10[g]), h00);
+            const XMVECTOR dx1 = XMVectorSubtract(XMLoadFloat4(&c11[g]), h01);
+            const XMVECTOR h0 = XMVectorMultiplyAdd(fu[g], dx0, h00);
+            const XMVECTOR h1 = XMVectorMultiplyAdd(fu[g], dx1, h01);
+            const XMVECTOR dz = XMVectorSubtract(h1, h0);
+
+            XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(heights + i + 4 * g), XMVectorMultiplyAdd(fv[g], dz, h0));
+            if (Gradient)
+            {
+                const XMVECTOR gx = XMVectorMultiplyAdd(fv[g], XMVectorSubtract(dx1, dx0), dx0);
+                XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(dhdx + i + 4 * g), XMVectorMultiply(gx, invSpacing));
+                XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(dhdz + i + 4 * g), XMVectorMultiply(dz, invSpacing));
+            }
+        }
+    }
+
+    for (; i < count; ++i)
+        heights[i] = HeightAndGradient(x[i], z[i], Gradient ? &dhdx[i] : nullptr, Gradient ? &dhdz[i] : nullptr);
+}
+
+void HeightField::HeightBatch(const float* x, const float* z, float* heights, UINT count)const
+{
+    Batch<false>(x, z, heights, nullptr, nullptr, count);
+}
+
+void HeightField::HeightAndGradientBatch(const float* x, const float* z, float* heights, float* dhdx, float* dhdz, UINT count)const
+{
+    Batch<true>(x, z, heights, dhdx, dhdz, count);
+}
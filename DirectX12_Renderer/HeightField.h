@@ -0,0 +1,66 @@
+#pragma once
+
+#include "d3dUtil.h"
+#include <functional>
+
+class JobSystem;
+
+// A height function cached on a regular grid, for the placement, grounding
+// and collision queries that would otherwise evaluate it point by point.
+//   - Heights are bilinear between samples.  Gradients are those of the
+//     bilinear patch, so they are exact for the cached surface.
+//   - Samples are stored in tiles of TileSize x TileSize cells.  Each tile
+//     repeats the first row and column of its neighbours, so the four corners
+//     of any cell lie in one small block of memory instead of two rows of the
+//     whole field.
+//   - Queries outside the field are clamped to its border.
+//   - The batch functions take SoA coordinates and process eight points per
+//     iteration as two four-wide DirectXMath vectors.  Only the corner loads
+//     are scalar.  Results match the single point functions up to rounding.
+class HeightField
+{
+public:
+    static const UINT TileSize = 32;
+
+    typedef std::function<float(float x, float z)> HeightFunction;
+
+    // Samples height at (originX + i*spacing, originZ + j*spacing) for
+    // i < samplesX, j < samplesZ.  Tiles are filled in parallel when jobs is
+    // given.
+    void Build(float originX, float originZ, float spacing, UINT samplesX, UINT samplesZ,
+        const HeightFunction& height, JobSystem* jobs);
+
+    float Height(float x, float z)const;
+    float HeightAndGradient(float x, float z, float* dhdx, float* dhdz)const;
+
+    void HeightBatch(const float* x, const float* z, float* heights, UINT count)const;
+    void HeightAndGradientBatch(const float* x, const float* z, float* heights, float* dhdx, float* dhdz, UINT count)const;
+
+    UINT64 ByteSize()const { return mSamples.size() * sizeof(float); }
+
+private:
+    static const UINT TileStride = TileSize + 1;
+
+    // Sample (cx, cz); (cx+1, cz) follows it and (cx, cz+1) is TileStride on.
+    const float* Cell(UINT cx, UINT cz)const
+    {
+        const UINT tile = (cz / TileSize) * mTilesX + cx / TileSize;
+        return &mSamples[(size_t)tile * TileStride * TileStride + (cz % TileSize) * TileStride + cx % TileSize];
+    }
+
+    template<bool Gradient>
+    void Batch(const float* x, const float* z, float* heights, float* dhdx, float* dhdz, UINT count)const;
+
+private:
+    float mOriginX = 0.0f;
+    float mOriginZ = 0.0f;
+    float mSpacing = 1.0f;
+    float mInvSpacing = 1.0f;
+
+    UINT mCellsX = 0;
+    UINT mCellsZ = 0;
+    UINT mTilesX = 0;
+    UINT mTilesZ = 0;
+
+    std::vector<float> mSamples;
+};
@@ -0,0 +1,55 @@
+#include "InstanceBatcher.h"
+
+namespace
+{
+    // Orders items so that everything SameDraw considers equal ends up adjacent.
+    bool DrawLess(const RenderItem* a, const RenderItem* b)
+    {
+        if (a->Geo != b->Geo)
+            return a->Geo < b->Geo;
+        if (a->Mat != b->Mat)
+            return a->Mat < b->Mat;
+        if (a->IndexByteOffset != b->IndexByteOffset)
+            return a->IndexByteOffset < b->IndexByteOffset;
+        if (a->StartIndexLocation != b->StartIndexLocation)
+            return a->StartIndexLocation < b->StartIndexLocation;
+        if (a->BaseVertexLocation != b->BaseVertexLocation)
+            return a->BaseVertexLocation < b->BaseVertexLocation;
+        if (a->IndexCount != b->IndexCount)
+            return a->IndexCount < b->IndexCount;
+        if (a->PrimitiveType != b->PrimitiveType)
+            return a->PrimitiveType < b->PrimitiveType;
+        return a->IndexFormat < b->IndexFormat;
+    }
+}
+
+bool InstanceBatcher::SameDraw(const RenderItem& a, const RenderItem& b)
+{
+    return a.Geo == b.Geo && a.Mat == b.Mat &&
+        a.IndexCount == b.IndexCount && a.StartIndexLocation == b.StartIndexLocation &&
+        a.BaseVertexLocation == b.BaseVertexLocation && a.PrimitiveType == b.PrimitiveType &&
+        a.IndexFormat == b.IndexFormat && a.IndexByteOffset == b.IndexByteOffset;
+}
+
+void InstanceBatcher::Build(RenderItem* const* items, UINT itemCount)
+{
+    mInstances.assign(items, items + itemCount);
+    mBatches.clear();
+
+    std::sort(mInstances.begin(), mInstances.end(), DrawLess);
+
+    for (UINT i = 0; i < itemCount; )
+    {
+        InstanceBatch batch;
+        batch.Item = mInstances[i];
+        batch.FirstInstance = i;
+
+        UINT end = i + 1;
+        while (end < itemCount && SameDraw(*mInstances[end], *batch.Item))
+            ++end;
+
+        batch.InstanceCount = end - i;
+        mBatches.push_back(batch);
+        i = end;
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "Datatypes.h"
+
+// A run of render items that share geometry, material and draw arguments and
+// can therefore be issued as one DrawIndexedInstanced call.
+struct InstanceBatch
+{
+    // Representative item: geometry, material and draw arguments for the batch.
+    RenderItem* Item = nullptr;
+
+    // Range in InstanceBatcher::Instances().
+    UINT FirstInstance = 0;
+    UINT InstanceCount = 0;
+};
+
+// Groups the visible items by (Geo, Mat, submesh) each frame.  Batches with at
+// least MinInstanceCount items are drawn with the instanced pipeline from a
+// buffer of per-instance transforms; smaller ones keep using ObjectCB.
+class InstanceBatcher
+{
+public:
+    static const UINT MinInstanceCount = 2;
+
+    void Build(RenderItem* const* items, UINT itemCount);
+
+    const std::vector<InstanceBatch>& Batches()const { return mBatches; }
+    const std::vector<RenderItem*>& Instances()const { return mInstances; }
+
+    static bool SameDraw(const RenderItem& a, const RenderItem& b);
+
+private:
+    std::vector<InstanceBatch> mBatches;
+    std::vector<RenderItem*> mInstances;
+};
@@ -0,0 +1,312 @@
+#include "JobSystem.h"
+#include <cassert>
+
+namespace
+{
+    // The system and thread index of the calling thread.
+    thread_local JobSystem* tJobSystem = nullptr;
+    thread_local unsigned int tThreadIndex = 0;
+
+    // Failed steal rounds before an idle worker goes to sleep.
+    const int SpinRounds = 64;
+
+    std::uint32_t XorShift(std::uint32_t& state)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+}
+
+bool JobSystem::Deque::Push(Job* job)
+{
+    const std::int64_t b = mBottom.load(std::memory_order_relaxed);
+    const std::int64_t t = mTop.load(std::memory_order_acquire);
+    if (b - t >= Capacity)
+        return false;
+
+    mJobs[b & (Capacity - 1)].store(job, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    mBottom.store(b + 1, std::memory_order_relaxed);
+    return true;
+}
+
+Job* JobSystem::Deque::Pop()
+{
+    const std::int64_t b = mBottom.load(std::memory_order_relaxed) - 1;
+    mBottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::int64_t t = mTop.load(std::memory_order_relaxed);
+
+    if (t > b)
+    {
+        // Empty.
+        mBottom.store(b + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    Job* job = mJobs[b & (Capacity - 1)].load(std::memory_order_relaxed);
+    if (t == b)
+    {
+        // Last job: race thieves for it.
+        if (!mTop.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            job = nullptr;
+        mBottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+Job* JobSystem::Deque::Steal()
+{
+    std::int64_t t = mTop.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const std::int64_t b = mBottom.load(std::memory_order_acquire);
+    if (t >= b)
+        return nullptr;
+
+    Job* job = mJobs[t & (Capacity - 1)].load(std::memory_order_relaxed);
+    if (!mTop.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        return nullptr;
+    return job;
+}
+
+JobSystem::JobSystem(unsigned int workerCount)
+{
+    for (unsigned int i = 0; i <= workerCount; ++i)
+    {
+        auto state = std::make_unique<ThreadState>();
+        state->Pool.reset(new Job[MaxJobsPerThread]);
+        state->RandomState = 0x9E3779B9u * (i + 1);
+        mThreads.push_back(std::move(state));
+    }
+
+    tJobSystem = this;
+    tThreadIndex = 0;
+
+    for (unsigned int i = 1; i <= workerCount; ++i)
+        mWorkers.emplace_back(&JobSystem::WorkerMain, this, i);
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(mSleepMutex);
+        mQuit = true;
+    }
+    mWake.notify_all();
+
+    for (auto& t : mWorkers)
+        t.join();
+
+    if (tJobSystem == this)
+        tJobSystem = nullptr;
+}
+
+JobSystem::ThreadState& JobSystem::CurrentThread()
+{
+    assert(tJobSystem == this && "jobs may only be used from the job system's threads");
+    return *mThreads[tThreadIndex];
+}
+
+Job* JobSystem::Create(std::function<void()> task, Job* parent)
+{
+    ThreadState& self = CurrentThread();
+    Job* job = &self.Pool[self.PoolNext++ % MaxJobsPerThread];
+    assert(job->Unfinished.load() == 0 && "job ring wrapped onto a job that is still running");
+
+    job->Task = std::move(task);
+    job->Parent = parent;
+    job->Unfinished.store(1, std::memory_order_relaxed);
+    job->PendingDependencies.store(1, std::memory_order_relaxed);
+    job->DependentCount = 0;
+
+    if (parent != nullptr)
+        parent->Unfinished.fetch_add(1, std::memory_order_relaxed);
+
+    return job;
+}
+
+void JobSystem::AddDependency(Job* job, Job* dependency)
+{
+    assert(dependency->DependentCount < Job::MaxDependents);
+    job->PendingDependencies.fetch_add(1, std::memory_order_relaxed);
+    dependency->Dependents[dependency->DependentCount++] = job;
+}
+
+void JobSystem::Run(Job* job)
+{
+    if (job->PendingDependencies.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        Enqueue(job);
+}
+
+void JobSystem::Enqueue(Job* job)
+{
+    ThreadState& self = CurrentThread();
+    if (!self.Jobs.Push(job))
+    {
+        // Deque full: running inline keeps progress without unbounded growth.
+        Execute(job, self);
+        return;
+    }
+
+    mQueuedJobs.fetch_add(1);
+    if (mSleepingWorkers.load() > 0)
+    {
+        // Taking the lock orders this wake-up after a sleeper's final check.
+        { std::lock_guard<std::mutex> lock(mSleepMutex); }
+        mWake.notify_one();
+    }
+}
+
+Job* JobSystem::FindJob(ThreadState& self)
+{
+    Job* job = self.Jobs.Pop();
+    if (job == nullptr)
+    {
+        const unsigned int threadCount = (unsigned int)mThreads.size();
+        if (threadCount > 1)
+        {
+            // One pass over the other threads from a random starting victim.
+            const unsigned int start = XorShift(self.RandomState) % threadCount;
+            for (unsigned int i = 0; i < threadCount && job == nullptr; ++i)
+            {
+                ThreadState& victim = *mThreads[(start + i) % threadCount];
+                if (&victim != &self)
+                    job = victim.Jobs.Steal();
+            }
+            if (job != nullptr)
+                self.Counters.JobsStolen++;
+        }
+    }
+
+    if (job != nullptr)
+        mQueuedJobs.fetch_sub(1);
+    return job;
+}
+
+void JobSystem::Execute(Job* job, ThreadState& self)
+{
+    if (job->Task)
+        job->Task();
+    self.Counters.JobsExecuted++;
+    Finish(job);
+}
+
+void JobSystem::Finish(Job* job)
+{
+    if (job->Unfinished.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+
+    // Read everything needed before releasing anyone: once Unfinished is zero
+    // and the parent is told, the slot may be reused.
+    Job* parent = job->Parent;
+    const int dependentCount = job->DependentCount;
+    Job* dependents[Job::MaxDependents];
+    for (int i = 0; i < dependentCount; ++i)
+        dependents[i] = job->Dependents[i];
+
+    for (int i = 0; i < dependentCount; ++i)
+        Run(dependents[i]);
+
+    if (parent != nullptr)
+        Finish(parent);
+}
+
+void JobSystem::Wait(const Job* job)
+{
+    ThreadState& self = CurrentThread();
+    while (job->Unfinished.load(std::memory_order_acquire) > 0)
+    {
+        Job* next = FindJob(self);
+        if (next != nullptr)
+            Execute(next, self);
+        else
+            std::this_thread::yield();
+    }
+}
+
+void JobSystem::WorkerMain(unsigned int index)
+{
+    tJobSystem = this;
+    tThreadIndex = index;
+    ThreadState& self = *mThreads[index];
+
+    int idleRounds = 0;
+    while (!mQuit.load(std::memory_order_relaxed))
+    {
+        Job* job = FindJob(self);
+        if (job != nullptr)
+        {
+            Execute(job, self);
+            idleRounds = 0;
+            continue;
+        }
+
+        if (++idleRounds < SpinRounds)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mSleepMutex);
+        mSleepingWorkers.fetch_add(1);
+        mWake.wait(lock, [this]() { return mQueuedJobs.load() > 0 || mQuit.load(); });
+        mSleepingWorkers.fetch_sub(1);
+        idleRounds = 0;
+    }
+}
+
+void JobSystem::SpawnRange(Job* root, unsigned int first, unsigned int last, unsigned int grain,
+    const std::function<void(unsigned int, unsigned int)>* body)
+{
+    Job* job = Create([this, root, first, last, grain, body]()
+    {
+        // Hand the upper half to thieves and keep splitting the lower half.
+        unsigned int end = last;
+        while (end - first > grain)
+        {
+            const unsigned int mid = first + (end - first) / 2;
+            SpawnRange(root, mid, end, grain, body);
+            end = mid;
+        }
+        (*body)(first, end);
+    }, root);
+    Run(job);
+}
+
+void JobSystem::ParallelFor(unsigned int count, unsigned int grain, const std::function<void(unsigned int, unsigned int)>& body)
+{
+    if (count == 0)
+        return;
+    if (grain == 0)
+        grain = 1;
+
+    if (count <= grain || mThreads.size() == 1)
+    {
+        body(0, count);
+        return;
+    }
+
+    Job* root = Create(nullptr);
+    SpawnRange(root, 0, count, grain, &body);
+    Run(root);
+    Wait(root);
+}
+
+JobSystem::Stats JobSystem::GetStats()const
+{
+    Stats stats;
+    for (const auto& t : mThreads)
+    {
+        stats.JobsExecuted += t->Counters.JobsExecuted;
+        stats.JobsStolen += t->Counters.JobsStolen;
+    }
+    return stats;
+}
+
+void JobSystem::ResetStats()
+{
+    for (auto& t : mThreads)
+        t->Counters = Stats();
+}
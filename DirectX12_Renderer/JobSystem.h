@@ -0,0 +1,128 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A unit of work.  Jobs are handed out by JobSystem::Create and recycled from a
+// per-thread ring, so a pointer is only valid until the job (and everything
+// waiting on it) has finished.
+struct Job
+{
+    static const int MaxDependents = 8;
+
+    std::function<void()> Task;
+    Job* Parent = nullptr;
+
+    // The job itself plus its unfinished children; the job is done at zero.
+    std::atomic<int> Unfinished{ 0 };
+
+    // Dependencies not yet finished, plus one held until Run is called.
+    std::atomic<int> PendingDependencies{ 0 };
+
+    // Jobs that depend on this one; released when it is done.
+    int DependentCount = 0;
+    Job* Dependents[MaxDependents];
+};
+
+// Work-stealing job scheduler.
+//   - Every thread (the creating thread is thread 0) owns a fixed-size
+//     Chase-Lev deque.  Owners push and pop at the bottom, LIFO, which keeps
+//     the most recently split work hot in cache; idle threads steal the
+//     oldest, largest pieces from the top of a random victim.
+//   - A job counts as done once it and all of its children (jobs created with
+//     it as Parent) have run.  Wait helps out by running other jobs.
+//   - AddDependency(a, b) holds a back until b is done.
+//   - ParallelFor splits a range recursively down to a grain size.
+// Jobs may only be created, run and waited on from the threads of the system.
+class JobSystem
+{
+public:
+    static const unsigned int MaxJobsPerThread = 4096;
+
+    struct Stats
+    {
+        std::uint64_t JobsExecuted = 0;
+        std::uint64_t JobsStolen = 0;
+    };
+
+    // workerCount threads are started in addition to the calling thread.
+    explicit JobSystem(unsigned int workerCount);
+    JobSystem(const JobSystem& rhs) = delete;
+    JobSystem& operator=(const JobSystem& rhs) = delete;
+    ~JobSystem();
+
+    // Worker threads plus the creating thread.
+    unsigned int ThreadCount()const { return (unsigned int)mThreads.size(); }
+
+    // A job without a task only groups its children for Wait.
+    Job* Create(std::function<void()> task, Job* parent = nullptr);
+
+    // job will not start before dependency is done.  Both must be created but
+    // not yet Run.
+    void AddDependency(Job* job, Job* dependency);
+
+    void Run(Job* job);
+    void Wait(const Job* job);
+
+    // Calls body(first, last) over [0, count) in pieces of at most grain
+    // indices and returns when all of them have run.
+    void ParallelFor(unsigned int count, unsigned int grain, const std::function<void(unsigned int, unsigned int)>& body);
+
+    // Summed over all threads; only meaningful while no jobs are in flight.
+    Stats GetStats()const;
+    void ResetStats();
+
+private:
+    // Lock-free work-stealing deque (Chase & Lev 2005, with the C11 memory
+    // orderings of Le et al. 2013).  Fixed capacity; Push fails when full and
+    // the caller runs the job inline instead.
+    class Deque
+    {
+    public:
+        static const std::int64_t Capacity = 4096;
+
+        bool Push(Job* job);
+        Job* Pop();
+        Job* Steal();
+
+    private:
+        std::atomic<std::int64_t> mTop{ 0 };
+        std::atomic<std::int64_t> mBottom{ 0 };
+        std::atomic<Job*> mJobs[Capacity];
+    };
+
+    struct ThreadState
+    {
+        Deque Jobs;
+        std::unique_ptr<Job[]> Pool;
+        unsigned int PoolNext = 0;
+        std::uint32_t RandomState = 0;
+        Stats Counters;
+    };
+
+    ThreadState& CurrentThread();
+    Job* FindJob(ThreadState& self);
+    void Execute(Job* job, ThreadState& self);
+    void Finish(Job* job);
+    void Enqueue(Job* job);
+    void WorkerMain(unsigned int index);
+    void SpawnRange(Job* root, unsigned int first, unsigned int last, unsigned int grain,
+        const std::function<void(unsigned int, unsigned int)>* body);
+
+private:
+    std::vector<std::unique_ptr<ThreadState>> mThreads;
+    std::vector<std::thread> mWorkers;
+
+    // Queued jobs not yet picked up, used to put idle workers to sleep.
+    std::atomic<int> mQueuedJobs{ 0 };
+    std::atomic<int> mSleepingWorkers{ 0 };
+    std::atomic<bool> mQuit{ false };
+    std::mutex mSleepMutex;
+    std::condition_variable mWake;
+};
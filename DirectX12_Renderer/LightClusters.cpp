@@ -0,0 +1,248 @@
+#include "LightClusters.h"
+#include "JobSystem.h"
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+    // Groups of four lights per bounds job.
+    const UINT BoundsGrain = 64;
+
+    XMVECTOR SliceOf(FXMVECTOR z, FXMVECTOR scale, FXMVECTOR bias, GXMVECTOR maxSlice)
+    {
+        XMVECTOR s = XMVectorFloor(XMVectorMultiplyAdd(XMVectorLog2(z), scale, bias));
+        return XMVectorClamp(s, XMVectorZero(), maxSlice);
+    }
+
+    // Adds one to the lanes where mask is set.
+    XMVECTOR CountIf(FXMVECTOR count, FXMVECTOR mask)
+    {
+        return XMVectorAdd(count, XMVectorSelect(XMVectorZero(), XMVectorSplatOne(), mask));
+    }
+}
+
+void LightClusters::GetSliceParameters(float nearZ, float farZ, float* scale, float* bias)
+{
+    *scale = (float)Slices / std::log2(farZ / nearZ);
+    *bias = -std::log2(nearZ) * *scale;
+}
+
+void LightClusters::Build(const Light* lights, UINT lightCount, const Camera& camera, JobSystem* jobs)
+{
+    // Tile boundaries in NDC run x = -1 + 2i/TilesX left to right and
+    // y = 1 - 2j/TilesY top to bottom.  The plane through the eye and the
+    // boundary x = a is P00*x - a*z = 0, positive to the right of it.
+    const XMFLOAT4X4 proj = camera.GetProj4x4f();
+    for (UINT i = 0; i <= TilesX; ++i)
+    {
+        const float a = -1.0f + 2.0f * i / TilesX;
+        const float len = std::sqrt(proj._11 * proj._11 + a * a);
+        mPlaneX[i][0] = proj._11 / len;
+        mPlaneX[i][1] = -a / len;
+    }
+    for (UINT j = 0; j <= TilesY; ++j)
+    {
+        const float b = 1.0f - 2.0f * j / TilesY;
+        const float len = std::sqrt(proj._22 * proj._22 + b * b);
+        mPlaneY[j][0] = proj._22 / len;
+        mPlaneY[j][1] = -b / len;
+    }
+
+    auto forEach = [jobs](UINT count, UINT grain, const std::function<void(UINT, UINT)>& body)
+    {
+        if (jobs != nullptr)
+            jobs->ParallelFor(count, grain, body);
+        else
+            body(0, count);
+    };
+
+    mBounds.resize(lightCount);
+    forEach((lightCount + 3) / 4, BoundsGrain, [&](UINT first, UINT last)
+    {
+        const UINT end = last * 4 < lightCount ? last * 4 : lightCount;
+        ComputeBounds(lights, first * 4, end, camera);
+    });
+
+    mVisibleLights.clear();
+    mVisibleBounds.clear();
+    for (UINT i = 0; i < lightCount; ++i)
+    {
+        if (mBounds[i].Visible)
+        {
+            mVisibleLights.push_back(lights[i]);
+            mVisibleBounds.push_back(mBounds[i]);
+        }
+    }
+
+    mRanges.resize(ClusterCount);
+    forEach(Slices, 1, [this](UINT first, UINT last) { CountSlices(first, last); });
+
+    mStats = Stats();
+    mStats.VisibleLights = (UINT)mVisibleLights.size();
+    UINT offset = 0;
+    for (auto& range : mRanges)
+    {
+        range.Offset = offset;
+        offset += range.Count;
+        if (range.Count > mStats.MaxLightsPerCluster)
+            mStats.MaxLightsPerCluster = range.Count;
+    }
+    mStats.IndexCount = offset;
+
+    mIndices.resize(offset);
+    forEach(Slices, 1, [this](UINT first, UINT last) { FillSlices(first, last); });
+}
+
+void LightClusters::ComputeBounds(const Light* lights, UINT first, UINT last, const Camera& camera)
+{
+    const XMFLOAT4X4 view = camera.GetView4x4f();
+    float sliceScale, sliceBias;
+    GetSliceParameters(camera.GetNearZ(), camera.GetFarZ(), &sliceScale, &sliceBias);
+
+    const XMVECTOR zero = XMVectorZero();
+    const XMVECTOR nearZ = XMVectorReplicate(camera.GetNearZ());
+    const XMVECTOR farZ = XMVectorReplicate(camera.GetFarZ());
+    const XMVECTOR scale = XMVectorReplicate(sliceScale);
+    const XMVECTOR bias = XMVectorReplicate(sliceBias);
+    const XMVECTOR maxSlice = XMVectorReplicate((float)(Slices - 1));
+    const XMVECTOR maxTileX = XMVectorReplicate((float)(TilesX - 1));
+    const XMVECTOR maxTileY = XMVectorReplicate((float)(TilesY - 1));
+
+    for (UINT i = first; i < last; i += 4)
+    {
+        // Four lights in SoA form; a short last group repeats its final light.
+        const Light* l[4];
+        for (UINT k = 0; k < 4; ++k)
+            l[k] = &lights[i + k < last ? i + k : last - 1];
+
+        XMVECTOR px = XMVectorSet(l[0]->Position.x, l[1]->Position.x, l[2]->Position.x, l[3]->Position.x);
+        XMVECTOR py = XMVectorSet(l[0]->Position.y, l[1]->Position.y, l[2]->Position.y, l[3]->Position.y);
+        XMVECTOR pz = XMVectorSet(l[0]->Position.z, l[1]->Position.z, l[2]->Position.z, l[3]->Position.z);
+        XMVECTOR r = XMVectorSet(l[0]->FalloffEnd, l[1]->FalloffEnd, l[2]->FalloffEnd, l[3]->FalloffEnd);
+        XMVECTOR negR = XMVectorNegate(r);
+
+        // To view space (row vectors: v = p*View).
+        XMVECTOR vx = XMVectorMultiplyAdd(px, XMVectorReplicate(view._11), XMVectorMultiplyAdd(py, XMVectorReplicate(view._21),
+            XMVectorMultiplyAdd(pz, XMVectorReplicate(view._31), XMVectorReplicate(view._41))));
+        XMVECTOR vy = XMVectorMultiplyAdd(px, XMVectorReplicate(view._12), XMVectorMultiplyAdd(py, XMVectorReplicate(view._22),
+            XMVectorMultiplyAdd(pz, XMVectorReplicate(view._32), XMVectorReplicate(view._42))));
+        XMVECTOR vz = XMVectorMultiplyAdd(px, XMVectorReplicate(view._13), XMVectorMultiplyAdd(py, XMVectorReplicate(view._23),
+            XMVectorMultiplyAdd(pz, XMVectorReplicate(view._33), XMVectorReplicate(view._43))));
+
+        // Depth range, clipped to [near, far].
+        XMVECTOR zMin = XMVectorSubtract(vz, r);
+        XMVECTOR zMax = XMVectorAdd(vz, r);
+        XMVECTOR visible = XMVectorAndInt(XMVectorGreater(zMax, nearZ), XMVectorLess(zMin, farZ));
+        XMVECTOR minZ = SliceOf(XMVectorMax(zMin, nearZ), scale, bias, maxSlice);
+        XMVECTOR maxZ = SliceOf(XMVectorMin(zMax, farZ), scale, bias, maxSlice);
+
+        // Tile i is skipped on the left when the whole sphere is right of its
+        // right boundary i+1, and on the right when the sphere is left of its
+        // left boundary i.  The boundaries are ordered, so what remains is one
+        // contiguous run of tiles.  Rows count down from the top: row j is
+        // skipped above the sphere when the sphere is below its lower
+        // boundary j+1, and below it when the sphere is above its upper one.
+        XMVECTOR minX = zero, skippedRight = zero;
+        for (UINT b = 0; b <= TilesX; ++b)
+        {
+            XMVECTOR d = XMVectorMultiplyAdd(vx, XMVectorReplicate(mPlaneX[b][0]), XMVectorMultiply(vz, XMVectorReplicate(mPlaneX[b][1])));
+            if (b > 0)
+                minX = CountIf(minX, XMVectorGreaterOrEqual(d, r));
+            if (b < TilesX)
+                skippedRight = CountIf(skippedRight, XMVectorLessOrEqual(d, negR));
+        }
+        XMVECTOR maxX = XMVectorSubtract(maxTileX, skippedRight);
+
+        XMVECTOR minY = zero, skippedBelow = zero;
+        for (UINT b = 0; b <= TilesY; ++b)
+        {
+            XMVECTOR d = XMVectorMultiplyAdd(vy, XMVectorReplicate(mPlaneY[b][0]), XMVectorMultiply(vz, XMVectorReplicate(mPlaneY[b][1])));
+            if (b > 0)
+                minY = CountIf(minY, XMVectorLessOrEqual(d, negR));
+            if (b < TilesY)
+                skippedBelow = CountIf(skippedBelow, XMVectorGreaterOrEqual(d, r));
+        }
+        XMVECTOR maxY = XMVectorSubtract(maxTileY, skippedBelow);
+
+        // The planes only bound the part of the sphere in front of the eye;
+        // a sphere reaching behind it gets every tile.
+        XMVECTOR behind = XMVectorLessOrEqual(vz, r);
+        minX = XMVectorSelect(minX, zero, behind);
+        maxX = XMVectorSelect(maxX, maxTileX, behind);
+        minY = XMVectorSelect(minY, zero, behind);
+        maxY = XMVectorSelect(maxY, maxTileY, behind);
+
+        visible = XMVectorAndInt(visible, XMVectorLessOrEqual(minX, maxX));
+        visible = XMVectorAndInt(visible, XMVectorLessOrEqual(minY, maxY));
+
+        XMFLOAT4 x0, x1, y0, y1, z0, z1;
+        XMStoreFloat4(&x0, minX);
+        XMStoreFloat4(&x1, maxX);
+        XMStoreFloat4(&y0, minY);
+        XMStoreFloat4(&y1, maxY);
+        XMStoreFloat4(&z0, minZ);
+        XMStoreFloat4(&z1, maxZ);
+        XMUINT4 mask;
+        XMStoreUInt4(&mask, visible);
+
+        const float* fx0 = &x0.x; const float* fx1 = &x1.x;
+        const float* fy0 = &y0.x; const float* fy1 = &y1.x;
+        const float* fz0 = &z0.x; const float* fz1 = &z1.x;
+        const UINT* visibleMask = &mask.x;
+
+        for (UINT k = 0; k < 4 && i + k < last; ++k)
+        {
+            LightBounds& bounds = mBounds[i + k];
+            bounds.Visible = visibleMask[k] != 0;
+            bounds.MinX = (std::uint8_t)fx0[k];
+            bounds.MaxX = (std::uint8_t)(bounds.Visible ? fx1[k] : 0.0f);
+            bounds.MinY = (std::uint8_t)fy0[k];
+            bounds.MaxY = (std::uint8_t)(bounds.Visible ? fy1[k] : 0.0f);
+            bounds.MinZ = (std::uint8_t)fz0[k];
+            bounds.MaxZ = (std::uint8_t)fz1[k];
+        }
+    }
+}
+
+void LightClusters::CountSlices(UINT firstSlice, UINT lastSlice)
+{
+    for (UINT s = firstSlice; s < lastSlice; ++s)
+    {
+        ClusterRange* slice = &mRanges[s * TilesX * TilesY];
+        for (UINT c = 0; c < TilesX * TilesY; ++c)
+            slice[c].Count = 0;
+
+        for (const auto& b : mVisibleBounds)
+        {
+            if (s < b.MinZ || s > b.MaxZ)
+                continue;
+
+            for (UINT y = b.MinY; y <= b.MaxY; ++y)
+                for (UINT x = b.MinX; x <= b.MaxX; ++x)
+                    slice[y * TilesX + x].Count++;
+        }
+    }
+}
+
+void LightClusters::FillSlices(UINT firstSlice, UINT lastSlice)
+{
+    UINT cursor[TilesX * TilesY];
+    for (UINT s = firstSlice; s < lastSlice; ++s)
+    {
+        const ClusterRange* slice = &mRanges[s * TilesX * TilesY];
+        for (UINT c = 0; c < TilesX * TilesY; ++c)
+            cursor[c] = slice[c].Offset;
+
+        for (UINT i = 0; i < (UINT)mVisibleBounds.size(); ++i)
+        {
+            const LightBounds& b = mVisibleBounds[i];
+            if (s < b.MinZ || s > b.MaxZ)
+                continue;
+
+            for (UINT y = b.MinY; y <= b.MaxY; ++y)
+                for (UINT x = b.MinX; x <= b.MaxX; ++x)
+                    mIndices[cursor[y * TilesX + x]++] = i;
+        }
+    }
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "d3dUtil.h"
+#include "Camera.h"
+#include <cstdint>
+
+class JobSystem;
+
+// The lights of one cluster: Count entries of the index list starting at
+// Offset.  Same layout as the uint2 the pixel shader reads.
+struct ClusterRange
+{
+    UINT Offset = 0;
+    UINT Count = 0;
+};
+
+// Clustered forward lighting, binned on the CPU.
+//   - The view frustum is cut into TilesX x TilesY screen tiles and Slices
+//     depth slices, exponentially spaced between the near and far planes so
+//     clusters stay roughly cubic: slice = log2(z)*scale + bias.
+//   - Point and spot lights are bounded by the sphere of radius FalloffEnd
+//     (spot lights conservatively, cone included).  Each sphere is tested
+//     against the tile boundary planes through the eye, four lights at a time,
+//     which gives the box of clusters it can reach.
+//   - Binning is split over depth slices so every thread writes its own
+//     clusters; the per-cluster lists end up in one compact index list in
+//     light order, the same on every run no matter how the work was split.
+// Indices refer to VisibleLights(), the lights that touch at least one
+// cluster, so only those have to be uploaded.  The HLSL side is in
+// LightingUtil.hlsl; keep the grid sizes in sync.
+class LightClusters
+{
+public:
+    static const UINT TilesX = 16;
+    static const UINT TilesY = 9;
+    static const UINT Slices = 24;
+    static const UINT ClusterCount = TilesX * TilesY * Slices;
+
+    struct Stats
+    {
+        UINT VisibleLights = 0;
+        UINT IndexCount = 0;
+        UINT MaxLightsPerCluster = 0;
+    };
+
+    // Slice mapping for the pass constants: slice = log2(viewZ)*scale + bias.
+    static void GetSliceParameters(float nearZ, float farZ, float* scale, float* bias);
+
+    // Bins the world space lights for the camera, whose view matrix must be up
+    // to date.  The work is spread over jobs when given.
+    void Build(const Light* lights, UINT lightCount, const Camera& camera, JobSystem* jobs);
+
+    // Cluster (x, y, slice) is at (slice*TilesY + y)*TilesX + x; row 0 is the
+    // top of the screen.
+    const std::vector<ClusterRange>& Ranges()const { return mRanges; }
+    const std::vector<UINT>& Indices()const { return mIndices; }
+    const std::vector<Light>& VisibleLights()const { return mVisibleLights; }
+
+    const Stats& GetStats()const { return mStats; }
+
+private:
+    // Inclusive cluster box reached by a light.
+    struct LightBounds
+    {
+        std::uint8_t MinX, MaxX;
+        std::uint8_t MinY, MaxY;
+        std::uint8_t MinZ, MaxZ;
+        bool Visible;
+    };
+
+    void ComputeBounds(const Light* lights, UINT first, UINT last, const Camera& camera);
+    void CountSlices(UINT firstSlice, UINT lastSlice);
+    void FillSlices(UINT firstSlice, UINT lastSlice);
+
+private:
+    // Tile boundary planes through the eye, as (x, z) and (y, z) normals.
+    float mPlaneX[TilesX + 1][2];
+    float mPlaneY[TilesY + 1][2];
+
+    std::vector<LightBounds> mBounds;
+    std::vector<LightBounds> mVisibleBounds;
+    std::vector<Light> mVisibleLights;
+
+    std::vector<ClusterRange> mRanges;
+    std::vector<UINT> mIndices;
+    Stats mStats;
+};
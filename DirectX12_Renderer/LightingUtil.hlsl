@@ -6,6 +6,11 @@
 
 #define MaxLights 16
 
+// Clustered lighting grid; must match LightClusters on the CPU.
+#define CLUSTER_TILES_X 16
+#define CLUSTER_TILES_Y 9
+#define CLUSTER_SLICES 24
+
 struct Light
 {
     float3 Strength;
@@ -167,4 +172,29 @@ float4 ComputeLighting(Light gLights[MaxLights], Material mat,
     return float4(result, 0.0f);
 }
 
+//---------------------------------------------------------------------------------------
+// Evaluates a point or spot light from the clustered light list; lights with
+// SpotPower 0 are point lights.
+//---------------------------------------------------------------------------------------
+float3 ComputeClusteredLight(Light L, Material mat, float3 pos, float3 normal, float3 toEye)
+{
+    if(L.SpotPower > 0.0f)
+        return ComputeSpotLight(L, mat, pos, normal, toEye);
+
+    return ComputePointLight(L, mat, pos, normal, toEye);
+}
+
+//---------------------------------------------------------------------------------------
+// Finds the cluster of a pixel from its screen position and view space depth.
+// The depth slices are exponential: slice = log2(viewZ)*sliceScale + sliceBias.
+//---------------------------------------------------------------------------------------
+uint ComputeClusterIndex(float2 screenPos, float viewZ, float2 invRenderTargetSize,
+                         float sliceScale, float sliceBias)
+{
+    uint2 tile = uint2(screenPos * invRenderTargetSize * float2(CLUSTER_TILES_X, CLUSTER_TILES_Y));
+    tile = min(tile, uint2(CLUSTER_TILES_X - 1, CLUSTER_TILES_Y - 1));
+
+    uint slice = (uint)clamp(log2(viewZ) * sliceScale + sliceBias, 0.0f, CLUSTER_SLICES - 1.0f);
 
+    return (slice * CLUSTER_TILES_Y + tile.y) * CLUSTER_TILES_X + tile.x;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+
+// Bounded multi-producer multi-consumer FIFO (Vyukov's array queue).
+//   - Every cell carries a sequence number that says whose turn it is: a
+//     producer may fill cell i when its sequence equals the enqueue position,
+//     a consumer may empty it when it equals the position plus one.  A CAS on
+//     the position claims the cell, so neither side ever takes a lock.
+//   - TryPush fails when the queue is full and TryPop when it is empty; the
+//     caller decides whether to retry, drop or do something else.
+// Capacity must be a power of two.
+template<typename T>
+class LockFreeQueue
+{
+public:
+    explicit LockFreeQueue(size_t capacity)
+        : mCells(new Cell[capacity]), mMask(capacity - 1)
+    {
+        assert(capacity >= 2 && (capacity & (capacity - 1)) == 0);
+        for (size_t i = 0; i < capacity; ++i)
+            mCells[i].Sequence.store(i, std::memory_order_relaxed);
+    }
+
+    LockFreeQueue(const LockFreeQueue& rhs) = delete;
+    LockFreeQueue& operator=(const LockFreeQueue& rhs) = delete;
+
+    size_t Capacity()const { return mMask + 1; }
+
+    bool TryPush(const T& value)
+    {
+        size_t pos = mEnqueuePos.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell& cell = mCells[pos & mMask];
+            const size_t seq = cell.Sequence.load(std::memory_order_acquire);
+            const std::ptrdiff_t diff = (std::ptrdiff_t)seq - (std::ptrdiff_t)pos;
+            if (diff == 0)
+            {
+                if (mEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    cell.Value = value;
+                    cell.Sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                // The cell still holds the value from one lap ago.
+                return false;
+            }
+            else
+            {
+                pos = mEnqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool TryPop(T& value)
+    {
+        size_t pos = mDequeuePos.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell& cell = mCells[pos & mMask];
+            const size_t seq = cell.Sequence.load(std::memory_order_acquire);
+            const std::ptrdiff_t diff = (std::ptrdiff_t)seq - (std::ptrdiff_t)(pos + 1);
+            if (diff == 0)
+            {
+                if (mDequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    value = cell.Value;
+                    cell.Sequence.store(pos + mMask + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                // Nothing has been written to this cell since it was last emptied.
+                return false;
+            }
+            else
+            {
+                pos = mDequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> Sequence;
+        T Value;
+    };
+
+    static const size_t CacheLine = 64;
+
+    std::unique_ptr<Cell[]> mCells;
+    const size_t mMask;
+
+    // The two positions are written by different sides; keep them on
+    // separate cache lines.
+    char mPad0[CacheLine];
+    std::atomic<size_t> mEnqueuePos{ 0 };
+    char mPad1[CacheLine];
+    std::atomic<size_t> mDequeuePos{ 0 };
+    char mPad2[CacheLine];
+};
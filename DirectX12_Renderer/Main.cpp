@@ -1,4 +1,7 @@
 #include "Renderer.h"
+#include "Benchmark.h"
+#include "MeshImporter.h"
+#include "TextureCooker.h"
 
 // Main Entry Point
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
@@ -9,6 +12,48 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
     _CrtSetDbgFlag(_CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF);
 #endif
 
+    // Headless mode: "-benchmark [name]" runs the CPU benchmarks without a window.
+    std::string args = cmdLine != nullptr ? cmdLine : "";
+    if (args.compare(0, 10, "-benchmark") == 0)
+    {
+        size_t first = args.find_first_not_of(' ', 10);
+        return Benchmark::Run(first == std::string::npos ? "" : args.substr(first));
+    }
+
+    // Offline cooking: "-cook-mesh <in.fbx> <out.mesh>" bakes an FBX into the runtime mesh format.
+    if (args.compare(0, 10, "-cook-mesh") == 0)
+    {
+        std::istringstream tokens(args.substr(10));
+        std::string fbxFile, meshFile;
+        tokens >> fbxFile >> meshFile;
+        return MeshImporter::Cook(fbxFile, AnsiToWString(meshFile)) ? 0 : 1;
+    }
+
+    // "-cook-textures <dir> <outdir> [-hq] [-box] [-fast|-best]" converts a folder of PNG/JPEG maps into BC-compressed DDS.
+    if (args.compare(0, 14, "-cook-textures") == 0)
+    {
+        std::istringstream tokens(args.substr(14));
+        std::string directory, outDirectory, flag;
+        tokens >> directory >> outDirectory;
+
+        TextureCookOptions options;
+        while (tokens >> flag)
+        {
+            if (flag == "-hq")
+                options.HighQuality = true;
+            else if (flag == "-box")
+                options.Filter = MipFilter::Box;
+            else if (flag == "-fast")
+                options.Quality = BlockQuality::Fast;
+            else if (flag == "-best")
+                options.Quality = BlockQuality::High;
+        }
+
+        JobSystem jobs(std::max(1u, std::thread::hardware_concurrency()) - 1);
+        options.Jobs = &jobs;
+        return TextureCooker::CookDirectory(AnsiToWString(directory), AnsiToWString(outDirectory), options) ? 0 : 1;
+    }
+
     try
     {
         Renderer theApp(hInstance);
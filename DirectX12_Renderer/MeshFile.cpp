@@ -0,0 +1,186 @@
+#include "MeshFile.h"
+
+namespace
+{
+    std::uint64_t AlignSection(std::uint64_t offset)
+    {
+        const std::uint64_t a = MeshFormat::SectionAlignment;
+        return (offset + a - 1) & ~(a - 1);
+    }
+
+    // Written so that a corrupt offset cannot wrap around past fileSize.
+    bool SectionFits(std::uint64_t offset, std::uint64_t size, std::uint64_t fileSize)
+    {
+        return offset <= fileSize && size <= fileSize - offset;
+    }
+}
+
+void MeshAsset::PackIndices(std::vector<std::uint8_t>& indexData, std::vector<SubmeshGeometry>& packed)const
+{
+    indexData.clear();
+    packed = Submeshes;
+
+    for (SubmeshGeometry& sm : packed)
+    {
+        const std::uint32_t* first = Indices32.data() + sm.StartIndexLocation;
+        const std::uint32_t maxIndex = sm.IndexCount > 0 ? *std::max_element(first, first + sm.IndexCount) : 0;
+
+        // Narrow only when it is lossless.  0xFFFF is left out so the strip-cut
+        // value can never appear as a real index.
+        const bool narrow = maxIndex < 0xFFFF;
+        const UINT indexSize = narrow ? sizeof(std::uint16_t) : sizeof(std::uint32_t);
+
+        // Index buffer views must be aligned to the index size.
+        indexData.resize((indexData.size() + indexSize - 1) & ~(size_t)(indexSize - 1));
+
+        sm.IndexFormat = narrow ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+        sm.IndexByteOffset = (UINT)indexData.size();
+        sm.StartIndexLocation = 0;
+
+        indexData.resize(indexData.size() + (size_t)sm.IndexCount * indexSize);
+        std::uint8_t* dst = indexData.data() + sm.IndexByteOffset;
+        if (narrow)
+        {
+            std::uint16_t* dst16 = reinterpret_cast<std::uint16_t*>(dst);
+            for (UINT i = 0; i < sm.IndexCount; ++i)
+                dst16[i] = static_cast<std::uint16_t>(first[i]);
+        }
+        else if (sm.IndexCount > 0)
+        {
+            memcpy(dst, first, (size_t)sm.IndexCount * indexSize);
+        }
+    }
+}
+
+MeshFile::~MeshFile()
+{
+    Close();
+}
+
+bool MeshFile::Open(const std::wstring& filename)
+{
+    Close();
+
+    mFile = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (mFile == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(mFile, &size) || size.QuadPart < (LONGLONG)sizeof(MeshFormat::Header))
+    {
+        Close();
+        return false;
+    }
+    mSize = (std::uint64_t)size.QuadPart;
+
+    mMapping = CreateFileMappingW(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mMapping == nullptr)
+    {
+        Close();
+        return false;
+    }
+
+    mView = static_cast<const std::uint8_t*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+    if (mView == nullptr)
+    {
+        Close();
+        return false;
+    }
+
+    mHeader = reinterpret_cast<const MeshFormat::Header*>(mView);
+
+    // Reject stale or truncated files so a bad bake falls back to the FBX path.
+    const MeshFormat::Header& h = *mHeader;
+    if (h.Magic != MeshFormat::Magic || h.Version != MeshFormat::Version ||
+        h.VertexByteStride != sizeof(Vertex) ||
+        !SectionFits(h.VertexOffset, (std::uint64_t)h.VertexCount * h.VertexByteStride, mSize) ||
+        !SectionFits(h.IndexOffset, h.IndexBufferByteSize, mSize) ||
+        !SectionFits(h.SubmeshOffset, (std::uint64_t)h.SubmeshCount * sizeof(MeshFormat::Submesh), mSize))
+    {
+        Close();
+        return false;
+    }
+
+    // Names are read as C strings, and each submesh's vertex count is taken as
+    // the distance to the next base vertex, so both have to hold up as well.
+    std::int64_t prevBaseVertex = 0;
+    for (std::uint32_t i = 0; i < h.SubmeshCount; ++i)
+    {
+        const MeshFormat::Submesh& record = Submeshes()[i];
+        const SubmeshGeometry& sm = record.Geometry;
+        const UINT indexSize = sm.IndexFormat == DXGI_FORMAT_R32_UINT ? 4 : 2;
+        const bool terminated = memchr(record.Name, '\0', MeshFormat::MaxNameLength) != nullptr;
+        const std::int64_t baseVertex = sm.BaseVertexLocation;
+        if ((sm.IndexFormat != DXGI_FORMAT_R16_UINT && sm.IndexFormat != DXGI_FORMAT_R32_UINT) ||
+            sm.IndexByteOffset % indexSize != 0 ||
+            sm.IndexByteOffset + ((std::uint64_t)sm.StartIndexLocation + sm.IndexCount) * indexSize > h.IndexBufferByteSize ||
+            !terminated || baseVertex < prevBaseVertex || baseVertex > (std::int64_t)h.VertexCount)
+        {
+            Close();
+            return false;
+        }
+        prevBaseVertex = baseVertex;
+    }
+
+    return true;
+}
+
+void MeshFile::Close()
+{
+    if (mView != nullptr)
+        UnmapViewOfFile(mView);
+    if (mMapping != nullptr)
+        CloseHandle(mMapping);
+    if (mFile != INVALID_HANDLE_VALUE)
+        CloseHandle(mFile);
+
+    mView = nullptr;
+    mMapping = nullptr;
+    mFile = INVALID_HANDLE_VALUE;
+    mHeader = nullptr;
+    mSize = 0;
+}
+
+bool MeshFile::Write(const std::wstring& filename, const MeshAsset& asset)
+{
+    assert(asset.SubmeshNames.size() == asset.Submeshes.size());
+
+    std::vector<std::uint8_t> indexData;
+    std::vector<SubmeshGeometry> submeshes;
+    asset.PackIndices(indexData, submeshes);
+
+    MeshFormat::Header header = {};
+    header.Magic = MeshFormat::Magic;
+    header.Version = MeshFormat::Version;
+    header.VertexByteStride = sizeof(Vertex);
+    header.VertexCount = (std::uint32_t)asset.Vertices.size();
+    header.IndexBufferByteSize = (std::uint32_t)indexData.size();
+    header.SubmeshCount = (std::uint32_t)asset.Submeshes.size();
+
+    header.VertexOffset = AlignSection(sizeof(MeshFormat::Header));
+    header.IndexOffset = AlignSection(header.VertexOffset + asset.Vertices.size() * sizeof(Vertex));
+    header.SubmeshOffset = AlignSection(header.IndexOffset + indexData.size());
+    const std::uint64_t fileSize = header.SubmeshOffset + asset.Submeshes.size() * sizeof(MeshFormat::Submesh);
+
+    std::vector<std::uint8_t> blob((size_t)fileSize, 0);
+    memcpy(blob.data(), &header, sizeof(header));
+    if (!asset.Vertices.empty())
+        memcpy(blob.data() + header.VertexOffset, asset.Vertices.data(), asset.Vertices.size() * sizeof(Vertex));
+    if (!indexData.empty())
+        memcpy(blob.data() + header.IndexOffset, indexData.data(), indexData.size());
+
+    MeshFormat::Submesh* records = reinterpret_cast<MeshFormat::Submesh*>(blob.data() + header.SubmeshOffset);
+    for (size_t i = 0; i < submeshes.size(); ++i)
+    {
+        strncpy_s(records[i].Name, asset.SubmeshNames[i].c_str(), _TRUNCATE);
+        records[i].Geometry = submeshes[i];
+    }
+
+    std::ofstream fout(filename, std::ios::binary | std::ios::trunc);
+    if (!fout)
+        return false;
+
+    fout.write(reinterpret_cast<const char*>(blob.data()), blob.size());
+    return fout.good();
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "d3dUtil.h"
+#include "Datatypes.h"
+
+// CPU copy of a mesh as it comes out of the importer: one vertex buffer, one
+// index list and a table of named submeshes.  Indices are kept at 32 bits and
+// are relative to each submesh's BaseVertexLocation; PackIndices narrows them.
+struct MeshAsset
+{
+    std::vector<Vertex> Vertices;
+    std::vector<std::uint32_t> Indices32;
+
+    std::vector<std::string> SubmeshNames;
+    std::vector<SubmeshGeometry> Submeshes;
+
+    // Builds the GPU index buffer.  Each submesh gets 16-bit indices when its
+    // largest index fits and 32-bit indices otherwise; packed receives the
+    // submeshes with IndexFormat, IndexByteOffset and StartIndexLocation rebased.
+    void PackIndices(std::vector<std::uint8_t>& indexData, std::vector<SubmeshGeometry>& packed)const;
+};
+
+// On-disk layout of a baked mesh (*.mesh).  The file is memory mapped and the
+// vertex/index sections are handed to the GPU upload as-is, so every section
+// starts on a 16 byte boundary and the records mirror the runtime structs.
+namespace MeshFormat
+{
+    const std::uint32_t Magic = 0x4853454D; // "MESH"
+    const std::uint32_t Version = 4;
+    const std::uint32_t SectionAlignment = 16;
+    const std::uint32_t MaxNameLength = 64;
+
+    struct Header
+    {
+        std::uint32_t Magic;
+        std::uint32_t Version;
+        std::uint32_t VertexByteStride;
+        std::uint32_t VertexCount;
+        std::uint32_t IndexBufferByteSize; // Mixed 16/32-bit; see SubmeshGeometry::IndexFormat.
+        std::uint32_t SubmeshCount;
+        std::uint32_t Reserved0;
+        std::uint32_t Reserved1;
+        std::uint64_t VertexOffset;     // Byte offsets from the start of the file.
+        std::uint64_t IndexOffset;
+        std::uint64_t SubmeshOffset;
+    };
+
+    struct Submesh
+    {
+        char Name[MaxNameLength];
+        SubmeshGeometry Geometry;
+    };
+
+    static_assert(sizeof(Vertex) == 32, "Vertex layout changed; bump MeshFormat::Version");
+    static_assert(sizeof(SubmeshGeometry) == 44, "SubmeshGeometry layout changed; bump MeshFormat::Version");
+}
+
+// Read-only view of a baked mesh file.  Open maps the whole file with a single
+// MapViewOfFile; the pointers returned stay valid until Close or destruction.
+class MeshFile
+{
+public:
+    MeshFile() = default;
+    MeshFile(const MeshFile& rhs) = delete;
+    MeshFile& operator=(const MeshFile& rhs) = delete;
+    ~MeshFile();
+
+    // Maps filename and validates the header and section bounds.
+    bool Open(const std::wstring& filename);
+    void Close();
+
+    const MeshFormat::Header& GetHeader()const { return *mHeader; }
+
+    const void* Vertices()const { return mView + mHeader->VertexOffset; }
+    const void* Indices()const { return mView + mHeader->IndexOffset; }
+    const MeshFormat::Submesh* Submeshes()const
+    {
+        return reinterpret_cast<const MeshFormat::Submesh*>(mView + mHeader->SubmeshOffset);
+    }
+
+    UINT VertexBufferByteSize()const { return mHeader->VertexCount * mHeader->VertexByteStride; }
+    UINT IndexBufferByteSize()const { return mHeader->IndexBufferByteSize; }
+
+    // Serializes asset into the baked format.
+    static bool Write(const std::wstring& filename, const MeshAsset& asset);
+
+private:
+    HANDLE mFile = INVALID_HANDLE_VALUE;
+    HANDLE mMapping = nullptr;
+    const std::uint8_t* mView = nullptr;
+    std::uint64_t mSize = 0;
+    const MeshFormat::Header* mHeader = nullptr;
+};
@@ -0,0 +1,128 @@
+#include "MeshImporter.h"
+
+using namespace DirectX;
+
+bool MeshImporter::ImportFbx(const std::string& filename, MeshAsset& asset, bool optimize)
+{
+    FbxManager* fbxManager = FbxManager::Create();
+    FbxIOSettings* ios = FbxIOSettings::Create(fbxManager, IOSROOT);
+    fbxManager->SetIOSettings(ios);
+    FbxImporter* fbxImporter = FbxImporter::Create(fbxManager, "");
+    FbxScene* fbxScene = FbxScene::Create(fbxManager, "");
+
+    if (!fbxImporter->Initialize(filename.c_str(), -1, fbxManager->GetIOSettings()) ||
+        !fbxImporter->Import(fbxScene))
+    {
+        fbxImporter->Destroy();
+        fbxManager->Destroy();
+        return false;
+    }
+
+    fbxScene->GetGlobalSettings().SetAxisSystem(FbxAxisSystem::DirectX);
+
+    FbxGeometryConverter geometryConverter(fbxManager);
+    geometryConverter.Triangulate(fbxScene, true);
+
+    fbxImporter->Destroy();
+
+    asset = MeshAsset();
+
+    FbxNode* rootNode = fbxScene->GetRootNode();
+    for (int k = 0; k < rootNode->GetChildCount(); k++)
+    {
+        FbxNode* node = rootNode->GetChild(k);
+        FbxNodeAttribute* attribute = node->GetNodeAttribute();
+
+        if (attribute != nullptr && attribute->GetAttributeType() == FbxNodeAttribute::eMesh)
+        {
+            ImportMesh(node->GetMesh(), asset);
+        }
+    }
+
+    fbxManager->Destroy();
+
+    if (optimize)
+        MeshOptimizer::Optimize(asset);
+
+    return !asset.Submeshes.empty();
+}
+
+bool MeshImporter::Cook(const std::string& fbxFilename, const std::wstring& meshFilename)
+{
+    MeshAsset asset;
+    if (!ImportFbx(fbxFilename, asset))
+        return false;
+
+    return MeshFile::Write(meshFilename, asset);
+}
+
+void MeshImporter::ImportMesh(FbxMesh* mesh, MeshAsset& asset)
+{
+    SubmeshGeometry submesh;
+    submesh.StartIndexLocation = (UINT)asset.Indices32.size();
+    submesh.BaseVertexLocation = (INT)asset.Vertices.size();
+
+    if (mesh->GetElementNormalCount() == 0)
+        mesh->GenerateNormals();
+
+    FbxStringList uvSetNames;
+    mesh->GetUVSetNames(uvSetNames);
+    const char* uvSetName = uvSetNames.GetCount() > 0 ? uvSetNames.GetStringAt(0) : nullptr;
+
+    // Attributes are read per polygon vertex so UV seams and hard edges survive,
+    // then welded back down to unique vertices.  FBX is z-up so y and z are swapped.
+    const int polygonCount = mesh->GetPolygonCount();
+    FbxVector4* controlPoints = mesh->GetControlPoints();
+    VertexWelder<Vertex> welder((std::uint32_t)mesh->GetControlPointsCount());
+
+    // Swapping two axes mirrors the mesh, so the winding is flipped to stay clockwise.
+    // Indices stay 32-bit here; MeshAsset::PackIndices narrows them per submesh.
+    const int winding[3] = { 0, 2, 1 };
+    for (int i = 0; i < polygonCount; i++)
+    {
+        for (int k : winding)
+        {
+            const int controlPoint = mesh->GetPolygonVertex(i, k);
+
+            Vertex v = {};
+            v.Pos.x = static_cast<float>(controlPoints[controlPoint].mData[0]);
+            v.Pos.y = static_cast<float>(controlPoints[controlPoint].mData[2]);
+            v.Pos.z = static_cast<float>(controlPoints[controlPoint].mData[1]);
+
+            FbxVector4 normal;
+            if (mesh->GetPolygonVertexNormal(i, k, normal))
+            {
+                XMVECTOR n = XMVectorSet((float)normal.mData[0], (float)normal.mData[2], (float)normal.mData[1], 0.0f);
+                XMStoreFloat3(&v.Normal, XMVector3Normalize(n));
+            }
+
+            FbxVector2 uv;
+            bool unmapped = true;
+            if (uvSetName != nullptr && mesh->GetPolygonVertexUV(i, k, uvSetName, uv, unmapped) && !unmapped)
+            {
+                // FBX puts the uv origin at the bottom left, Direct3D at the top left.
+                v.Tex.x = static_cast<float>(uv.mData[0]);
+                v.Tex.y = 1.0f - static_cast<float>(uv.mData[1]);
+            }
+
+            asset.Indices32.push_back(welder.Add(v));
+        }
+    }
+
+    asset.Vertices.insert(asset.Vertices.end(), welder.Vertices().begin(), welder.Vertices().end());
+    submesh.IndexCount = polygonCount * 3;
+
+    if (welder.UniqueCount() > 0)
+    {
+        BoundingBox::CreateFromPoints(submesh.Bounds, welder.UniqueCount(),
+            &asset.Vertices[submesh.BaseVertexLocation].Pos, sizeof(Vertex));
+    }
+
+    std::ostringstream log;
+    log << mesh->GetName() << ": " << mesh->GetControlPointsCount() << " control points, "
+        << welder.AddedCount() << " polygon vertices welded to " << welder.UniqueCount() << "\n";
+    ::OutputDebugStringA(log.str().c_str());
+
+    asset.SubmeshNames.push_back(mesh->GetName());
+    asset.Submeshes.push_back(submesh);
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "MeshFile.h"
+#include "MeshOptimizer.h"
+#include "VertexWelder.h"
+#include <fbxsdk.h>
+
+// FBX -> MeshAsset conversion shared by the runtime fallback path in
+// Renderer::LoadCharacters and the offline cooker ("-cook-mesh in.fbx out.mesh").
+class MeshImporter
+{
+public:
+    // Imports every mesh node under the scene root as one submesh.  Unless
+    // optimize is false the result is run through MeshOptimizer before returning.
+    static bool ImportFbx(const std::string& filename, MeshAsset& asset, bool optimize = true);
+
+    // Imports an FBX file and writes it out as a baked mesh file.
+    static bool Cook(const std::string& fbxFilename, const std::wstring& meshFilename);
+
+private:
+    static void ImportMesh(FbxMesh* mesh, MeshAsset& asset);
+};
@@ -0,0 +1,319 @@
+#include "MeshOptimizer.h"
+#include <numeric>
+
+using namespace DirectX;
+
+namespace
+{
+    // Once a cluster's running ACMR drops below this, Tipsify closes it at the next
+    // fan boundary (a "soft" boundary).  Smaller clusters give the overdraw sort
+    // more freedom at the cost of a few extra cache misses at each boundary.
+    const float SoftBoundaryAcmr = 0.75f;
+
+    // Vertex -> triangle adjacency in CSR form, plus the number of not yet
+    // emitted triangles still using each vertex.
+    struct Adjacency
+    {
+        std::vector<UINT> Offsets;
+        std::vector<UINT> Triangles;
+        std::vector<UINT> Live;
+    };
+
+    void BuildAdjacency(const std::uint32_t* indices, UINT indexCount, UINT vertexCount, Adjacency& adj)
+    {
+        adj.Live.assign(vertexCount, 0);
+        for (UINT i = 0; i < indexCount; ++i)
+            adj.Live[indices[i]]++;
+
+        adj.Offsets.resize(vertexCount + 1);
+        adj.Offsets[0] = 0;
+        for (UINT v = 0; v < vertexCount; ++v)
+            adj.Offsets[v + 1] = adj.Offsets[v] + adj.Live[v];
+
+        adj.Triangles.resize(indexCount);
+        std::vector<UINT> fill(adj.Offsets.begin(), adj.Offsets.end() - 1);
+        for (UINT i = 0; i < indexCount; ++i)
+            adj.Triangles[fill[indices[i]]++] = i / 3;
+    }
+
+    XMVECTOR LoadPosition(const XMFLOAT3* positions, UINT stride, std::uint32_t v)
+    {
+        const std::uint8_t* base = reinterpret_cast<const std::uint8_t*>(positions);
+        return XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(base + (size_t)v * stride));
+    }
+}
+
+void MeshOptimizer::OptimizeVertexCache(std::uint32_t* indices, UINT indexCount, UINT vertexCount,
+    std::vector<UINT>* clusters)
+{
+    const UINT triangleCount = indexCount / 3;
+    if (clusters != nullptr)
+        clusters->assign(1, 0);
+    if (triangleCount == 0)
+        return;
+
+    Adjacency adj;
+    BuildAdjacency(indices, triangleCount * 3, vertexCount, adj);
+
+    // A vertex is in the FIFO cache while timestamp - cacheTime <= CacheSize.
+    std::vector<UINT> cacheTime(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<std::uint32_t> deadEnd;
+    std::vector<std::uint32_t> candidates;
+    std::vector<std::uint32_t> output;
+    deadEnd.reserve(triangleCount * 3);
+    output.reserve(triangleCount * 3);
+
+    UINT timestamp = CacheSize + 1;
+    UINT cursor = 0;
+    UINT clusterStart = 0;
+    UINT clusterMisses = 0;
+
+    // Pops the dead-end stack for a vertex that still has work, then falls back
+    // to a linear scan.  Either way the new fan starts a hard cluster boundary.
+    auto skipDeadEnd = [&]() -> int
+    {
+        while (!deadEnd.empty())
+        {
+            std::uint32_t d = deadEnd.back();
+            deadEnd.pop_back();
+            if (adj.Live[d] > 0)
+                return (int)d;
+        }
+        for (; cursor < vertexCount; ++cursor)
+        {
+            if (adj.Live[cursor] > 0)
+                return (int)cursor;
+        }
+        return -1;
+    };
+
+    bool hardBoundary = true;
+    int fan = skipDeadEnd();
+    while (fan >= 0)
+    {
+        const UINT emittedTriangles = (UINT)output.size() / 3;
+        if (clusters != nullptr && emittedTriangles > clusterStart &&
+            (hardBoundary || (float)clusterMisses / (emittedTriangles - clusterStart) < SoftBoundaryAcmr))
+        {
+            clusters->push_back(emittedTriangles);
+            clusterStart = emittedTriangles;
+            clusterMisses = 0;
+        }
+
+        // Emit every remaining triangle around the fanning vertex.
+        candidates.clear();
+        for (UINT a = adj.Offsets[fan]; a < adj.Offsets[fan + 1]; ++a)
+        {
+            const UINT t = adj.Triangles[a];
+            if (emitted[t])
+                continue;
+
+            for (UINT k = 0; k < 3; ++k)
+            {
+                const std::uint32_t v = indices[t * 3 + k];
+                output.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                adj.Live[v]--;
+
+                if (timestamp - cacheTime[v] > CacheSize)
+                {
+                    cacheTime[v] = timestamp++;
+                    ++clusterMisses;
+                }
+            }
+            emitted[t] = true;
+        }
+
+        // Next fan: the oldest candidate that will still be in the cache after
+        // its remaining triangles are emitted.
+        int best = -1;
+        int bestPriority = -1;
+        for (std::uint32_t v : candidates)
+        {
+            if (adj.Live[v] == 0)
+                continue;
+
+            int priority = 0;
+            if (timestamp - cacheTime[v] + 2 * adj.Live[v] <= CacheSize)
+                priority = (int)(timestamp - cacheTime[v]);
+
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                best = (int)v;
+            }
+        }
+
+        hardBoundary = best < 0;
+        fan = hardBoundary ? skipDeadEnd() : best;
+    }
+
+    std::copy(output.begin(), output.end(), indices);
+}
+
+void MeshOptimizer::OptimizeOverdraw(std::uint32_t* indices, UINT indexCount,
+    const XMFLOAT3* positions, UINT positionStride, const std::vector<UINT>& clusters)
+{
+    const UINT triangleCount = indexCount / 3;
+    const UINT clusterCount = (UINT)clusters.size();
+    if (clusterCount <= 1)
+        return;
+
+    // Area-weighted centroid and summed face normal of every cluster.
+    std::vector<XMFLOAT3> centroids(clusterCount);
+    std::vector<XMFLOAT3> normals(clusterCount);
+    XMVECTOR meshCentroid = XMVectorZero();
+    float meshArea = 0.0f;
+
+    for (UINT c = 0; c < clusterCount; ++c)
+    {
+        const UINT first = clusters[c];
+        const UINT last = c + 1 < clusterCount ? clusters[c + 1] : triangleCount;
+
+        XMVECTOR centroid = XMVectorZero();
+        XMVECTOR normal = XMVectorZero();
+        float area = 0.0f;
+        for (UINT t = first; t < last; ++t)
+        {
+            XMVECTOR p0 = LoadPosition(positions, positionStride, indices[t * 3 + 0]);
+            XMVECTOR p1 = LoadPosition(positions, positionStride, indices[t * 3 + 1]);
+            XMVECTOR p2 = LoadPosition(positions, positionStride, indices[t * 3 + 2]);
+
+            XMVECTOR n = XMVector3Cross(p1 - p0, p2 - p0);
+            float a = 0.5f * XMVectorGetX(XMVector3Length(n));
+
+            centroid += (p0 + p1 + p2) * (a / 3.0f);
+            normal += n;
+            area += a;
+        }
+
+        meshCentroid += centroid;
+        meshArea += area;
+
+        XMStoreFloat3(&centroids[c], area > 0.0f ? centroid / area : XMVectorZero());
+        XMStoreFloat3(&normals[c], XMVector3Normalize(normal));
+    }
+
+    if (meshArea > 0.0f)
+        meshCentroid /= meshArea;
+
+    // Clusters far out along their own normal are likely to occlude the rest,
+    // so they are drawn first.
+    std::vector<float> sortKey(clusterCount);
+    for (UINT c = 0; c < clusterCount; ++c)
+    {
+        XMVECTOR offset = XMLoadFloat3(&centroids[c]) - meshCentroid;
+        sortKey[c] = XMVectorGetX(XMVector3Dot(offset, XMLoadFloat3(&normals[c])));
+    }
+
+    std::vector<UINT> order(clusterCount);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](UINT a, UINT b) { return sortKey[a] > sortKey[b]; });
+
+    std::vector<std::uint32_t> output;
+    output.reserve(triangleCount * 3);
+    for (UINT c : order)
+    {
+        const UINT first = clusters[c];
+        const UINT last = c + 1 < clusterCount ? clusters[c + 1] : triangleCount;
+        output.insert(output.end(), indices + first * 3, indices + last * 3);
+    }
+
+    std::copy(output.begin(), output.end(), indices);
+}
+
+void MeshOptimizer::OptimizeVertexFetch(std::uint32_t* indices, UINT indexCount, UINT vertexCount,
+    std::vector<std::uint32_t>& remap)
+{
+    const std::uint32_t unused = 0xFFFFFFFF;
+    remap.assign(vertexCount, unused);
+
+    std::uint32_t next = 0;
+    for (UINT i = 0; i < indexCount; ++i)
+    {
+        std::uint32_t& r = remap[indices[i]];
+        if (r == unused)
+            r = next++;
+        indices[i] = r;
+    }
+
+    for (UINT v = 0; v < vertexCount; ++v)
+    {
+        if (remap[v] == unused)
+            remap[v] = next++;
+    }
+}
+
+VertexCacheStats MeshOptimizer::AnalyzeVertexCache(const std::uint32_t* indices, UINT indexCount, UINT vertexCount,
+    UINT cacheSize)
+{
+    VertexCacheStats stats;
+    stats.TriangleCount = indexCount / 3;
+
+    std::vector<UINT> cacheTime(vertexCount, 0);
+    std::vector<bool> referenced(vertexCount, false);
+    UINT timestamp = cacheSize + 1;
+
+    for (UINT i = 0; i < stats.TriangleCount * 3; ++i)
+    {
+        const std::uint32_t v = indices[i];
+        if (timestamp - cacheTime[v] > cacheSize)
+        {
+            cacheTime[v] = timestamp++;
+            stats.TransformedVertexCount++;
+        }
+        if (!referenced[v])
+        {
+            referenced[v] = true;
+            stats.VertexCount++;
+        }
+    }
+
+    if (stats.TriangleCount > 0)
+        stats.ACMR = (float)stats.TransformedVertexCount / stats.TriangleCount;
+    if (stats.VertexCount > 0)
+        stats.ATVR = (float)stats.TransformedVertexCount / stats.VertexCount;
+
+    return stats;
+}
+
+void MeshOptimizer::OptimizeRange(std::uint32_t* indices, UINT indexCount, UINT vertexCount,
+    const XMFLOAT3* positions, UINT positionStride, std::vector<std::uint32_t>& remap)
+{
+    std::vector<UINT> clusters;
+    OptimizeVertexCache(indices, indexCount, vertexCount, &clusters);
+    OptimizeOverdraw(indices, indexCount, positions, positionStride, clusters);
+    OptimizeVertexFetch(indices, indexCount, vertexCount, remap);
+}
+
+void MeshOptimizer::Optimize(GeometryGenerator::MeshData& mesh)
+{
+    if (mesh.Vertices.empty() || mesh.Indices32.empty())
+        return;
+
+    std::vector<std::uint32_t> remap;
+    OptimizeRange(mesh.Indices32.data(), (UINT)mesh.Indices32.size(), (UINT)mesh.Vertices.size(),
+        &mesh.Vertices[0].Position, sizeof(GeometryGenerator::Vertex), remap);
+    RemapVertices(mesh.Vertices.data(), (UINT)mesh.Vertices.size(), remap);
+}
+
+void MeshOptimizer::Optimize(MeshAsset& asset)
+{
+    std::vector<std::uint32_t> remap;
+    for (size_t i = 0; i < asset.Submeshes.size(); ++i)
+    {
+        const SubmeshGeometry& sm = asset.Submeshes[i];
+        const UINT vertexEnd = i + 1 < asset.Submeshes.size() ?
+            (UINT)asset.Submeshes[i + 1].BaseVertexLocation : (UINT)asset.Vertices.size();
+        const UINT vertexCount = vertexEnd - sm.BaseVertexLocation;
+        if (vertexCount == 0 || sm.IndexCount == 0)
+            continue;
+
+        Vertex* vertices = &asset.Vertices[sm.BaseVertexLocation];
+        OptimizeRange(&asset.Indices32[sm.StartIndexLocation], sm.IndexCount, vertexCount,
+            &vertices->Pos, sizeof(Vertex), remap);
+        RemapVertices(vertices, vertexCount, remap);
+    }
+}
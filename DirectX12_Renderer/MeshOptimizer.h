@@ -0,0 +1,63 @@
+#pragma once
+
+#include "GeometryGenerator.h"
+#include "MeshFile.h"
+
+// Post-transform cache statistics from a FIFO cache simulation.
+//   ACMR: vertex shader invocations per triangle (0.5 is ideal for large grids, 3 is worst).
+//   ATVR: vertex shader invocations per referenced vertex (1 is ideal).
+struct VertexCacheStats
+{
+    UINT TriangleCount = 0;
+    UINT VertexCount = 0;
+    UINT TransformedVertexCount = 0;
+    float ACMR = 0.0f;
+    float ATVR = 0.0f;
+};
+
+// Offline index/vertex reordering run on meshes before upload:
+//   1. OptimizeVertexCache - Tipsify triangle order (Sander et al. 2007) for a FIFO
+//      post-transform cache, also returning the cluster boundaries it produced.
+//   2. OptimizeOverdraw    - sorts those clusters so outward-facing ones draw first.
+//   3. OptimizeVertexFetch - renumbers vertices in first-use order so vertex fetch
+//      walks the vertex buffer linearly.
+// All indices are 32-bit and relative to the start of the vertex range passed in.
+class MeshOptimizer
+{
+public:
+    static const UINT CacheSize = 16;
+
+    static void OptimizeVertexCache(std::uint32_t* indices, UINT indexCount, UINT vertexCount,
+        std::vector<UINT>* clusters = nullptr);
+
+    // positions points at the first vertex's position; positionStride is the vertex size.
+    static void OptimizeOverdraw(std::uint32_t* indices, UINT indexCount,
+        const DirectX::XMFLOAT3* positions, UINT positionStride, const std::vector<UINT>& clusters);
+
+    // Rewrites indices and fills remap[old] = new.  Unreferenced vertices keep
+    // their relative order after the referenced ones so the vertex count is unchanged.
+    static void OptimizeVertexFetch(std::uint32_t* indices, UINT indexCount, UINT vertexCount,
+        std::vector<std::uint32_t>& remap);
+
+    template<typename T>
+    static void RemapVertices(T* vertices, UINT vertexCount, const std::vector<std::uint32_t>& remap)
+    {
+        std::vector<T> copy(vertices, vertices + vertexCount);
+        for (UINT i = 0; i < vertexCount; ++i)
+            vertices[remap[i]] = copy[i];
+    }
+
+    static VertexCacheStats AnalyzeVertexCache(const std::uint32_t* indices, UINT indexCount, UINT vertexCount,
+        UINT cacheSize = CacheSize);
+
+    // Full pipeline on a generated mesh.
+    static void Optimize(GeometryGenerator::MeshData& mesh);
+
+    // Full pipeline on every submesh of an imported mesh.  Submeshes must be stored
+    // in vertex order, each owning [BaseVertexLocation, next BaseVertexLocation).
+    static void Optimize(MeshAsset& asset);
+
+private:
+    static void OptimizeRange(std::uint32_t* indices, UINT indexCount, UINT vertexCount,
+        const DirectX::XMFLOAT3* positions, UINT positionStride, std::vector<std::uint32_t>& remap);
+};
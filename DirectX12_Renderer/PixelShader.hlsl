@@ -17,20 +17,23 @@
 Texture2D gDiffuseMap : register(t0);
 SamplerState gsamLinear : register(s0);
 
+// Point and spot lights binned into clusters on the CPU: each cluster has an
+// (offset, count) range into the index list, whose entries index the lights.
+StructuredBuffer<Light> gClusterLights : register(t1, space1);
+StructuredBuffer<uint2> gClusterRanges : register(t2, space1);
+StructuredBuffer<uint> gClusterLightIndices : register(t3, space1);
+
+// World is the transposed 3x4 affine part of the world matrix and
+// TexTransform the first two columns of the texture transform.
 cbuffer cbPerObject : register(b0)
 {
-    float4x4 gWorld;
-    float4x4 gTexTransform;
+    float4 gWorld[3];
+    float4 gTexTransform[2];
 };
 
 cbuffer cbPass : register(b1)
 {
-    float4x4 gView;
-    float4x4 gInvView;
-    float4x4 gProj;
-    float4x4 gInvProj;
     float4x4 gViewProj;
-    float4x4 gInvViewProj;
     float3 gEyePosW;
     float cbPerObjectPad1;
     float2 gRenderTargetSize;
@@ -39,8 +42,9 @@ cbuffer cbPass : register(b1)
     float gFarZ;
     float gTotalTime;
     float gDeltaTime;
-    float4 gAmbientLight;
-    Light gLights[MaxLights];
+    float gClusterSliceScale;
+    float gClusterSliceBias;
+    float2 cbPassPad2;
 };
 
 cbuffer cbMaterial : register(b2)
@@ -51,6 +55,12 @@ cbuffer cbMaterial : register(b2)
     float4x4 gMatTransform;
 };
 
+cbuffer cbLights : register(b3)
+{
+    float4 gAmbientLight;
+    Light gLights[MaxLights];
+};
+
 struct VS_OUTPUT
 {
     float4 pos : SV_POSITION;
@@ -75,6 +85,18 @@ float4 PS(VS_OUTPUT input) : SV_TARGET
     float4 directLight = ComputeLighting(gLights, mat, input.worldpos,
         input.normal, toEyeW, shadowFactor);
 
+    // Linear view depth from the perspective depth buffer value.
+    float viewZ = gNearZ * gFarZ / (gFarZ - input.pos.z * (gFarZ - gNearZ));
+    uint cluster = ComputeClusterIndex(input.pos.xy, viewZ, gInvRenderTargetSize,
+        gClusterSliceScale, gClusterSliceBias);
+
+    uint2 range = gClusterRanges[cluster];
+    for(uint i = 0; i < range.y; ++i)
+    {
+        Light L = gClusterLights[gClusterLightIndices[range.x + i]];
+        directLight.rgb += ComputeClusteredLight(L, mat, input.worldpos, input.normal, toEyeW);
+    }
+
     float4 litColor = ambient + directLight;
 
     litColor.a = diffuseAlbedo.a;
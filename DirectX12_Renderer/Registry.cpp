@@ -0,0 +1,52 @@
+#include "Registry.h"
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+namespace
+{
+    struct NameTable
+    {
+        std::mutex Mutex;
+        std::unordered_map<std::string, NameId> Ids;
+
+        // A deque so String can hand out references that stay valid.
+        std::deque<std::string> Strings;
+    };
+
+    NameTable& Table()
+    {
+        static NameTable table;
+        return table;
+    }
+}
+
+NameId Names::Intern(const std::string& name)
+{
+    NameTable& table = Table();
+    std::lock_guard<std::mutex> lock(table.Mutex);
+
+    auto it = table.Ids.find(name);
+    if (it != table.Ids.end())
+        return it->second;
+
+    const NameId id = (NameId)table.Strings.size();
+    table.Strings.push_back(name);
+    table.Ids.emplace(name, id);
+    return id;
+}
+
+const std::string& Names::String(NameId id)
+{
+    NameTable& table = Table();
+    std::lock_guard<std::mutex> lock(table.Mutex);
+    assert(id < table.Strings.size());
+    return table.Strings[id];
+}
+
+std::uint32_t Names::Count()
+{
+    NameTable& table = Table();
+    std::lock_guard<std::mutex> lock(table.Mutex);
+    return (std::uint32_t)table.Strings.size();
+}
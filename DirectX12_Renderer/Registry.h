@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Interned names.  A string is hashed once, when it is interned; after that
+// it is a dense integer id that compares, indexes and copies for free.  Ids
+// are process-wide and never reused, so they can be cached in statics.
+typedef std::uint32_t NameId;
+
+namespace Names
+{
+    const NameId Invalid = 0xFFFFFFFF;
+
+    // Thread safe.  Meant for load and setup code, not per-frame lookups.
+    NameId Intern(const std::string& name);
+
+    // The string an id was interned from.
+    const std::string& String(NameId id);
+
+    // Ids handed out so far; every id is below this.
+    std::uint32_t Count();
+}
+
+// Reference to an entry of a Registry<T>.  The generation is bumped every time
+// a slot is freed, so a handle to a removed entry is detected instead of
+// silently resolving to whatever was added in its place.
+template<typename T>
+struct Handle
+{
+    static const std::uint32_t InvalidIndex = 0xFFFFFFFF;
+
+    std::uint32_t Index = InvalidIndex;
+    std::uint32_t Generation = 0;
+
+    bool IsValid()const { return Index != InvalidIndex; }
+    bool operator==(const Handle& rhs)const { return Index == rhs.Index && Generation == rhs.Generation; }
+    bool operator!=(const Handle& rhs)const { return !(*this == rhs); }
+};
+
+template<typename T>
+const std::uint32_t Handle<T>::InvalidIndex;
+
+// Owns named objects in dense slots.
+//   - Get is an array index and a generation compare.
+//   - Find maps an interned name to its handle through an array indexed by
+//     NameId, so no string is hashed or compared.
+//   - Removed slots are reused by later Adds with the next generation.
+// Slot indices are stable for the life of an entry and below SlotCount(),
+// so they also serve as dense indices (GeoIndex, MatCBIndex).
+template<typename T>
+class Registry
+{
+public:
+    Handle<T> Add(NameId name, std::unique_ptr<T> item)
+    {
+        assert(!Find(name).IsValid() && "name already registered");
+
+        std::uint32_t index;
+        if (!mFree.empty())
+        {
+            index = mFree.back();
+            mFree.pop_back();
+        }
+        else
+        {
+            index = (std::uint32_t)mSlots.size();
+            mSlots.emplace_back();
+        }
+
+        Slot& slot = mSlots[index];
+        slot.Item = std::move(item);
+        slot.Name = name;
+
+        if (name >= mByName.size())
+            mByName.resize(name + 1, Handle<T>::InvalidIndex);
+        mByName[name] = index;
+        mCount++;
+
+        Handle<T> handle;
+        handle.Index = index;
+        handle.Generation = slot.Generation;
+        return handle;
+    }
+
+    void Remove(Handle<T> handle)
+    {
+        assert(Get(handle) != nullptr);
+
+        Slot& slot = mSlots[handle.Index];
+        mByName[slot.Name] = Handle<T>::InvalidIndex;
+        slot.Item.reset();
+        slot.Name = Names::Invalid;
+        slot.Generation++;
+        mFree.push_back(handle.Index);
+        mCount--;
+    }
+
+    // nullptr for an invalid or stale handle.
+    T* Get(Handle<T> handle)const
+    {
+        if (handle.Index >= mSlots.size() || mSlots[handle.Index].Generation != handle.Generation)
+            return nullptr;
+        return mSlots[handle.Index].Item.get();
+    }
+
+    Handle<T> Find(NameId name)const
+    {
+        Handle<T> handle;
+        if (name < mByName.size() && mByName[name] != Handle<T>::InvalidIndex)
+        {
+            handle.Index = mByName[name];
+            handle.Generation = mSlots[handle.Index].Generation;
+        }
+        return handle;
+    }
+
+    // Entries in use.
+    std::uint32_t Size()const { return mCount; }
+
+    // Slot i's entry, or nullptr for a free slot; for walking every entry.
+    std::uint32_t SlotCount()const { return (std::uint32_t)mSlots.size(); }
+    T* At(std::uint32_t index)const { return mSlots[index].Item.get(); }
+
+private:
+    struct Slot
+    {
+        std::unique_ptr<T> Item;
+        NameId Name = Names::Invalid;
+        std::uint32_t Generation = 0;
+    };
+
+    std::vector<Slot> mSlots;
+    std::vector<std::uint32_t> mFree;
+    std::vector<std::uint32_t> mByName;
+    std::uint32_t mCount = 0;
+};
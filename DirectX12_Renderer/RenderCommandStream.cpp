@@ -0,0 +1,230 @@
+#include "RenderCommandStream.h"
+#include <cstring>
+#include <type_traits>
+
+namespace
+{
+    enum Op : std::uint32_t
+    {
+        OpSetRootSignature,
+        OpSetDescriptorHeap,
+        OpSetViewport,
+        OpSetRenderTarget,
+        OpClearRenderTarget,
+        OpClearDepthStencil,
+        OpTransition,
+        OpSetPipelineState,
+        OpSetVertexBuffer,
+        OpSetIndexBuffer,
+        OpSetPrimitiveTopology,
+        OpSetDescriptorTable,
+        OpSetConstantBufferView,
+        OpSetShaderResourceView,
+        OpDrawIndexedInstanced
+    };
+
+    struct ViewportArgs { D3D12_VIEWPORT Viewport; D3D12_RECT ScissorRect; };
+    struct RenderTargetArgs { D3D12_CPU_DESCRIPTOR_HANDLE Rtv; D3D12_CPU_DESCRIPTOR_HANDLE Dsv; };
+    struct ClearRenderTargetArgs { D3D12_CPU_DESCRIPTOR_HANDLE Rtv; FLOAT Color[4]; };
+    struct ClearDepthStencilArgs { D3D12_CPU_DESCRIPTOR_HANDLE Dsv; FLOAT Depth; UINT8 Stencil; };
+    struct TransitionArgs { ID3D12Resource* Resource; D3D12_RESOURCE_STATES Before; D3D12_RESOURCE_STATES After; };
+    struct RootTableArgs { UINT RootIndex; D3D12_GPU_DESCRIPTOR_HANDLE Handle; };
+    struct RootAddressArgs { UINT RootIndex; D3D12_GPU_VIRTUAL_ADDRESS Address; };
+    struct DrawArgs { UINT IndexCount; UINT InstanceCount; UINT StartIndex; INT BaseVertex; UINT StartInstance; };
+
+    // Commands are packed without padding, so arguments are copied out rather
+    // than read in place.
+    template<typename T>
+    T Read(const std::uint8_t*& p)
+    {
+        T args;
+        std::memcpy(&args, p, sizeof(T));
+        p += sizeof(T);
+        return args;
+    }
+}
+
+template<typename T>
+void RenderCommandStream::Write(std::uint32_t op, const T& args)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "command arguments must be plain values");
+
+    const size_t offset = mData.size();
+    mData.resize(offset + sizeof(op) + sizeof(T));
+    std::memcpy(&mData[offset], &op, sizeof(op));
+    std::memcpy(&mData[offset + sizeof(op)], &args, sizeof(T));
+    mCommandCount++;
+}
+
+void RenderCommandStream::Clear()
+{
+    // Keeps the capacity; a frame's stream is about the same size every frame.
+    mData.clear();
+    mCommandCount = 0;
+}
+
+void RenderCommandStream::Replay(CommandBackend& backend)const
+{
+    const std::uint8_t* p = mData.data();
+    const std::uint8_t* end = p + mData.size();
+
+    while (p < end)
+    {
+        switch (Read<std::uint32_t>(p))
+        {
+        case OpSetRootSignature:
+            backend.SetRootSignature(Read<ID3D12RootSignature*>(p));
+            break;
+        case OpSetDescriptorHeap:
+            backend.SetDescriptorHeap(Read<ID3D12DescriptorHeap*>(p));
+            break;
+        case OpSetViewport:
+        {
+            ViewportArgs a = Read<ViewportArgs>(p);
+            backend.SetViewport(a.Viewport, a.ScissorRect);
+            break;
+        }
+        case OpSetRenderTarget:
+        {
+            RenderTargetArgs a = Read<RenderTargetArgs>(p);
+            backend.SetRenderTarget(a.Rtv, a.Dsv);
+            break;
+        }
+        case OpClearRenderTarget:
+        {
+            ClearRenderTargetArgs a = Read<ClearRenderTargetArgs>(p);
+            backend.ClearRenderTarget(a.Rtv, a.Color);
+            break;
+        }
+        case OpClearDepthStencil:
+        {
+            ClearDepthStencilArgs a = Read<ClearDepthStencilArgs>(p);
+            backend.ClearDepthStencil(a.Dsv, a.Depth, a.Stencil);
+            break;
+        }
+        case OpTransition:
+        {
+            TransitionArgs a = Read<TransitionArgs>(p);
+            backend.Transition(a.Resource, a.Before, a.After);
+            break;
+        }
+        case OpSetPipelineState:
+            backend.SetPipelineState(Read<ID3D12PipelineState*>(p));
+            break;
+        case OpSetVertexBuffer:
+            backend.SetVertexBuffer(Read<D3D12_VERTEX_BUFFER_VIEW>(p));
+            break;
+        case OpSetIndexBuffer:
+            backend.SetIndexBuffer(Read<D3D12_INDEX_BUFFER_VIEW>(p));
+            break;
+        case OpSetPrimitiveTopology:
+            backend.SetPrimitiveTopology(Read<D3D12_PRIMITIVE_TOPOLOGY>(p));
+            break;
+        case OpSetDescriptorTable:
+        {
+            RootTableArgs a = Read<RootTableArgs>(p);
+            backend.SetDescriptorTable(a.RootIndex, a.Handle);
+            break;
+        }
+        case OpSetConstantBufferView:
+        {
+            RootAddressArgs a = Read<RootAddressArgs>(p);
+            backend.SetConstantBufferView(a.RootIndex, a.Address);
+            break;
+        }
+        case OpSetShaderResourceView:
+        {
+            RootAddressArgs a = Read<RootAddressArgs>(p);
+            backend.SetShaderResourceView(a.RootIndex, a.Address);
+            break;
+        }
+        case OpDrawIndexedInstanced:
+        {
+            DrawArgs a = Read<DrawArgs>(p);
+            backend.DrawIndexedInstanced(a.IndexCount, a.InstanceCount, a.StartIndex, a.BaseVertex, a.StartInstance);
+            break;
+        }
+        default:
+            assert(false && "corrupt render command stream");
+            return;
+        }
+    }
+}
+
+void RenderCommandStream::SetRootSignature(ID3D12RootSignature* rootSignature)
+{
+    Write(OpSetRootSignature, rootSignature);
+}
+
+void RenderCommandStream::SetDescriptorHeap(ID3D12DescriptorHeap* heap)
+{
+    Write(OpSetDescriptorHeap, heap);
+}
+
+void RenderCommandStream::SetViewport(const D3D12_VIEWPORT& viewport, const D3D12_RECT& scissorRect)
+{
+    Write(OpSetViewport, ViewportArgs{ viewport, scissorRect });
+}
+
+void RenderCommandStream::SetRenderTarget(D3D12_CPU_DESCRIPTOR_HANDLE rtv, D3D12_CPU_DESCRIPTOR_HANDLE dsv)
+{
+    Write(OpSetRenderTarget, RenderTargetArgs{ rtv, dsv });
+}
+
+void RenderCommandStream::ClearRenderTarget(D3D12_CPU_DESCRIPTOR_HANDLE rtv, const FLOAT color[4])
+{
+    ClearRenderTargetArgs a;
+    a.Rtv = rtv;
+    std::memcpy(a.Color, color, sizeof(a.Color));
+    Write(OpClearRenderTarget, a);
+}
+
+void RenderCommandStream::ClearDepthStencil(D3D12_CPU_DESCRIPTOR_HANDLE dsv, FLOAT depth, UINT8 stencil)
+{
+    Write(OpClearDepthStencil, ClearDepthStencilArgs{ dsv, depth, stencil });
+}
+
+void RenderCommandStream::Transition(ID3D12Resource* resource, D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after)
+{
+    Write(OpTransition, TransitionArgs{ resource, before, after });
+}
+
+void RenderCommandStream::SetPipelineState(ID3D12PipelineState* pso)
+{
+    Write(OpSetPipelineState, pso);
+}
+
+void RenderCommandStream::SetVertexBuffer(const D3D12_VERTEX_BUFFER_VIEW& vbv)
+{
+    Write(OpSetVertexBuffer, vbv);
+}
+
+void RenderCommandStream::SetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW& ibv)
+{
+    Write(OpSetIndexBuffer, ibv);
+}
+
+void RenderCommandStream::SetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology)
+{
+    Write(OpSetPrimitiveTopology, topology);
+}
+
+void RenderCommandStream::SetDescriptorTable(UINT rootIndex, D3D12_GPU_DESCRIPTOR_HANDLE handle)
+{
+    Write(OpSetDescriptorTable, RootTableArgs{ rootIndex, handle });
+}
+
+void RenderCommandStream::SetConstantBufferView(UINT rootIndex, D3D12_GPU_VIRTUAL_ADDRESS address)
+{
+    Write(OpSetConstantBufferView, RootAddressArgs{ rootIndex, address });
+}
+
+void RenderCommandStream::SetShaderResourceView(UINT rootIndex, D3D12_GPU_VIRTUAL_ADDRESS address)
+{
+    Write(OpSetShaderResourceView, RootAddressArgs{ rootIndex, address });
+}
+
+void RenderCommandStream::DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance)
+{
+    Write(OpDrawIndexedInstanced, DrawArgs{ indexCount, instanceCount, startIndex, baseVertex, startInstance });
+}
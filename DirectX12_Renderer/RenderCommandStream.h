@@ -0,0 +1,45 @@
+#pragma once
+
+#include "CommandBackend.h"
+
+// Backend-agnostic command buffer.  Recording appends each command as a 32-bit
+// opcode followed by its arguments; Replay decodes them in order into any other
+// backend, so a frame recorded once can be submitted to a D3D12 command list,
+// checked by a NullCommandBackend, or both.
+//
+// Only plain values are stored.  Pointers (PSOs, resources, heaps) are kept as
+// given and must outlive the replay.
+class RenderCommandStream : public CommandBackend
+{
+public:
+    void Clear();
+    void Replay(CommandBackend& backend)const;
+
+    UINT CommandCount()const { return mCommandCount; }
+    size_t ByteSize()const { return mData.size(); }
+
+    void SetRootSignature(ID3D12RootSignature* rootSignature)override;
+    void SetDescriptorHeap(ID3D12DescriptorHeap* heap)override;
+    void SetViewport(const D3D12_VIEWPORT& viewport, const D3D12_RECT& scissorRect)override;
+    void SetRenderTarget(D3D12_CPU_DESCRIPTOR_HANDLE rtv, D3D12_CPU_DESCRIPTOR_HANDLE dsv)override;
+    void ClearRenderTarget(D3D12_CPU_DESCRIPTOR_HANDLE rtv, const FLOAT color[4])override;
+    void ClearDepthStencil(D3D12_CPU_DESCRIPTOR_HANDLE dsv, FLOAT depth, UINT8 stencil)override;
+    void Transition(ID3D12Resource* resource, D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after)override;
+
+    void SetPipelineState(ID3D12PipelineState* pso)override;
+    void SetVertexBuffer(const D3D12_VERTEX_BUFFER_VIEW& vbv)override;
+    void SetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW& ibv)override;
+    void SetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology)override;
+    void SetDescriptorTable(UINT rootIndex, D3D12_GPU_DESCRIPTOR_HANDLE handle)override;
+    void SetConstantBufferView(UINT rootIndex, D3D12_GPU_VIRTUAL_ADDRESS address)override;
+    void SetShaderResourceView(UINT rootIndex, D3D12_GPU_VIRTUAL_ADDRESS address)override;
+    void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance)override;
+
+private:
+    template<typename T>
+    void Write(std::uint32_t op, const T& args);
+
+private:
+    std::vector<std::uint8_t> mData;
+    UINT mCommandCount = 0;
+};
@@ -2,16 +2,24 @@
 
 const int gNumFrameResources = 3;
 
+// The FBX SDK is not documented as thread safe, so its imports take turns on
+// the loader's decode threads.
+static std::mutex gFbxMutex;
+
 Renderer::Renderer(HINSTANCE hInstance) : Window(hInstance)
 {
 }
 
 Renderer::~Renderer()
 {
-    if (md3dDevice != nullptr) {
+    if (mFence != nullptr) {
         FlushCommandQueue();
     }
 
+    // Stop the loader and streaming threads while the device is still around.
+    mAssetLoader.Shutdown();
+    mTerrainStreamer.Shutdown();
+
     ImGui_ImplDX12_Shutdown();
     ImGui_ImplWin32_Shutdown();
     ImGui::DestroyContext();
@@ -50,10 +58,6 @@ bool Renderer::initDirect3D()
             IID_PPV_ARGS(&md3dDevice)));
     }
 
-    // 3, Fence 
-    ThrowIfFailed(md3dDevice->CreateFence(0, D3D12_FENCE_FLAG_NONE,
-        IID_PPV_ARGS(&mFence)));
-
     //  ũ  
     // Render Target View
     mRtvDescriptorSize = md3dDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
@@ -68,6 +72,9 @@ bool Renderer::initDirect3D()
     queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
     ThrowIfFailed(md3dDevice->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&mCommandQueue)));
 
+    // Fence .  Command Queue SignalϹǷ Queue  .
+    mFence = std::make_unique<D3D12Timeline>(md3dDevice.Get(), mCommandQueue.Get());
+
     ThrowIfFailed(md3dDevice->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(mDirectCmdListAlloc.GetAddressOf())));
 
     ThrowIfFailed(md3dDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, mDirectCmdListAlloc.Get(), nullptr, IID_PPV_ARGS(mCommandList.GetAddressOf())));
@@ -75,6 +82,9 @@ bool Renderer::initDirect3D()
     //  CommandList ۼ , Reset ȣϱ  ̸ Close صд.
     mCommandList->Close();
 
+    ThrowIfFailed(md3dDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, mDirectCmdListAlloc.Get(), nullptr, IID_PPV_ARGS(mPostCommandList.GetAddressOf())));
+    mPostCommandList->Close();
+
     // 5. Swap chain 
     // Swap chain ϱ  ʱȭ
     mSwapChain.Reset();
@@ -123,24 +133,8 @@ void Renderer::FlushCommandQueue()
 // CPU & GPU ۾ ȭ
 // ========================================================================================================
 {
-    // Fence  Command Queue ϱ  Fence  Ų.
-    mCurrentFence++;
-
-    // Command Queue Signal ȣϿ Fence  Ų.
-    ThrowIfFailed(mCommandQueue->Signal(mFence.Get(), mCurrentFence));
-
-    // GPU  Fence  Command Queue ϱ  Ѵ.
-    if (mFence->GetCompletedValue() < mCurrentFence)
-    {
-        HANDLE eventHandle = CreateEventEx(nullptr, false, false, EVENT_ALL_ACCESS);
-
-        // GPU  Fence   , Event ߻Ų.
-        ThrowIfFailed(mFence->SetEventOnCompletion(mCurrentFence, eventHandle));
-
-        // Event ߻  Ѵ.
-        WaitForSingleObject(eventHandle, INFINITE);
-        CloseHandle(eventHandle);
-    }
+    // Signal ߰ϰ GPU   Command Queue   Ѵ.
+    mFence->Flush();
 }
 
 ID3D12Resource* Renderer::CurrentBackBuffer()const
@@ -199,6 +193,8 @@ void Renderer::Set4xMsaaState(bool value)
 
 bool Renderer::Initialize()
 {
+    mStartTime = AssetLoader::Now();
+
     // Window & Direct3D ʱȭ
     if (!Window::Initialize()) return false;
     {
@@ -228,7 +224,11 @@ bool Renderer::Initialize()
 
     mCbvSrvDescriptorSize = md3dDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 
+    // Assets are only queued here; Update takes them on as they arrive.
+    mAssetLoader.Initialize(AssetLoaderDesc());
+
     //LoadCharacters();
+    LoadAnimations();
     LoadTextures();
     BuildDescriptorHeaps();
 
@@ -245,19 +245,24 @@ bool Renderer::Initialize()
     // ========================================================================================================
     // Root Signature 
     // ========================================================================================================
-    CD3DX12_DESCRIPTOR_RANGE texTable[2];
+    CD3DX12_DESCRIPTOR_RANGE texTable[SrvTableSize];
     texTable[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0); // t0 : Texture
     texTable[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 1); // imgui ҽ 
 
-    CD3DX12_ROOT_PARAMETER slotRootParameter[4];
+    CD3DX12_ROOT_PARAMETER slotRootParameter[9];
     slotRootParameter[0].InitAsDescriptorTable(_countof(texTable), texTable, D3D12_SHADER_VISIBILITY_PIXEL); 
     slotRootParameter[1].InitAsConstantBufferView(0); // b0 : ObjectCB
     slotRootParameter[2].InitAsConstantBufferView(1); // b1 : PassCB
     slotRootParameter[3].InitAsConstantBufferView(2); // b2 : MaterialCB
+    slotRootParameter[4].InitAsShaderResourceView(0, 1, D3D12_SHADER_VISIBILITY_VERTEX); // t0, space1 : Instance data (raw)
+    slotRootParameter[5].InitAsConstantBufferView(3, 0, D3D12_SHADER_VISIBILITY_PIXEL); // b3 : LightCB
+    slotRootParameter[6].InitAsShaderResourceView(1, 1, D3D12_SHADER_VISIBILITY_PIXEL); // t1, space1 : Cluster lights
+    slotRootParameter[7].InitAsShaderResourceView(2, 1, D3D12_SHADER_VISIBILITY_PIXEL); // t2, space1 : Cluster ranges
+    slotRootParameter[8].InitAsShaderResourceView(3, 1, D3D12_SHADER_VISIBILITY_PIXEL); // t3, space1 : Cluster light indices
 
     auto staticSamplers = GetStaticSamplers(); // Static Sampler
 
-    CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(4, slotRootParameter, (UINT)staticSamplers.size(), staticSamplers.data(), D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
+    CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(_countof(slotRootParameter), slotRootParameter, (UINT)staticSamplers.size(), staticSamplers.data(), D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
     HRESULT hr = D3D12SerializeRootSignature(&rootSigDesc, D3D_ROOT_SIGNATURE_VERSION_1, serializedRootSig.GetAddressOf(), errorBlob.GetAddressOf());
 
@@ -270,8 +275,9 @@ bool Renderer::Initialize()
     ThrowIfFailed(md3dDevice->CreateRootSignature(0, serializedRootSig->GetBufferPointer(), serializedRootSig->GetBufferSize(), IID_PPV_ARGS(mRootSignature.GetAddressOf())));
 
     // Shader Complie
-    mVertexShader = d3dUtil::CompileShader(L"VertexShader.hlsl", nullptr, "VS", "vs_5_0");
-    mPixelShader = d3dUtil::CompileShader(L"PixelShader.hlsl", nullptr, "PS", "ps_5_0");
+    mVertexShader = d3dUtil::CompileShader(L"VertexShader.hlsl", nullptr, "VS", "vs_5_1");
+    mInstancedVertexShader = d3dUtil::CompileShader(L"VertexShader.hlsl", nullptr, "VSInstanced", "vs_5_1");
+    mPixelShader = d3dUtil::CompileShader(L"PixelShader.hlsl", nullptr, "PS", "ps_5_1");
 
     // InputLayout 
     mInputLayout =
@@ -309,6 +315,15 @@ bool Renderer::Initialize()
     psoDesc.DSVFormat = mDepthStencilFormat;
     ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&mPSO)));
 
+    // Same state, but world/tex transforms come from the instance buffer.
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC instancedPsoDesc = psoDesc;
+    instancedPsoDesc.VS =
+    {
+        reinterpret_cast<BYTE*>(mInstancedVertexShader->GetBufferPointer()),
+        mInstancedVertexShader->GetBufferSize()
+    };
+    ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&instancedPsoDesc, IID_PPV_ARGS(&mInstancedPSO)));
+
     // ========================================================================================================
     //   
     // ========================================================================================================
@@ -318,6 +333,8 @@ bool Renderer::Initialize()
     // Ƽ 
     // ========================================================================================================
     BuildMaterials();
+    BuildLights();
+    BuildTerrain();
 
     // ========================================================================================================
     //   
@@ -346,8 +363,9 @@ void Renderer::OnResize()
     assert(mSwapChain);
     assert(mDirectCmdListAlloc);
 
-    // Flush before changing any resources.
-    FlushCommandQueue();
+    // Wait for the GPU before changing any resources.  Every submission so
+    // far was followed by a signal, so no new one is needed.
+    mFence->WaitIdle();
 
     ThrowIfFailed(mCommandList->Reset(mDirectCmdListAlloc.Get(), nullptr));
 
@@ -446,17 +464,91 @@ void Renderer::Update(const GameTimer& gt)
 
     // Has the GPU finished processing the commands of the current frame resource?
     // If not, wait until the GPU has completed commands up to this fence point.
-    if (mCurrFrameResource->Fence != 0 && mFence->GetCompletedValue() < mCurrFrameResource->Fence)
+    mFence->ResetFrameStats();
+    if (mCurrFrameResource->Fence != 0)
+        mFence->Wait(mCurrFrameResource->Fence);
+    const UINT64 completedFence = mFence->CompletedValue();
+
+    // Ring space of frames the GPU has finished with can be reused.
+    mUploadRing->BeginFrame(completedFence);
+
+    // Assets finished in the background join the scene.  Their uploads go in
+    // one batch, ahead of this frame's draws on the same queue.
+    mAssetLoader.Update();
+    mTextureUploader->Submit();
+    if (mLoadedSeconds == 0.0 && mAssetLoader.Pending() == 0)
     {
-        HANDLE eventHandle = CreateEventEx(nullptr, false, false, EVENT_ALL_ACCESS);
-        ThrowIfFailed(mFence->SetEventOnCompletion(mCurrFrameResource->Fence, eventHandle));
-        WaitForSingleObject(eventHandle, INFINITE);
-        CloseHandle(eventHandle);
+        mLoadedSeconds = AssetLoader::Now() - mStartTime;
+        std::ostringstream log;
+        log << "Startup: all assets loaded after " << (int)(mLoadedSeconds * 1000.0) << " ms\n";
+        ::OutputDebugStringA(log.str().c_str());
     }
 
-    UpdateObjectCBs(gt);
-    UpdateMaterialCBs(gt);
-    UpdateMainPassCB(gt);
+    // Takes on chunks the streaming workers have finished and asks for the
+    // ones the camera has moved towards.  Never waits on the workers.
+    mTerrainStreamer.Update(mCamera.GetPosition3f(), completedFence);
+
+    // The rest of the update runs as a job graph across all cores:
+    //   transforms -> cull -> batch and build the draw queue -> object and instance data (split over draws)
+    //   material CBs, pass CB, light CB, light clusters, animation
+    // Only the culling chain is ordered; the constant buffer writes touch
+    // disjoint memory and only read the items.
+    Job* frame = mJobSystem->Create(nullptr);
+
+    Job* animation = mJobSystem->Create([&]()
+    {
+        mAnimationSystem.Update(gt.DeltaTime(), AnimationBudgetMs);
+    }, frame);
+
+    // Moved nodes write their items' World before the BVH refits.
+    Job* transforms = mJobSystem->Create([&]() { mTransforms.Update(mJobSystem.get()); }, frame);
+
+    Job* cull = mJobSystem->Create([&]()
+    {
+        XMFLOAT4 planes[6];
+        mCamera.GetFrustumPlanes(planes);
+        FrustumPlanes frustum;
+        frustum.Set(planes);
+        mSceneBvh.Refit();
+        mSceneBvh.Cull(frustum, mVisibleRitems);
+        mTerrainStreamer.Select(mCamera.GetPosition3f(), frustum, mVisibleRitems);
+        mTextureStreamer.RequestVisible(mCamera, (float)mClientHeight, mVisibleRitems.data(), (UINT)mVisibleRitems.size());
+        mInstanceBatcher.Build(mVisibleRitems.data(), (UINT)mVisibleRitems.size());
+        mDrawQueue.Build(mInstanceBatcher, mCamera.GetPosition(), mCamera.GetLook(), mCamera.GetFarZ());
+    }, frame);
+
+    mJobSystem->AddDependency(cull, transforms);
+
+    Job* constants = mJobSystem->Create([&]() { UpdateDrawConstants(gt); }, frame);
+    mJobSystem->AddDependency(constants, cull);
+
+    Job* materials = mJobSystem->Create([&]() { UpdateMaterialCBs(gt); }, frame);
+    Job* pass = mJobSystem->Create([&]() { UpdateMainPassCB(gt); }, frame);
+    Job* lights = mJobSystem->Create([&]() { UpdateLightCB(gt); }, frame);
+    Job* clusters = mJobSystem->Create([&]() { UpdateLightClusters(gt); }, frame);
+
+    for (Job* job : { animation, transforms, cull, constants, materials, pass, lights, clusters })
+        mJobSystem->Run(job);
+    mJobSystem->Run(frame);
+    mJobSystem->Wait(frame);
+
+    // Switches materials to the textures whose new levels have landed, before
+    // the draws read them, and starts the next changes.
+    mTextureStreamer.Update(completedFence);
+
+    // The ring ran out, so some draws have no constants.  Wait for the GPU,
+    // replace the ring with one twice the size and write this frame's data again.
+    // Nothing of this frame has been submitted yet, so the last signal covers
+    // everything that reads the old ring.
+    while (mUploadRing->GetFrameStats().Failures > 0)
+    {
+        mFence->WaitIdle();
+        mUploadRing = std::make_unique<UploadRing>(md3dDevice.Get(), 2 * mUploadRing->Capacity());
+        mUploadRing->BeginFrame(mFence->CompletedValue());
+        UpdateDrawConstants(gt);
+        UpdateMainPassCB(gt);
+        UpdateLightClusters(gt);
+    }
 }
 
 void Renderer::Draw(const GameTimer& gt)
@@ -468,61 +560,97 @@ void Renderer::Draw(const GameTimer& gt)
 
     // A command list can be reset after it has been added to the command queue via ExecuteCommandList.
     // Reusing the command list reuses memory.
-    ThrowIfFailed(mCommandList->Reset(mDirectCmdListAlloc.Get(), mPSO.Get()));
+    ThrowIfFailed(mCommandList->Reset(cmdListAlloc.Get(), nullptr));
+
+    // The frame is recorded into command streams first and replayed into the
+    // command lists, so the same recording can also be checked without a GPU.
+    mPreStream.Clear();
 
     // Viewport  
-    mCommandList->RSSetViewports(1, &mScreenViewport);
-    mCommandList->RSSetScissorRects(1, &mScissorRect);
+    mPreStream.SetViewport(mScreenViewport, mScissorRect);
 
     // ҽ   : Present -> Render Target
-    mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
-        D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET));
+    mPreStream.Transition(CurrentBackBuffer(), D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
 
     //  ۿ  ۸ Ŭ
-    mCommandList->ClearRenderTargetView(CurrentBackBufferView(), Colors::LightSteelBlue, 0, nullptr);
-    mCommandList->ClearDepthStencilView(DepthStencilView(), D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
-
-    //  Ÿ  ۿ  ۷ 
-    mCommandList->OMSetRenderTargets(1, &CurrentBackBufferView(), true, &DepthStencilView());
-
-    // Descriptor Heap  : SRV
-    ID3D12DescriptorHeap* descriptorHeaps[] = { mSrvDescriptorHeap.Get()};
-    mCommandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
+    mPreStream.ClearRenderTarget(CurrentBackBufferView(), Colors::LightSteelBlue);
+    mPreStream.ClearDepthStencil(DepthStencilView(), 1.0f, 0);
 
-    // Root Signature 
-    mCommandList->SetGraphicsRootSignature(mRootSignature.Get());
+    mFrameBackend.SetCommandList(mCommandList.Get());
+    mPreStream.Replay(mFrameBackend);
 
-    //    : PassCB
-    auto passCB = mCurrFrameResource->PassCB->Resource();
-    passCB->SetName(L"Pass Constant Buffer");
-    mCommandList->SetGraphicsRootConstantBufferView(2, passCB->GetGPUVirtualAddress());
-
-    UINT objCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
-    UINT matCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(MaterialConstants));
-
-    auto objectCB = mCurrFrameResource->ObjectCB->Resource();
-    auto matCB = mCurrFrameResource->MaterialCB->Resource();
+    // Vertex buffers of newly streamed terrain chunks, ahead of the draws.
+    mTerrainStreamer.RecordUploads(mCommandList.Get());
+    ThrowIfFailed(mCommandList->Close());
 
-    // For each render item...
-    for (size_t i = 0; i < mOpaqueRitems.size(); ++i)
+    // Scene draws: the sorted queue is cut into contiguous chunks recorded in
+    // parallel.  Each chunk list starts from scratch, so RecordQueue sets up its
+    // own viewport, render target, heap and root signature.
+    const UINT drawCount = mDrawQueue.Size();
+    const UINT chunkCount = std::max(1u, std::min(mRecordChunkCount, (drawCount + MinDrawsPerChunk - 1) / MinDrawsPerChunk));
+
+    DrawBindings bindings;
+    bindings.RootSignature = mRootSignature.Get();
+    bindings.SrvHeap = mSrvDescriptorHeap.Get();
+    bindings.Viewport = mScreenViewport;
+    bindings.ScissorRect = mScissorRect;
+    bindings.RenderTarget = CurrentBackBufferView();
+    bindings.DepthStencil = DepthStencilView();
+    bindings.DefaultPSO = mPSO.Get();
+    bindings.InstancedPSO = mInstancedPSO.Get();
+    bindings.SrvHeapStart = mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart();
+    bindings.SrvDescriptorSize = mCbvSrvDescriptorSize;
+    bindings.PassCB = mPassCBAddress;
+    bindings.MaterialCB = mCurrFrameResource->MaterialCB->Resource()->GetGPUVirtualAddress();
+    bindings.LightCB = mCurrFrameResource->LightCB->Resource()->GetGPUVirtualAddress();
+    bindings.MaterialCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(MaterialConstants));
+    bindings.ClusterLights = mClusterLightsAddress;
+    bindings.ClusterRanges = mClusterRangesAddress;
+    bindings.ClusterLightIndices = mClusterIndicesAddress;
+
+    // ThrowIfFailed stays on this thread: an exception escaping a job would
+    // terminate the process instead of reaching the main loop's handler.  The
+    // lists are reset here, and each job hands back the result of its Close.
+    for (UINT chunk = 0; chunk < chunkCount; ++chunk)
     {
-        auto ri = mOpaqueRitems[i];
-
-        mCommandList->IASetVertexBuffers(0, 1, &ri->Geo->VertexBufferView());
-        mCommandList->IASetIndexBuffer(&ri->Geo->IndexBufferView());
-        mCommandList->IASetPrimitiveTopology(ri->PrimitiveType);
-
-        CD3DX12_GPU_DESCRIPTOR_HANDLE tex(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
-        tex.Offset(ri->Mat->DiffuseSrvHeapIndex, mCbvSrvDescriptorSize);
-
-        D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = objectCB->GetGPUVirtualAddress() + ri->ObjCBIndex * objCBByteSize;
-        D3D12_GPU_VIRTUAL_ADDRESS matCBAddress = matCB->GetGPUVirtualAddress() + ri->Mat->MatCBIndex * matCBByteSize;
+        auto alloc = mCurrFrameResource->ChunkCmdListAllocs[chunk];
+        ThrowIfFailed(alloc->Reset());
+        ThrowIfFailed(mCurrFrameResource->ChunkCmdLists[chunk]->Reset(alloc.Get(), nullptr));
+    }
 
-        mCommandList->SetGraphicsRootDescriptorTable(0, tex);
-        mCommandList->SetGraphicsRootConstantBufferView(1, objCBAddress);
-        mCommandList->SetGraphicsRootConstantBufferView(3, matCBAddress);
+    HRESULT chunkResults[MaxRecordChunks];
+    mJobSystem->ParallelFor(chunkCount, 1, [&](UINT firstChunk, UINT lastChunk)
+    {
+        for (UINT chunk = firstChunk; chunk < lastChunk; ++chunk)
+            chunkResults[chunk] = RecordDrawChunk(chunk, chunkCount, bindings);
+    });
+    for (UINT chunk = 0; chunk < chunkCount; ++chunk)
+        ThrowIfFailed(chunkResults[chunk]);
+
+#if defined(DEBUG) || defined(_DEBUG)
+    // Replays the frame in submission order through the null device, which
+    // checks bindings and barrier states the way the debug layer would.
+    mCommandValidator.Reset();
+    mCommandValidator.RequireRootParameters(mPSO.Get(), DrawRecorder::DefaultRootParameters);
+    mCommandValidator.RequireRootParameters(mInstancedPSO.Get(), DrawRecorder::InstancedRootParameters);
+    mPreStream.Replay(mCommandValidator);
+    for (UINT chunk = 0; chunk < chunkCount; ++chunk)
+    {
+        mCommandValidator.BeginList();
+        mChunkStreams[chunk].Replay(mCommandValidator);
+    }
+    if (mCommandValidator.ErrorCount() > 0)
+        OutputDebugStringA(("Render command validation: " + mCommandValidator.FirstError() + "\n").c_str());
+#endif
 
-        mCommandList->DrawIndexedInstanced(ri->IndexCount, 1, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+    DrawStats drawStats;
+    for (UINT chunk = 0; chunk < chunkCount; ++chunk)
+    {
+        const DrawStats& chunkStats = mChunkRecorders[chunk].GetStats();
+        drawStats.Draws += chunkStats.Draws;
+        drawStats.Instances += chunkStats.Instances;
+        drawStats.BindsIssued += chunkStats.BindsIssued;
+        drawStats.BindsSkipped += chunkStats.BindsSkipped;
     }
 
     ImGui_ImplDX12_NewFrame();
@@ -530,31 +658,115 @@ void Renderer::Draw(const GameTimer& gt)
     ImGui::NewFrame();
     ImGui::ShowDemoWindow();
 
+    ImGui::Begin("Draw Stats");
+    ImGui::Text("Visible items: %u", (UINT)mVisibleRitems.size());
+    ImGui::Text("Draws: %u (%u instances)", drawStats.Draws, drawStats.Instances);
+    ImGui::Text("Binds issued: %u", drawStats.BindsIssued);
+    ImGui::Text("Binds avoided: %u", drawStats.BindsSkipped);
+
+    const TransformSystem::Stats& transformStats = mTransforms.GetStats();
+    ImGui::Text("Transforms: %u of %u nodes updated, %u items moved",
+        transformStats.NodesUpdated, mTransforms.NodeCount(), transformStats.ItemsUpdated);
+
+    const TerrainStreamer::Stats& terrainStats = mTerrainStreamer.GetStats();
+    ImGui::Text("Terrain: %u nodes, %u triangles", terrainStats.NodesSelected, terrainStats.TrianglesSelected);
+    ImGui::Text("Terrain chunks: %u resident (%.1f MB), %u pending, %llu streamed, %llu evicted",
+        terrainStats.ResidentChunks, terrainStats.ResidentBytes / (1024.0 * 1024.0), terrainStats.PendingChunks,
+        (unsigned long long)terrainStats.TotalArrived, (unsigned long long)terrainStats.TotalEvicted);
+
+    const LightClusters::Stats& clusterStats = mLightClusters.GetStats();
+    ImGui::Text("Clustered lights: %u of %u visible, %u list entries (max %u per cluster)",
+        clusterStats.VisibleLights, (UINT)mSceneLights.size(), clusterStats.IndexCount, clusterStats.MaxLightsPerCluster);
+    ImGui::Text("Record chunks: %u", chunkCount);
+
+    const GpuTimeline::Stats& fenceStats = mFence->GetFrameStats();
+    ImGui::Text("GPU wait: %.2f ms (%u waits), %.1f s in total",
+        fenceStats.WaitSeconds * 1000.0, fenceStats.Waits, mFence->GetTotalStats().WaitSeconds);
+
+    const UploadRing::FrameStats ringStats = mUploadRing->GetFrameStats();
+    ImGui::Text("Upload ring: %u allocations, %.1f KB + %.1f KB alignment",
+        ringStats.Allocations, ringStats.BytesAllocated / 1024.0, ringStats.BytesWasted / 1024.0);
+    ImGui::Text("Upload ring in flight: %.2f of %.2f MB",
+        mUploadRing->BytesInFlight() / (1024.0 * 1024.0), mUploadRing->Capacity() / (1024.0 * 1024.0));
+
+    const TextureStreamer::Stats& textureStats = mTextureStreamer.GetStats();
+    ImGui::Text("Textures: %.1f MB resident, %u changing, %llu streamed in, %llu out",
+        textureStats.ResidentBytes / (1024.0 * 1024.0), textureStats.InFlight,
+        textureStats.TotalStreamedIn, textureStats.TotalStreamedOut);
+
+    const AssetLoader::Stats& loadStats = mAssetLoader.GetStats();
+    ImGui::Text("Assets: %u loaded, %u failed, %u pending", loadStats.Loaded, loadStats.Failed, loadStats.Pending);
+    if (mLoadedSeconds > 0.0)
+        ImGui::Text("Startup: first frame %.0f ms, fully loaded %.0f ms", mFirstFrameSeconds * 1000.0, mLoadedSeconds * 1000.0);
+    else
+        ImGui::Text("Startup: first frame %.0f ms, loading", mFirstFrameSeconds * 1000.0);
+    ImGui::End();
+
     ImGui::Render();
-    ImGui_ImplDX12_RenderDrawData(ImGui::GetDrawData(), mCommandList.Get());
+
+    // The frame allocator is free again now that the first list is closed.
+    ThrowIfFailed(mPostCommandList->Reset(cmdListAlloc.Get(), nullptr));
+    mPostCommandList->RSSetViewports(1, &mScreenViewport);
+    mPostCommandList->RSSetScissorRects(1, &mScissorRect);
+    mPostCommandList->OMSetRenderTargets(1, &bindings.RenderTarget, true, &bindings.DepthStencil);
+    ID3D12DescriptorHeap* descriptorHeaps[] = { mSrvDescriptorHeap.Get() };
+    mPostCommandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
+    ImGui_ImplDX12_RenderDrawData(ImGui::GetDrawData(), mPostCommandList.Get());
 
     // Indicate a state transition on the resource usage.
-    mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
-        D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
+    mFrameBackend.SetCommandList(mPostCommandList.Get());
+    mFrameBackend.Transition(CurrentBackBuffer(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
 
     // Done recording commands.
-    ThrowIfFailed(mCommandList->Close());
-
-    // Add the command list to the queue for execution.
-    ID3D12CommandList* cmdsLists[] = { mCommandList.Get() };
-    mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+    ThrowIfFailed(mPostCommandList->Close());
+
+    // Submission order is fixed regardless of which thread finished first:
+    // clears, scene chunks in queue order, then ImGui and the present barrier.
+    std::vector<ID3D12CommandList*> cmdsLists;
+    cmdsLists.reserve(chunkCount + 2);
+    cmdsLists.push_back(mCommandList.Get());
+    for (UINT chunk = 0; chunk < chunkCount; ++chunk)
+        cmdsLists.push_back(mCurrFrameResource->ChunkCmdLists[chunk].Get());
+    cmdsLists.push_back(mPostCommandList.Get());
+    mCommandQueue->ExecuteCommandLists((UINT)cmdsLists.size(), cmdsLists.data());
 
     // Swap the back and front buffers
     ThrowIfFailed(mSwapChain->Present(0, 0));
     mCurrBackBuffer = (mCurrBackBuffer + 1) % SwapChainBufferCount;
 
-    // Advance the fence value to mark commands up to this fence point.
-    mCurrFrameResource->Fence = ++mCurrentFence;
+    if (mFirstFrameSeconds == 0.0)
+    {
+        mFirstFrameSeconds = AssetLoader::Now() - mStartTime;
+        std::ostringstream log;
+        log << "Startup: first frame after " << (int)(mFirstFrameSeconds * 1000.0) << " ms\n";
+        ::OutputDebugStringA(log.str().c_str());
+    }
 
-    // Add an instruction to the command queue to set a new fence point. 
-    // Because we are on the GPU timeline, the new fence point won't be 
-    // set until the GPU finishes processing all the commands prior to this Signal().
-    mCommandQueue->Signal(mFence.Get(), mCurrentFence);
+    // Add an instruction to the command queue to set a new fence point and
+    // mark commands up to it with its value.  Because we are on the GPU
+    // timeline, the new fence point won't be set until the GPU finishes
+    // processing all the commands prior to this Signal().
+    const UINT64 fence = mFence->Signal();
+    mCurrFrameResource->Fence = fence;
+    mUploadRing->EndFrame(fence);
+    mTerrainStreamer.EndFrame(fence);
+    mTextureStreamer.EndFrame(fence);
+}
+
+HRESULT Renderer::RecordDrawChunk(UINT chunk, UINT chunkCount, const DrawBindings& bindings)
+{
+    auto cmdList = mCurrFrameResource->ChunkCmdLists[chunk];
+
+    // Draws in sort key order: pipeline, geometry, material, then front to back.
+    const UINT drawCount = mDrawQueue.Size();
+    RenderCommandStream& stream = mChunkStreams[chunk];
+    stream.Clear();
+    mChunkRecorders[chunk].Begin(&stream, nullptr);
+    mChunkRecorders[chunk].RecordQueue(mDrawQueue, drawCount * chunk / chunkCount, drawCount * (chunk + 1) / chunkCount, bindings);
+
+    mChunkBackends[chunk].SetCommandList(cmdList.Get());
+    stream.Replay(mChunkBackends[chunk]);
+    return cmdList->Close();
 }
 
 void Renderer::OnMouseDown(WPARAM btnState, int x, int y)
@@ -615,11 +827,14 @@ void Renderer::BuildBoxGeometry()
 {
     GeometryGenerator geoGen;
     GeometryGenerator::MeshData box = geoGen.CreateBox(1.0f, 1.0f, 1.0f, 1);
+    MeshOptimizer::Optimize(box);
 
     SubmeshGeometry boxSubmesh;
     boxSubmesh.IndexCount = (UINT)box.Indices32.size();
     boxSubmesh.StartIndexLocation = 0;
     boxSubmesh.BaseVertexLocation = 0;
+    BoundingBox::CreateFromPoints(boxSubmesh.Bounds, box.Vertices.size(),
+        &box.Vertices[0].Position, sizeof(GeometryGenerator::Vertex));
 
     std::vector<Vertex> vertices(box.Vertices.size());
 
@@ -658,144 +873,220 @@ void Renderer::BuildBoxGeometry()
     geo->IndexFormat = DXGI_FORMAT_R16_UINT;
     geo->IndexBufferByteSize = ibByteSize;
 
-    geo->DrawArgs["box"] = boxSubmesh;
+    mBoxSubmesh = geo->AddSubmesh(Names::Intern("box"), boxSubmesh);
 
-    mGeometries[geo->Name] = std::move(geo);
+    MeshGeometry* boxGeo = geo.get();
+    mBoxGeo = mGeometries.Add(Names::Intern(boxGeo->Name), std::move(geo));
+    boxGeo->GeoIndex = mBoxGeo.Index;
 }
 
 void Renderer::BuildMaterials()
 {
     auto grass = std::make_unique<Material>();
     grass->Name = "grass";
-    grass->MatCBIndex = 0;
-    grass->DiffuseSrvHeapIndex = 0;
+    grass->DiffuseSrvHeapIndex = 0;     // The null view until the texture is loaded.
     grass->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
     grass->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
     grass->Roughness = 0.2f;
 
-    mMaterials["grass"] = std::move(grass);
+    // The slot doubles as the material's constant buffer index.
+    Material* grassMat = grass.get();
+    mGrassMat = mMaterials.Add(Names::Intern(grassMat->Name), std::move(grass));
+    grassMat->MatCBIndex = (int)mGrassMat.Index;
+}
+
+void Renderer::BuildLights()
+{
+    mLightConstants.AmbientLight = { 0.25f, 0.25f, 0.35f, 1.0f };
+    mLightConstants.Lights[0].Direction = { 0.57735f, -0.57735f, 0.57735f };
+    mLightConstants.Lights[0].Strength = { 0.6f, 0.6f, 0.6f };
+    mLightConstants.Lights[1].Direction = { -0.57735f, -0.57735f, 0.57735f };
+    mLightConstants.Lights[1].Strength = { 0.3f, 0.3f, 0.3f };
+    mLightConstants.Lights[2].Direction = { 0.0f, -0.707f, -0.707f };
+    mLightConstants.Lights[2].Strength = { 0.15f, 0.15f, 0.15f };
+
+    mLightFramesDirty = gNumFrameResources;
+
+    // Small coloured lights over the box field, every fourth one a spot light
+    // pointing down; these go through the light clusters.
+    for (int z = 0; z < 16; ++z)
+    {
+        for (int x = 0; x < 16; ++x)
+        {
+            Light light;
+            light.Position = { -4.0f + 0.5f * x, 1.25f, -4.0f + 0.5f * z };
+            light.Strength = { MathHelper::RandF(0.1f, 0.6f), MathHelper::RandF(0.1f, 0.6f), MathHelper::RandF(0.1f, 0.6f) };
+            light.FalloffStart = 0.25f;
+            light.FalloffEnd = MathHelper::RandF(0.75f, 1.5f);
+            light.Direction = { 0.0f, -1.0f, 0.0f };
+            light.SpotPower = (x + z) % 4 == 0 ? 8.0f : 0.0f;
+            mSceneLights.push_back(light);
+        }
+    }
+}
+
+void Renderer::BuildTerrain()
+{
+    auto height = [this](float x, float z) { return GetTerrainHeight(x, z); };
+
+    const float placementSize = 1024.0f;
+    const UINT samples = (UINT)placementSize + 1;
+    mHeightField.Build(-0.5f * placementSize, -0.5f * placementSize, 1.0f, samples, samples, height, nullptr);
+
+    // Chunk geometry is numbered after everything built so far.
+    TerrainStreamerDesc desc;
+    mTerrainStreamer.Initialize(md3dDevice.Get(), mCommandList.Get(), desc, height,
+        mMaterials.Get(mGrassMat), mGeometries.SlotCount());
 }
 
 void Renderer::BuildRenderItems()
 {
     int index = 0;
+    Material* grass = mMaterials.Get(mGrassMat);
 
     // Map Data
+    MeshGeometry* boxGeo = mGeometries.Get(mBoxGeo);
+    const SubmeshGeometry& boxSubmesh = boxGeo->Submeshes[mBoxSubmesh];
+    const UINT mapNode = mTransforms.Create(TransformSystem::InvalidNode, XMMatrixIdentity());
     for (float z = -3; z < 3; z++) {
         for (float x = -3; x < 3; x++) {
             auto boxitem = std::make_unique<RenderItem>();
-            //XMStoreFloat4x4(&boxitem->World, XMMatrixTranslation(x, GetTerrainHeight(x, z) , z));
-            XMStoreFloat4x4(&boxitem->World, XMMatrixTranslation(x, 0.5 , z));
+            const UINT boxNode = mTransforms.Create(mapNode, XMMatrixTranslation(x, mHeightField.Height(x, z) + 0.5f, z));
+            mTransforms.Attach(boxNode, boxitem.get());
             XMStoreFloat4x4(&boxitem->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
             boxitem->ObjCBIndex = index++;
-            boxitem->Mat = mMaterials["grass"].get();
-            boxitem->Geo = mGeometries["boxGeo"].get();
+            boxitem->Mat = grass;
+            boxitem->Geo = boxGeo;
+            boxitem->Submesh = mBoxSubmesh;
             boxitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-            boxitem->IndexCount = boxitem->Geo->DrawArgs["box"].IndexCount;
-            boxitem->StartIndexLocation = boxitem->Geo->DrawArgs["box"].StartIndexLocation;
-            boxitem->BaseVertexLocation = boxitem->Geo->DrawArgs["box"].BaseVertexLocation;
+            boxitem->IndexCount = boxSubmesh.IndexCount;
+            boxitem->StartIndexLocation = boxSubmesh.StartIndexLocation;
+            boxitem->BaseVertexLocation = boxSubmesh.BaseVertexLocation;
+            boxitem->Bounds = boxSubmesh.Bounds;
             mAllRitems.push_back(std::move(boxitem));
         }
     }
 
-    // Character Mesh
-    for (UINT i = 0; i < meshes.size(); i++) {
-        auto mesh = std::make_unique<RenderItem>();
-        XMMATRIX world = XMLoadFloat4x4(&mesh->World);
+    // All the render items are opaque.
+    for (auto& e : mAllRitems) {
+        mOpaqueRitems.push_back(e.get());
+    }
 
-        XMMATRIX Translation = XMMatrixTranslation(1.0f, 1.0f, 100.0f);
-        XMMATRIX Scaling = XMMatrixScaling(0.01f, 0.01f, 0.01f);
-        XMMATRIX yRotation = XMMatrixRotationX(XMConvertToRadians(-90.0f));
+    // World matrices for the BVH.
+    mTransforms.Update(nullptr);
+    mSceneBvh.Build(mOpaqueRitems.data(), (UINT)mOpaqueRitems.size());
+}
 
-        XMMATRIX TRSMatrix = XMMatrixMultiply(XMMatrixMultiply(Translation, yRotation), Scaling);
-        XMMatrixMultiply(world, TRSMatrix);
+void Renderer::BuildCharacterItems()
+{
+    Material* grass = mMaterials.Get(mGrassMat);
 
-        XMStoreFloat4x4(&mesh->World, TRSMatrix);
+    // Character Mesh: every mesh of the character hangs off one node.
+    XMMATRIX Translation = XMMatrixTranslation(1.0f, 1.0f, 100.0f);
+    XMMATRIX Scaling = XMMatrixScaling(0.01f, 0.01f, 0.01f);
+    XMMATRIX yRotation = XMMatrixRotationX(XMConvertToRadians(-90.0f));
+    const UINT characterNode = mTransforms.Create(TransformSystem::InvalidNode,
+        XMMatrixMultiply(XMMatrixMultiply(Translation, yRotation), Scaling));
 
-        mesh->ObjCBIndex = index++;
-        mesh->Geo = mGeometries["Character"].get();
-        mesh->Mat = mMaterials["grass"].get();
+    for (UINT i = 0; i < meshes.size(); i++) {
+        auto mesh = std::make_unique<RenderItem>();
+        mTransforms.Attach(characterNode, mesh.get());
+
+        mesh->ObjCBIndex = (UINT)mAllRitems.size();
+        // meshes[i] was registered as submesh i.
+        mesh->Geo = mGeometries.Get(mCharacterGeo);
+        mesh->Submesh = i;
+        mesh->Mat = grass;
         mesh->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-        mesh->IndexCount = mesh->Geo->DrawArgs[meshes[i].MeshName].IndexCount;
-        mesh->StartIndexLocation = mesh->Geo->DrawArgs[meshes[i].MeshName].StartIndexLocation;
-        mesh->BaseVertexLocation = mesh->Geo->DrawArgs[meshes[i].MeshName].BaseVertexLocation;
+        const SubmeshGeometry& submesh = mesh->Geo->Submeshes[i];
+        mesh->IndexCount = submesh.IndexCount;
+        mesh->StartIndexLocation = submesh.StartIndexLocation;
+        mesh->BaseVertexLocation = submesh.BaseVertexLocation;
+        mesh->IndexFormat = submesh.IndexFormat;
+        mesh->IndexByteOffset = submesh.IndexByteOffset;
+        mesh->Bounds = submesh.Bounds;
+        mOpaqueRitems.push_back(mesh.get());
         mAllRitems.push_back(std::move(mesh));
     }
 
-    // All the render items are opaque.
-    for (auto& e : mAllRitems) {
-        mOpaqueRitems.push_back(e.get());
-    }
+    // The BVH is rebuilt with the new items; between frames, so no job is
+    // reading it.
+    mTransforms.Update(nullptr);
+    mSceneBvh.Build(mOpaqueRitems.data(), (UINT)mOpaqueRitems.size());
 }
 
 void Renderer::BuildFrameResources()
 {
+    // One worker per remaining core; the main thread runs jobs while it waits.
+    unsigned int hardwareThreads = std::thread::hardware_concurrency();
+    mJobSystem = std::make_unique<JobSystem>(hardwareThreads > 1 ? hardwareThreads - 1 : 1);
+
+    mRecordChunkCount = mJobSystem->ThreadCount() < MaxRecordChunks ? mJobSystem->ThreadCount() : MaxRecordChunks;
+    mChunkStreams.resize(mRecordChunkCount);
+    mChunkBackends.resize(mRecordChunkCount);
+    mChunkRecorders.resize(mRecordChunkCount);
+
     for (int i = 0; i < gNumFrameResources; ++i)
     {
-        mFrameResources.push_back(std::make_unique<FrameResource>(md3dDevice.Get(), 1, (UINT)mAllRitems.size(), (UINT)mMaterials.size()));
+        mFrameResources.push_back(std::make_unique<FrameResource>(md3dDevice.Get(), mMaterials.SlotCount(), mRecordChunkCount));
     }
+
+    // Worst case per frame is every item and terrain node drawn on its own
+    // with a full CB slot.
+    const UINT64 frameBytes = (mAllRitems.size() + mTerrainStreamer.MaxNodeCount()) * d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants)) +
+        d3dUtil::CalcConstantBufferByteSize(sizeof(PassConstants)) +
+        LightClusters::ClusterCount * sizeof(ClusterRange) + mSceneLights.size() * (sizeof(Light) + 64 * sizeof(UINT));
+    mUploadRing = std::make_unique<UploadRing>(md3dDevice.Get(), gNumFrameResources * frameBytes);
 }
 
 void Renderer::BuildDescriptorHeaps()
 {
     // Create SRV heap
     D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
-    srvHeapDesc.NumDescriptors = 2;
+    srvHeapDesc.NumDescriptors = 5;
     srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
     srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
     ThrowIfFailed(md3dDevice->CreateDescriptorHeap(&srvHeapDesc, IID_PPV_ARGS(&mSrvDescriptorHeap)));
 
-    CD3DX12_CPU_DESCRIPTOR_HANDLE srvDescriptor(mSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
-
-    // Table 0 : grass Texture
-    auto grassTex = mTextures["grassTex"]->Resource;
-
-    D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-    srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-    srvDesc.Format = grassTex->GetDesc().Format;
-    srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-    srvDesc.Texture2D.MostDetailedMip = 0;
-    srvDesc.Texture2D.MipLevels = grassTex->GetDesc().MipLevels;
-    srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
-
-    md3dDevice->CreateShaderResourceView(grassTex.Get(), &srvDesc, srvDescriptor);
+    // 0 : null view, sampled as black by materials whose texture is still loading
+    // 1 : ImGui
+    // 2, 3 : grass Texture and its spare, written when it is loaded
+    // 4 : null view, so that the two-entry table of any slot stays in the heap
+    D3D12_SHADER_RESOURCE_VIEW_DESC nullDesc = {};
+    nullDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    nullDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    nullDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+    nullDesc.Texture2D.MipLevels = 1;
+
+    for (UINT slot : { 0u, 4u })
+    {
+        CD3DX12_CPU_DESCRIPTOR_HANDLE descriptor(mSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), slot, mCbvSrvUavDescriptorSize);
+        md3dDevice->CreateShaderResourceView(nullptr, &nullDesc, descriptor);
+    }
 }
 
-void Renderer::UpdateObjectCBs(const GameTimer& gt)
+void Renderer::UpdateDrawConstants(const GameTimer& gt)
 {
-    auto currObjectCB = mCurrFrameResource->ObjectCB.get();
-    currObjectCB->Resource()->SetName(L"Object Constant Buffer");
-    for (auto& e : mAllRitems)
+    // Object constants and instance data are transient: each packet of this
+    // frame's queue gets fresh ring space, so only what is drawn is written
+    // and items can come and go without resizing anything.
+    mJobSystem->ParallelFor(mDrawQueue.Size(), DrawConstantsGrain, [&](UINT first, UINT last)
     {
-        // Only update the cbuffer data if the constants have changed.  
-        // This needs to be tracked per frame resource.
-        if (e->NumFramesDirty > 0)
-        {
-            XMMATRIX world = XMLoadFloat4x4(&e->World);
-            XMMATRIX texTransform = XMLoadFloat4x4(&e->TexTransform);
-
-            ObjectConstants objConstants;
-            XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(world));
-            XMStoreFloat4x4(&objConstants.TexTransform, XMMatrixTranspose(texTransform));
-
-            currObjectCB->CopyData(e->ObjCBIndex, objConstants);
-
-            // Next FrameResource need to be updated too.
-            e->NumFramesDirty--;
-        }
-    }
+        // Running out is picked up from the ring's failure count in Update.
+        mDrawQueue.WriteConstants(first, last, mInstanceBatcher, *mUploadRing);
+    });
 }
 
 void Renderer::UpdateMaterialCBs(const GameTimer& gt)
 {
     auto currMaterialCB = mCurrFrameResource->MaterialCB.get();
     currMaterialCB->Resource()->SetName(L"Material Constant Buffer");
-    for (auto& e : mMaterials)
+    for (UINT i = 0; i < mMaterials.SlotCount(); ++i)
     {
         // Only update the cbuffer data if the constants have changed.  If the cbuffer
         // data changes, it needs to be updated for each FrameResource.
-        Material* mat = e.second.get();
-        if (mat->NumFramesDirty > 0)
+        Material* mat = mMaterials.At(i);
+        if (mat != nullptr && mat->NumFramesDirty > 0)
         {
             XMMATRIX matTransform = XMLoadFloat4x4(&mat->MatTransform);
 
@@ -818,178 +1109,250 @@ void Renderer::UpdateMainPassCB(const GameTimer& gt)
     XMMATRIX view = mCamera.GetView();
     XMMATRIX proj = mCamera.GetProj();
 
+    // Only what the shaders read; the inverses were never used.
     XMMATRIX viewProj = XMMatrixMultiply(view, proj);
-    XMMATRIX invView = XMMatrixInverse(&XMMatrixDeterminant(view), view);
-    XMMATRIX invProj = XMMatrixInverse(&XMMatrixDeterminant(proj), proj);
-    XMMATRIX invViewProj = XMMatrixInverse(&XMMatrixDeterminant(viewProj), viewProj);
-
-    XMStoreFloat4x4(&mMainPassCB.View, XMMatrixTranspose(view));
-    XMStoreFloat4x4(&mMainPassCB.InvView, XMMatrixTranspose(invView));
-    XMStoreFloat4x4(&mMainPassCB.Proj, XMMatrixTranspose(proj));
-    XMStoreFloat4x4(&mMainPassCB.InvProj, XMMatrixTranspose(invProj));
+
     XMStoreFloat4x4(&mMainPassCB.ViewProj, XMMatrixTranspose(viewProj));
-    XMStoreFloat4x4(&mMainPassCB.InvViewProj, XMMatrixTranspose(invViewProj));
     mMainPassCB.EyePosW = mCamera.GetPosition3f();
     mMainPassCB.RenderTargetSize = XMFLOAT2((float)mClientWidth, (float)mClientHeight);
     mMainPassCB.InvRenderTargetSize = XMFLOAT2(1.0f / mClientWidth, 1.0f / mClientHeight);
-    mMainPassCB.NearZ = 1.0f;
-    mMainPassCB.FarZ = 1000.0f;
+    mMainPassCB.NearZ = mCamera.GetNearZ();
+    mMainPassCB.FarZ = mCamera.GetFarZ();
     mMainPassCB.TotalTime = gt.TotalTime();
     mMainPassCB.DeltaTime = gt.DeltaTime();
-    mMainPassCB.AmbientLight = { 0.25f, 0.25f, 0.35f, 1.0f };
-    mMainPassCB.Lights[0].Direction = { 0.57735f, -0.57735f, 0.57735f };
-    mMainPassCB.Lights[0].Strength = { 0.6f, 0.6f, 0.6f };
-    mMainPassCB.Lights[1].Direction = { -0.57735f, -0.57735f, 0.57735f };
-    mMainPassCB.Lights[1].Strength = { 0.3f, 0.3f, 0.3f };
-    mMainPassCB.Lights[2].Direction = { 0.0f, -0.707f, -0.707f };
-    mMainPassCB.Lights[2].Strength = { 0.15f, 0.15f, 0.15f };
-
-    auto currPassCB = mCurrFrameResource->PassCB.get();
-    currPassCB->CopyData(0, mMainPassCB);
+    LightClusters::GetSliceParameters(mMainPassCB.NearZ, mMainPassCB.FarZ,
+        &mMainPassCB.ClusterSliceScale, &mMainPassCB.ClusterSliceBias);
+
+    mPassCBAddress = mUploadRing->AllocateConstants(mMainPassCB);
 }
 
-void Renderer::LoadTextures()
+void Renderer::UpdateLightCB(const GameTimer& gt)
 {
-    std::unique_ptr<uint8_t[]> textureData;
-    std::vector<D3D12_SUBRESOURCE_DATA> subresources;
-
-    auto grassTex = std::make_unique<Texture>();
-    grassTex->Name = "grassTex";
-
-    ThrowIfFailed(LoadDDSTextureFromFile(md3dDevice.Get(), L"Textures/grass.dds", &grassTex->Resource, textureData, subresources));
-    grassTex->Resource->SetName(L"grass Texture");
-    
-    const UINT64 uploadBufferSize = GetRequiredIntermediateSize(grassTex->Resource.Get(), 0, static_cast<UINT>(subresources.size()));
+    // Same scheme as the materials: a change sets mLightFramesDirty to
+    // gNumFrameResources and each frame resource picks it up once.
+    if (mLightFramesDirty > 0)
+    {
+        mCurrFrameResource->LightCB->CopyData(0, mLightConstants);
+        mLightFramesDirty--;
+    }
+}
 
-    CD3DX12_HEAP_PROPERTIES heapProps(D3D12_HEAP_TYPE_UPLOAD);
+void Renderer::UpdateLightClusters(const GameTimer& gt)
+{
+    // Rebinned every frame since the clusters move with the camera; the
+    // binning itself fans out over the job system.
+    mLightClusters.Build(mSceneLights.data(), (UINT)mSceneLights.size(), mCamera, mJobSystem.get());
+
+    const auto& visibleLights = mLightClusters.VisibleLights();
+    const auto& ranges = mLightClusters.Ranges();
+    const auto& indices = mLightClusters.Indices();
+    mClusterLightsAddress = mUploadRing->AllocateArray(visibleLights.data(), visibleLights.size());
+    mClusterRangesAddress = mUploadRing->AllocateArray(ranges.data(), ranges.size());
+    mClusterIndicesAddress = mUploadRing->AllocateArray(indices.data(), indices.size());
+}
 
-    ThrowIfFailed(
-        md3dDevice->CreateCommittedResource(
-            &heapProps,
-            D3D12_HEAP_FLAG_NONE,
-            &CD3DX12_RESOURCE_DESC::Buffer(uploadBufferSize),
-            D3D12_RESOURCE_STATE_GENERIC_READ,
-            nullptr,
-            IID_PPV_ARGS(&grassTex->UploadHeap)));
+void Renderer::LoadTextures()
+{
+    // Every texture goes through the same staging budget, straight from the
+    // mapped DDS files.
+    const UINT64 stagingBytes = 8 * 1024 * 1024;
+    mTextureUploader = std::make_unique<TextureUploader>(md3dDevice.Get(), mCommandQueue.Get(), stagingBytes);
 
-    UpdateSubresources(mCommandList.Get(), grassTex->Resource.Get(), grassTex->UploadHeap.Get(),
-        0, 0, static_cast<UINT>(subresources.size()), subresources.data());
-    mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(grassTex->Resource.Get(),
-        D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+    // Only the coarse levels are loaded here; the rest stream in once
+    // something drawn with the texture is seen close enough.
+    TextureStreamerDesc streamerDesc;
+    mTextureStreamer.Initialize(md3dDevice.Get(), mTextureUploader.get(), streamerDesc);
 
+    struct TextureLoad
+    {
+        std::unique_ptr<DdsFile> File = std::make_unique<DdsFile>();
+    };
+    auto grass = std::make_shared<TextureLoad>();
+
+    // grass.dds is only ever read here; after changing grass.jpg, cook it
+    // offline with "-cook-textures Textures Textures".  The back buffer is
+    // not sRGB, so the cooked sRGB data is sampled as is.
+    AssetLoader::Request request;
+    request.Name = "grass";
+    request.Priority = AssetPriority::High;
+    request.Read = [grass]()
+    {
+        if (!grass->File->Open(L"Textures/grass.dds", true))
+            return false;
 
-    mTextures[grassTex->Name] = std::move(grassTex);
+        const DdsFile& dds = *grass->File;
+        AssetLoader::Prefetch(dds.Subresource(0).pData, dds.FileSize() - dds.GetLevel(0).Offset);
+        return true;
+    };
+    request.Ready = [this, grass](bool loaded) -> UINT64
+    {
+        if (!loaded)
+            return 0;
+
+        const UINT64 staged = mTextureUploader->GetStats().BytesStaged;
+        mTextureStreamer.Add(std::move(grass->File), mGrassTex);
+        mTextureStreamer.CreateViews(mGrassTex, mSrvDescriptorHeap.Get(), mCbvSrvUavDescriptorSize, 2, 3, SrvTableSize);
+        mTextureStreamer.Bind(mGrassTex, mMaterials.Get(mGrassMat));
+        return mTextureUploader->GetStats().BytesStaged - staged;
+    };
+    mAssetLoader.Load(std::move(request));
 }
 
 void Renderer::LoadCharacters()
 {
-    FbxManager* mfbxManager = FbxManager::Create();
-    FbxIOSettings* ios = FbxIOSettings::Create(mfbxManager, IOSROOT);
-    mfbxManager->SetIOSettings(ios);
-    FbxImporter* mfbxImporter = FbxImporter::Create(mfbxManager, "");
-    FbxScene* mfbxScene = FbxScene::Create(mfbxManager, "");
-
-    mfbxImporter->Initialize("Models/Remy.fbx", -1, mfbxManager->GetIOSettings());
-    mfbxImporter->Import(mfbxScene);
-
-    mfbxScene->GetGlobalSettings().SetAxisSystem(FbxAxisSystem::DirectX);
-
-    FbxGeometryConverter geometryConverter(mfbxManager);
-    geometryConverter.Triangulate(mfbxScene, true);
-
-    mfbxImporter->Destroy();
-
-    FbxNode* lRootNode = mfbxScene->GetRootNode();
-
-    std::vector<Vertex> vertices;
-    std::vector<std::uint16_t> indices;
-
-    for (int k = 0; k < lRootNode->GetChildCount(); k++) {
-        FbxMeshData meshdata;
-
-        FbxNode* mNode = lRootNode->GetChild(k);
-
-        FbxNodeAttribute* attribute = mNode->GetNodeAttribute();
-
-        if (attribute->GetAttributeType() == FbxNodeAttribute::eMesh) {
-            FbxMesh* mesh = mNode->GetMesh();
-            int vertexcount = mesh->GetControlPointsCount();
+    // The geometry is registered now, so that it is numbered before the
+    // terrain chunks; its buffers and render items come with the asset.
+    auto geo = std::make_unique<MeshGeometry>();
+    geo->Name = "Character";
+    MeshGeometry* characterGeo = geo.get();
+    mCharacterGeo = mGeometries.Add(Names::Intern(characterGeo->Name), std::move(geo));
+    characterGeo->GeoIndex = mCharacterGeo.Index;
 
-            FbxVector4* controlPoints = mesh->GetControlPoints();
-            for (int i = 0; i < vertexcount; ++i) {
-                Vertex tempvertex;
-                tempvertex.Pos.x = static_cast<float>(controlPoints[i].mData[0]);
-                tempvertex.Pos.y = static_cast<float>(controlPoints[i].mData[2]);
-                tempvertex.Pos.z = static_cast<float>(controlPoints[i].mData[1]);
+    struct MeshLoad
+    {
+        MeshFile File;
+        bool Mapped = false;
 
-                vertices.push_back(tempvertex);
-            }
+        // The imported FBX data, if the bake failed.
+        MeshAsset Asset;
+        std::vector<std::uint8_t> IndexData;
+        std::vector<SubmeshGeometry> Submeshes;
+    };
+    auto mesh = std::make_shared<MeshLoad>();
+
+    // Prefer the baked mesh: a single file mapping uploaded straight to the GPU,
+    // with no FBX SDK work.  The FBX path cooks it for the next launch.
+    AssetLoader::Request request;
+    request.Name = "Remy";
+    request.Priority = AssetPriority::Low;
+    request.Read = [mesh]()
+    {
+        mesh->Mapped = mesh->File.Open(L"Models/Remy.mesh");
+        if (mesh->Mapped)
+        {
+            AssetLoader::Prefetch(mesh->File.Vertices(), mesh->File.VertexBufferByteSize());
+            AssetLoader::Prefetch(mesh->File.Indices(), mesh->File.IndexBufferByteSize());
+        }
+        return true;
+    };
+    request.Decode = [mesh]()
+    {
+        if (mesh->Mapped)
+            return true;
 
-            uint16_t arrIdx[3];
-            int polygonCount = mesh->GetPolygonCount();
+        {
+            std::lock_guard<std::mutex> lock(gFbxMutex);
+            if (!MeshImporter::ImportFbx("Models/Remy.fbx", mesh->Asset))
+                return false;
+        }
 
+        mesh->Mapped = MeshFile::Write(L"Models/Remy.mesh", mesh->Asset) && mesh->File.Open(L"Models/Remy.mesh");
+        if (!mesh->Mapped)
+        {
+            ::OutputDebugStringA("Models/Remy.mesh: bake failed, using the imported FBX data\n");
+            mesh->Asset.PackIndices(mesh->IndexData, mesh->Submeshes);
+        }
+        return true;
+    };
+    request.Ready = [this, mesh](bool loaded) -> UINT64
+    {
+        if (!loaded)
+            return 0;
 
-            for (int i = 0; i < polygonCount; i++) // ﰢ 
+        const UINT64 staged = mTextureUploader->GetStats().BytesStaged;
+        if (mesh->Mapped)
+        {
+            const MeshFile& file = mesh->File;
+            std::vector<SubmeshGeometry> submeshes(file.GetHeader().SubmeshCount);
+            std::vector<std::string> names(submeshes.size());
+            for (size_t i = 0; i < submeshes.size(); ++i)
             {
-                for (int j = 0; j < 3; j++) // ﰢ    
-                {
-                    uint16_t controlPointIndex = mesh->GetPolygonVertex(i, j); //  ε 
-                    arrIdx[j] = controlPointIndex;
-                }
-
-                indices.push_back(arrIdx[0]);
-                indices.push_back(arrIdx[2]);
-                indices.push_back(arrIdx[1]);
-
+                submeshes[i] = file.Submeshes()[i].Geometry;
+                names[i] = file.Submeshes()[i].Name;
             }
 
-            meshdata.MeshName = mesh->GetName();
-            meshdata.VertexSize = vertexcount;
-            meshdata.IndexSize = polygonCount * 3;
-
-            meshes.push_back(meshdata);
+            LoadCharacterGeometry(file.Vertices(), file.VertexBufferByteSize(),
+                file.Indices(), file.IndexBufferByteSize(),
+                submeshes.data(), names.data(), (UINT)submeshes.size());
+        }
+        else
+        {
+            const MeshAsset& asset = mesh->Asset;
+            LoadCharacterGeometry(asset.Vertices.data(), (UINT)(asset.Vertices.size() * sizeof(Vertex)),
+                mesh->IndexData.data(), (UINT)mesh->IndexData.size(),
+                mesh->Submeshes.data(), asset.SubmeshNames.data(), (UINT)mesh->Submeshes.size());
         }
-    }
-
-    const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
-    const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
-
-    auto geo = std::make_unique<MeshGeometry>();
-    geo->Name = "Character";
 
-    ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
-    CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
+        BuildCharacterItems();
+        return mTextureUploader->GetStats().BytesStaged - staged;
+    };
+    mAssetLoader.Load(std::move(request));
+}
 
-    ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-    CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
+void Renderer::LoadCharacterGeometry(const void* vertices, UINT vbByteSize, const void* indices, UINT ibByteSize,
+    const SubmeshGeometry* submeshes, const std::string* names, UINT submeshCount)
+{
+    MeshGeometry* geo = mGeometries.Get(mCharacterGeo);
 
-    geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-        mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
+    // No system memory copy is kept: the source is either a file mapping or a
+    // temporary import, and nothing reads the character geometry back on the CPU.
+    geo->VertexBufferGPU = mTextureUploader->UploadBuffer(vertices, vbByteSize,
+        D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
 
-    geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-        mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
+    geo->IndexBufferGPU = mTextureUploader->UploadBuffer(indices, ibByteSize,
+        D3D12_RESOURCE_STATE_INDEX_BUFFER);
 
     geo->VertexByteStride = sizeof(Vertex);
     geo->VertexBufferByteSize = vbByteSize;
-    geo->IndexFormat = DXGI_FORMAT_R16_UINT;
+    // Index width varies per submesh; render items take it from their SubmeshGeometry.
+    geo->IndexFormat = submeshCount > 0 ? submeshes[0].IndexFormat : DXGI_FORMAT_R16_UINT;
     geo->IndexBufferByteSize = ibByteSize;
 
-    UINT indexlocation = 0;
-    UINT vertexlocation = 0;
+    const UINT vertexCount = vbByteSize / sizeof(Vertex);
+    for (UINT i = 0; i < submeshCount; i++) {
+        FbxMeshData meshdata;
+        meshdata.MeshName = names[i];
+        meshdata.IndexSize = submeshes[i].IndexCount;
+        meshdata.VertexSize = (i + 1 < submeshCount ? submeshes[i + 1].BaseVertexLocation : vertexCount) - submeshes[i].BaseVertexLocation;
+        meshes.push_back(meshdata);
 
-    for (int i = 0; i < meshes.size(); i++) {
-        SubmeshGeometry submesh;
-        submesh.IndexCount = meshes[i].IndexSize;
-        submesh.StartIndexLocation = indexlocation;
-        submesh.BaseVertexLocation = vertexlocation;
+        geo->AddSubmesh(Names::Intern(names[i]), submeshes[i]);
+    }
+}
 
-        indexlocation += meshes[i].IndexSize;
-        vertexlocation += meshes[i].VertexSize;
+void Renderer::LoadAnimations()
+{
+    struct AnimationLoad
+    {
+        Skeleton Rig;
+        std::vector<AnimationClip> Clips;
+    };
+    auto animation = std::make_shared<AnimationLoad>();
 
-        geo->DrawArgs[meshes[i].MeshName] = submesh;
-    }
+    // The FBX SDK does its own reading, so all of it is a Decode step.
+    AssetLoader::Request request;
+    request.Name = "Walking";
+    request.Decode = [animation]()
+    {
+        std::lock_guard<std::mutex> lock(gFbxMutex);
+        return AnimationImporter::LoadFbx("Models/Walking.fbx", animation->Rig, animation->Clips) && !animation->Clips.empty();
+    };
+    request.Ready = [this, animation](bool loaded) -> UINT64
+    {
+        if (!loaded)
+        {
+            ::OutputDebugStringA("Models/Walking.fbx: no skeleton or animation found\n");
+            return 0;
+        }
 
-    mGeometries[geo->Name] = std::move(geo);
+        // The animation job picks these up from this frame on.
+        mSkeleton = std::move(animation->Rig);
+        mAnimationClips = std::move(animation->Clips);
+        mAnimationSystem.SetSkeleton(&mSkeleton);
+        mAnimationSystem.AddInstance(&mAnimationClips[0]);
+        return 0;
+    };
+    mAssetLoader.Load(std::move(request));
 }
 
 float Renderer::GetTerrainHeight(float x, float z)
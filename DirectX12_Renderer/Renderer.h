@@ -7,6 +7,26 @@
 #include "UploadBuffer.h"
 #include "FrameResource.h"
 #include "GeometryGenerator.h"
+#include "Animation.h"
+#include "AnimationImporter.h"
+#include "MeshFile.h"
+#include "MeshImporter.h"
+#include "MeshOptimizer.h"
+#include "SceneBvh.h"
+#include "InstanceBatcher.h"
+#include "DrawQueue.h"
+#include "DrawRecorder.h"
+#include "RenderCommandStream.h"
+#include "JobSystem.h"
+#include "UploadRing.h"
+#include "LightClusters.h"
+#include "TerrainStreamer.h"
+#include "HeightField.h"
+#include "TransformSystem.h"
+#include "GpuTimeline.h"
+#include "TextureUploader.h"
+#include "TextureStreamer.h"
+#include "AssetLoader.h"
 #include "DDSTextureLoader.h"
 #include <DirectXColors.h>
 #include <fbxsdk.h>
@@ -50,15 +70,26 @@ private:
     void BuildDescriptorHeaps();
     void BuildBoxGeometry();
     void BuildMaterials();
+    void BuildLights();
+    void BuildTerrain();
 
     void BuildRenderItems();
+    void BuildCharacterItems();
     void BuildFrameResources();
-    void UpdateObjectCBs(const GameTimer& gt);
+    void UpdateDrawConstants(const GameTimer& gt);
     void UpdateMainPassCB(const GameTimer& gt);
     void UpdateMaterialCBs(const GameTimer& gt);
+    void UpdateLightCB(const GameTimer& gt);
+    void UpdateLightClusters(const GameTimer& gt);
+    // Runs as a job, so it returns the result of closing the list rather
+    // than throwing; the caller checks it after the jobs are done.
+    HRESULT RecordDrawChunk(UINT chunk, UINT chunkCount, const DrawBindings& bindings);
 
     void LoadTextures();
     void LoadCharacters();
+    void LoadCharacterGeometry(const void* vertices, UINT vbByteSize, const void* indices, UINT ibByteSize,
+        const SubmeshGeometry* submeshes, const std::string* names, UINT submeshCount);
+    void LoadAnimations();
     
 
     float GetTerrainHeight(float x, float z);
@@ -71,13 +102,15 @@ private:
     ComPtr<IDXGISwapChain> mSwapChain;
     ComPtr<ID3D12Device> md3dDevice;
 
-    ComPtr<ID3D12Fence> mFence;
-    UINT64 mCurrentFence = 0;
+    std::unique_ptr<D3D12Timeline> mFence;
 
     ComPtr<ID3D12CommandQueue> mCommandQueue;
     ComPtr<ID3D12CommandAllocator> mDirectCmdListAlloc;
     ComPtr<ID3D12GraphicsCommandList> mCommandList;
 
+    // Records ImGui and the present barrier after the scene chunks.
+    ComPtr<ID3D12GraphicsCommandList> mPostCommandList;
+
     static const int SwapChainBufferCount = 2;
     int mCurrBackBuffer = 0;
     ComPtr<ID3D12Resource> mSwapChainBuffer[SwapChainBufferCount];
@@ -112,24 +145,109 @@ private:
     ComPtr<ID3DBlob> serializedRootSig = nullptr;
     ComPtr<ID3DBlob> errorBlob = nullptr;
 
-    std::unordered_map<std::string, std::unique_ptr<MeshGeometry>> mGeometries;
-    std::unordered_map<std::string, std::unique_ptr<Material>> mMaterials;
-    std::unordered_map<std::string, std::unique_ptr<Texture>> mTextures;
+    Registry<MeshGeometry> mGeometries;
+    Registry<Material> mMaterials;
+
+    // Resolved once when the resources are created, so building and spawning
+    // render items never looks anything up by name.
+    Handle<MeshGeometry> mBoxGeo;
+    UINT mBoxSubmesh = 0;
+    Handle<MeshGeometry> mCharacterGeo;
+    Handle<Material> mGrassMat;
+    UINT mGrassTex = 0;             // In mTextureStreamer.
 
     std::unique_ptr<UploadBuffer<ObjectConstants>> mObjectCB = nullptr;
 
     ComPtr<ID3DBlob> mVertexShader = nullptr;
+    ComPtr<ID3DBlob> mInstancedVertexShader = nullptr;
     ComPtr<ID3DBlob> mPixelShader = nullptr;
 
     std::vector<std::unique_ptr<RenderItem>> mAllRitems;
     std::vector<RenderItem*> mOpaqueRitems;
 
+    // Parent/child placement of the render items; owns their World matrices.
+    TransformSystem mTransforms;
+
+    // Opaque items that survived frustum culling this frame.
+    SceneBvh mSceneBvh;
+
+    // Terrain chunks streamed around the camera from GetTerrainHeight; their
+    // selected LOD nodes are added to the visible list after the BVH cull.
+    TerrainStreamer mTerrainStreamer;
+    std::vector<RenderItem*> mVisibleRitems;
+
+    // GetTerrainHeight cached at 1 m around the origin, for placement queries.
+    HeightField mHeightField;
+
+    // Visible items grouped by (Geo, Mat, submesh) for instanced drawing.
+    InstanceBatcher mInstanceBatcher;
+
+    DrawQueue mDrawQueue;
+
+    // Update and Draw fan out over all cores through the job system.
+    std::unique_ptr<JobSystem> mJobSystem;
+    static constexpr UINT DrawConstantsGrain = 256;
+
+    // Pass, object and instance data for the frames in flight.  Starts with
+    // room for every item drawn singly each frame and doubles when a frame
+    // runs out.
+    std::unique_ptr<UploadRing> mUploadRing;
+    D3D12_GPU_VIRTUAL_ADDRESS mPassCBAddress = 0;
+
+    // Texture data from mapped DDS files, through one staging ring.
+    std::unique_ptr<TextureUploader> mTextureUploader;
+
+    // Mip levels of the streamed textures, following the visible items.
+    TextureStreamer mTextureStreamer;
+
+    // Entries in root parameter 0's SRV table (t0 texture, t1 ImGui).  Every
+    // slot a material can bind as the table's base needs this many views.
+    static constexpr UINT SrvTableSize = 2;
+
+    // Textures, animations and the character load in the background and join
+    // the scene as they arrive.  Startup is timed from Initialize.
+    AssetLoader mAssetLoader;
+    double mStartTime = 0.0;
+    double mFirstFrameSeconds = 0.0;
+    double mLoadedSeconds = 0.0;
+
+    // The draw queue is split into up to mRecordChunkCount contiguous chunks,
+    // each recorded as a job into the frame resource's chunk list.  Chunks
+    // smaller than MinDrawsPerChunk are not worth a thread.
+    static constexpr UINT MaxRecordChunks = 8;
+    static constexpr UINT MinDrawsPerChunk = 64;
+    std::vector<RenderCommandStream> mChunkStreams;
+    std::vector<D3D12CommandBackend> mChunkBackends;
+    std::vector<DrawRecorder> mChunkRecorders;
+    UINT mRecordChunkCount = 0;
+
+    // Viewport, clears and barriers recorded on the main thread.
+    RenderCommandStream mPreStream;
+    D3D12CommandBackend mFrameBackend;
+
+    // Debug builds replay each frame's streams through the null device.
+    NullCommandBackend mCommandValidator;
+
     PassConstants mMainPassCB;
+
+    // Copied into the frame resources' LightCB while mLightFramesDirty > 0.
+    LightConstants mLightConstants;
+    int mLightFramesDirty = 0;
+
+    // Point and spot lights in world space, binned into view clusters every
+    // frame.  Not limited by MaxLights; the visible ones and the cluster lists
+    // go into the upload ring.
+    std::vector<Light> mSceneLights;
+    LightClusters mLightClusters;
+    D3D12_GPU_VIRTUAL_ADDRESS mClusterLightsAddress = 0;
+    D3D12_GPU_VIRTUAL_ADDRESS mClusterRangesAddress = 0;
+    D3D12_GPU_VIRTUAL_ADDRESS mClusterIndicesAddress = 0;
     UINT mPassCbvOffset = 0;
 
     std::vector<D3D12_INPUT_ELEMENT_DESC> mInputLayout;
 
     ComPtr<ID3D12PipelineState> mPSO = nullptr;
+    ComPtr<ID3D12PipelineState> mInstancedPSO = nullptr;
 
     XMFLOAT3 mEyePos = { 0.0f, 0.0f, 0.0f };
     XMFLOAT4X4 mView = MathHelper::Identity4x4();
@@ -137,6 +255,12 @@ private:
 
     std::vector<FbxMeshData> meshes;
 
+    // CPU skinning palettes for the character, evaluated within a fixed per-frame budget.
+    static constexpr float AnimationBudgetMs = 2.0f;
+    Skeleton mSkeleton;
+    std::vector<AnimationClip> mAnimationClips;
+    AnimationSystem mAnimationSystem;
+
     Camera mCamera;
 
     float mTheta = 1.5f * XM_PI;
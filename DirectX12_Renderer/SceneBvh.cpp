@@ -0,0 +1,268 @@
+#include "SceneBvh.h"
+#include <numeric>
+
+using namespace DirectX;
+
+namespace
+{
+    enum class Containment { Outside, Intersects, Inside };
+
+    // Box vs. eight planes, four per iteration.  The box is outside if its
+    // projected radius cannot reach the inside of any plane, inside if it is
+    // fully on the inside of every plane.
+    Containment Classify(const FrustumPlanes& f, const XMFLOAT3& center, const XMFLOAT3& extents)
+    {
+        const XMVECTOR cx = XMVectorReplicate(center.x);
+        const XMVECTOR cy = XMVectorReplicate(center.y);
+        const XMVECTOR cz = XMVectorReplicate(center.z);
+        const XMVECTOR ex = XMVectorReplicate(extents.x);
+        const XMVECTOR ey = XMVectorReplicate(extents.y);
+        const XMVECTOR ez = XMVectorReplicate(extents.z);
+
+        XMVECTOR outside = XMVectorFalseInt();
+        XMVECTOR crossing = XMVectorFalseInt();
+        for (int g = 0; g < 2; ++g)
+        {
+            XMVECTOR dist = XMVectorMultiplyAdd(cx, f.X[g], XMVectorMultiplyAdd(cy, f.Y[g], XMVectorMultiplyAdd(cz, f.Z[g], f.W[g])));
+            XMVECTOR radius = XMVectorMultiplyAdd(ex, f.AbsX[g], XMVectorMultiplyAdd(ey, f.AbsY[g], XMVectorMultiply(ez, f.AbsZ[g])));
+
+            outside = XMVectorOrInt(outside, XMVectorLess(XMVectorAdd(dist, radius), XMVectorZero()));
+            crossing = XMVectorOrInt(crossing, XMVectorLess(XMVectorSubtract(dist, radius), XMVectorZero()));
+        }
+
+        if (!XMComparisonAllTrue(XMVector4EqualIntR(outside, XMVectorFalseInt())))
+            return Containment::Outside;
+        if (!XMComparisonAllTrue(XMVector4EqualIntR(crossing, XMVectorFalseInt())))
+            return Containment::Intersects;
+        return Containment::Inside;
+    }
+
+    float Component(const XMFLOAT3& v, int axis)
+    {
+        return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+    }
+}
+
+void FrustumPlanes::Set(const XMFLOAT4 planes[6])
+{
+    const XMFLOAT4& p0 = planes[0];
+    const XMFLOAT4& p1 = planes[1];
+    const XMFLOAT4& p2 = planes[2];
+    const XMFLOAT4& p3 = planes[3];
+    const XMFLOAT4& p4 = planes[4];
+    const XMFLOAT4& p5 = planes[5];
+
+    X[0] = XMVectorSet(p0.x, p1.x, p2.x, p3.x);
+    Y[0] = XMVectorSet(p0.y, p1.y, p2.y, p3.y);
+    Z[0] = XMVectorSet(p0.z, p1.z, p2.z, p3.z);
+    W[0] = XMVectorSet(p0.w, p1.w, p2.w, p3.w);
+
+    X[1] = XMVectorSet(p4.x, p5.x, p5.x, p5.x);
+    Y[1] = XMVectorSet(p4.y, p5.y, p5.y, p5.y);
+    Z[1] = XMVectorSet(p4.z, p5.z, p5.z, p5.z);
+    W[1] = XMVectorSet(p4.w, p5.w, p5.w, p5.w);
+
+    for (int g = 0; g < 2; ++g)
+    {
+        AbsX[g] = XMVectorAbs(X[g]);
+        AbsY[g] = XMVectorAbs(Y[g]);
+        AbsZ[g] = XMVectorAbs(Z[g]);
+    }
+}
+
+bool FrustumPlanes::Intersects(const XMFLOAT3& center, const XMFLOAT3& extents)const
+{
+    return Classify(*this, center, extents) != Containment::Outside;
+}
+
+void SceneBvh::Build(RenderItem* const* items, UINT itemCount)
+{
+    // items may point into mItems when rebuilding, so copy before touching it.
+    std::vector<RenderItem*> source(items, items + itemCount);
+    mItems.swap(source);
+
+    mItemBounds.resize(itemCount);
+    for (UINT i = 0; i < itemCount; ++i)
+        UpdateItemBounds(i);
+
+    mNodes.clear();
+    mNodes.reserve(2 * (itemCount / LeafSize + 1));
+    mMovedSinceBuild = 0;
+
+    if (itemCount > 0)
+        BuildNode(0, itemCount);
+}
+
+UINT SceneBvh::BuildNode(UINT first, UINT count)
+{
+    const UINT index = (UINT)mNodes.size();
+    mNodes.emplace_back();
+
+    BoundingBox bounds = mItemBounds[first];
+    XMVECTOR centroidMin = XMLoadFloat3(&bounds.Center);
+    XMVECTOR centroidMax = centroidMin;
+    for (UINT i = first + 1; i < first + count; ++i)
+    {
+        BoundingBox::CreateMerged(bounds, bounds, mItemBounds[i]);
+
+        XMVECTOR c = XMLoadFloat3(&mItemBounds[i].Center);
+        centroidMin = XMVectorMin(centroidMin, c);
+        centroidMax = XMVectorMax(centroidMax, c);
+    }
+
+    Node node;
+    node.Center = bounds.Center;
+    node.Extents = bounds.Extents;
+
+    if (count <= LeafSize)
+    {
+        node.First = first;
+        node.Count = count;
+        mNodes[index] = node;
+        return index;
+    }
+
+    // Median split along the axis with the widest spread of centroids.
+    XMFLOAT3 spread;
+    XMStoreFloat3(&spread, centroidMax - centroidMin);
+    const int axis = (spread.x >= spread.y && spread.x >= spread.z) ? 0 : (spread.y >= spread.z ? 1 : 2);
+
+    std::vector<UINT> order(count);
+    std::iota(order.begin(), order.end(), first);
+    std::nth_element(order.begin(), order.begin() + count / 2, order.end(), [&](UINT a, UINT b)
+    {
+        return Component(mItemBounds[a].Center, axis) < Component(mItemBounds[b].Center, axis);
+    });
+
+    std::vector<RenderItem*> items(count);
+    std::vector<BoundingBox> itemBounds(count);
+    for (UINT i = 0; i < count; ++i)
+    {
+        items[i] = mItems[order[i]];
+        itemBounds[i] = mItemBounds[order[i]];
+    }
+    std::copy(items.begin(), items.end(), mItems.begin() + first);
+    std::copy(itemBounds.begin(), itemBounds.end(), mItemBounds.begin() + first);
+
+    BuildNode(first, count / 2);
+    node.First = BuildNode(first + count / 2, count - count / 2);
+    node.Count = 0;
+    mNodes[index] = node;
+    return index;
+}
+
+void SceneBvh::UpdateItemBounds(UINT item)
+{
+    RenderItem* ri = mItems[item];
+    ri->Bounds.Transform(mItemBounds[item], XMLoadFloat4x4(&ri->World));
+    ri->BoundsDirty = false;
+}
+
+bool SceneBvh::Refit()
+{
+    UINT moved = 0;
+    for (UINT i = 0; i < (UINT)mItems.size(); ++i)
+    {
+        if (mItems[i]->BoundsDirty)
+        {
+            UpdateItemBounds(i);
+            moved++;
+        }
+    }
+
+    if (moved == 0)
+        return false;
+
+    mMovedSinceBuild += moved;
+    if (mMovedSinceBuild > mItems.size())
+    {
+        Build(mItems.data(), (UINT)mItems.size());
+        return true;
+    }
+
+    // Children always follow their parent, so a reverse walk sees them first.
+    for (UINT n = (UINT)mNodes.size(); n-- > 0; )
+    {
+        Node& node = mNodes[n];
+
+        BoundingBox bounds;
+        if (node.Count > 0)
+        {
+            bounds = mItemBounds[node.First];
+            for (UINT i = node.First + 1; i < node.First + node.Count; ++i)
+                BoundingBox::CreateMerged(bounds, bounds, mItemBounds[i]);
+        }
+        else
+        {
+            const Node& left = mNodes[n + 1];
+            const Node& right = mNodes[node.First];
+            BoundingBox::CreateMerged(bounds, BoundingBox(left.Center, left.Extents), BoundingBox(right.Center, right.Extents));
+        }
+
+        node.Center = bounds.Center;
+        node.Extents = bounds.Extents;
+    }
+
+    return true;
+}
+
+void SceneBvh::Cull(const FrustumPlanes& frustum, std::vector<RenderItem*>& visible)
+{
+    visible.clear();
+    mStats = Stats();
+
+    if (mNodes.empty())
+        return;
+
+    // Median splits keep the tree balanced, so depth stays near log2(n / LeafSize).
+    UINT stack[64];
+    UINT top = 0;
+    stack[top++] = 0;
+
+    while (top > 0)
+    {
+        const UINT n = stack[--top];
+        const Node& node = mNodes[n];
+        mStats.NodesVisited++;
+
+        Containment c = Classify(frustum, node.Center, node.Extents);
+        if (c == Containment::Outside)
+            continue;
+
+        if (c == Containment::Inside)
+        {
+            AppendSubtree(n, visible);
+            continue;
+        }
+
+        if (node.Count > 0)
+        {
+            for (UINT i = node.First; i < node.First + node.Count; ++i)
+            {
+                mStats.ItemsTested++;
+                if (Classify(frustum, mItemBounds[i].Center, mItemBounds[i].Extents) != Containment::Outside)
+                    visible.push_back(mItems[i]);
+            }
+        }
+        else
+        {
+            stack[top++] = node.First;
+            stack[top++] = n + 1;
+        }
+    }
+
+    mStats.ItemsVisible = (UINT)visible.size();
+}
+
+void SceneBvh::AppendSubtree(UINT n, std::vector<RenderItem*>& visible)
+{
+    const Node& node = mNodes[n];
+    if (node.Count > 0)
+    {
+        visible.insert(visible.end(), mItems.begin() + node.First, mItems.begin() + node.First + node.Count);
+        return;
+    }
+
+    AppendSubtree(n + 1, visible);
+    AppendSubtree(node.First, visible);
+}
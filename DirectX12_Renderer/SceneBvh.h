@@ -0,0 +1,81 @@
+#pragma once
+
+#include "Datatypes.h"
+
+// World-space frustum planes stored SoA so one XMVECTOR holds the same
+// component of four planes.  The six planes are padded to eight by repeating
+// the far plane, and each plane keeps its inside half-space at dot(n, p) + d >= 0.
+struct FrustumPlanes
+{
+    DirectX::XMVECTOR X[2];
+    DirectX::XMVECTOR Y[2];
+    DirectX::XMVECTOR Z[2];
+    DirectX::XMVECTOR W[2];
+
+    // |X|, |Y|, |Z| for projecting box extents onto the plane normals.
+    DirectX::XMVECTOR AbsX[2];
+    DirectX::XMVECTOR AbsY[2];
+    DirectX::XMVECTOR AbsZ[2];
+
+    void Set(const DirectX::XMFLOAT4 planes[6]);
+
+    // False only when the box is entirely outside one of the planes.
+    bool Intersects(const DirectX::XMFLOAT3& center, const DirectX::XMFLOAT3& extents)const;
+};
+
+// Bounding volume hierarchy over RenderItems used to build the visible draw list.
+//   - Build sorts the items into a binary tree of world-space AABBs (median split
+//     on the longest centroid axis, up to LeafSize items per leaf).
+//   - Refit recomputes the boxes of items whose BoundsDirty flag is set and walks
+//     the tree bottom-up; the tree is rebuilt instead once too many items moved.
+//   - Cull tests nodes against all frustum planes four at a time and accepts whole
+//     subtrees without further tests once a node is fully inside.
+class SceneBvh
+{
+public:
+    static const UINT LeafSize = 4;
+
+    struct Stats
+    {
+        UINT NodesVisited = 0;
+        UINT ItemsTested = 0;
+        UINT ItemsVisible = 0;
+    };
+
+    void Build(RenderItem* const* items, UINT itemCount);
+
+    // Returns true if anything moved.
+    bool Refit();
+
+    void Cull(const FrustumPlanes& frustum, std::vector<RenderItem*>& visible);
+
+    UINT ItemCount()const { return (UINT)mItems.size(); }
+    UINT NodeCount()const { return (UINT)mNodes.size(); }
+    const Stats& GetStats()const { return mStats; }
+
+private:
+    // Leaves have Count > 0 and own mItems[First, First + Count).  Interior nodes
+    // have Count == 0; their left child directly follows them and First is the right child.
+    struct Node
+    {
+        DirectX::XMFLOAT3 Center;
+        UINT First;
+        DirectX::XMFLOAT3 Extents;
+        UINT Count;
+    };
+
+    UINT BuildNode(UINT first, UINT count);
+    void UpdateItemBounds(UINT item);
+    void AppendSubtree(UINT node, std::vector<RenderItem*>& visible);
+
+private:
+    std::vector<Node> mNodes;
+    std::vector<RenderItem*> mItems;
+    std::vector<DirectX::BoundingBox> mItemBounds;
+
+    // Item moves absorbed by refitting since the last build.  Once this passes
+    // the item count the boxes are likely loose enough that a rebuild pays off.
+    UINT mMovedSinceBuild = 0;
+
+    Stats mStats;
+};
@@ -0,0 +1,278 @@
+#include "Terrain.h"
+#include "GeometryGenerator.h"
+#include <cfloat>
+
+using namespace DirectX;
+
+namespace
+{
+    // Squared distance from p to the box, zero inside.
+    float DistanceSq(const XMFLOAT3& p, const XMFLOAT3& center, const XMFLOAT3& extents)
+    {
+        const float dx = std::max(fabsf(p.x - center.x) - extents.x, 0.0f);
+        const float dy = std::max(fabsf(p.y - center.y) - extents.y, 0.0f);
+        const float dz = std::max(fabsf(p.z - center.z) - extents.z, 0.0f);
+        return dx * dx + dy * dy + dz * dz;
+    }
+
+    // Grid vertex k of edge e of an r x r quad grid, walking the perimeter
+    // clockwise seen from above: north edge west to east, east edge north to
+    // south, south edge east to west, west edge south to north.
+    UINT EdgeVertex(UINT e, UINT k, UINT r)
+    {
+        const UINT side = r + 1;
+        switch (e)
+        {
+        case 0: return k;
+        case 1: return k * side + r;
+        case 2: return r * side + r - k;
+        default: return (r - k) * side;
+        }
+    }
+}
+
+void Terrain::Build(const TerrainDesc& desc, const HeightFunction& height)
+{
+    assert(desc.LodCount >= 1 && desc.LodCount <= MaxLodCount);
+
+    mDesc = desc;
+    const UINT r = desc.GridResolution;
+    const UINT side = r + 1;
+
+    // The grid, then one skirt row of side vertices per edge.
+    mVerticesPerNode = side * side + 4 * side;
+    assert(mVerticesPerNode <= 0x10000 && "node grid too fine for 16-bit indices");
+
+    mIndices = NodeIndices(r);
+
+    mNodes.clear();
+    mNodes.emplace_back();
+    mNodes[0].CenterX = desc.CenterX;
+    mNodes[0].CenterZ = desc.CenterZ;
+    mNodes[0].Size = desc.Size;
+    mNodes[0].Level = desc.LodCount - 1;
+    AddChildren(0);
+
+    mVertices.resize((size_t)mNodes.size() * mVerticesPerNode);
+    for (UINT l = 0; l < MaxLodCount; ++l)
+        mEdgeError[l] = 0.0f;
+    for (UINT n = 0; n < (UINT)mNodes.size(); ++n)
+    {
+        const float error = BuildNodeGrid(n, height);
+        mEdgeError[mNodes[n].Level] = std::max(mEdgeError[mNodes[n].Level], error);
+    }
+
+    // Where a level meets a finer neighbour the two edges can be apart by both
+    // their errors, so the skirt covers twice the worst error at this level
+    // or below, plus a little slack.
+    float finerError = 0.0f;
+    for (UINT l = 0; l < desc.LodCount; ++l)
+    {
+        finerError = std::max(finerError, mEdgeError[l]);
+        const float spacing = desc.Size / (float)(1u << (desc.LodCount - 1 - l)) / r;
+        mSkirtDepth[l] = 2.0f * finerError + 0.1f * spacing;
+    }
+
+    for (UINT n = 0; n < (UINT)mNodes.size(); ++n)
+        ApplySkirts(n);
+}
+
+std::vector<std::uint16_t> Terrain::NodeIndices(UINT gridResolution)
+{
+    const UINT r = gridResolution;
+    const UINT side = r + 1;
+
+    GeometryGenerator geoGen;
+    GeometryGenerator::MeshData grid = geoGen.CreateGrid(1.0f, 1.0f, side, side);
+    std::vector<std::uint16_t> indices = grid.GetIndices16();
+
+    // Skirt quads along the perimeter.  Walking it in one direction lets the
+    // same winding face outward on every edge.
+    for (UINT e = 0; e < 4; ++e)
+    {
+        for (UINT t = 0; t < r; ++t)
+        {
+            const std::uint16_t a = (std::uint16_t)EdgeVertex(e, t, r);
+            const std::uint16_t b = (std::uint16_t)EdgeVertex(e, t + 1, r);
+            const std::uint16_t sa = (std::uint16_t)(side * side + e * side + t);
+            const std::uint16_t sb = (std::uint16_t)(sa + 1);
+
+            indices.insert(indices.end(), { a, sa, b, b, sa, sb });
+        }
+    }
+    return indices;
+}
+
+void Terrain::AddChildren(UINT node)
+{
+    if (mNodes[node].Level == 0)
+        return;
+
+    const UINT first = (UINT)mNodes.size();
+    mNodes.resize(first + 4);
+
+    const Node& parent = mNodes[node];
+    const float half = 0.5f * parent.Size;
+    for (UINT k = 0; k < 4; ++k)
+    {
+        Node& child = mNodes[first + k];
+        child.Size = half;
+        child.Level = parent.Level - 1;
+        child.CenterX = parent.CenterX + ((k & 1) ? 0.5f : -0.5f) * half;
+        child.CenterZ = parent.CenterZ + ((k & 2) ? 0.5f : -0.5f) * half;
+    }
+    mNodes[node].FirstChild = first;
+
+    for (UINT k = 0; k < 4; ++k)
+        AddChildren(first + k);
+}
+
+float Terrain::BuildNodeGrid(UINT n, const HeightFunction& height)
+{
+    Node& node = mNodes[n];
+    const UINT r = mDesc.GridResolution;
+    const UINT side = r + 1;
+    const float spacing = node.Size / r;
+    const float half = 0.5f * node.Size;
+
+    // Heights with a one sample border for the normals.  Same layout as
+    // CreateGrid: row i runs west to east at z = half - i*spacing.
+    const UINT border = side + 2;
+    std::vector<float> h(border * border);
+    for (UINT i = 0; i < border; ++i)
+    {
+        for (UINT j = 0; j < border; ++j)
+        {
+            const float x = -half + ((float)j - 1.0f) * spacing;
+            const float z = half - ((float)i - 1.0f) * spacing;
+            h[i * border + j] = height(node.CenterX + x, node.CenterZ + z);
+        }
+    }
+
+    Vertex* v = &mVertices[(size_t)n * mVerticesPerNode];
+    node.MinY = FLT_MAX;
+    node.MaxY = -FLT_MAX;
+    for (UINT i = 0; i < side; ++i)
+    {
+        for (UINT j = 0; j < side; ++j)
+        {
+            const float x = -half + j * spacing;
+            const float z = half - i * spacing;
+            const float y = h[(i + 1) * border + j + 1];
+
+            // Central differences; row i+1 is further south.
+            const float dx = h[(i + 1) * border + j + 2] - h[(i + 1) * border + j];
+            const float dz = h[i * border + j + 1] - h[(i + 2) * border + j + 1];
+            XMVECTOR normal = XMVector3Normalize(XMVectorSet(-dx, 2.0f * spacing, -dz, 0.0f));
+
+            Vertex& out = v[i * side + j];
+            out.Pos = XMFLOAT3(x, y, z);
+            XMStoreFloat3(&out.Normal, normal);
+            out.Tex = XMFLOAT2((node.CenterX + x) * mDesc.TextureScale, -(node.CenterZ + z) * mDesc.TextureScale);
+
+            node.MinY = std::min(node.MinY, y);
+            node.MaxY = std::max(node.MaxY, y);
+        }
+    }
+
+    // How far the straight edges between this node's vertices stray from the
+    // field, sampled at leaf spacing.
+    float error = 0.0f;
+    const UINT samplesPerQuad = 1u << node.Level;
+    if (samplesPerQuad > 1)
+    {
+        for (UINT e = 0; e < 4; ++e)
+        {
+            for (UINT t = 0; t < r; ++t)
+            {
+                const Vertex& a = v[EdgeVertex(e, t, r)];
+                const Vertex& b = v[EdgeVertex(e, t + 1, r)];
+                for (UINT s = 1; s < samplesPerQuad; ++s)
+                {
+                    const float f = (float)s / samplesPerQuad;
+                    const float x = a.Pos.x + f * (b.Pos.x - a.Pos.x);
+                    const float z = a.Pos.z + f * (b.Pos.z - a.Pos.z);
+                    const float y = a.Pos.y + f * (b.Pos.y - a.Pos.y);
+                    error = std::max(error, fabsf(height(node.CenterX + x, node.CenterZ + z) - y));
+                }
+            }
+        }
+    }
+
+    return error;
+}
+
+void Terrain::ApplySkirts(UINT n)
+{
+    Node& node = mNodes[n];
+    const UINT r = mDesc.GridResolution;
+    const UINT side = r + 1;
+    const float depth = mSkirtDepth[node.Level];
+
+    Vertex* v = &mVertices[(size_t)n * mVerticesPerNode];
+    for (UINT e = 0; e < 4; ++e)
+    {
+        for (UINT k = 0; k <= r; ++k)
+        {
+            Vertex& skirt = v[side * side + e * side + k];
+            skirt = v[EdgeVertex(e, k, r)];
+            skirt.Pos.y -= depth;
+        }
+    }
+
+    const float minY = node.MinY - depth;
+    node.BoundsCenter = XMFLOAT3(node.CenterX, 0.5f * (minY + node.MaxY), node.CenterZ);
+    node.BoundsExtents = XMFLOAT3(0.5f * node.Size, 0.5f * (node.MaxY - minY), 0.5f * node.Size);
+
+    RenderItem& item = node.Item;
+    XMStoreFloat4x4(&item.World, XMMatrixTranslation(node.CenterX, 0.0f, node.CenterZ));
+    item.PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+    item.IndexCount = (UINT)mIndices.size();
+    item.StartIndexLocation = 0;
+    item.BaseVertexLocation = (int)(n * mVerticesPerNode);
+    item.Bounds.Center = XMFLOAT3(0.0f, node.BoundsCenter.y, 0.0f);
+    item.Bounds.Extents = node.BoundsExtents;
+    item.BoundsDirty = true;
+}
+
+void Terrain::SetGeometry(MeshGeometry* geo, Material* mat)
+{
+    for (auto& node : mNodes)
+    {
+        node.Item.Geo = geo;
+        node.Item.Mat = mat;
+    }
+}
+
+void Terrain::Select(const XMFLOAT3& eye, const FrustumPlanes& frustum, std::vector<RenderItem*>& visible)
+{
+    mStats = Stats();
+    if (!mNodes.empty())
+        SelectNode(0, eye, frustum, visible);
+}
+
+void Terrain::SelectNode(UINT n, const XMFLOAT3& eye, const FrustumPlanes& frustum, std::vector<RenderItem*>& visible)
+{
+    Node& node = mNodes[n];
+    mStats.NodesVisited++;
+
+    if (!frustum.Intersects(node.BoundsCenter, node.BoundsExtents))
+        return;
+
+    // Refine while the eye is within the range of the next finer level.
+    if (node.Level > 0)
+    {
+        const float range = LodRange(node.Level - 1);
+        if (DistanceSq(eye, node.BoundsCenter, node.BoundsExtents) < range * range)
+        {
+            for (UINT k = 0; k < 4; ++k)
+                SelectNode(node.FirstChild + k, eye, frustum, visible);
+            return;
+        }
+    }
+
+    visible.push_back(&node.Item);
+    mStats.NodesSelected++;
+    mStats.TrianglesSelected += node.Item.IndexCount / 3;
+    mStats.SelectedPerLevel[node.Level]++;
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "Datatypes.h"
+#include "SceneBvh.h"
+#include <functional>
+
+struct TerrainDesc
+{
+    // Side of the square terrain and its centre.
+    float Size = 1024.0f;
+    float CenterX = 0.0f;
+    float CenterZ = 0.0f;
+
+    // Quadtree depth.  The root covers the whole terrain at level LodCount-1,
+    // the leaves Size / 2^(LodCount-1) at level 0.
+    UINT LodCount = 5;
+
+    // Quads along a node side; the same at every level, so a node's vertex
+    // spacing doubles with each level up.
+    UINT GridResolution = 32;
+
+    // Distance up to which the leaves are drawn; each level up doubles it.
+    float LeafRange = 96.0f;
+
+    // Texture repeats per metre.
+    float TextureScale = 0.25f;
+};
+
+// Chunked heightfield terrain with CDLOD-style quadtree LOD selection.
+//   - Every quadtree node owns a GridResolution^2 grid (GeometryGenerator::CreateGrid
+//     topology) sampled from the height function at its own spacing.  All
+//     nodes share one index buffer and differ only in BaseVertexLocation.
+//   - Select walks the tree from the root: a node is drawn as is unless the
+//     eye is within the range of the level below, in which case its children
+//     are selected instead.  Frustum culled nodes are dropped on the way.
+//   - Neighbours of different levels do not share edge vertices; skirts hang
+//     from every node edge, deep enough to cover the largest height error of
+//     the node's level and the finer ones, so the cracks never show.
+class Terrain
+{
+public:
+    static const UINT MaxLodCount = 12;
+
+    typedef std::function<float(float x, float z)> HeightFunction;
+
+    struct Stats
+    {
+        UINT NodesVisited = 0;
+        UINT NodesSelected = 0;
+        UINT TrianglesSelected = 0;
+        UINT SelectedPerLevel[MaxLodCount] = {};
+    };
+
+    // Samples height into the grids of all nodes.
+    void Build(const TerrainDesc& desc, const HeightFunction& height);
+
+    // The index buffer shared by every node of a terrain with this grid
+    // resolution: the grid, then the skirts.
+    static std::vector<std::uint16_t> NodeIndices(UINT gridResolution);
+
+    // Frees the CPU copy of the vertices once they have been uploaded.
+    void ReleaseVertices() { std::vector<Vertex>().swap(mVertices); }
+
+    // Node i's vertices start at i*VerticesPerNode(); Indices() serves every node.
+    const std::vector<Vertex>& Vertices()const { return mVertices; }
+    const std::vector<std::uint16_t>& Indices()const { return mIndices; }
+    UINT VerticesPerNode()const { return mVerticesPerNode; }
+    UINT NodeCount()const { return (UINT)mNodes.size(); }
+
+    // Points the node render items at the GPU copy of Vertices() and Indices().
+    void SetGeometry(MeshGeometry* geo, Material* mat);
+
+    // Appends the render items of the selected nodes to visible.
+    void Select(const DirectX::XMFLOAT3& eye, const FrustumPlanes& frustum, std::vector<RenderItem*>& visible);
+
+    float LodRange(UINT level)const { return mDesc.LeafRange * (float)(1u << level); }
+    float SkirtDepth(UINT level)const { return mSkirtDepth[level]; }
+    const Stats& GetStats()const { return mStats; }
+
+private:
+    struct Node
+    {
+        float CenterX = 0.0f;
+        float CenterZ = 0.0f;
+        float Size = 0.0f;
+        UINT Level = 0;
+
+        // Index of the first of four consecutive children; 0 for leaves.
+        UINT FirstChild = 0;
+
+        // Height range of the grid itself.
+        float MinY = 0.0f;
+        float MaxY = 0.0f;
+
+        // World-space bounds including the skirts.
+        DirectX::XMFLOAT3 BoundsCenter = { 0.0f, 0.0f, 0.0f };
+        DirectX::XMFLOAT3 BoundsExtents = { 0.0f, 0.0f, 0.0f };
+
+        RenderItem Item;
+    };
+
+    void AddChildren(UINT node);
+    float BuildNodeGrid(UINT node, const HeightFunction& height);
+    void ApplySkirts(UINT node);
+    void SelectNode(UINT node, const DirectX::XMFLOAT3& eye, const FrustumPlanes& frustum, std::vector<RenderItem*>& visible);
+
+private:
+    TerrainDesc mDesc;
+    std::vector<Node> mNodes;
+
+    std::vector<Vertex> mVertices;
+    std::vector<std::uint16_t> mIndices;
+    UINT mVerticesPerNode = 0;
+
+    // Largest height error along a node edge per level, and the skirt depth
+    // derived from it.
+    float mEdgeError[MaxLodCount] = {};
+    float mSkirtDepth[MaxLodCount] = {};
+
+    Stats mStats;
+};
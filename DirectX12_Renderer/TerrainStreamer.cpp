@@ -0,0 +1,346 @@
+#include "TerrainStreamer.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+using Microsoft::WRL::ComPtr;
+
+TerrainStreamer::~TerrainStreamer()
+{
+    Shutdown();
+}
+
+void TerrainStreamer::Initialize(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList, const TerrainStreamerDesc& desc,
+    const HeightFunction& height, Material* mat, UINT firstGeoIndex)
+{
+    assert(mWorkers.empty() && desc.WorkerCount >= 1 && desc.MaxPendingChunks >= 1);
+
+    mDesc = desc;
+    mHeight = height;
+    mDevice = device;
+    mMaterial = mat;
+    mFirstGeoIndex = firstGeoIndex;
+
+    // Every chunk has the same node tree, so the sizes are known up front.
+    const UINT side = desc.Chunk.GridResolution + 1;
+    mNodesPerChunk = 0;
+    for (UINT l = 0; l < desc.Chunk.LodCount; ++l)
+        mNodesPerChunk += 1u << (2 * l);
+    mChunkByteSize = (UINT64)mNodesPerChunk * (side * side + 4 * side) * sizeof(Vertex);
+    assert(MaxResidentChunks() >= 1 && "budget smaller than one chunk");
+
+    const std::vector<std::uint16_t> indices = Terrain::NodeIndices(desc.Chunk.GridResolution);
+    mIndexCount = (UINT)indices.size();
+    mIndexBufferByteSize = mIndexCount * sizeof(std::uint16_t);
+    if (device != nullptr)
+    {
+        mIndexBuffer = d3dUtil::CreateDefaultBuffer(device, cmdList, indices.data(), mIndexBufferByteSize, mIndexBufferUploader);
+        mIndexBuffer->SetName(L"Terrain Chunk Index Buffer");
+    }
+
+    mFreeGeoSlots.clear();
+    for (UINT slot = MaxResidentChunks(); slot-- > 0;)
+        mFreeGeoSlots.push_back(slot);
+
+    // Requests and finished chunks together never exceed MaxPendingChunks.
+    size_t capacity = 2;
+    while (capacity < desc.MaxPendingChunks)
+        capacity *= 2;
+    mRequests = std::make_unique<LockFreeQueue<std::uint64_t>>(capacity);
+    mFinished = std::make_unique<LockFreeQueue<Chunk*>>(capacity);
+
+    mQuit = false;
+    for (UINT i = 0; i < desc.WorkerCount; ++i)
+        mWorkers.emplace_back(&TerrainStreamer::WorkerMain, this);
+}
+
+void TerrainStreamer::Shutdown()
+{
+    if (mWorkers.empty())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(mSleepMutex);
+        mQuit = true;
+    }
+    mWake.notify_all();
+
+    for (auto& t : mWorkers)
+        t.join();
+    mWorkers.clear();
+
+    // Chunks finished but never taken on.
+    Chunk* chunk;
+    while (mFinished->TryPop(chunk))
+        delete chunk;
+
+    std::uint64_t key;
+    while (mRequests->TryPop(key))
+        ;
+
+    mChunks.clear();
+    mLru.clear();
+    mPending.clear();
+    mUploads.clear();
+    mRetired.clear();
+    mQueuedRequests = 0;
+    mStats = Stats();
+}
+
+void TerrainStreamer::WorkerMain()
+{
+    while (!mQuit.load(std::memory_order_relaxed))
+    {
+        std::uint64_t key;
+        if (mRequests->TryPop(key))
+        {
+            mQueuedRequests.fetch_sub(1);
+            Chunk* chunk = Generate(key);
+
+            // The queue holds every pending chunk, so this only spins if the
+            // render thread has not caught up with a pop it already started.
+            while (!mFinished->TryPush(chunk))
+                std::this_thread::yield();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mSleepMutex);
+        mSleepingWorkers.fetch_add(1);
+        mWake.wait(lock, [this]() { return mQueuedRequests.load() > 0 || mQuit.load(); });
+        mSleepingWorkers.fetch_sub(1);
+    }
+}
+
+TerrainStreamer::Chunk* TerrainStreamer::Generate(std::uint64_t key)
+{
+    auto chunk = std::make_unique<Chunk>();
+    chunk->Key = key;
+
+    TerrainDesc desc = mDesc.Chunk;
+    desc.CenterX = (KeyX(key) + 0.5f) * desc.Size;
+    desc.CenterZ = (KeyZ(key) + 0.5f) * desc.Size;
+    chunk->Ground.Build(desc, mHeight);
+
+    const std::vector<Vertex>& vertices = chunk->Ground.Vertices();
+    const UINT vbByteSize = (UINT)(vertices.size() * sizeof(Vertex));
+    assert(vbByteSize == mChunkByteSize);
+
+    // The device is free threaded, so the buffers are created here and the
+    // upload buffer filled; the render thread only records the copy.
+    if (mDevice != nullptr)
+    {
+        const CD3DX12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(vbByteSize);
+        const CD3DX12_HEAP_PROPERTIES defaultHeap(D3D12_HEAP_TYPE_DEFAULT);
+        const CD3DX12_HEAP_PROPERTIES uploadHeap(D3D12_HEAP_TYPE_UPLOAD);
+
+        ThrowIfFailed(mDevice->CreateCommittedResource(&defaultHeap, D3D12_HEAP_FLAG_NONE, &bufferDesc,
+            D3D12_RESOURCE_STATE_COMMON, nullptr, IID_PPV_ARGS(&chunk->Geo.VertexBufferGPU)));
+        ThrowIfFailed(mDevice->CreateCommittedResource(&uploadHeap, D3D12_HEAP_FLAG_NONE, &bufferDesc,
+            D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&chunk->Geo.VertexBufferUploader)));
+
+        void* mapped = nullptr;
+        ThrowIfFailed(chunk->Geo.VertexBufferUploader->Map(0, nullptr, &mapped));
+        memcpy(mapped, vertices.data(), vbByteSize);
+        chunk->Geo.VertexBufferUploader->Unmap(0, nullptr);
+        chunk->Geo.VertexBufferGPU->SetName(L"Terrain Chunk Vertex Buffer");
+    }
+
+    chunk->Geo.VertexByteStride = sizeof(Vertex);
+    chunk->Geo.VertexBufferByteSize = vbByteSize;
+    chunk->Ground.ReleaseVertices();
+
+    return chunk.release();
+}
+
+void TerrainStreamer::Update(const XMFLOAT3& eye, UINT64 completedFence)
+{
+    ++mFrame;
+    mStats.Arrived = 0;
+    mStats.Requested = 0;
+    mStats.Evicted = 0;
+
+    // Stamped in fence order, with unstamped ones behind.
+    while (!mRetired.empty() && mRetired.front().Fence != 0 && mRetired.front().Fence <= completedFence)
+        mRetired.pop_front();
+
+    Chunk* finished;
+    while (mStats.Arrived < mDesc.MaxArrivalsPerFrame && mFinished->TryPop(finished))
+    {
+        Arrive(finished);
+        mStats.Arrived++;
+    }
+
+    // The chunks around the eye, nearest first.
+    const float size = mDesc.Chunk.Size;
+    const float radius = mDesc.LoadRadius;
+    const int x0 = (int)std::floor((eye.x - radius) / size);
+    const int x1 = (int)std::floor((eye.x + radius) / size);
+    const int z0 = (int)std::floor((eye.z - radius) / size);
+    const int z1 = (int)std::floor((eye.z + radius) / size);
+
+    std::vector<std::pair<float, std::uint64_t>> wanted;
+    for (int z = z0; z <= z1; ++z)
+    {
+        for (int x = x0; x <= x1; ++x)
+        {
+            const float dx = (x + 0.5f) * size - eye.x;
+            const float dz = (z + 0.5f) * size - eye.z;
+            const float distSq = dx * dx + dz * dz;
+            if (distSq <= radius * radius)
+                wanted.emplace_back(distSq, MakeKey(x, z));
+        }
+    }
+    std::sort(wanted.begin(), wanted.end());
+
+    // Mark every wanted resident chunk first, so eviction below never picks
+    // one of them.
+    for (const auto& w : wanted)
+    {
+        auto it = mChunks.find(w.second);
+        if (it != mChunks.end())
+        {
+            Chunk* chunk = it->second.get();
+            chunk->LastUsedFrame = mFrame;
+            mLru.splice(mLru.begin(), mLru, chunk->LruPosition);
+        }
+    }
+
+    for (const auto& w : wanted)
+    {
+        if (mPending.size() >= mDesc.MaxPendingChunks)
+            break;
+        if (mChunks.count(w.second) != 0 || mPending.count(w.second) != 0)
+            continue;
+
+        // Room for this one as well as those already on the way.
+        const UINT64 needed = (mChunks.size() + mPending.size() + 1) * mChunkByteSize;
+        if (needed > mDesc.MemoryBudget && !EvictOne())
+            break;
+
+        Request(w.second);
+    }
+
+    mStats.ResidentChunks = (UINT)mChunks.size();
+    mStats.PendingChunks = (UINT)mPending.size();
+    mStats.ResidentBytes = mChunks.size() * mChunkByteSize;
+}
+
+void TerrainStreamer::Arrive(Chunk* chunk)
+{
+    mPending.erase(chunk->Key);
+
+    chunk->GeoSlot = mFreeGeoSlots.back();
+    mFreeGeoSlots.pop_back();
+
+    MeshGeometry& geo = chunk->Geo;
+    geo.GeoIndex = mFirstGeoIndex + chunk->GeoSlot;
+    geo.IndexBufferGPU = mIndexBuffer;
+    geo.IndexFormat = DXGI_FORMAT_R16_UINT;
+    geo.IndexBufferByteSize = mIndexBufferByteSize;
+
+    static const NameId nodeName = Names::Intern("node");
+    SubmeshGeometry nodeSubmesh;
+    nodeSubmesh.IndexCount = mIndexCount;
+    geo.AddSubmesh(nodeName, nodeSubmesh);
+
+    chunk->Ground.SetGeometry(&geo, mMaterial);
+    chunk->LastUsedFrame = mFrame;
+    mLru.push_front(chunk);
+    chunk->LruPosition = mLru.begin();
+
+    if (geo.VertexBufferUploader != nullptr)
+        mUploads.push_back(chunk);
+
+    mChunks[chunk->Key].reset(chunk);
+    mStats.TotalArrived++;
+}
+
+bool TerrainStreamer::EvictOne()
+{
+    if (mLru.empty() || mLru.back()->LastUsedFrame == mFrame)
+        return false;
+
+    Chunk* chunk = mLru.back();
+    mLru.pop_back();
+    Retire(chunk->Geo.VertexBufferGPU);
+    mFreeGeoSlots.push_back(chunk->GeoSlot);
+    mChunks.erase(chunk->Key);
+
+    mStats.Evicted++;
+    mStats.TotalEvicted++;
+    return true;
+}
+
+void TerrainStreamer::Request(std::uint64_t key)
+{
+    mPending.insert(key);
+    mStats.Requested++;
+
+    // At most MaxPendingChunks keys are ever in the queue.
+    const bool pushed = mRequests->TryPush(key);
+    assert(pushed);
+    (void)pushed;
+
+    mQueuedRequests.fetch_add(1);
+    if (mSleepingWorkers.load() > 0)
+    {
+        // Taking the lock orders this wake-up after a sleeper's final check.
+        { std::lock_guard<std::mutex> lock(mSleepMutex); }
+        mWake.notify_one();
+    }
+}
+
+void TerrainStreamer::Retire(ComPtr<ID3D12Resource>& buffer)
+{
+    if (buffer == nullptr)
+        return;
+
+    RetiredBuffer retired;
+    retired.Buffer = std::move(buffer);
+    mRetired.push_back(std::move(retired));
+}
+
+void TerrainStreamer::Select(const XMFLOAT3& eye, const FrustumPlanes& frustum, std::vector<RenderItem*>& visible)
+{
+    mStats.NodesSelected = 0;
+    mStats.TrianglesSelected = 0;
+    for (const auto& entry : mChunks)
+    {
+        Terrain& ground = entry.second->Ground;
+        ground.Select(eye, frustum, visible);
+        mStats.NodesSelected += ground.GetStats().NodesSelected;
+        mStats.TrianglesSelected += ground.GetStats().TrianglesSelected;
+    }
+}
+
+void TerrainStreamer::RecordUploads(ID3D12GraphicsCommandList* cmdList)
+{
+    if (mUploads.empty())
+        return;
+
+    std::vector<CD3DX12_RESOURCE_BARRIER> barriers;
+    for (Chunk* chunk : mUploads)
+    {
+        barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(chunk->Geo.VertexBufferGPU.Get(),
+            D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COPY_DEST));
+    }
+    cmdList->ResourceBarrier((UINT)barriers.size(), barriers.data());
+
+    barriers.clear();
+    for (Chunk* chunk : mUploads)
+    {
+        cmdList->CopyBufferRegion(chunk->Geo.VertexBufferGPU.Get(), 0, chunk->Geo.VertexBufferUploader.Get(), 0, mChunkByteSize);
+        barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(chunk->Geo.VertexBufferGPU.Get(),
+            D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ));
+        Retire(chunk->Geo.VertexBufferUploader);
+    }
+    cmdList->ResourceBarrier((UINT)barriers.size(), barriers.data());
+
+    mUploads.clear();
+}
+
+void TerrainStreamer::EndFrame(UINT64 fence)
+{
+    for (auto it = mRetired.rbegin(); it != mRetired.rend() && it->Fence == 0; ++it)
+        it->Fence = fence;
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#include "Terrain.h"
+#include "LockFreeQueue.h"
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+struct TerrainStreamerDesc
+{
+    TerrainStreamerDesc()
+    {
+        Chunk.Size = 256.0f;
+        Chunk.LodCount = 3;
+    }
+
+    // Shape of every chunk; the centre is set per chunk.  Chunk (i, j) covers
+    // [i*Size, (i+1)*Size) x [j*Size, (j+1)*Size).
+    TerrainDesc Chunk;
+
+    // Chunks whose centre is within this distance of the eye, measured in
+    // the xz plane, are wanted.
+    float LoadRadius = 1100.0f;
+
+    // Vertex memory allowed for resident chunks and those being generated.
+    UINT64 MemoryBudget = 64ull * 1024 * 1024;
+
+    UINT WorkerCount = 2;
+
+    // Chunks handed to the workers at once.  Keeping this small means the
+    // nearest missing chunks go first and little work is wasted on chunks
+    // the camera has already left behind.
+    UINT MaxPendingChunks = 8;
+
+    // Finished chunks taken on per frame, which bounds the upload work
+    // added to any one frame.
+    UINT MaxArrivalsPerFrame = 4;
+};
+
+// Streams an unbounded terrain in square chunks around the camera.
+//   - Each chunk is a Terrain of its own, sampled from the height function
+//     at the chunk's position.  Chunks use the same grid, so neighbours of
+//     equal level meet exactly and the skirts hide the rest.
+//   - Worker threads generate chunks and create their vertex buffers plus a
+//     filled upload buffer; the render thread only records one copy per
+//     chunk.  Requests go to the workers and finished chunks come back
+//     through lock-free queues, so the render thread never waits on them.
+//   - Resident chunks are kept in LRU order.  A chunk is used in a frame
+//     when it is wanted; when a new request would exceed the memory budget,
+//     the least recently used chunks that are not wanted this frame are
+//     evicted.  Their buffers are released once the GPU is past the last
+//     frame that drew them.
+// Everything but the workers runs on the render thread.
+class TerrainStreamer
+{
+public:
+    typedef Terrain::HeightFunction HeightFunction;
+
+    struct Stats
+    {
+        UINT ResidentChunks = 0;
+        UINT PendingChunks = 0;
+        UINT64 ResidentBytes = 0;
+
+        // This frame.
+        UINT Arrived = 0;
+        UINT Requested = 0;
+        UINT Evicted = 0;
+
+        // Over the whole run.
+        UINT64 TotalArrived = 0;
+        UINT64 TotalEvicted = 0;
+
+        // Summed over the chunks by the last Select.
+        UINT NodesSelected = 0;
+        UINT TrianglesSelected = 0;
+    };
+
+    TerrainStreamer() = default;
+    TerrainStreamer(const TerrainStreamer& rhs) = delete;
+    TerrainStreamer& operator=(const TerrainStreamer& rhs) = delete;
+    ~TerrainStreamer();
+
+    // Records the upload of the index buffer shared by all chunks to cmdList
+    // and starts the workers.  Chunk geometry gets GeoIndex firstGeoIndex and
+    // up.  Without a device the chunks get no GPU buffers.
+    void Initialize(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList, const TerrainStreamerDesc& desc,
+        const HeightFunction& height, Material* mat, UINT firstGeoIndex);
+
+    // Stops the workers and drops every chunk.  The GPU must be idle.
+    void Shutdown();
+
+    // Once per frame before Select: releases buffers the GPU is done with,
+    // takes on finished chunks, then evicts and requests around eye.
+    void Update(const DirectX::XMFLOAT3& eye, UINT64 completedFence);
+
+    // Appends the selected nodes of all resident chunks to visible.
+    void Select(const DirectX::XMFLOAT3& eye, const FrustumPlanes& frustum, std::vector<RenderItem*>& visible);
+
+    // Records the copies of the chunks taken on by this frame's Update.  Must
+    // run on a list executed before any draws of the frame.
+    void RecordUploads(ID3D12GraphicsCommandList* cmdList);
+
+    // Buffers released during the frame are freed once the GPU reaches fence.
+    void EndFrame(UINT64 fence);
+
+    UINT64 ChunkByteSize()const { return mChunkByteSize; }
+    UINT MaxResidentChunks()const { return (UINT)(mDesc.MemoryBudget / mChunkByteSize); }
+    UINT MaxNodeCount()const { return MaxResidentChunks() * mNodesPerChunk; }
+    const Stats& GetStats()const { return mStats; }
+
+private:
+    struct Chunk
+    {
+        std::uint64_t Key = 0;
+        Terrain Ground;
+        MeshGeometry Geo;
+        UINT GeoSlot = 0;
+        UINT64 LastUsedFrame = 0;
+        std::list<Chunk*>::iterator LruPosition;
+    };
+
+    struct RetiredBuffer
+    {
+        // 0 until the frame that released it has been given a fence.
+        UINT64 Fence = 0;
+        Microsoft::WRL::ComPtr<ID3D12Resource> Buffer;
+    };
+
+    static std::uint64_t MakeKey(int x, int z) { return ((std::uint64_t)(std::uint32_t)x << 32) | (std::uint32_t)z; }
+    static int KeyX(std::uint64_t key) { return (int)(std::uint32_t)(key >> 32); }
+    static int KeyZ(std::uint64_t key) { return (int)(std::uint32_t)key; }
+
+    void WorkerMain();
+    Chunk* Generate(std::uint64_t key);
+    void Arrive(Chunk* chunk);
+    bool EvictOne();
+    void Request(std::uint64_t key);
+    void Retire(Microsoft::WRL::ComPtr<ID3D12Resource>& buffer);
+
+private:
+    TerrainStreamerDesc mDesc;
+    HeightFunction mHeight;
+    ID3D12Device* mDevice = nullptr;
+    Material* mMaterial = nullptr;
+
+    Microsoft::WRL::ComPtr<ID3D12Resource> mIndexBuffer;
+    Microsoft::WRL::ComPtr<ID3D12Resource> mIndexBufferUploader;
+    UINT mIndexBufferByteSize = 0;
+    UINT mIndexCount = 0;
+
+    UINT64 mChunkByteSize = 0;
+    UINT mNodesPerChunk = 0;
+
+    // Render thread state.
+    std::unordered_map<std::uint64_t, std::unique_ptr<Chunk>> mChunks;
+    std::list<Chunk*> mLru;
+    std::unordered_set<std::uint64_t> mPending;
+    std::vector<Chunk*> mUploads;
+    std::deque<RetiredBuffer> mRetired;
+    std::vector<UINT> mFreeGeoSlots;
+    UINT mFirstGeoIndex = 0;
+    UINT64 mFrame = 0;
+    Stats mStats;
+
+    // Shared with the workers.
+    std::unique_ptr<LockFreeQueue<std::uint64_t>> mRequests;
+    std::unique_ptr<LockFreeQueue<Chunk*>> mFinished;
+    std::vector<std::thread> mWorkers;
+    std::atomic<int> mQueuedRequests{ 0 };
+    std::atomic<int> mSleepingWorkers{ 0 };
+    std::atomic<bool> mQuit{ false };
+    std::mutex mSleepMutex;
+    std::condition_variable mWake;
+};
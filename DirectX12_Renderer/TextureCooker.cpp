@@ -0,0 +1,442 @@
+#include "TextureCooker.h"
+#include "JobSystem.h"
+#include <DirectXTex.h>
+#include <chrono>
+#include <map>
+
+using namespace DirectX;
+
+namespace
+{
+    // Rows per job for filtering and format conversion.
+    const UINT RowGrain = 16;
+
+    // Kaiser filter: half width in destination texels and window shape.
+    const float KaiserWidth = 3.0f;
+    const float KaiserAlpha = 4.0f;
+
+    double Seconds()
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void Log(const std::wstring& message)
+    {
+        ::OutputDebugStringW((message + L"\n").c_str());
+    }
+
+    void ForRows(JobSystem* jobs, UINT rows, const std::function<void(UINT, UINT)>& body)
+    {
+        if (jobs != nullptr && rows > RowGrain)
+            jobs->ParallelFor(rows, RowGrain, body);
+        else
+            body(0, rows);
+    }
+
+    float SrgbToLinear(float c)
+    {
+        return c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+    }
+
+    float LinearToSrgb(float c)
+    {
+        return c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+    }
+
+    BYTE ToUnorm8(float c)
+    {
+        return (BYTE)(MathHelper::Clamp(c, 0.0f, 1.0f) * 255.0f + 0.5f);
+    }
+
+    // Zeroth order modified Bessel function of the first kind.
+    float BesselI0(float x)
+    {
+        float sum = 1.0f;
+        float term = 1.0f;
+        for (int k = 1; k < 32 && term > sum * 1e-8f; ++k)
+        {
+            const float t = x / (2.0f * k);
+            term *= t * t;
+            sum += term;
+        }
+        return sum;
+    }
+
+    float Kaiser(float x)
+    {
+        if (fabsf(x) >= KaiserWidth)
+            return 0.0f;
+        const float r = x / KaiserWidth;
+        const float sinc = x == 0.0f ? 1.0f : sinf(MathHelper::Pi * x) / (MathHelper::Pi * x);
+        return sinc * BesselI0(KaiserAlpha * sqrtf(1.0f - r * r)) / BesselI0(KaiserAlpha);
+    }
+
+    // Weights for resampling one axis from srcSize to dstSize texels.
+    // Destination texel d reads source texels First[d] + t, t < TapCount,
+    // clamped to the edge, with Weights[d * TapCount + t].
+    struct Kernel
+    {
+        UINT TapCount = 0;
+        std::vector<int> First;
+        std::vector<float> Weights;
+    };
+
+    Kernel MakeKernel(UINT srcSize, UINT dstSize, MipFilter filter)
+    {
+        const float scale = (float)srcSize / dstSize;
+        const float radius = (filter == MipFilter::Box ? 0.5f : KaiserWidth) * scale;
+
+        Kernel kernel;
+        kernel.TapCount = (UINT)ceilf(2.0f * radius) + 1;
+        kernel.First.resize(dstSize);
+        kernel.Weights.resize((size_t)dstSize * kernel.TapCount);
+
+        for (UINT d = 0; d < dstSize; ++d)
+        {
+            const float center = (d + 0.5f) * scale;
+            const int first = (int)floorf(center - radius);
+            float* weights = &kernel.Weights[(size_t)d * kernel.TapCount];
+
+            float sum = 0.0f;
+            for (UINT t = 0; t < kernel.TapCount; ++t)
+            {
+                const float i = (float)(first + (int)t);
+                float w;
+                if (filter == MipFilter::Box)
+                    w = std::max(0.0f, std::min(i + 1.0f, center + radius) - std::max(i, center - radius));
+                else
+                    w = Kaiser((i + 0.5f - center) / scale);
+                weights[t] = w;
+                sum += w;
+            }
+            for (UINT t = 0; t < kernel.TapCount; ++t)
+                weights[t] /= sum;
+            kernel.First[d] = first;
+        }
+        return kernel;
+    }
+
+    void Downsample(const TextureImage& src, TextureImage& dst, MipFilter filter, bool renormalize, JobSystem* jobs)
+    {
+        const Kernel kx = MakeKernel(src.Width, dst.Width, filter);
+        const Kernel ky = MakeKernel(src.Height, dst.Height, filter);
+        const int maxX = (int)src.Width - 1;
+        const int maxY = (int)src.Height - 1;
+
+        // Rows first, into dst.Width x src.Height.
+        TextureImage rows;
+        rows.Resize(dst.Width, src.Height);
+        ForRows(jobs, src.Height, [&](UINT first, UINT last)
+        {
+            for (UINT y = first; y < last; ++y)
+            {
+                for (UINT x = 0; x < dst.Width; ++x)
+                {
+                    const float* weights = &kx.Weights[(size_t)x * kx.TapCount];
+                    XMVECTOR sum = XMVectorZero();
+                    for (UINT t = 0; t < kx.TapCount; ++t)
+                    {
+                        const int sx = MathHelper::Clamp(kx.First[x] + (int)t, 0, maxX);
+                        sum = XMVectorMultiplyAdd(XMLoadFloat4(&src.At(sx, y)), XMVectorReplicate(weights[t]), sum);
+                    }
+                    XMStoreFloat4(&rows.At(x, y), sum);
+                }
+            }
+        });
+
+        ForRows(jobs, dst.Height, [&](UINT first, UINT last)
+        {
+            for (UINT y = first; y < last; ++y)
+            {
+                const float* weights = &ky.Weights[(size_t)y * ky.TapCount];
+                for (UINT x = 0; x < dst.Width; ++x)
+                {
+                    XMVECTOR sum = XMVectorZero();
+                    for (UINT t = 0; t < ky.TapCount; ++t)
+                    {
+                        const int sy = MathHelper::Clamp(ky.First[y] + (int)t, 0, maxY);
+                        sum = XMVectorMultiplyAdd(XMLoadFloat4(&rows.At(x, sy)), XMVectorReplicate(weights[t]), sum);
+                    }
+
+                    // Filtering shortens normals; put them back on the unit sphere.
+                    if (renormalize)
+                    {
+                        const XMVECTOR half = XMVectorReplicate(0.5f);
+                        XMVECTOR n = XMVector3Normalize(XMVectorMultiplyAdd(sum, XMVectorReplicate(2.0f), XMVectorReplicate(-1.0f)));
+                        sum = XMVectorSelect(sum, XMVectorMultiplyAdd(n, half, half), g_XMSelect1110);
+                    }
+                    XMStoreFloat4(&dst.At(x, y), sum);
+                }
+            }
+        });
+    }
+
+    bool IsColor(TextureUsage usage)
+    {
+        return usage == TextureUsage::Color || usage == TextureUsage::ColorAlpha;
+    }
+
+    const wchar_t* FormatName(DXGI_FORMAT format)
+    {
+        switch (format)
+        {
+        case DXGI_FORMAT_BC1_UNORM_SRGB: return L"BC1";
+        case DXGI_FORMAT_BC3_UNORM_SRGB: return L"BC3";
+        case DXGI_FORMAT_BC4_UNORM: return L"BC4";
+        case DXGI_FORMAT_BC5_UNORM: return L"BC5";
+        case DXGI_FORMAT_BC7_UNORM_SRGB: return L"BC7";
+        default: return L"?";
+        }
+    }
+}
+
+bool TextureCooker::DecodeImage(const std::wstring& filename, bool srgb, TextureImage& image)
+{
+    // WIC needs COM on the calling thread.
+    const HRESULT com = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+    // The file's color space is ignored so the texels come out as stored;
+    // the sRGB curve is applied below.
+    ScratchImage loaded;
+    ScratchImage converted;
+    HRESULT hr = LoadFromWICFile(filename.c_str(), WIC_FLAGS_FORCE_RGB | WIC_FLAGS_IGNORE_SRGB, nullptr, loaded);
+    if (SUCCEEDED(hr) && loaded.GetMetadata().format != DXGI_FORMAT_R32G32B32A32_FLOAT)
+        hr = Convert(*loaded.GetImage(0, 0, 0), DXGI_FORMAT_R32G32B32A32_FLOAT, TEX_FILTER_DEFAULT, TEX_THRESHOLD_DEFAULT, converted);
+    else
+        converted = std::move(loaded);
+
+    if (SUCCEEDED(com))
+        CoUninitialize();
+
+    if (FAILED(hr))
+    {
+        Log(filename + L": could not decode");
+        return false;
+    }
+
+    const Image* texels = converted.GetImage(0, 0, 0);
+    image.Resize((UINT)texels->width, (UINT)texels->height);
+    for (UINT y = 0; y < image.Height; ++y)
+    {
+        const XMFLOAT4* row = reinterpret_cast<const XMFLOAT4*>(texels->pixels + y * texels->rowPitch);
+        for (UINT x = 0; x < image.Width; ++x)
+        {
+            XMFLOAT4 c = row[x];
+            if (srgb)
+            {
+                c.x = SrgbToLinear(c.x);
+                c.y = SrgbToLinear(c.y);
+                c.z = SrgbToLinear(c.z);
+            }
+            image.At(x, y) = c;
+        }
+    }
+    return true;
+}
+
+void TextureCooker::BuildMips(const TextureImage& image, MipFilter filter, bool renormalize, JobSystem* jobs,
+    std::vector<TextureImage>& mips)
+{
+    mips.clear();
+    mips.push_back(image);
+    while (mips.back().Width > 1 || mips.back().Height > 1)
+    {
+        const TextureImage& src = mips.back();
+        TextureImage dst;
+        dst.Resize(std::max(1u, src.Width / 2), std::max(1u, src.Height / 2));
+        Downsample(src, dst, filter, renormalize, jobs);
+        mips.push_back(std::move(dst));
+    }
+}
+
+DXGI_FORMAT TextureCooker::FormatFor(TextureUsage usage, bool highQuality)
+{
+    switch (usage)
+    {
+    case TextureUsage::Color: return highQuality ? DXGI_FORMAT_BC7_UNORM_SRGB : DXGI_FORMAT_BC1_UNORM_SRGB;
+    case TextureUsage::ColorAlpha: return highQuality ? DXGI_FORMAT_BC7_UNORM_SRGB : DXGI_FORMAT_BC3_UNORM_SRGB;
+    case TextureUsage::Normal: return DXGI_FORMAT_BC5_UNORM;
+    default: return DXGI_FORMAT_BC4_UNORM;
+    }
+}
+
+bool TextureCooker::WriteDds(const std::wstring& filename, const std::vector<TextureImage>& mips, TextureUsage usage,
+    const TextureCookOptions& options, TextureCookStats* stats)
+{
+    assert(!mips.empty());
+    const double start = Seconds();
+    const bool srgb = IsColor(usage);
+
+    // RGBA8 source for the encoder, with the sRGB curve already applied so
+    // it passes through to the sRGB block format untouched.
+    ScratchImage source;
+    HRESULT hr = source.Initialize2D(srgb ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM,
+        mips[0].Width, mips[0].Height, 1, mips.size());
+    if (FAILED(hr))
+    {
+        Log(filename + L": out of memory");
+        return false;
+    }
+
+    for (size_t level = 0; level < mips.size(); ++level)
+    {
+        const TextureImage& mip = mips[level];
+        const Image* dst = source.GetImage(level, 0, 0);
+        ForRows(options.Jobs, mip.Height, [&](UINT first, UINT last)
+        {
+            for (UINT y = first; y < last; ++y)
+            {
+                BYTE* row = dst->pixels + y * dst->rowPitch;
+                for (UINT x = 0; x < mip.Width; ++x)
+                {
+                    const XMFLOAT4& c = mip.At(x, y);
+                    row[4 * x + 0] = ToUnorm8(srgb ? LinearToSrgb(c.x) : c.x);
+                    row[4 * x + 1] = ToUnorm8(srgb ? LinearToSrgb(c.y) : c.y);
+                    row[4 * x + 2] = ToUnorm8(srgb ? LinearToSrgb(c.z) : c.z);
+                    row[4 * x + 3] = ToUnorm8(c.w);
+                }
+            }
+        });
+    }
+
+    const DXGI_FORMAT format = FormatFor(usage, options.HighQuality);
+    ScratchImage compressed;
+    hr = compressed.Initialize2D(format, mips[0].Width, mips[0].Height, 1, mips.size());
+    if (SUCCEEDED(hr))
+    {
+        for (size_t level = 0; level < mips.size(); ++level)
+        {
+            const Image* src = source.GetImage(level, 0, 0);
+            const Image* dst = compressed.GetImage(level, 0, 0);
+            BlockEncoder::Encode(format, src->pixels, (UINT)src->width, (UINT)src->height, src->rowPitch,
+                options.Quality, options.Jobs, dst->pixels, dst->rowPitch);
+        }
+        hr = SaveToDDSFile(compressed.GetImages(), compressed.GetImageCount(), compressed.GetMetadata(), DDS_FLAGS_NONE, filename.c_str());
+    }
+    if (FAILED(hr))
+    {
+        Log(filename + L": could not encode or write");
+        return false;
+    }
+
+    if (stats != nullptr)
+    {
+        stats->Width = mips[0].Width;
+        stats->Height = mips[0].Height;
+        stats->MipLevels = (UINT)mips.size();
+        stats->Format = format;
+        stats->UncompressedBytes = source.GetPixelsSize();
+        stats->CookedBytes = compressed.GetPixelsSize();
+        stats->EncodeSeconds = Seconds() - start;
+    }
+    return true;
+}
+
+bool TextureCooker::Cook(const std::wstring& filename, const std::wstring& opacityFilename, const std::wstring& ddsFilename,
+    TextureUsage usage, const TextureCookOptions& options, TextureCookStats* stats)
+{
+    TextureCookStats local;
+    TextureCookStats& s = stats != nullptr ? *stats : local;
+    s = TextureCookStats();
+
+    double start = Seconds();
+    TextureImage image;
+    if (!DecodeImage(filename, IsColor(usage), image))
+        return false;
+
+    if (!opacityFilename.empty())
+    {
+        TextureImage opacity;
+        if (!DecodeImage(opacityFilename, false, opacity))
+            return false;
+
+        // Nearest texel if the sizes differ.
+        for (UINT y = 0; y < image.Height; ++y)
+        {
+            const UINT oy = (UINT)((UINT64)y * opacity.Height / image.Height);
+            for (UINT x = 0; x < image.Width; ++x)
+                image.At(x, y).w = opacity.At((UINT)((UINT64)x * opacity.Width / image.Width), oy).x;
+        }
+    }
+    s.DecodeSeconds = Seconds() - start;
+
+    start = Seconds();
+    std::vector<TextureImage> mips;
+    BuildMips(image, options.Filter, usage == TextureUsage::Normal, options.Jobs, mips);
+    s.MipSeconds = Seconds() - start;
+
+    return WriteDds(ddsFilename, mips, usage, options, &s);
+}
+
+bool TextureCooker::CookDirectory(const std::wstring& directory, const std::wstring& outDirectory,
+    const TextureCookOptions& options)
+{
+    // Source images by name without the extension.
+    std::map<std::wstring, std::wstring> sources;
+    WIN32_FIND_DATAW found;
+    HANDLE find = FindFirstFileW((directory + L"\\*").c_str(), &found);
+    if (find == INVALID_HANDLE_VALUE)
+    {
+        Log(directory + L": not found");
+        return false;
+    }
+    do
+    {
+        const std::wstring name = found.cFileName;
+        const size_t dot = name.find_last_of(L'.');
+        if (dot == std::wstring::npos)
+            continue;
+        const std::wstring ext = name.substr(dot);
+        if (_wcsicmp(ext.c_str(), L".png") == 0 || _wcsicmp(ext.c_str(), L".jpg") == 0 || _wcsicmp(ext.c_str(), L".jpeg") == 0)
+            sources[name.substr(0, dot)] = directory + L"\\" + name;
+    } while (FindNextFileW(find, &found));
+    FindClose(find);
+
+    CreateDirectoryW(outDirectory.c_str(), nullptr);
+
+    bool ok = true;
+    for (const auto& source : sources)
+    {
+        const std::wstring& stem = source.first;
+        const size_t underscore = stem.find_last_of(L'_');
+        const std::wstring base = underscore == std::wstring::npos ? stem : stem.substr(0, underscore);
+        const std::wstring map = underscore == std::wstring::npos ? L"" : stem.substr(underscore + 1);
+
+        auto opacity = sources.find(base + L"_Opacity");
+        const bool hasOpacity = opacity != sources.end();
+
+        TextureUsage usage = TextureUsage::Color;
+        std::wstring opacityFilename;
+        if (map == L"Normal")
+            usage = TextureUsage::Normal;
+        else if (map == L"Gloss" || map == L"Roughness")
+            usage = TextureUsage::Mask;
+        else if (map == L"Opacity")
+        {
+            // Already in the alpha of the diffuse map.
+            if (sources.count(base + L"_Diffuse") != 0)
+                continue;
+            usage = TextureUsage::Mask;
+        }
+        else if (map == L"Diffuse" && hasOpacity)
+        {
+            usage = TextureUsage::ColorAlpha;
+            opacityFilename = opacity->second;
+        }
+
+        TextureCookStats stats;
+        if (!Cook(source.second, opacityFilename, outDirectory + L"\\" + stem + L".dds", usage, options, &stats))
+        {
+            ok = false;
+            continue;
+        }
+
+        wchar_t line[256];
+        swprintf_s(line, L"%s: %ux%u %s, %u mips, %.1f -> %.1f MB, decode %.0f ms, mips %.0f ms, encode %.0f ms",
+            stem.c_str(), stats.Width, stats.Height, FormatName(stats.Format), stats.MipLevels,
+            stats.UncompressedBytes / (1024.0 * 1024.0), stats.CookedBytes / (1024.0 * 1024.0),
+            stats.DecodeSeconds * 1000.0, stats.MipSeconds * 1000.0, stats.EncodeSeconds * 1000.0);
+        Log(line);
+    }
+    return ok;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "d3dUtil.h"
+#include "BlockEncoder.h"
+
+class JobSystem;
+
+// One level of a texture as linear float RGBA, rows top to bottom.
+struct TextureImage
+{
+    UINT Width = 0;
+    UINT Height = 0;
+    std::vector<DirectX::XMFLOAT4> Texels;
+
+    void Resize(UINT width, UINT height) { Width = width; Height = height; Texels.resize((size_t)width * height); }
+    DirectX::XMFLOAT4& At(UINT x, UINT y) { return Texels[(size_t)y * Width + x]; }
+    const DirectX::XMFLOAT4& At(UINT x, UINT y)const { return Texels[(size_t)y * Width + x]; }
+};
+
+// What the channels of a texture hold decides how it is filtered and which
+// block format it is stored in.
+enum class TextureUsage
+{
+    Color,          // sRGB RGB.                        BC1 (BC7 high quality)
+    ColorAlpha,     // sRGB RGB, linear alpha.          BC3 (BC7 high quality)
+    Normal,         // Tangent-space XY in RG.          BC5, renormalized per mip
+    Mask,           // One linear channel in R.         BC4
+};
+
+enum class MipFilter
+{
+    Box,            // Area average; 2x2 for even sizes.
+    Kaiser,         // Kaiser-windowed sinc, sharper with less aliasing.
+};
+
+struct TextureCookOptions
+{
+    MipFilter Filter = MipFilter::Kaiser;
+
+    // BC7 instead of BC1/BC3 for color maps.  Several times slower to encode.
+    bool HighQuality = false;
+
+    // Encoder effort, "-fast" and "-best" on the command line.
+    BlockQuality Quality = BlockQuality::Normal;
+
+    // Splits mip filtering and block encoding across threads when given.
+    JobSystem* Jobs = nullptr;
+};
+
+struct TextureCookStats
+{
+    UINT Width = 0;
+    UINT Height = 0;
+    UINT MipLevels = 0;
+    DXGI_FORMAT Format = DXGI_FORMAT_UNKNOWN;
+
+    // The same mip chain as RGBA8, and as written.
+    UINT64 UncompressedBytes = 0;
+    UINT64 CookedBytes = 0;
+
+    double DecodeSeconds = 0.0;
+    double MipSeconds = 0.0;
+    double EncodeSeconds = 0.0;
+};
+
+// Offline conversion of source images (PNG, JPEG; anything WIC decodes) into
+// block-compressed, fully mipmapped DDS files the runtime loads directly
+// ("-cook-textures <dir> <outdir> [-hq] [-box] [-fast|-best]").
+//   - Color is filtered in linear space and written as sRGB.
+//   - Normal maps are renormalized on every level and keep only XY (BC5); a
+//     shader sampling one must rebuild Z itself.
+//   - An opacity map is packed into the alpha of the color map it belongs to.
+//   - Blocks are encoded by BlockEncoder.
+// Failures return false and say why in the debugger output.
+class TextureCooker
+{
+public:
+    // Gray images are expanded to RGB.  srgb converts RGB to linear.
+    static bool DecodeImage(const std::wstring& filename, bool srgb, TextureImage& image);
+
+    // mips[0] is a copy of image, followed by every level down to 1x1.
+    static void BuildMips(const TextureImage& image, MipFilter filter, bool renormalize, JobSystem* jobs,
+        std::vector<TextureImage>& mips);
+
+    static DXGI_FORMAT FormatFor(TextureUsage usage, bool highQuality);
+
+    static bool WriteDds(const std::wstring& filename, const std::vector<TextureImage>& mips, TextureUsage usage,
+        const TextureCookOptions& options, TextureCookStats* stats = nullptr);
+
+    // opacityFilename may be empty; otherwise its first channel becomes alpha
+    // and usage should be ColorAlpha.
+    static bool Cook(const std::wstring& filename, const std::wstring& opacityFilename, const std::wstring& ddsFilename,
+        TextureUsage usage, const TextureCookOptions& options, TextureCookStats* stats = nullptr);
+
+    // Cooks every "<Name>_<Map>.png/.jpg" in directory into "<Name>_<Map>.dds"
+    // in outDirectory.  The map suffix picks the usage: Normal, Gloss,
+    // Roughness and Opacity are normal or mask maps; anything else is color.
+    // <Name>_Opacity is folded into <Name>_Diffuse when both exist.
+    static bool CookDirectory(const std::wstring& directory, const std::wstring& outDirectory,
+        const TextureCookOptions& options);
+};
@@ -0,0 +1,414 @@
+#include "TextureStreamer.h"
+#include "Camera.h"
+
+using namespace DirectX;
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+    // Sampled by the frames and copied from by the next change, at once.
+    const D3D12_RESOURCE_STATES StreamedState = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_COPY_SOURCE;
+}
+
+UINT TextureResidency::Add(const UINT64* levelBytes, UINT mipLevels, UINT coarsestFirstMip, UINT firstMipMask)
+{
+    assert(mipLevels <= DdsFile::MaxMipLevels && coarsestFirstMip < mipLevels);
+
+    Entry e;
+    for (UINT mip = 0; mip < mipLevels; ++mip)
+        e.LevelBytes[mip] = levelBytes[mip];
+    e.MipLevels = mipLevels;
+    e.FirstMipMask = firstMipMask;
+    assert(CanBeFirst(e, coarsestFirstMip));
+    e.CoarsestFirstMip = coarsestFirstMip;
+    e.Resident = coarsestFirstMip;
+    e.Target = coarsestFirstMip;
+    e.Wanted = coarsestFirstMip;
+    mTextures.push_back(e);
+    return (UINT)mTextures.size() - 1;
+}
+
+void TextureResidency::Request(UINT texture, UINT mip)
+{
+    Entry& e = mTextures[texture];
+    mip = std::min(mip, e.CoarsestFirstMip);
+    while (!CanBeFirst(e, mip))
+        mip--;
+    if (e.LastUsed != mFrame)
+    {
+        e.LastUsed = mFrame;
+        e.Wanted = mip;
+    }
+    else
+    {
+        e.Wanted = std::min(e.Wanted, mip);
+    }
+}
+
+void TextureResidency::Complete(UINT texture)
+{
+    Entry& e = mTextures[texture];
+    e.Resident = e.Target;
+}
+
+UINT64 TextureResidency::Bytes(UINT texture, UINT firstMip)const
+{
+    const Entry& e = mTextures[texture];
+    UINT64 bytes = 0;
+    for (UINT mip = firstMip; mip < e.MipLevels; ++mip)
+        bytes += e.LevelBytes[mip];
+    return bytes;
+}
+
+UINT64 TextureResidency::SettledBytes()const
+{
+    UINT64 bytes = 0;
+    for (UINT i = 0; i < (UINT)mTextures.size(); ++i)
+        bytes += Bytes(i, mTextures[i].Target);
+    return bytes;
+}
+
+void TextureResidency::Plan(UINT64 budgetBytes, UINT64 uploadBytesPerFrame, std::vector<Change>& changes)
+{
+    UINT64 settled = SettledBytes();
+
+    mOrder.clear();
+    for (UINT i = 0; i < (UINT)mTextures.size(); ++i)
+    {
+        if (!InFlight(i) && WantedMip(mTextures[i]) < mTextures[i].Resident)
+            mOrder.push_back(i);
+    }
+    std::sort(mOrder.begin(), mOrder.end(), [this](UINT a, UINT b)
+    {
+        const UINT missingA = mTextures[a].Resident - WantedMip(mTextures[a]);
+        const UINT missingB = mTextures[b].Resident - WantedMip(mTextures[b]);
+        return missingA != missingB ? missingA > missingB : a < b;
+    });
+
+    UINT64 uploaded = 0;
+    for (UINT index : mOrder)
+    {
+        Entry& e = mTextures[index];
+        const UINT wanted = WantedMip(e);
+        const UINT64 residentBytes = Bytes(index, e.Resident);
+
+        // As many finer levels as the upload cap leaves room for, stopping
+        // only where the texture can start.  wanted always can.
+        UINT first = e.Resident;
+        for (UINT mip = e.Resident; mip-- > wanted; )
+        {
+            const UINT64 more = Bytes(index, mip) - residentBytes;
+            if (uploaded + more > uploadBytesPerFrame && !(uploaded == 0 && first == e.Resident))
+                break;
+            if (CanBeFirst(e, mip))
+                first = mip;
+        }
+        if (first == e.Resident)
+            continue;
+
+        const UINT64 growth = Bytes(index, first) - residentBytes;
+        if (settled + growth > budgetBytes)
+            settled -= Evict(settled + growth - budgetBytes, index, changes);
+        if (settled + growth > budgetBytes)
+            continue;
+
+        e.Target = first;
+        changes.push_back({ index, first, growth });
+        settled += growth;
+        uploaded += growth;
+    }
+
+    mFrame++;
+}
+
+UINT64 TextureResidency::Evict(UINT64 bytes, UINT keep, std::vector<Change>& changes)
+{
+    mLru.clear();
+    for (UINT i = 0; i < (UINT)mTextures.size(); ++i)
+    {
+        if (i != keep && !InFlight(i) && mTextures[i].Resident < WantedMip(mTextures[i]))
+            mLru.push_back(i);
+    }
+    std::sort(mLru.begin(), mLru.end(), [this](UINT a, UINT b) { return mTextures[a].LastUsed < mTextures[b].LastUsed; });
+
+    UINT64 freed = 0;
+    for (UINT index : mLru)
+    {
+        if (freed >= bytes)
+            break;
+
+        Entry& e = mTextures[index];
+        const UINT wanted = WantedMip(e);
+        freed += Bytes(index, e.Resident) - Bytes(index, wanted);
+        e.Target = wanted;
+        changes.push_back({ index, wanted, 0 });
+    }
+    return freed;
+}
+
+UINT TextureResidency::RequiredMip(UINT texelSize, float uvScale, float worldSize, float distance,
+    float projScale, float viewportHeight, UINT mipLevels)
+{
+    // Pixels across the object, and level 0 texels across the same span.
+    const float pixels = worldSize * projScale * 0.5f * viewportHeight / std::max(distance, 1e-3f);
+    const float texels = texelSize * uvScale;
+    if (pixels <= 0.0f)
+        return mipLevels - 1;
+
+    const float texelsPerPixel = texels / pixels;
+    if (texelsPerPixel <= 1.0f)
+        return 0;
+    return std::min(mipLevels - 1, (UINT)log2f(texelsPerPixel));
+}
+
+void TextureStreamer::Initialize(ID3D12Device* device, TextureUploader* uploader, const TextureStreamerDesc& desc)
+{
+    mDevice = device;
+    mUploader = uploader;
+    mDesc = desc;
+}
+
+bool TextureStreamer::Add(const std::wstring& ddsFile, bool ignoreSrgb, UINT& texture)
+{
+    auto file = std::make_unique<DdsFile>();
+    if (!file->Open(ddsFile, ignoreSrgb))
+        return false;
+    Add(std::move(file), texture);
+    return true;
+}
+
+void TextureStreamer::Add(std::unique_ptr<DdsFile> file, UINT& texture)
+{
+    assert(file->IsOpen());
+    auto t = std::make_unique<StreamedTexture>();
+    t->File = std::move(file);
+
+    // The first level no larger than MinResidentSize, or the last one, made
+    // finer until the texture can start there: a non-square or odd-sized BC
+    // texture has small levels that are not whole blocks.
+    const DdsFile& dds = *t->File;
+    UINT64 levelBytes[DdsFile::MaxMipLevels];
+    UINT firstMipMask = 0;
+    UINT coarsest = dds.MipLevels() - 1;
+    for (UINT mip = dds.MipLevels(); mip-- > 0; )
+    {
+        const DdsFile::Level& level = dds.GetLevel(mip);
+        levelBytes[mip] = level.RowBytes * level.Rows;
+        if (std::max(level.Width, level.Height) <= mDesc.MinResidentSize)
+            coarsest = mip;
+        if (dds.CanBeFirstMip(mip))
+            firstMipMask |= 1u << mip;
+    }
+    while (coarsest > 0 && !dds.CanBeFirstMip(coarsest))
+        coarsest--;
+
+    t->ResidentMip = coarsest;
+    t->Resource = mUploader->Upload(dds, coarsest, StreamedState);
+
+    texture = mResidency.Add(levelBytes, dds.MipLevels(), coarsest, firstMipMask);
+    mTextures.push_back(std::move(t));
+    mStats.Textures++;
+}
+
+void TextureStreamer::CreateViews(UINT texture, ID3D12DescriptorHeap* heap, UINT descriptorSize, UINT srvIndex, UINT spareSrvIndex,
+    UINT tableSize)
+{
+    assert(std::max(srvIndex, spareSrvIndex) + tableSize <= heap->GetDesc().NumDescriptors &&
+        "a table based at the texture's views runs past the end of the heap");
+
+    StreamedTexture& t = *mTextures[texture];
+    mDescriptorSize = descriptorSize;
+    t.Heap = heap;
+    t.Srv[0] = srvIndex;
+    t.Srv[1] = spareSrvIndex;
+    t.CurrentSrv = 0;
+    WriteView(t, 0);
+}
+
+void TextureStreamer::Bind(UINT texture, Material* material)
+{
+    StreamedTexture& t = *mTextures[texture];
+    t.Materials.push_back(material);
+    material->DiffuseSrvHeapIndex = (int)t.Srv[t.CurrentSrv];
+    mBindings.push_back(std::make_pair(material, texture));
+}
+
+int TextureStreamer::Find(const Material* material)const
+{
+    for (const auto& binding : mBindings)
+    {
+        if (binding.first == material)
+            return (int)binding.second;
+    }
+    return -1;
+}
+
+void TextureStreamer::RequestVisible(const Camera& camera, float viewportHeight, RenderItem* const* items, UINT count)
+{
+    const float projScale = camera.GetProj4x4f()._22;
+    const XMVECTOR eye = camera.GetPosition();
+
+    // Items come sorted by material, so the lookup rarely runs.
+    const Material* material = nullptr;
+    int texture = -1;
+    for (UINT i = 0; i < count; ++i)
+    {
+        const RenderItem* ri = items[i];
+        if (ri->Mat != material)
+        {
+            material = ri->Mat;
+            texture = Find(material);
+        }
+        if (texture < 0)
+            continue;
+
+        // The texture is taken to span the item's bounding sphere once per
+        // unit of its texture transform's scale.
+        BoundingBox world;
+        ri->Bounds.Transform(world, XMLoadFloat4x4(&ri->World));
+        const float radius = XMVectorGetX(XMVector3Length(XMLoadFloat3(&world.Extents)));
+        const float centerDistance = XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat3(&world.Center), eye)));
+        const float distance = std::max(camera.GetNearZ(), centerDistance - radius);
+
+        const XMFLOAT4X4& tex = ri->TexTransform;
+        const float uvScale = std::max(sqrtf(tex._11 * tex._11 + tex._12 * tex._12), sqrtf(tex._21 * tex._21 + tex._22 * tex._22));
+
+        const DdsFile& dds = *mTextures[texture]->File;
+        const int mip = (int)TextureResidency::RequiredMip(std::max(dds.Width(), dds.Height()), uvScale, 2.0f * radius,
+            distance, projScale, viewportHeight, dds.MipLevels()) + mDesc.MipBias;
+        mResidency.Request((UINT)texture, (UINT)MathHelper::Clamp(mip, 0, (int)dds.MipLevels() - 1));
+    }
+}
+
+void TextureStreamer::Update(UINT64 completedFence)
+{
+    mStats.StreamedIn = 0;
+    mStats.StreamedOut = 0;
+    mStats.UploadBytes = 0;
+
+    while (!mRetired.empty() && mRetired.front().Fence <= completedFence)
+        mRetired.pop_front();
+
+    // Switch once the copies are done and no frame in flight can be reading
+    // the spare descriptor.
+    for (UINT i = 0; i < (UINT)mTextures.size(); ++i)
+    {
+        const StreamedTexture& t = *mTextures[i];
+        if (t.Pending != nullptr && mUploader->Timeline().IsComplete(t.PendingFence) && t.SpareFence <= completedFence)
+            Switch(i);
+    }
+
+    mChanges.clear();
+    mResidency.Plan(mDesc.MemoryBudget, mDesc.MaxUploadBytesPerFrame, mChanges);
+    for (const TextureResidency::Change& change : mChanges)
+    {
+        if (change.FirstMip < mTextures[change.Texture]->ResidentMip)
+            mStats.StreamedIn++;
+        else
+            mStats.StreamedOut++;
+        mStats.UploadBytes += change.UploadBytes;
+        Record(change.Texture, change.FirstMip);
+    }
+
+    if (!mChanges.empty())
+    {
+        const UINT64 fence = mUploader->Submit();
+        for (const TextureResidency::Change& change : mChanges)
+            mTextures[change.Texture]->PendingFence = fence;
+    }
+
+    mStats.TotalStreamedIn += mStats.StreamedIn;
+    mStats.TotalStreamedOut += mStats.StreamedOut;
+    mStats.InFlight = 0;
+    for (const auto& t : mTextures)
+        mStats.InFlight += t->Pending != nullptr ? 1 : 0;
+    mStats.ResidentBytes = mResidency.SettledBytes();
+}
+
+void TextureStreamer::EndFrame(UINT64 fence)
+{
+    for (UINT texture : mSwitched)
+        mTextures[texture]->SpareFence = fence;
+    mSwitched.clear();
+
+    for (ComPtr<ID3D12Resource>& resource : mReplaced)
+    {
+        Retired retired;
+        retired.Resource = std::move(resource);
+        retired.Fence = fence;
+        mRetired.push_back(std::move(retired));
+    }
+    mReplaced.clear();
+}
+
+void TextureStreamer::Record(UINT texture, UINT firstMip)
+{
+    StreamedTexture& t = *mTextures[texture];
+    const DdsFile& dds = *t.File;
+    assert(dds.CanBeFirstMip(firstMip));
+    const DdsFile::Level& top = dds.GetLevel(firstMip);
+
+    D3D12_RESOURCE_DESC desc = dds.ResourceDesc();
+    desc.Width = top.Width;
+    desc.Height = top.Height;
+    desc.MipLevels = (UINT16)(dds.MipLevels() - firstMip);
+
+    CD3DX12_HEAP_PROPERTIES heapProperties(D3D12_HEAP_TYPE_DEFAULT);
+    ThrowIfFailed(mDevice->CreateCommittedResource(
+        &heapProperties,
+        D3D12_HEAP_FLAG_NONE,
+        &desc,
+        D3D12_RESOURCE_STATE_COPY_DEST,
+        nullptr,
+        IID_PPV_ARGS(&t.Pending)));
+    t.Pending->SetName(dds.Filename().c_str());
+    t.PendingMip = firstMip;
+
+    // Levels both textures have are copied on the GPU.
+    for (UINT mip = std::max(firstMip, t.ResidentMip); mip < dds.MipLevels(); ++mip)
+    {
+        CD3DX12_TEXTURE_COPY_LOCATION dst(t.Pending.Get(), mip - firstMip);
+        CD3DX12_TEXTURE_COPY_LOCATION src(t.Resource.Get(), mip - t.ResidentMip);
+        mUploader->CommandList()->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+    }
+
+    // Finer ones come from the file.
+    for (UINT mip = firstMip; mip < t.ResidentMip; ++mip)
+        mUploader->UploadLevel(dds, mip, t.Pending.Get(), mip - firstMip);
+
+    CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(t.Pending.Get(),
+        D3D12_RESOURCE_STATE_COPY_DEST, StreamedState);
+    mUploader->CommandList()->ResourceBarrier(1, &barrier);
+}
+
+void TextureStreamer::Switch(UINT texture)
+{
+    StreamedTexture& t = *mTextures[texture];
+    mReplaced.push_back(std::move(t.Resource));
+    t.Resource = std::move(t.Pending);
+    t.ResidentMip = t.PendingMip;
+
+    t.CurrentSrv ^= 1;
+    WriteView(t, t.CurrentSrv);
+    for (Material* material : t.Materials)
+        material->DiffuseSrvHeapIndex = (int)t.Srv[t.CurrentSrv];
+
+    mSwitched.push_back(texture);
+    mResidency.Complete(texture);
+}
+
+void TextureStreamer::WriteView(StreamedTexture& t, UINT slot)
+{
+    assert(t.Heap != nullptr && "CreateViews has not been called for this texture");
+
+    D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+    srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    srvDesc.Format = t.File->Format();
+    srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+    srvDesc.Texture2D.MostDetailedMip = 0;
+    srvDesc.Texture2D.MipLevels = t.Resource->GetDesc().MipLevels;
+    srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
+
+    CD3DX12_CPU_DESCRIPTOR_HANDLE descriptor(t.Heap->GetCPUDescriptorHandleForHeapStart(), t.Srv[slot], mDescriptorSize);
+    mDevice->CreateShaderResourceView(t.Resource.Get(), &srvDesc, descriptor);
+}
@@ -0,0 +1,227 @@
+#pragma once
+
+#include "d3dUtil.h"
+#include "Datatypes.h"
+#include "DdsFile.h"
+#include "TextureUploader.h"
+#include <deque>
+
+class Camera;
+
+// Which mip levels of each streamed texture should be resident.  No GPU work
+// happens here, so the policy runs the same in the renderer and in benchmarks.
+//   - Each frame, Request records the finest level some visible item wants;
+//     a texture nobody asks for wants only its coarse levels, which are
+//     always resident.
+//   - Plan turns the difference into changes of the first resident level.
+//     Textures missing the most levels go first.  The bytes read from disk
+//     per frame are capped, though one level always gets through.
+//   - Levels no longer wanted stay resident as a cache until the budget is
+//     needed, then go in least recently used order.
+//   - The budget counts textures as they will be once the changes in flight
+//     have landed; a texture being replaced briefly exists twice.
+class TextureResidency
+{
+public:
+    struct Change
+    {
+        UINT Texture;
+        UINT FirstMip;
+        UINT64 UploadBytes;     // Finer levels read from the file.
+    };
+
+    // levelBytes[mip] for mipLevels levels; levels from coarsestFirstMip
+    // down are always resident.  Only the levels set in firstMipMask, and
+    // level 0, are ever made the first resident one; requests for others
+    // are rounded to the next finer level that is.
+    UINT Add(const UINT64* levelBytes, UINT mipLevels, UINT coarsestFirstMip, UINT firstMipMask = ~0u);
+    UINT TextureCount()const { return (UINT)mTextures.size(); }
+
+    // mip and everything coarser is wanted this frame.
+    void Request(UINT texture, UINT mip);
+
+    // Appends this frame's changes and marks their textures in flight, then
+    // starts collecting requests for the next frame.
+    void Plan(UINT64 budgetBytes, UINT64 uploadBytesPerFrame, std::vector<Change>& changes);
+
+    // The change of texture has landed.
+    void Complete(UINT texture);
+
+    UINT ResidentMip(UINT texture)const { return mTextures[texture].Resident; }
+    bool InFlight(UINT texture)const { return mTextures[texture].Target != mTextures[texture].Resident; }
+
+    // Bytes of levels [firstMip, end) of texture.
+    UINT64 Bytes(UINT texture, UINT firstMip)const;
+
+    // Sum over the textures as they will be once every change has landed.
+    UINT64 SettledBytes()const;
+
+    // Mip whose texels come closest to one per pixel for a texture of
+    // texelSize mapped uvScale times across an object of worldSize, seen at
+    // distance through a projection whose _22 is projScale on a viewport
+    // viewportHeight pixels tall.
+    static UINT RequiredMip(UINT texelSize, float uvScale, float worldSize, float distance,
+        float projScale, float viewportHeight, UINT mipLevels);
+
+private:
+    struct Entry
+    {
+        UINT64 LevelBytes[DdsFile::MaxMipLevels];
+        UINT MipLevels = 0;
+        UINT CoarsestFirstMip = 0;
+        UINT FirstMipMask = ~0u;
+        UINT Resident = 0;      // First resident level.
+        UINT Target = 0;        // First level once the change in flight lands.
+        UINT Wanted = 0;        // Finest level asked for this frame.
+        UINT64 LastUsed = 0;    // Frame of the last request.
+    };
+
+    UINT WantedMip(const Entry& e)const { return e.LastUsed == mFrame ? e.Wanted : e.CoarsestFirstMip; }
+    static bool CanBeFirst(const Entry& e, UINT mip) { return mip == 0 || (e.FirstMipMask >> mip & 1) != 0; }
+
+    // Drops levels nobody wants from the least recently used textures, other
+    // than keep, until bytes are freed; returns the bytes freed.
+    UINT64 Evict(UINT64 bytes, UINT keep, std::vector<Change>& changes);
+
+    std::vector<Entry> mTextures;
+    UINT64 mFrame = 1;
+
+    std::vector<UINT> mOrder;
+    std::vector<UINT> mLru;
+};
+
+struct TextureStreamerDesc
+{
+    // GPU memory allowed for streamed textures, counted in texel bytes.
+    UINT64 MemoryBudget = 32ull * 1024 * 1024;
+
+    // Texel bytes read from the DDS files per frame.
+    UINT64 MaxUploadBytesPerFrame = 2ull * 1024 * 1024;
+
+    // Levels this size and smaller are loaded up front and never evicted.
+    UINT MinResidentSize = 64;
+
+    // Added to the mip each item asks for; positive trades sharpness for memory.
+    int MipBias = 0;
+};
+
+// Streams the mip levels of DDS textures in and out as the camera moves.
+//   - Add uploads only the coarse levels; the feedback from the visible items
+//     (RequestVisible) drives TextureResidency, and Update carries out its
+//     changes.
+//   - A change builds a new texture with the wanted levels: the levels both
+//     have are copied on the GPU from the current texture, the finer ones
+//     come from the mapped file through the TextureUploader.
+//   - Each texture has two descriptors.  Once a change's copies are done the
+//     new texture is written to the spare one and the bound materials
+//     switch to it, so no descriptor in use by a frame in flight is touched.
+//     The old texture and descriptor are given back after the GPU is past
+//     the frame of the switch (EndFrame).
+// Textures stay readable as PIXEL_SHADER_RESOURCE and COPY_SOURCE together.
+// Not thread safe: RequestVisible may run in a job, but not alongside the
+// other calls.
+class TextureStreamer
+{
+public:
+    struct Stats
+    {
+        UINT Textures = 0;
+        UINT InFlight = 0;
+        UINT64 ResidentBytes = 0;   // Settled, see TextureResidency.
+
+        // This frame.
+        UINT StreamedIn = 0;
+        UINT StreamedOut = 0;
+        UINT64 UploadBytes = 0;
+
+        // Over the whole run.
+        UINT64 TotalStreamedIn = 0;
+        UINT64 TotalStreamedOut = 0;
+    };
+
+    TextureStreamer() = default;
+    TextureStreamer(const TextureStreamer& rhs) = delete;
+    TextureStreamer& operator=(const TextureStreamer& rhs) = delete;
+
+    void Initialize(ID3D12Device* device, TextureUploader* uploader, const TextureStreamerDesc& desc);
+
+    // Maps ddsFile and uploads its coarse levels; false if it does not open.
+    bool Add(const std::wstring& ddsFile, bool ignoreSrgb, UINT& texture);
+
+    // Takes over a file opened elsewhere, such as on a loader thread.
+    void Add(std::unique_ptr<DdsFile> file, UINT& texture);
+
+    // Writes the view of texture to srvIndex of heap; spareSrvIndex takes
+    // turns with it as the texture changes.  Either one is bound as the base
+    // of a descriptor table of tableSize entries, so the heap must hold
+    // tableSize views from each.
+    void CreateViews(UINT texture, ID3D12DescriptorHeap* heap, UINT descriptorSize, UINT srvIndex, UINT spareSrvIndex,
+        UINT tableSize);
+
+    // material's DiffuseSrvHeapIndex follows texture from now on, and items
+    // drawn with it drive its residency.
+    void Bind(UINT texture, Material* material);
+
+    // Residency feedback from this frame's visible items.
+    void RequestVisible(const Camera& camera, float viewportHeight, RenderItem* const* items, UINT count);
+
+    // Releases what the GPU is done with, switches to the textures whose
+    // copies are complete, then plans and records this frame's changes.
+    void Update(UINT64 completedFence);
+
+    // Tags this frame's switches with its fence.
+    void EndFrame(UINT64 fence);
+
+    ID3D12Resource* Resource(UINT texture)const { return mTextures[texture]->Resource.Get(); }
+    const Stats& GetStats()const { return mStats; }
+
+private:
+    struct StreamedTexture
+    {
+        std::unique_ptr<DdsFile> File;
+        Microsoft::WRL::ComPtr<ID3D12Resource> Resource;    // Levels [ResidentMip, end).
+        UINT ResidentMip = 0;
+
+        ID3D12DescriptorHeap* Heap = nullptr;
+        UINT Srv[2] = { 0, 0 };
+        UINT CurrentSrv = 0;
+        UINT64 SpareFence = 0;      // The spare descriptor is free once the GPU is here.
+
+        std::vector<Material*> Materials;
+
+        // The change in flight.
+        Microsoft::WRL::ComPtr<ID3D12Resource> Pending;
+        UINT PendingMip = 0;
+        UINT64 PendingFence = 0;    // On the uploader's timeline.
+    };
+
+    struct Retired
+    {
+        Microsoft::WRL::ComPtr<ID3D12Resource> Resource;
+        UINT64 Fence;
+    };
+
+    int Find(const Material* material)const;
+    void Record(UINT texture, UINT firstMip);
+    void Switch(UINT texture);
+    void WriteView(StreamedTexture& t, UINT slot);
+
+private:
+    Microsoft::WRL::ComPtr<ID3D12Device> mDevice;
+    TextureUploader* mUploader = nullptr;
+    TextureStreamerDesc mDesc;
+    UINT mDescriptorSize = 0;
+
+    std::vector<std::unique_ptr<StreamedTexture>> mTextures;
+    std::vector<std::pair<const Material*, UINT>> mBindings;
+    TextureResidency mResidency;
+    std::vector<TextureResidency::Change> mChanges;
+
+    // Textures switched this frame, waiting for EndFrame's fence, and the
+    // resources they replaced.
+    std::vector<UINT> mSwitched;
+    std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> mReplaced;
+    std::deque<Retired> mRetired;
+
+    Stats mStats;
+};
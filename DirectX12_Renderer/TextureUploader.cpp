@@ -0,0 +1,231 @@
+#include "TextureUploader.h"
+
+using Microsoft::WRL::ComPtr;
+
+TextureUploader::TextureUploader(ID3D12Device* device, ID3D12CommandQueue* queue, UINT64 stagingBytes) :
+    mDevice(device),
+    mQueue(queue)
+{
+    mTimeline = std::make_unique<D3D12Timeline>(device, queue);
+    mRing = std::make_unique<UploadRing>(device, stagingBytes);
+    mRing->Resource()->SetName(L"Texture Staging Ring");
+
+    ThrowIfFailed(device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&mAllocator)));
+    ThrowIfFailed(device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, mAllocator.Get(), nullptr,
+        IID_PPV_ARGS(&mCommandList)));
+    mCommandList->SetName(L"Texture Uploads");
+
+    // Created open; BeginBatch resets it before the first copy.
+    ThrowIfFailed(mCommandList->Close());
+    mFreeAllocators.push_back(mAllocator);
+    mAllocator.Reset();
+}
+
+TextureUploader::~TextureUploader()
+{
+    Submit();
+    mTimeline->WaitIdle();
+}
+
+UINT64 TextureUploader::RowPitch(UINT64 rowBytes)
+{
+    const UINT64 a = D3D12_TEXTURE_DATA_PITCH_ALIGNMENT;
+    return (rowBytes + a - 1) & ~(a - 1);
+}
+
+ComPtr<ID3D12Resource> TextureUploader::Upload(const DdsFile& dds, UINT firstMip, D3D12_RESOURCE_STATES state)
+{
+    assert(dds.IsOpen() && firstMip < dds.MipLevels());
+    assert(dds.CanBeFirstMip(firstMip) && "a BC texture cannot start at a level that is not whole blocks");
+    const DdsFile::Level& top = dds.GetLevel(firstMip);
+
+    D3D12_RESOURCE_DESC desc = dds.ResourceDesc();
+    desc.Width = top.Width;
+    desc.Height = top.Height;
+    desc.MipLevels = (UINT16)(dds.MipLevels() - firstMip);
+
+    ComPtr<ID3D12Resource> texture;
+    CD3DX12_HEAP_PROPERTIES heapProperties(D3D12_HEAP_TYPE_DEFAULT);
+    ThrowIfFailed(mDevice->CreateCommittedResource(
+        &heapProperties,
+        D3D12_HEAP_FLAG_NONE,
+        &desc,
+        D3D12_RESOURCE_STATE_COPY_DEST,
+        nullptr,
+        IID_PPV_ARGS(&texture)));
+    texture->SetName(dds.Filename().c_str());
+
+    for (UINT mip = firstMip; mip < dds.MipLevels(); ++mip)
+        UploadLevel(dds, mip, texture.Get(), mip - firstMip);
+
+    // Recorded after the last copy, on the same or a later list.
+    CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(texture.Get(),
+        D3D12_RESOURCE_STATE_COPY_DEST, state);
+    CommandList()->ResourceBarrier(1, &barrier);
+
+    mStats.Textures++;
+    return texture;
+}
+
+ComPtr<ID3D12Resource> TextureUploader::UploadBuffer(const void* data, UINT64 byteSize, D3D12_RESOURCE_STATES state)
+{
+    ComPtr<ID3D12Resource> buffer;
+    CD3DX12_HEAP_PROPERTIES heapProperties(D3D12_HEAP_TYPE_DEFAULT);
+    CD3DX12_RESOURCE_DESC desc = CD3DX12_RESOURCE_DESC::Buffer(byteSize);
+    ThrowIfFailed(mDevice->CreateCommittedResource(
+        &heapProperties,
+        D3D12_HEAP_FLAG_NONE,
+        &desc,
+        D3D12_RESOURCE_STATE_COMMON,
+        nullptr,
+        IID_PPV_ARGS(&buffer)));
+
+    CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(buffer.Get(),
+        D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COPY_DEST);
+    CommandList()->ResourceBarrier(1, &barrier);
+
+    // Pieces of up to half the ring, as in UploadLevel.
+    const UINT64 maxPieceBytes = mRing->Capacity() / 2 - D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT;
+    const BYTE* src = static_cast<const BYTE*>(data);
+    UINT64 offset = 0;
+    while (offset < byteSize)
+    {
+        if (!mRecording)
+            BeginBatch();
+
+        const UINT64 bytes = std::min(byteSize - offset, maxPieceBytes);
+        UploadAllocation piece = mRing->Allocate(bytes, 16);
+        if (piece.Cpu == nullptr)
+        {
+            MakeRoom();
+            continue;
+        }
+
+        memcpy(piece.Cpu, src + offset, (size_t)bytes);
+        mCommandList->CopyBufferRegion(buffer.Get(), offset, mRing->Resource(), piece.Offset, bytes);
+
+        mStats.Copies++;
+        mStats.BytesStaged += bytes;
+        offset += bytes;
+    }
+
+    barrier = CD3DX12_RESOURCE_BARRIER::Transition(buffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST, state);
+    CommandList()->ResourceBarrier(1, &barrier);
+
+    mStats.Buffers++;
+    return buffer;
+}
+
+void TextureUploader::UploadLevel(const DdsFile& dds, UINT mip, ID3D12Resource* texture, UINT textureMip)
+{
+    const DdsFile::Level& level = dds.GetLevel(mip);
+    const UINT blockSize = dds.IsBlockCompressed() ? 4 : 1;
+    const UINT64 pitch = RowPitch(level.RowBytes);
+
+    // Up to half the ring per piece always fits once the ring has drained,
+    // wherever its head happens to be.
+    const UINT64 maxPieceBytes = mRing->Capacity() / 2 - D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT;
+    assert(pitch <= maxPieceBytes && "staging ring too small for one row of this texture");
+    const UINT maxRows = (UINT)std::max<UINT64>(1, maxPieceBytes / pitch);
+
+    CD3DX12_TEXTURE_COPY_LOCATION dst(texture, textureMip);
+    UINT row = 0;
+    while (row < level.Rows)
+    {
+        if (!mRecording)
+            BeginBatch();
+
+        const UINT rows = std::min(level.Rows - row, maxRows);
+        UploadAllocation piece = mRing->Allocate(pitch * rows, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+        if (piece.Cpu == nullptr)
+        {
+            MakeRoom();
+            continue;
+        }
+
+        dds.CopyRows(mip, row, rows, piece.Cpu, pitch);
+
+        D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint = {};
+        footprint.Offset = piece.Offset;
+        footprint.Footprint.Format = dds.Format();
+        footprint.Footprint.Width = (level.Width + blockSize - 1) / blockSize * blockSize;
+        footprint.Footprint.Height = rows * blockSize;
+        footprint.Footprint.Depth = 1;
+        footprint.Footprint.RowPitch = (UINT)pitch;
+        CD3DX12_TEXTURE_COPY_LOCATION src(mRing->Resource(), footprint);
+
+        // Blocks past the right or bottom edge of a small level are not copied.
+        const UINT y = row * blockSize;
+        D3D12_BOX box = { 0, 0, 0, level.Width, std::min(rows * blockSize, level.Height - y), 1 };
+        mCommandList->CopyTextureRegion(&dst, 0, y, 0, &src, &box);
+
+        mStats.Copies++;
+        mStats.BytesStaged += pitch * rows;
+        row += rows;
+    }
+}
+
+ID3D12GraphicsCommandList* TextureUploader::CommandList()
+{
+    if (!mRecording)
+        BeginBatch();
+    return mCommandList.Get();
+}
+
+UINT64 TextureUploader::Submit()
+{
+    if (!mRecording)
+        return mTimeline->LastSignaled();
+
+    ThrowIfFailed(mCommandList->Close());
+    ID3D12CommandList* cmdsLists[] = { mCommandList.Get() };
+    mQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+
+    const UINT64 fence = mTimeline->Signal();
+    mRing->EndFrame(fence);
+
+    Batch batch;
+    batch.Fence = fence;
+    batch.Allocator = std::move(mAllocator);
+    mInFlight.push_back(std::move(batch));
+
+    mRecording = false;
+    mStats.Batches++;
+    return fence;
+}
+
+void TextureUploader::BeginBatch()
+{
+    // Retire finished batches: their ring space and allocators come back.
+    const UINT64 completed = mTimeline->CompletedValue();
+    while (!mInFlight.empty() && mInFlight.front().Fence <= completed)
+    {
+        mFreeAllocators.push_back(std::move(mInFlight.front().Allocator));
+        mInFlight.pop_front();
+    }
+    mRing->BeginFrame(completed);
+
+    if (mFreeAllocators.empty())
+    {
+        ThrowIfFailed(mDevice->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&mAllocator)));
+    }
+    else
+    {
+        mAllocator = std::move(mFreeAllocators.back());
+        mFreeAllocators.pop_back();
+        ThrowIfFailed(mAllocator->Reset());
+    }
+
+    ThrowIfFailed(mCommandList->Reset(mAllocator.Get(), nullptr));
+    mRecording = true;
+}
+
+void TextureUploader::MakeRoom()
+{
+    Submit();
+    assert(!mInFlight.empty());
+
+    // BeginBatch retires it.
+    mStats.Stalls++;
+    mTimeline->Wait(mInFlight.front().Fence);
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "d3dUtil.h"
+#include "DdsFile.h"
+#include "GpuTimeline.h"
+#include "UploadRing.h"
+#include <deque>
+
+// Streams texel data into default-heap textures through one upload ring of
+// fixed size, instead of a committed upload buffer per texture.
+//   - Rows go from the DDS mapping straight into the ring at the 256-byte
+//     pitch the copy needs; a level larger than the ring is split into
+//     pieces of rows.
+//   - Copies are recorded on the uploader's own command lists and submitted
+//     in batches on the given queue; when the ring is full the pending batch
+//     is submitted and the oldest one waited for, so any number of textures
+//     goes through the same staging budget.
+//   - Textures end in the state asked for, PIXEL_SHADER_RESOURCE by default.
+//     Submit before drawing with them; later work on the same queue sees the
+//     copies.
+class TextureUploader
+{
+public:
+    struct Stats
+    {
+        UINT Textures = 0;
+        UINT Buffers = 0;
+        UINT Copies = 0;
+        UINT Batches = 0;
+        UINT Stalls = 0;            // Times the ring was full.
+        UINT64 BytesStaged = 0;
+    };
+
+    TextureUploader(ID3D12Device* device, ID3D12CommandQueue* queue, UINT64 stagingBytes);
+    TextureUploader(const TextureUploader& rhs) = delete;
+    TextureUploader& operator=(const TextureUploader& rhs) = delete;
+
+    // Waits for the copies still reading the ring.
+    ~TextureUploader();
+
+    // Creates the texture and records the copies of levels [firstMip,
+    // dds.MipLevels()), leaving it in state; firstMip must pass
+    // dds.CanBeFirstMip.  dds can be closed once this returns.
+    Microsoft::WRL::ComPtr<ID3D12Resource> Upload(const DdsFile& dds, UINT firstMip = 0,
+        D3D12_RESOURCE_STATES state = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+
+    // Creates a default-heap buffer holding data, left in state.  Meshes go
+    // through the same ring as the textures.
+    Microsoft::WRL::ComPtr<ID3D12Resource> UploadBuffer(const void* data, UINT64 byteSize, D3D12_RESOURCE_STATES state);
+
+    // Records the copies of mip into an existing texture in COPY_DEST, whose
+    // level textureMip has the same size; the caller transitions it.
+    void UploadLevel(const DdsFile& dds, UINT mip, ID3D12Resource* texture, UINT textureMip);
+
+    // The list the copies are being recorded on, opened if need be, for
+    // barriers and GPU copies that belong with them.  Another call to the
+    // uploader may submit it.
+    ID3D12GraphicsCommandList* CommandList();
+
+    // Submits what has been recorded; returns the fence value that covers it.
+    UINT64 Submit();
+
+    GpuTimeline& Timeline() { return *mTimeline; }
+    UINT64 StagingBytes()const { return mRing->Capacity(); }
+    const Stats& GetStats()const { return mStats; }
+
+    // Row pitch of a copy footprint for rows of rowBytes.
+    static UINT64 RowPitch(UINT64 rowBytes);
+
+private:
+    struct Batch
+    {
+        UINT64 Fence;
+        Microsoft::WRL::ComPtr<ID3D12CommandAllocator> Allocator;
+    };
+
+    void BeginBatch();
+
+    // Frees ring space: submits the open batch and waits for the oldest.
+    void MakeRoom();
+
+private:
+    Microsoft::WRL::ComPtr<ID3D12Device> mDevice;
+    ID3D12CommandQueue* mQueue = nullptr;
+    std::unique_ptr<D3D12Timeline> mTimeline;
+    std::unique_ptr<UploadRing> mRing;
+
+    Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> mCommandList;
+    Microsoft::WRL::ComPtr<ID3D12CommandAllocator> mAllocator;
+    bool mRecording = false;
+
+    // Submitted batches, oldest first, and allocators free for reuse.
+    std::deque<Batch> mInFlight;
+    std::vector<Microsoft::WRL::ComPtr<ID3D12CommandAllocator>> mFreeAllocators;
+
+    Stats mStats;
+};
@@ -0,0 +1,182 @@
+#include "TransformSystem.h"
+#include "JobSystem.h"
+#include <atomic>
+
+using namespace DirectX;
+
+namespace
+{
+    // Slots per job when a level is split.
+    const UINT UpdateGrain = 1024;
+}
+
+UINT TransformSystem::Create(UINT parent, FXMMATRIX local)
+{
+    assert(parent == InvalidNode || parent < NodeCount());
+
+    // New nodes go to the end; the next Update moves them to their level and
+    // links them to their parent's slot.
+    const UINT node = NodeCount();
+    mNodeParent.push_back(parent);
+    mNodeDepth.push_back(parent == InvalidNode ? 0 : mNodeDepth[parent] + 1);
+    mSlotOfNode.push_back(node);
+
+    mParentSlot.emplace_back();
+    mLocal.emplace_back();
+    XMStoreFloat4x4A(&mLocal.back(), local);
+    mWorld.emplace_back();
+    XMStoreFloat4x4A(&mWorld.back(), local);
+    mDirty.push_back(1);
+    mChanged.push_back(0);
+
+    mLayoutDirty = true;
+    mDirtyCount++;
+    return node;
+}
+
+void TransformSystem::SetLocal(UINT node, FXMMATRIX local)
+{
+    const UINT slot = mSlotOfNode[node];
+    XMStoreFloat4x4A(&mLocal[slot], local);
+    if (!mDirty[slot])
+    {
+        mDirty[slot] = 1;
+        mDirtyCount++;
+    }
+}
+
+void TransformSystem::Attach(UINT node, RenderItem* item)
+{
+    mAttachments.emplace_back(node, item);
+    mLayoutDirty = true;
+
+    // Make sure the item picks up the current world.
+    const UINT slot = mSlotOfNode[node];
+    if (!mDirty[slot])
+    {
+        mDirty[slot] = 1;
+        mDirtyCount++;
+    }
+}
+
+void TransformSystem::SortByDepth()
+{
+    const UINT count = NodeCount();
+
+    UINT levels = 0;
+    for (UINT depth : mNodeDepth)
+        levels = std::max(levels, depth + 1);
+
+    // Counting sort on depth; creation order is kept within a level.
+    mLevelStart.assign(levels + 1, 0);
+    for (UINT depth : mNodeDepth)
+        mLevelStart[depth + 1]++;
+    for (UINT d = 0; d < levels; ++d)
+        mLevelStart[d + 1] += mLevelStart[d];
+
+    std::vector<UINT> next(mLevelStart.begin(), mLevelStart.end() - 1);
+    std::vector<UINT> newSlot(count);
+    for (UINT node = 0; node < count; ++node)
+        newSlot[node] = next[mNodeDepth[node]]++;
+
+    std::vector<XMFLOAT4X4A> local(count), world(count);
+    std::vector<std::uint8_t> dirty(count);
+    std::vector<UINT> parentSlot(count);
+    for (UINT node = 0; node < count; ++node)
+    {
+        const UINT from = mSlotOfNode[node];
+        const UINT to = newSlot[node];
+        local[to] = mLocal[from];
+        world[to] = mWorld[from];
+        dirty[to] = mDirty[from];
+        parentSlot[to] = mNodeParent[node] == InvalidNode ? InvalidNode : newSlot[mNodeParent[node]];
+    }
+    mLocal.swap(local);
+    mWorld.swap(world);
+    mDirty.swap(dirty);
+    mParentSlot.swap(parentSlot);
+    mSlotOfNode.swap(newSlot);
+    mChanged.assign(count, 0);
+
+    // Attachments grouped by slot.
+    mItemStart.assign(count + 1, 0);
+    for (const auto& a : mAttachments)
+        mItemStart[mSlotOfNode[a.first] + 1]++;
+    for (UINT s = 0; s < count; ++s)
+        mItemStart[s + 1] += mItemStart[s];
+
+    mItems.resize(mAttachments.size());
+    std::vector<UINT> cursor(mItemStart.begin(), mItemStart.end() - 1);
+    for (const auto& a : mAttachments)
+        mItems[cursor[mSlotOfNode[a.first]]++] = a.second;
+
+    mLayoutDirty = false;
+}
+
+UINT TransformSystem::UpdateSlots(UINT first, UINT last, UINT* items)
+{
+    UINT updated = 0;
+    for (UINT s = first; s < last; ++s)
+    {
+        const UINT parent = mParentSlot[s];
+        const bool changed = mDirty[s] || (parent != InvalidNode && mChanged[parent]);
+        mChanged[s] = changed;
+        if (!changed)
+            continue;
+
+        mDirty[s] = 0;
+        XMMATRIX world = XMLoadFloat4x4A(&mLocal[s]);
+        if (parent != InvalidNode)
+            world = XMMatrixMultiply(world, XMLoadFloat4x4A(&mWorld[parent]));
+        XMStoreFloat4x4A(&mWorld[s], world);
+
+        for (UINT i = mItemStart[s]; i < mItemStart[s + 1]; ++i)
+        {
+            XMStoreFloat4x4(&mItems[i]->World, world);
+            mItems[i]->BoundsDirty = true;
+        }
+        *items += mItemStart[s + 1] - mItemStart[s];
+        updated++;
+    }
+    return updated;
+}
+
+void TransformSystem::Update(JobSystem* jobs)
+{
+    mStats.NodesUpdated = 0;
+    mStats.ItemsUpdated = 0;
+    if (mDirtyCount == 0 && !mLayoutDirty)
+        return;
+
+    if (mLayoutDirty)
+        SortByDepth();
+    mStats.Levels = (UINT)mLevelStart.size() - 1;
+
+    // Levels run in order; the slots of one level only read the level above.
+    std::atomic<UINT> updated{ 0 };
+    std::atomic<UINT> items{ 0 };
+    for (UINT d = 0; d < mStats.Levels; ++d)
+    {
+        const UINT first = mLevelStart[d];
+        const UINT count = mLevelStart[d + 1] - first;
+        if (jobs != nullptr && count > UpdateGrain)
+        {
+            jobs->ParallelFor(count, UpdateGrain, [&](UINT begin, UINT end)
+            {
+                UINT rangeItems = 0;
+                updated.fetch_add(UpdateSlots(first + begin, first + end, &rangeItems), std::memory_order_relaxed);
+                items.fetch_add(rangeItems, std::memory_order_relaxed);
+            });
+        }
+        else
+        {
+            UINT rangeItems = 0;
+            updated.fetch_add(UpdateSlots(first, first + count, &rangeItems), std::memory_order_relaxed);
+            items.fetch_add(rangeItems, std::memory_order_relaxed);
+        }
+    }
+
+    mStats.NodesUpdated = updated.load();
+    mStats.ItemsUpdated = items.load();
+    mDirtyCount = 0;
+}
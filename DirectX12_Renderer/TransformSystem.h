@@ -0,0 +1,76 @@
+#pragma once
+
+#include "Datatypes.h"
+
+class JobSystem;
+
+// Parent/child transforms for scene objects.
+//   - Nodes are addressed by the id Create returns.  Their data is stored
+//     structure-of-arrays in slots sorted by hierarchy depth, so a single pass
+//     over the slots always reaches a parent before its children, and every
+//     level can be split across threads.
+//   - SetLocal flags a node.  Update recomputes world = local * parentWorld
+//     for flagged nodes and for everything below them; the rest of the tree is
+//     a flag check per node.  With nothing flagged Update returns at once, so
+//     static objects cost nothing per frame.
+//   - Render items attached to a node get its world matrix, and BoundsDirty,
+//     only when it changed.
+class TransformSystem
+{
+public:
+    static const UINT InvalidNode = 0xFFFFFFFF;
+
+    struct Stats
+    {
+        UINT Levels = 0;
+        UINT NodesUpdated = 0;
+        UINT ItemsUpdated = 0;
+    };
+
+    // parent is InvalidNode for a root.
+    UINT Create(UINT parent, DirectX::FXMMATRIX local);
+    void SetLocal(UINT node, DirectX::FXMMATRIX local);
+
+    // World is as of the last Update.
+    DirectX::XMMATRIX GetLocal(UINT node)const { return DirectX::XMLoadFloat4x4A(&mLocal[mSlotOfNode[node]]); }
+    DirectX::XMMATRIX GetWorld(UINT node)const { return DirectX::XMLoadFloat4x4A(&mWorld[mSlotOfNode[node]]); }
+
+    // item->World follows the node from the next Update on.
+    void Attach(UINT node, RenderItem* item);
+
+    // Large levels are split across jobs when given.
+    void Update(JobSystem* jobs);
+
+    UINT NodeCount()const { return (UINT)mNodeParent.size(); }
+    const Stats& GetStats()const { return mStats; }
+
+private:
+    void SortByDepth();
+
+    // Returns the number of slots recomputed and adds their items to items.
+    UINT UpdateSlots(UINT first, UINT last, UINT* items);
+
+private:
+    // Indexed by node id.
+    std::vector<UINT> mNodeParent;
+    std::vector<UINT> mNodeDepth;
+    std::vector<UINT> mSlotOfNode;
+    std::vector<std::pair<UINT, RenderItem*>> mAttachments;
+
+    // Indexed by slot, in depth order.  mLevelStart[d] is the first slot of
+    // depth d, with one extra entry at the end.
+    std::vector<UINT> mParentSlot;
+    std::vector<DirectX::XMFLOAT4X4A> mLocal;
+    std::vector<DirectX::XMFLOAT4X4A> mWorld;
+    std::vector<std::uint8_t> mDirty;
+    std::vector<std::uint8_t> mChanged;
+    std::vector<UINT> mLevelStart;
+
+    // Attached items of slot s are mItems[mItemStart[s], mItemStart[s+1]).
+    std::vector<UINT> mItemStart;
+    std::vector<RenderItem*> mItems;
+
+    bool mLayoutDirty = false;
+    UINT mDirtyCount = 0;
+    Stats mStats;
+};
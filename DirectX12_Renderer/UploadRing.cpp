@@ -0,0 +1,118 @@
+#include "UploadRing.h"
+
+namespace
+{
+    // Capacities are rounded to this, so a position's alignment is also its
+    // alignment within the buffer.
+    const UINT64 RingGranularity = 64 * 1024;
+
+    UINT64 RoundCapacity(UINT64 capacity)
+    {
+        capacity = (capacity + RingGranularity - 1) & ~(RingGranularity - 1);
+        return capacity > 0 ? capacity : RingGranularity;
+    }
+}
+
+UploadRing::UploadRing(ID3D12Device* device, UINT64 capacity) :
+    mCapacity(RoundCapacity(capacity))
+{
+    CD3DX12_HEAP_PROPERTIES heapProperties(D3D12_HEAP_TYPE_UPLOAD);
+    CD3DX12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(mCapacity);
+    ThrowIfFailed(device->CreateCommittedResource(
+        &heapProperties,
+        D3D12_HEAP_FLAG_NONE,
+        &bufferDesc,
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(&mUploadBuffer)));
+    mUploadBuffer->SetName(L"Upload Ring");
+
+    // Stays mapped for the life of the ring; the fences keep the CPU off
+    // memory the GPU is still reading.
+    ThrowIfFailed(mUploadBuffer->Map(0, nullptr, reinterpret_cast<void**>(&mMappedData)));
+    mGpuBase = mUploadBuffer->GetGPUVirtualAddress();
+}
+
+UploadRing::UploadRing(UINT64 capacity) :
+    mCapacity(RoundCapacity(capacity))
+{
+    mSystemMemory.resize((size_t)mCapacity);
+    mMappedData = mSystemMemory.data();
+    mGpuBase = 0x100000000ull;
+}
+
+UploadRing::~UploadRing()
+{
+    if (mUploadBuffer != nullptr)
+        mUploadBuffer->Unmap(0, nullptr);
+
+    mMappedData = nullptr;
+}
+
+void UploadRing::BeginFrame(UINT64 completedFence)
+{
+    while (!mFrames.empty() && mFrames.front().Fence <= completedFence)
+    {
+        mTail = mFrames.front().Head;
+        mFrames.pop_front();
+    }
+
+    mAllocations.store(0, std::memory_order_relaxed);
+    mFailures.store(0, std::memory_order_relaxed);
+    mBytesAllocated.store(0, std::memory_order_relaxed);
+    mBytesWasted.store(0, std::memory_order_relaxed);
+}
+
+void UploadRing::EndFrame(UINT64 fence)
+{
+    FrameMark mark;
+    mark.Fence = fence;
+    mark.Head = mHead.load(std::memory_order_relaxed);
+    mFrames.push_back(mark);
+}
+
+UploadAllocation UploadRing::Allocate(UINT64 size, UINT64 alignment)
+{
+    assert(alignment != 0 && (alignment & (alignment - 1)) == 0 && alignment <= RingGranularity);
+
+    UploadAllocation allocation;
+    UINT64 head = mHead.load(std::memory_order_relaxed);
+    UINT64 position;
+    for (;;)
+    {
+        position = (head + alignment - 1) & ~(alignment - 1);
+
+        // A piece never wraps around the end of the buffer; skip to the start.
+        if (position % mCapacity + size > mCapacity)
+            position = (position / mCapacity + 1) * mCapacity;
+
+        if (position + size - mTail > mCapacity)
+        {
+            mFailures.fetch_add(1, std::memory_order_relaxed);
+            return allocation;
+        }
+
+        if (mHead.compare_exchange_weak(head, position + size, std::memory_order_relaxed))
+            break;
+    }
+
+    mAllocations.fetch_add(1, std::memory_order_relaxed);
+    mBytesAllocated.fetch_add(size, std::memory_order_relaxed);
+    mBytesWasted.fetch_add(position - head, std::memory_order_relaxed);
+
+    const UINT64 offset = position % mCapacity;
+    allocation.Cpu = mMappedData + offset;
+    allocation.Gpu = mGpuBase + offset;
+    allocation.Offset = offset;
+    return allocation;
+}
+
+UploadRing::FrameStats UploadRing::GetFrameStats()const
+{
+    FrameStats stats;
+    stats.Allocations = mAllocations.load(std::memory_order_relaxed);
+    stats.Failures = mFailures.load(std::memory_order_relaxed);
+    stats.BytesAllocated = mBytesAllocated.load(std::memory_order_relaxed);
+    stats.BytesWasted = mBytesWasted.load(std::memory_order_relaxed);
+    return stats;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "d3dUtil.h"
+#include <atomic>
+#include <deque>
+
+// A piece of the ring: where to write it and where the GPU reads it.
+// Cpu is null when the ring was full.
+struct UploadAllocation
+{
+    BYTE* Cpu = nullptr;
+    D3D12_GPU_VIRTUAL_ADDRESS Gpu = 0;
+    UINT64 Offset = 0;      // From the start of the ring's buffer, for copies.
+};
+
+// Transient upload memory for per-frame data (object and pass constants,
+// instance data) carved front to back out of one persistently mapped buffer
+// shared by all frames in flight.
+//   - Allocations are only as large as the data; the alignment decides the
+//     padding in front of them, so 16-byte aligned structured data packs
+//     tightly and only root CBVs pay for the 256-byte placement rule.
+//   - Memory is given back a frame at a time: EndFrame tags everything
+//     allocated since the last EndFrame with the frame's fence value, and
+//     BeginFrame retires the frames whose fence the GPU has passed.
+//   - Allocate is lock-free and may be called from any thread; BeginFrame and
+//     EndFrame must not run at the same time as it.
+// When the ring is full Allocate fails instead of overwriting data still in
+// flight; the caller is expected to wait for the GPU and recreate it larger.
+class UploadRing
+{
+public:
+    // Counters for the allocations made since BeginFrame.
+    struct FrameStats
+    {
+        UINT Allocations = 0;
+        UINT Failures = 0;
+        UINT64 BytesAllocated = 0;
+        UINT64 BytesWasted = 0;
+    };
+
+    // Creates and maps an upload heap buffer of at least capacity bytes.
+    UploadRing(ID3D12Device* device, UINT64 capacity);
+
+    // System memory with made-up GPU addresses, for benchmarks without a device.
+    explicit UploadRing(UINT64 capacity);
+
+    UploadRing(const UploadRing& rhs) = delete;
+    UploadRing& operator=(const UploadRing& rhs) = delete;
+    ~UploadRing();
+
+    ID3D12Resource* Resource()const { return mUploadBuffer.Get(); }
+    UINT64 Capacity()const { return mCapacity; }
+
+    // Bytes between the oldest frame still in flight and the newest allocation.
+    UINT64 BytesInFlight()const { return mHead.load(std::memory_order_relaxed) - mTail; }
+
+    // Retires every frame whose fence value is <= completedFence and resets
+    // the frame counters.
+    void BeginFrame(UINT64 completedFence);
+    void EndFrame(UINT64 fence);
+
+    // alignment must be a power of two no larger than 64 KB.
+    UploadAllocation Allocate(UINT64 size, UINT64 alignment);
+
+    // Copies data into a 256-byte aligned piece for a root CBV; 0 when full.
+    template<typename T>
+    D3D12_GPU_VIRTUAL_ADDRESS AllocateConstants(const T& data)
+    {
+        UploadAllocation a = Allocate(sizeof(T), D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+        if (a.Cpu == nullptr)
+            return 0;
+        memcpy(a.Cpu, &data, sizeof(T));
+        return a.Gpu;
+    }
+
+    // Copies count elements into a 16-byte aligned piece for a root SRV; 0
+    // when full.  An empty array still gets an address to bind.
+    template<typename T>
+    D3D12_GPU_VIRTUAL_ADDRESS AllocateArray(const T* data, size_t count)
+    {
+        UploadAllocation a = Allocate(sizeof(T) * (count > 0 ? count : 1), 16);
+        if (a.Cpu == nullptr)
+            return 0;
+        if (count > 0)
+            memcpy(a.Cpu, data, sizeof(T) * count);
+        return a.Gpu;
+    }
+
+    FrameStats GetFrameStats()const;
+
+private:
+    // Byte positions only ever grow; the ring offset is the position modulo
+    // the capacity, so head - tail is always the space in use.
+    struct FrameMark
+    {
+        UINT64 Fence;
+        UINT64 Head;
+    };
+
+private:
+    Microsoft::WRL::ComPtr<ID3D12Resource> mUploadBuffer;
+    std::vector<BYTE> mSystemMemory;
+    BYTE* mMappedData = nullptr;
+    D3D12_GPU_VIRTUAL_ADDRESS mGpuBase = 0;
+    UINT64 mCapacity = 0;
+
+    std::atomic<UINT64> mHead{ 0 };
+    UINT64 mTail = 0;
+    std::deque<FrameMark> mFrames;
+
+    std::atomic<UINT> mAllocations{ 0 };
+    std::atomic<UINT> mFailures{ 0 };
+    std::atomic<UINT64> mBytesAllocated{ 0 };
+    std::atomic<UINT64> mBytesWasted{ 0 };
+};
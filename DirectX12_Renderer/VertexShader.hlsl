@@ -14,20 +14,17 @@
 
 #pragma enable_d3d11_debug_symbols
 
+// World is the transposed 3x4 affine part of the world matrix and
+// TexTransform the first two columns of the texture transform.
 cbuffer cbPerObject : register(b0)
 {
-    float4x4 gWorld;
-    float4x4 gTexTransform;
+    float4 gWorld[3];
+    float4 gTexTransform[2];
 };
 
 cbuffer cbPass : register(b1)
 {
-    float4x4 gView;
-    float4x4 gInvView;
-    float4x4 gProj;
-    float4x4 gInvProj;
     float4x4 gViewProj;
-    float4x4 gInvViewProj;
     float3 gEyePosW;
     float cbPerObjectPad1;
     float2 gRenderTargetSize;
@@ -36,8 +33,9 @@ cbuffer cbPass : register(b1)
     float gFarZ;
     float gTotalTime;
     float gDeltaTime;
-    float4 gAmbientLight;
-    Light gLights[MaxLights];
+    float gClusterSliceScale;
+    float gClusterSliceBias;
+    float2 cbPassPad2;
 };
 
 cbuffer cbMaterial : register(b2)
@@ -48,6 +46,19 @@ cbuffer cbMaterial : register(b2)
     float4x4 gMatTransform;
 };
 
+cbuffer cbLights : register(b3)
+{
+    float4 gAmbientLight;
+    Light gLights[MaxLights];
+};
+
+// Instanced path: a raw root SRV bound at the batch's data.  A 16-byte header
+// (flags), then per instance three world rows and, when the header has
+// INSTANCE_HAS_TEX_TRANSFORM, two texture transform rows.
+#define INSTANCE_HAS_TEX_TRANSFORM 0x1
+
+ByteAddressBuffer gInstanceData : register(t0, space1);
+
 struct VS_OUTPUT
 {
     float4 pos : SV_POSITION;
@@ -64,18 +75,45 @@ struct VS_INPUT
 };
 
 
-VS_OUTPUT VS(VS_INPUT input) {
+VS_OUTPUT TransformVertex(VS_INPUT input, float4 world[3], float4 texTransform[2])
+{
 	VS_OUTPUT output = (VS_OUTPUT)0.0f;
 
-    float4 worldpos = mul(float4(input.pos, 1.0f), gWorld);
+    float4 pos = float4(input.pos, 1.0f);
+    float4 worldpos = float4(dot(pos, world[0]), dot(pos, world[1]), dot(pos, world[2]), 1.0f);
     output.worldpos = worldpos.xyz;
 
-    output.normal = mul(input.normal, (float3x3)gWorld);
+    output.normal = float3(dot(input.normal, world[0].xyz), dot(input.normal, world[1].xyz), dot(input.normal, world[2].xyz));
 
     output.pos = mul(worldpos, gViewProj);
     
-    float4 tex = mul(float4(input.tex, 0.0f, 1.0f), gTexTransform);
+    float4 uv = float4(input.tex, 0.0f, 1.0f);
+    float4 tex = float4(dot(uv, texTransform[0]), dot(uv, texTransform[1]), 0.0f, 1.0f);
     output.tex = mul(tex, gMatTransform).xy;
 
 	return output;
 }
+
+VS_OUTPUT VS(VS_INPUT input) {
+    return TransformVertex(input, gWorld, gTexTransform);
+}
+
+VS_OUTPUT VSInstanced(VS_INPUT input, uint instanceID : SV_InstanceID) {
+    const uint flags = gInstanceData.Load(0);
+    const bool hasTexTransform = (flags & INSTANCE_HAS_TEX_TRANSFORM) != 0;
+    const uint address = 16 + instanceID * (hasTexTransform ? 80 : 48);
+
+    float4 world[3];
+    world[0] = asfloat(gInstanceData.Load4(address));
+    world[1] = asfloat(gInstanceData.Load4(address + 16));
+    world[2] = asfloat(gInstanceData.Load4(address + 32));
+
+    float4 texTransform[2] = { float4(1.0f, 0.0f, 0.0f, 0.0f), float4(0.0f, 1.0f, 0.0f, 0.0f) };
+    if (hasTexTransform)
+    {
+        texTransform[0] = asfloat(gInstanceData.Load4(address + 48));
+        texTransform[1] = asfloat(gInstanceData.Load4(address + 64));
+    }
+
+    return TransformVertex(input, world, texTransform);
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+// Builds a deduplicated vertex buffer from a stream of per-polygon-vertex
+// attributes.  Every 32-bit word of T takes part in the key, so whatever the
+// vertex layout holds (position, normal, uv, tangent, ...) is welded exactly;
+// the only canonicalization is -0.0f -> 0.0f.
+//
+// Lookups go through an open-addressing table of vertex indices with linear
+// probing, kept at most half full, so there is no per-vertex allocation.
+template<typename T>
+class VertexWelder
+{
+    static_assert(std::is_trivially_copyable<T>::value, "VertexWelder needs a plain vertex struct");
+    static_assert(sizeof(T) % sizeof(std::uint32_t) == 0, "VertexWelder hashes whole 32-bit words");
+
+public:
+    explicit VertexWelder(std::uint32_t expectedVertexCount = 0)
+    {
+        std::uint32_t capacity = 64;
+        while (capacity < expectedVertexCount * 2)
+            capacity *= 2;
+
+        mTable.assign(capacity, Empty);
+        mVertices.reserve(expectedVertexCount);
+    }
+
+    // Returns the index of v in Vertices(), appending it if it has not been seen.
+    std::uint32_t Add(const T& v)
+    {
+        T key;
+        Canonicalize(v, key);
+        mAddedCount++;
+
+        if ((mVertices.size() + 1) * 2 > mTable.size())
+            Grow();
+
+        const std::uint32_t mask = (std::uint32_t)mTable.size() - 1;
+        for (std::uint32_t slot = Hash(key) & mask; ; slot = (slot + 1) & mask)
+        {
+            const std::uint32_t index = mTable[slot];
+            if (index == Empty)
+            {
+                mTable[slot] = (std::uint32_t)mVertices.size();
+                mVertices.push_back(key);
+                return mTable[slot];
+            }
+
+            if (std::memcmp(&mVertices[index], &key, sizeof(T)) == 0)
+                return index;
+        }
+    }
+
+    const std::vector<T>& Vertices()const { return mVertices; }
+
+    // Number of Add calls versus number of unique vertices produced.
+    std::uint32_t AddedCount()const { return mAddedCount; }
+    std::uint32_t UniqueCount()const { return (std::uint32_t)mVertices.size(); }
+
+private:
+    enum : std::uint32_t { Empty = 0xFFFFFFFF };
+    static const std::uint32_t WordCount = sizeof(T) / sizeof(std::uint32_t);
+
+    static void Canonicalize(const T& v, T& key)
+    {
+        std::uint32_t words[WordCount];
+        std::memcpy(words, &v, sizeof(T));
+        for (std::uint32_t i = 0; i < WordCount; ++i)
+        {
+            if (words[i] == 0x80000000)
+                words[i] = 0;
+        }
+        std::memcpy(&key, words, sizeof(T));
+    }
+
+    // Murmur3-style mixing of every word of the vertex.
+    static std::uint32_t Hash(const T& key)
+    {
+        std::uint32_t words[WordCount];
+        std::memcpy(words, &key, sizeof(T));
+
+        std::uint32_t h = 0x9747B28C;
+        for (std::uint32_t i = 0; i < WordCount; ++i)
+        {
+            std::uint32_t k = words[i] * 0xCC9E2D51;
+            k = (k << 15) | (k >> 17);
+            h ^= k * 0x1B873593;
+            h = ((h << 13) | (h >> 19)) * 5 + 0xE6546B64;
+        }
+
+        h ^= h >> 16;
+        h *= 0x85EBCA6B;
+        h ^= h >> 13;
+        h *= 0xC2B2AE35;
+        h ^= h >> 16;
+        return h;
+    }
+
+    void Grow()
+    {
+        mTable.assign(mTable.size() * 2, Empty);
+
+        const std::uint32_t mask = (std::uint32_t)mTable.size() - 1;
+        for (std::uint32_t index = 0; index < (std::uint32_t)mVertices.size(); ++index)
+        {
+            std::uint32_t slot = Hash(mVertices[index]) & mask;
+            while (mTable[slot] != Empty)
+                slot = (slot + 1) & mask;
+            mTable[slot] = index;
+        }
+    }
+
+private:
+    std::vector<std::uint32_t> mTable;
+    std::vector<T> mVertices;
+    std::uint32_t mAddedCount = 0;
+};
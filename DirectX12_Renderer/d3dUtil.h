@@ -26,6 +26,7 @@
 #include <sstream>
 #include <cassert>
 #include "d3dx12.h"
+#include "Registry.h"
 #include "DDSTextureLoader.h"
 #include "MathHelper.h"
 
@@ -152,6 +153,12 @@ struct SubmeshGeometry
 	UINT StartIndexLocation = 0;
 	INT BaseVertexLocation = 0;
 
+    // Index width is chosen per submesh: 16-bit when every index fits, 32-bit
+    // otherwise.  IndexByteOffset is where this submesh's index view starts inside
+    // the shared index buffer; StartIndexLocation is relative to that view.
+    DXGI_FORMAT IndexFormat = DXGI_FORMAT_R16_UINT;
+    UINT IndexByteOffset = 0;
+
     // Bounding box of the geometry defined by this submesh. 
     // This is used in later chapters of the book.
 	DirectX::BoundingBox Bounds;
@@ -162,6 +169,9 @@ struct MeshGeometry
 	// Give it a name so we can look it up by name.
 	std::string Name;
 
+	// Dense index of this geometry, used in draw sort keys.
+	UINT GeoIndex = 0;
+
 	// System memory copies.  Use Blobs because the vertex/index format can be generic.
 	// It is up to the client to cast appropriately.  
 	Microsoft::WRL::ComPtr<ID3DBlob> VertexBufferCPU = nullptr;
@@ -181,13 +191,35 @@ struct MeshGeometry
 
 	// A MeshGeometry may store multiple geometries in one vertex/index buffer.
 	// Use this container to define the Submesh geometries so we can draw
-	// the Submeshes individually.
-	std::unordered_map<std::string, SubmeshGeometry> DrawArgs;
+	// the Submeshes individually.  Submeshes are addressed by the index
+	// AddSubmesh returns; FindSubmesh compares interned names for callers
+	// that only have the name.
+	std::vector<SubmeshGeometry> Submeshes;
+	std::vector<NameId> SubmeshNames;
+
+	UINT AddSubmesh(NameId name, const SubmeshGeometry& submesh)
+	{
+		Submeshes.push_back(submesh);
+		SubmeshNames.push_back(name);
+		return (UINT)Submeshes.size() - 1;
+	}
+
+	// Index of the named submesh, or UINT(-1).
+	UINT FindSubmesh(NameId name)const
+	{
+		for (UINT i = 0; i < (UINT)SubmeshNames.size(); ++i)
+		{
+			if (SubmeshNames[i] == name)
+				return i;
+		}
+		return (UINT)-1;
+	}
 
+	// Geometry without GPU buffers (headless benchmarks) yields null views.
 	D3D12_VERTEX_BUFFER_VIEW VertexBufferView()const
 	{
 		D3D12_VERTEX_BUFFER_VIEW vbv;
-		vbv.BufferLocation = VertexBufferGPU->GetGPUVirtualAddress();
+		vbv.BufferLocation = VertexBufferGPU ? VertexBufferGPU->GetGPUVirtualAddress() : 0;
 		vbv.StrideInBytes = VertexByteStride;
 		vbv.SizeInBytes = VertexBufferByteSize;
 
@@ -204,6 +236,17 @@ struct MeshGeometry
 		return ibv;
 	}
 
+	// View for a submesh that does not use the buffer-wide index format.
+	D3D12_INDEX_BUFFER_VIEW IndexBufferView(DXGI_FORMAT format, UINT byteOffset)const
+	{
+		D3D12_INDEX_BUFFER_VIEW ibv;
+		ibv.BufferLocation = (IndexBufferGPU ? IndexBufferGPU->GetGPUVirtualAddress() : 0) + byteOffset;
+		ibv.Format = format;
+		ibv.SizeInBytes = IndexBufferByteSize - byteOffset;
+
+		return ibv;
+	}
+
 	// We can free this memory after we finish upload to the GPU.
 	void DisposeUploaders()
 	{